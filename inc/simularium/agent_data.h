@@ -2,6 +2,7 @@
 #define AICS_AGENT_DATA_H
 
 #include "json/json-forwards.h"
+#include <cstdint>
 #include <vector>
 
 namespace aics {
@@ -23,7 +24,7 @@ namespace simularium {
 
     struct AgentData {
         float vis_type = 0;
-        float id = 0;
+        std::uint32_t id = 0; // floats only hold ids up to 2^24 exactly
         float type = 0;
         float x = 0;
         float y = 0;
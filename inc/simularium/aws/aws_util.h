@@ -1,11 +1,17 @@
 #ifndef AICS_AWS_UTIL_H
 #define AICS_AWS_UTIL_H
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace aics {
 namespace simularium {
     namespace aws_util {
+        // Objects are read from, and written to, the bucket SIMULARIUM_S3_BUCKET
+        //  in SIMULARIUM_S3_REGION, or at SIMULARIUM_S3_ENDPOINT if it is set;
+        //  the SDK and a single client are set up on first use, and shared
+        //  by every transfer of the process
 
         /**
          *   Download
@@ -29,6 +35,57 @@ namespace simularium {
          */
         bool Upload(std::string fileName, std::string objectName);
 
+        // An object in S3 and the local file it is transferred from or to
+        struct FileTransfer {
+            std::string objectName;
+            std::string fileName;
+        };
+
+        /**
+         *   DownloadAll, UploadAll
+         *
+         *   @param  transfers   the objects to download, or files to upload
+         *
+         *   runs the transfers in parallel, and waits for all of them;
+         *   returns false if any of them failed
+         */
+        bool DownloadAll(std::vector<FileTransfer> transfers);
+        bool UploadAll(std::vector<FileTransfer> transfers);
+
+        /**
+         *   GetETag
+         *
+         *   @param  objectName  the path in S3 to the object
+         *   @param  etag        set to the entity tag of the object
+         *
+         *   looks the object up with a HEAD request, without downloading it;
+         *   returns false if there is no such object, or S3 can't be reached
+         */
+        bool GetETag(std::string objectName, std::string& etag);
+
+        /**
+         *   GetSize
+         *
+         *   @param  objectName  the path in S3 to the object
+         *   @param  size        set to the size of the object in bytes
+         *
+         *   looks the object up with a HEAD request, like GetETag
+         */
+        bool GetSize(std::string objectName, std::uint64_t& size);
+
+        /**
+         *   DownloadRange
+         *
+         *   @param  objectName  the path in S3 to the object
+         *   @param  offset      the first byte to download
+         *   @param  size        the number of bytes to download
+         *   @param  out         receives the bytes
+         *
+         *   downloads part of an object with a ranged GET; returns false
+         *   unless all 'size' bytes were read
+         */
+        bool DownloadRange(std::string objectName, std::uint64_t offset, std::uint64_t size, std::vector<char>& out);
+
     } // namespace aws_util
 } // namespace simularium
 } // namespace aics
@@ -10,6 +10,32 @@ namespace simularium {
         std::string GetS3Location();
         std::string GetS3CacheLocation();
         std::string GetEnvironment();
+        std::string GetCacheCompressor();
+        int GetCacheCompressionLevel();
+        std::size_t GetCacheKeyframeInterval();
+        bool GetCacheQuantization();
+        bool GetCacheColumnarLayout();
+        bool GetCachePackedRecords();
+        float GetCacheFiberStep();
+        float GetCacheFiberTolerance();
+        std::size_t GetCacheStaticFrames();
+        bool GetCacheAttributeTable();
+        std::size_t GetCachePyramidLevels();
+        std::size_t GetCacheCheckpointInterval();
+        std::size_t GetCacheSegmentFrames();
+        std::size_t GetCachePrefetchSegments();
+        std::size_t GetCacheRangeBytes();
+        bool GetCachePersistent();
+        std::size_t GetCacheDiskQuota();
+        std::size_t GetCacheOpenFiles();
+        std::string GetCacheEvictionPolicy();
+        std::size_t GetCacheWriteBufferSize();
+        std::size_t GetFrameCacheSize();
+        std::string GetStorageBackend();
+        std::string GetStorageFolder();
+        std::string GetS3Bucket();
+        std::string GetS3Region();
+        std::string GetS3Endpoint();
 
     } // namespace config
 } // namespace simularium
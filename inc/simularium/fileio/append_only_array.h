@@ -0,0 +1,91 @@
+#ifndef AICS_APPEND_ONLY_ARRAY_H
+#define AICS_APPEND_ONLY_ARRAY_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+
+        /**
+         *   AppendOnlyArray
+         *
+         *   An array that one writer thread appends to while other threads
+         *   read it without locking. Elements are stored in segments that never
+         *   move, and an element is published to readers by the release store
+         *   of the element count that follows it
+         *
+         *   Readers may index any element below a Size() they have observed;
+         *   Clear is not safe to call while other threads are reading
+         */
+        template <typename T>
+        class AppendOnlyArray {
+        public:
+            AppendOnlyArray() = default;
+            AppendOnlyArray(const AppendOnlyArray&) = delete;
+            AppendOnlyArray& operator=(const AppendOnlyArray&) = delete;
+
+            // Returns false once every segment is full
+            bool Append(const T& value)
+            {
+                std::size_t index = this->m_size.load(std::memory_order_relaxed);
+                std::size_t offset = 0;
+                std::size_t segment = SegmentOf(index, offset);
+                if (segment >= kNumSegments) {
+                    return false;
+                }
+
+                if (!this->m_segments[segment]) {
+                    this->m_segments[segment].reset(new T[kFirstSegmentSize << segment]);
+                }
+
+                this->m_segments[segment][offset] = value;
+                this->m_size.store(index + 1, std::memory_order_release);
+                return true;
+            }
+
+            void Clear()
+            {
+                this->m_size.store(0, std::memory_order_release);
+                for (auto& segment : this->m_segments) {
+                    segment.reset();
+                }
+            }
+
+            std::size_t Size() const { return this->m_size.load(std::memory_order_acquire); }
+
+            const T& operator[](std::size_t index) const
+            {
+                std::size_t offset = 0;
+                std::size_t segment = SegmentOf(index, offset);
+                return this->m_segments[segment][offset];
+            }
+
+        private:
+            // Segment k holds kFirstSegmentSize << k elements
+            static const std::size_t kFirstSegmentSize = 1024;
+            static const std::size_t kNumSegments = 40;
+
+            static std::size_t SegmentOf(std::size_t index, std::size_t& offset)
+            {
+                std::size_t segment = 0;
+                for (std::size_t j = index / kFirstSegmentSize + 1; j > 1; j >>= 1) {
+                    segment++;
+                }
+
+                offset = index - kFirstSegmentSize * ((std::size_t(1) << segment) - 1);
+                return segment;
+            }
+
+            std::array<std::unique_ptr<T[]>, kNumSegments> m_segments;
+            std::atomic<std::size_t> m_size { 0 };
+        };
+
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_APPEND_ONLY_ARRAY_H
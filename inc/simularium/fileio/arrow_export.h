@@ -0,0 +1,88 @@
+#ifndef AICS_ARROW_EXPORT_H
+#define AICS_ARROW_EXPORT_H
+
+#include "simularium/agent_data.h"
+#include "simularium/fileio/segmented_binary_file.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace arrow {
+            // Arrow IPC files (Feather v2) start and end with this, see
+            //  https://arrow.apache.org/docs/format/Columnar.html#ipc-file-format
+            static const char kMagic[6] = { 'A', 'R', 'R', 'O', 'W', '1' };
+
+            // Column buffers are aligned for zero-copy SIMD reads
+            static const std::size_t kBufferAlignment = 64;
+
+            static const std::size_t kDefaultBatchFrames = 100;
+
+            // Location of a message in the file, as listed in the footer
+            struct Block {
+                std::int64_t offset = 0;
+                std::int32_t metaDataLength = 0; // continuation marker, length, and flatbuffer
+                std::int32_t padding = 0;
+                std::int64_t bodyLength = 0;
+            };
+
+            static_assert(sizeof(Block) == 24, "Block must be tightly packed");
+
+            /**
+             *   ArrowFileWriter
+             *
+             *   Writes frames to an Arrow IPC file, a record batch at a time,
+             *   with one row per agent:
+             *     frame uint32, time float32, id uint32, vis_type int32, type int32,
+             *     x, y, z, xrot, yrot, zrot, collision_radius float32,
+             *     subpoints list<float32>
+             *
+             *   None of the columns have nulls. The footer, which lists the
+             *   batches, is written on Close, so only the frames of the batch
+             *   being written are held in memory
+             */
+            class ArrowFileWriter {
+            public:
+                ~ArrowFileWriter();
+
+                bool Open(std::string filePath);
+                bool WriteBatch(const std::vector<TrajectoryFrame>& frames);
+                bool Close();
+
+            private:
+                bool WriteMessage(
+                    const std::vector<char>& metadata,
+                    const std::vector<char>& body,
+                    Block& block);
+
+                std::ofstream m_file;
+                std::int64_t m_position = 0;
+                std::vector<Block> m_batches;
+            };
+
+            /**
+             *   ExportCache
+             *
+             *   @param  cache           the runtime cache to export
+             *   @param  filePath        where to write the Arrow IPC file; an
+             *                           existing file will be overwritten
+             *   @param  batchFrames     frames per record batch
+             *
+             *   Frames are read the way they are streamed to clients, so
+             *   static agents and attributes are part of every row; frames
+             *   that aren't available yet are left out
+             */
+            bool ExportCache(
+                SegmentedBinaryFile& cache,
+                std::string filePath,
+                std::size_t batchFrames = kDefaultBatchFrames);
+
+        } // namespace arrow
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_ARROW_EXPORT_H
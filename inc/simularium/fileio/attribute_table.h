@@ -0,0 +1,103 @@
+#ifndef AICS_ATTRIBUTE_TABLE_H
+#define AICS_ATTRIBUTE_TABLE_H
+
+#include "simularium/agent_data.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace attributes {
+
+            /**
+             *   AttributeRecord
+             *
+             *   The fields of an agent that rarely change, as of the frame
+             *   at cache position 'frame'; they hold until the next record
+             *   for the same id
+             */
+            struct AttributeRecord {
+                std::uint32_t frame = 0;
+                std::uint32_t id = 0;
+                float visType = 0;
+                float type = 0;
+                float collisionRadius = 0;
+            };
+
+            static_assert(sizeof(AttributeRecord) == 20, "AttributeRecord must be tightly packed");
+
+            /**
+             *   AttributeTable
+             *
+             *   Change records for the attributes of every agent, in frame order
+             */
+            class AttributeTable {
+            public:
+                void Clear();
+                std::size_t Size() const { return this->m_records.size(); }
+                const AttributeRecord& operator[](std::size_t index) const { return this->m_records[index]; }
+
+                /**
+                 *   Record
+                 *
+                 *   Appends a record for every agent of the frame at 'frameIndex'
+                 *   whose attributes are new or changed. Agents that share an id
+                 *   can't be looked up, so nothing is recorded for such frames,
+                 *   and false is returned
+                 */
+                bool Record(std::size_t frameIndex, const TrajectoryFrame& frame);
+
+                // Records must be appended in frame order
+                void Append(const AttributeRecord& record);
+
+                /**
+                 *   Apply
+                 *
+                 *   Sets the attributes of every agent of the frame at 'frameIndex'
+                 *   from the table; returns false if an agent has no record
+                 */
+                bool Apply(std::size_t frameIndex, TrajectoryFrame& frame) const;
+
+                // Whether Apply would give every agent the attributes it has
+                bool Matches(std::size_t frameIndex, const TrajectoryFrame& frame) const;
+
+                // Number of records for frames up to and including 'frameIndex'
+                std::size_t NumRecordsThrough(std::size_t frameIndex) const;
+
+            private:
+                const AttributeRecord* Find(std::size_t frameIndex, std::uint32_t id) const;
+
+                std::vector<AttributeRecord> m_records;
+                std::unordered_map<std::uint32_t, std::vector<std::size_t>> m_recordsById; // in frame order
+            };
+
+            /**
+             *   Encode
+             *
+             *   Layout (little-endian, 4 byte values):
+             *     uint32 index of the first record, uint32 number of records N,
+             *     N records: uint32 frame, uint32 id, float vis_type, type, collision_radius
+             */
+            std::vector<char> Encode(const AttributeTable& table, std::size_t begin, std::size_t end);
+            bool Decode(const char* data, std::size_t size, std::vector<AttributeRecord>& records);
+
+            /**
+             *   SerializeFrame
+             *
+             *   A float chunk without the attributes: frame number, time,
+             *   number of agents, then per agent: id (the bits of a uint32),
+             *   x, y, z, xrot, yrot, zrot, n-subpoints, subpoints
+             */
+            void SerializeFrame(const TrajectoryFrame& frame, std::vector<float>& out);
+
+            // Parses a chunk written by SerializeFrame; the attributes are left at 0
+            bool ParseFrame(const char* data, std::size_t size, TrajectoryFrame& frame);
+
+        } // namespace attributes
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_ATTRIBUTE_TABLE_H
@@ -0,0 +1,87 @@
+#ifndef AICS_COLUMNAR_FRAME_H
+#define AICS_COLUMNAR_FRAME_H
+
+#include "simularium/agent_data.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace columnar {
+
+            // A run of consecutive agents that share a type
+            struct TypeGroup {
+                float type = 0;
+                std::uint32_t first = 0;
+                std::uint32_t count = 0;
+            };
+
+            /**
+             *   ColumnarFrame
+             *
+             *   A frame stored as one contiguous array per field, with agents
+             *   grouped by type so each group can be uploaded as an instanced buffer
+             */
+            struct ColumnarFrame {
+                std::size_t frameNumber = 0;
+                float time = 0;
+                std::vector<TypeGroup> groups;
+
+                std::vector<std::uint32_t> ids;
+                std::vector<float> types;
+                std::vector<float> visTypes;
+                std::vector<float> positions; // x, y, z per agent
+                std::vector<float> rotations; // xrot, yrot, zrot per agent
+                std::vector<float> radii;
+
+                // subpoints of agent i are [subpointOffsets[i], subpointOffsets[i + 1])
+                std::vector<std::uint32_t> subpointOffsets;
+                std::vector<float> subpoints;
+
+                std::size_t NumAgents() const { return this->ids.size(); }
+            };
+
+            /**
+             *   GroupByType
+             *
+             *   Stable sorts the agents of a frame by type
+             */
+            void GroupByType(TrajectoryFrame& frame);
+
+            ColumnarFrame ToColumnar(const TrajectoryFrame& frame);
+            TrajectoryFrame FromColumnar(const ColumnarFrame& frame);
+
+            /**
+             *   Encode
+             *
+             *   Chunk layout (little-endian, 4 byte values):
+             *     uint32 frame number, float time, uint32 number of agents (n),
+             *     uint32 number of type groups (g)
+             *     g x { float type, uint32 first agent, uint32 agent count }
+             *     uint32 ids[n], float types[n], vis_types[n]
+             *     float positions[n][3], rotations[n][3], radii[n]
+             *     uint32 subpoint offsets[n + 1]
+             *     float subpoints[subpoint offsets[n]]
+             */
+            std::vector<char> Encode(const ColumnarFrame& frame);
+            bool Decode(const char* data, std::size_t size, ColumnarFrame& frame);
+
+            /**
+             *   ComputeBounds
+             *
+             *   Axis aligned bounds of the agent positions; empty frames
+             *   return an inverted (lo > hi) box
+             */
+            void ComputeBounds(
+                const ColumnarFrame& frame,
+                std::array<float, 3>& lo,
+                std::array<float, 3>& hi);
+
+        } // namespace columnar
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_COLUMNAR_FRAME_H
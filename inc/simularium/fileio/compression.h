@@ -0,0 +1,77 @@
+#ifndef AICS_COMPRESSION_H
+#define AICS_COMPRESSION_H
+
+#include <string>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace compression {
+
+            enum Compressor {
+                None = 0,
+                LZ4 = 1,
+                ZSTD = 2
+            };
+
+            struct CompressionOptions {
+                Compressor compressor = Compressor::None;
+                int level = 5; // 0 (no compression) - 9 (max compression)
+                bool byteShuffle = true;
+                int numThreads = 4;
+            };
+
+            /**
+             *   IsAvailable
+             *
+             *   Returns true if the server was built with blosc support
+             */
+            bool IsAvailable();
+
+            /**
+             *   ParseCompressor
+             *
+             *   @param  name    "lz4", "zstd", or "none"
+             *
+             *   Unrecognized names map to Compressor::None
+             */
+            Compressor ParseCompressor(std::string name);
+
+            /**
+             *   Compress
+             *
+             *   @param  src         the float data to compress
+             *   @param  size        the size of src, in bytes
+             *   @param  options     compressor, level, and thread settings
+             *   @param  out         receives the compressed blosc chunk
+             *
+             *   Returns false if the data could not be compressed
+             *   e.g. blosc is unavailable, or the result would be larger than the input
+             */
+            bool Compress(
+                const char* src,
+                std::size_t size,
+                const CompressionOptions& options,
+                std::vector<char>& out);
+
+            /**
+             *   Decompress
+             *
+             *   @param  src         a blosc chunk written by Compress
+             *   @param  size        the size of src, in bytes
+             *   @param  numThreads  the number of threads blosc may use
+             *   @param  out         receives the decompressed data
+             */
+            bool Decompress(
+                const char* src,
+                std::size_t size,
+                int numThreads,
+                std::vector<char>& out);
+
+        } // namespace compression
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_COMPRESSION_H
@@ -0,0 +1,91 @@
+#ifndef AICS_FIBER_CODEC_H
+#define AICS_FIBER_CODEC_H
+
+#include "simularium/agent_data.h"
+#include <cstdint>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace fiber {
+
+            // vis_type_fiber; the subpoints of fibers are x, y, z points along the fiber
+            static const float kFiberVisType = 1001;
+
+            struct FiberOptions {
+                // Quantization step of the points, in simulation units;
+                //  0 stores fibers like any other agent
+                float step = 0;
+
+                // Points closer than this to the simplified polyline are
+                //  dropped (Douglas-Peucker); 0 keeps every point
+                float tolerance = 0;
+            };
+
+            // A fiber section, see EncodeFibers
+            struct EncodedFibers {
+                std::vector<char> section;
+                float error = 0; // largest distance of an original point from the stored polyline
+                std::size_t numSubpoints = 0; // subpoint values of the stored fibers
+            };
+
+            /**
+             *   Simplify
+             *
+             *   @param  points      x, y, z per point
+             *   @param  tolerance   the largest distance of a dropped point
+             *                       from the simplified polyline
+             *
+             *   Returns the indices of the points to keep; the first
+             *   and the last point are always kept
+             */
+            std::vector<std::size_t> Simplify(const std::vector<float>& points, float tolerance);
+
+            /**
+             *   EncodeFibers
+             *
+             *   @param  frame       subpoints of its fibers are moved into the
+             *                       section, and cleared
+             *   @param  options     the quantization step and simplification tolerance
+             *   @param  out         receives the fiber section
+             *
+             *   Section layout (little-endian):
+             *     uint32 number of fiber records, float quantization step
+             *     per fiber, in agent order: varint (LEB128) number of points + 1,
+             *       or 0 for a fiber that was left as-is; then the first point
+             *       as 3 floats, and every following point as the zigzag varint
+             *       x, y, and z steps from the point before it
+             *     uint32 size of the section, including this value
+             *
+             *   Steps are taken from the decoded point before, so the
+             *   quantization error does not build up along a fiber
+             *   Returns false, leaving the frame as-is, if it has no fibers
+             */
+            bool EncodeFibers(TrajectoryFrame& frame, const FiberOptions& options, EncodedFibers& out);
+
+            /**
+             *   SplitChunk
+             *
+             *   @param  data        a chunk that ends with a fiber section
+             *   @param  size        the size of data, in bytes
+             *   @param  bodySize    receives the size of the chunk before the section
+             */
+            bool SplitChunk(const char* data, std::size_t size, std::size_t& bodySize);
+
+            /**
+             *   DecodeFibers
+             *
+             *   @param  data    a fiber section written by EncodeFibers
+             *   @param  size    the size of data, in bytes
+             *   @param  frame   the frame the section was taken from, with
+             *                   the subpoints of its fibers restored in place
+             */
+            bool DecodeFibers(const char* data, std::size_t size, TrajectoryFrame& frame);
+
+        } // namespace fiber
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_FIBER_CODEC_H
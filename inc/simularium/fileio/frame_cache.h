@@ -0,0 +1,108 @@
+#ifndef AICS_FRAME_CACHE_H
+#define AICS_FRAME_CACHE_H
+
+#include "simularium/fileio/simularium_binary_file.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+
+        struct FrameCacheStats {
+            std::uint64_t hits = 0;
+            std::uint64_t misses = 0; // requests that loaded the frame
+            std::uint64_t shared = 0; // requests that waited on another request's load
+            std::uint64_t evictions = 0;
+            std::size_t bytes = 0;
+            std::size_t entries = 0;
+        };
+
+        /**
+         *   FrameCache
+         *
+         *   Keeps the single frame updates served most recently in memory,
+         *   keyed by cache identifier, frame number, and the stream options
+         *   they were read with
+         *
+         *   Frame data is copied into the cache, so entries don't keep the
+         *   files they were read from mapped. The cache is split into shards,
+         *   each with its own lock and least recently used list, and
+         *   'capacity' bytes split evenly between them
+         */
+        class FrameCache {
+        public:
+            static const std::size_t kDefaultShards = 16;
+
+            explicit FrameCache(std::size_t capacity = 0, std::size_t numShards = kDefaultShards);
+
+            /**
+             *   GetOrLoad
+             *
+             *   @param  load    reads the update from disk on a miss
+             *
+             *   Concurrent requests for the same frame share a single
+             *   load; updates without frames aren't kept
+             */
+            BroadcastUpdate GetOrLoad(
+                const std::string& identifier,
+                std::size_t frameNumber,
+                const StreamOptions& options,
+                std::function<BroadcastUpdate()> load);
+
+            // Drops every frame of the cache, loads in flight aren't kept
+            void Invalidate(const std::string& identifier);
+            void Clear();
+
+            FrameCacheStats GetStats();
+            bool IsEnabled() { return this->m_shardCapacity > 0; }
+
+        private:
+            struct Entry {
+                std::string identifier;
+                BroadcastUpdate update;
+                std::size_t size = 0;
+                std::list<std::string>::iterator lruPos;
+            };
+
+            struct Shard {
+                std::mutex mutex;
+                std::list<std::string> lru; // most recently used first
+                std::unordered_map<std::string, Entry> entries;
+                std::unordered_map<std::string, std::shared_future<BroadcastUpdate>> loading;
+                std::size_t bytes = 0;
+            };
+
+            static std::string MakeKey(
+                const std::string& identifier,
+                std::size_t frameNumber,
+                const StreamOptions& options);
+
+            Shard& GetShard(const std::string& key);
+            void Insert(Shard& shard, const std::string& key, const std::string& identifier, BroadcastUpdate update);
+
+            std::size_t m_shardCapacity = 0;
+            std::vector<std::unique_ptr<Shard>> m_shards;
+
+            // Bumped on invalidation, loads that started before are not kept
+            std::atomic<std::uint64_t> m_generation { 0 };
+
+            std::atomic<std::uint64_t> m_hits { 0 };
+            std::atomic<std::uint64_t> m_misses { 0 };
+            std::atomic<std::uint64_t> m_shared { 0 };
+            std::atomic<std::uint64_t> m_evictions { 0 };
+        };
+
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_FRAME_CACHE_H
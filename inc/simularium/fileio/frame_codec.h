@@ -0,0 +1,136 @@
+#ifndef AICS_FRAME_CODEC_H
+#define AICS_FRAME_CODEC_H
+
+#include "simularium/agent_data.h"
+#include <cstdint>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace codec {
+
+            // Fields that may be carried by an agent record in a delta frame
+            enum DeltaField : std::uint32_t {
+                delta_vis_type = 1 << 0,
+                delta_type = 1 << 1,
+                delta_x = 1 << 2,
+                delta_y = 1 << 3,
+                delta_z = 1 << 4,
+                delta_xrot = 1 << 5,
+                delta_yrot = 1 << 6,
+                delta_zrot = 1 << 7,
+                delta_collision_radius = 1 << 8,
+                delta_subpoints = 1 << 9, // n-subpoints followed by the subpoints
+                delta_all_fields = (1 << 10) - 1
+            };
+
+            // Ids up to this one are stored exactly as floats
+            static const std::uint32_t kMaxFloatId = 1 << 24;
+
+            /**
+             *   IdsFitInFloat
+             *
+             *   Whether the ids of a frame survive float chunks and deltas
+             *   as-is; larger ids are rounded
+             */
+            bool IdsFitInFloat(const TrajectoryFrame& frame);
+
+            // Float chunk fields per agent, without the subpoints
+            static const std::size_t kAgentStride = 11;
+
+            // Layouts of the agents in a float chunk, see FrameCodec
+            struct FixedStrideLayout {
+            }; // no agent has subpoints, so every agent takes kAgentStride floats
+            struct GeneralLayout {
+            }; // agents are followed by their subpoints, e.g. fibers
+
+            /**
+             *   FrameCodec
+             *
+             *   Writes and reads float chunks for frames of one Layout
+             *   Accepts() tells whether a frame, or a chunk, has that layout;
+             *   the chunks of both layouts are the same, byte for byte
+             */
+            template <typename Layout>
+            struct FrameCodec;
+
+            template <>
+            struct FrameCodec<FixedStrideLayout> {
+                static bool Accepts(const TrajectoryFrame& frame);
+                static bool Accepts(const char* data, std::size_t size);
+                static void Serialize(const TrajectoryFrame& frame, std::vector<float>& out);
+                static bool Parse(const char* data, std::size_t size, TrajectoryFrame& frame);
+            };
+
+            template <>
+            struct FrameCodec<GeneralLayout> {
+                static bool Accepts(const TrajectoryFrame&) { return true; }
+                static bool Accepts(const char*, std::size_t) { return true; }
+                static void Serialize(const TrajectoryFrame& frame, std::vector<float>& out);
+                static bool Parse(const char* data, std::size_t size, TrajectoryFrame& frame);
+            };
+
+            /**
+             *   SerializeFrame
+             *
+             *   Returns the float chunk for a frame: frame number, time,
+             *   number of agents, then every agent as serialized by Serialize(AgentData&)
+             *   Frames without subpoints are written with FrameCodec<FixedStrideLayout>
+             */
+            std::vector<float> SerializeFrame(const TrajectoryFrame& frame);
+
+            // Serializes into 'out', reusing its capacity
+            void SerializeFrame(const TrajectoryFrame& frame, std::vector<float>& out);
+
+            /**
+             *   ParseFrame
+             *
+             *   @param  data    a float chunk written by SerializeFrame
+             *   @param  size    the size of data, in bytes
+             *   @param  frame   receives the parsed frame
+             *
+             *   Returns false if the chunk is truncated or malformed
+             *   Chunks without subpoints are read with FrameCodec<FixedStrideLayout>
+             */
+            bool ParseFrame(const char* data, std::size_t size, TrajectoryFrame& frame);
+
+            /**
+             *   EncodeDelta
+             *
+             *   @param  previous    the frame the delta is applied to
+             *   @param  current     the frame to encode
+             *   @param  out         receives the delta chunk
+             *
+             *   Agents are matched by id. The delta chunk is a float sequence:
+             *     frame number, time, number of agents,
+             *     number of removed agents, [id] per removed agent,
+             *     number of agent records, [id, DeltaField mask, changed fields] per record
+             *   Records for agents that are not in the previous frame carry every
+             *   field and are appended, in order, after the surviving agents
+             *
+             *   Returns false (and a keyframe should be written instead) if the
+             *   agents can't be described that way, e.g. duplicate ids, ids that
+             *   don't fit in a float, or reordered agents, or if the delta would
+             *   not be smaller than the frame
+             */
+            bool EncodeDelta(
+                const TrajectoryFrame& previous,
+                const TrajectoryFrame& current,
+                std::vector<float>& out);
+
+            /**
+             *   ApplyDelta
+             *
+             *   @param  data    a delta chunk written by EncodeDelta
+             *   @param  size    the size of data, in bytes
+             *   @param  frame   the previous frame; updated in place
+             */
+            bool ApplyDelta(const char* data, std::size_t size, TrajectoryFrame& frame);
+
+        } // namespace codec
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_FRAME_CODEC_H
@@ -0,0 +1,98 @@
+#ifndef AICS_FRAME_INDEX_H
+#define AICS_FRAME_INDEX_H
+
+#include "simularium/agent_data.h"
+#include "simularium/fileio/append_only_array.h"
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+
+        // Per-frame summary, stored in the index file next to each cache
+        struct FrameStats {
+            double time = 0; // simulation time of the frame
+            std::uint32_t numAgents = 0;
+            std::uint32_t frameSize = 0; // bytes of the frame as a full float chunk, as streamed
+
+            // Axis aligned bounds of the agent positions;
+            //  frames without agents have lo > hi
+            std::array<float, 3> lo = { { 0, 0, 0 } };
+            std::array<float, 3> hi = { { 0, 0, 0 } };
+        };
+
+        static_assert(sizeof(FrameStats) == 40, "FrameStats must be tightly packed");
+
+        /**
+         *   ComputeFrameStats
+         *
+         *   @param  frame       the frame to summarize
+         *   @param  scratch     reused between calls to hold the position columns
+         */
+        FrameStats ComputeFrameStats(const TrajectoryFrame& frame, std::vector<float>& scratch);
+
+        /**
+         *   FrameIndex
+         *
+         *   A FrameStats record per frame, kept in memory and appended to a
+         *   sidecar file: "SIMULARIUMIDX" followed by a major, minor, and
+         *   patch byte, then one 40 byte FrameStats per frame
+         *
+         *   Like the TOC, records are appended by one writer thread and can be
+         *   read from other threads without locking
+         */
+        class FrameIndex {
+        public:
+            /**
+             *   Create
+             *
+             *   @param  filePath    where to create the index; an existing
+             *                       index will be overwritten
+             */
+            bool Create(std::string filePath);
+
+            /**
+             *   Open
+             *
+             *   @param  filePath    the index of an existing cache
+             *   @param  numFrames   the number of frames in the cache; records
+             *                       past it are ignored, and overwritten by new frames
+             *
+             *   A missing or unreadable index is replaced with an empty one,
+             *   Size() tells how many frames still need to be indexed
+             */
+            bool Open(std::string filePath, std::size_t numFrames);
+
+            // Records reach the file on Flush
+            void Append(const FrameStats& stats);
+            void Flush();
+
+            std::size_t Size() const { return this->m_stats.Size(); }
+            const FrameStats& operator[](std::size_t index) const { return this->m_stats[index]; }
+
+            /**
+             *   FindFrameForTime
+             *
+             *   @param  time        the simulation time to look for
+             *   @param  numFrames   only the first numFrames records are searched
+             *
+             *   Binary search for the frame closest in time, preferring the later
+             *   frame on a tie; frame times are expected to never decrease
+             */
+            std::size_t FindFrameForTime(double time, std::size_t numFrames) const;
+
+        private:
+            std::fstream m_fstream;
+            AppendOnlyArray<FrameStats> m_stats;
+            std::size_t m_numFlushed = 0;
+        };
+
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_FRAME_INDEX_H
@@ -0,0 +1,59 @@
+#ifndef AICS_MAPPED_FILE_H
+#define AICS_MAPPED_FILE_H
+
+#include <string>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+
+        /**
+         *   MappedFile
+         *
+         *   A read-only memory mapping of a file on disk
+         *   The mapping covers the file as it was when Map was called;
+         *   data appended afterwards is not visible through it
+         */
+        class MappedFile {
+        public:
+            MappedFile() = default;
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            bool Map(std::string filePath);
+            void Unmap();
+
+            const char* GetData() const { return this->m_data; }
+            std::size_t GetSize() const { return this->m_size; }
+            bool IsMapped() const { return this->m_data != nullptr; }
+
+            /**
+             *   AdviseSequential
+             *
+             *   Hints to the kernel that the mapping will be read front to back
+             *   so it can read ahead aggressively and drop pages behind
+             */
+            void AdviseSequential();
+
+            /**
+             *   AdviseWillNeed
+             *
+             *   @param  offset  the start of the byte range that will be read soon
+             *   @param  length  the length of the byte range
+             *
+             *   Starts paging in the given range before it is accessed
+             */
+            void AdviseWillNeed(std::size_t offset, std::size_t length);
+
+        private:
+            char* m_data = nullptr;
+            std::size_t m_size = 0;
+        };
+
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_MAPPED_FILE_H
@@ -0,0 +1,62 @@
+#ifndef AICS_PACKED_FRAME_H
+#define AICS_PACKED_FRAME_H
+
+#include "simularium/agent_data.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ *   SIMULARIUM_PACKED_AGENT_FIELDS
+ *
+ *   The fixed-size part of a packed agent record, in order, as
+ *   FIELD(AgentData member, stored type, offset subtracted before storing)
+ *   Vis types start at vis_type_default (1000), so they fit a byte
+ *   Records are followed by a varint subpoint count and the subpoints;
+ *   the readers and writers in packed_frame.cpp are generated from this list
+ */
+#define SIMULARIUM_PACKED_AGENT_FIELDS(FIELD) \
+    FIELD(id, std::uint32_t, 0)               \
+    FIELD(type, std::uint16_t, 0)             \
+    FIELD(vis_type, std::uint8_t, 1000)       \
+    FIELD(x, float, 0)                        \
+    FIELD(y, float, 0)                        \
+    FIELD(z, float, 0)                        \
+    FIELD(xrot, float, 0)                     \
+    FIELD(yrot, float, 0)                     \
+    FIELD(zrot, float, 0)                     \
+    FIELD(collision_radius, float, 0)
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace packed {
+
+            /**
+             *   CanPack
+             *
+             *   Whether every agent field of a frame fits its stored type
+             *   without loss, e.g. types are whole numbers below 2^16 and
+             *   vis types are whole numbers from 1000 to 1255
+             */
+            bool CanPack(const TrajectoryFrame& frame);
+
+            /**
+             *   Encode
+             *
+             *   Chunk layout (little-endian, no padding):
+             *     uint32 frame number, float time, uint32 number of agents
+             *     per agent: the fields of SIMULARIUM_PACKED_AGENT_FIELDS,
+             *     a varint (LEB128) subpoint count, then float subpoints
+             *     zero padding up to a multiple of 4 bytes
+             *
+             *   Returns false, leaving out empty, if the frame can't be packed
+             */
+            bool Encode(const TrajectoryFrame& frame, std::vector<char>& out);
+            bool Decode(const char* data, std::size_t size, TrajectoryFrame& frame);
+
+        } // namespace packed
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_PACKED_FRAME_H
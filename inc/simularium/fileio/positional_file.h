@@ -0,0 +1,49 @@
+#ifndef AICS_POSITIONAL_FILE_H
+#define AICS_POSITIONAL_FILE_H
+
+#include <cstdint>
+#include <string>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+
+        /**
+         *   PositionalFile
+         *
+         *   A read-only file handle that reads at explicit offsets (pread),
+         *   without a shared seek position, so any number of threads can
+         *   read through it at once while another handle appends to the file
+         */
+        class PositionalFile {
+        public:
+            PositionalFile() = default;
+            ~PositionalFile();
+
+            PositionalFile(const PositionalFile&) = delete;
+            PositionalFile& operator=(const PositionalFile&) = delete;
+
+            bool Open(std::string filePath);
+            void Close();
+            bool IsOpen() const { return this->m_fd >= 0; }
+
+            /**
+             *   Read
+             *
+             *   @param  offset  file position to read from
+             *   @param  out     receives 'size' bytes
+             *   @param  size    number of bytes to read
+             *
+             *   Returns false unless all 'size' bytes could be read
+             */
+            bool Read(std::uint64_t offset, char* out, std::size_t size) const;
+
+        private:
+            int m_fd = -1;
+        };
+
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_POSITIONAL_FILE_H
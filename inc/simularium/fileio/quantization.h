@@ -0,0 +1,65 @@
+#ifndef AICS_QUANTIZATION_H
+#define AICS_QUANTIZATION_H
+
+#include "simularium/agent_data.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace quantization {
+
+            struct QuantizationOptions {
+                bool enabled = false;
+
+                // Simulation box, centered on the origin; positions outside
+                //  of it widen the quantized range for that frame
+                std::array<float, 3> boxSize = { { 0, 0, 0 } };
+            };
+
+            // Largest absolute error introduced by quantization
+            struct QuantizationError {
+                float position = 0; // in simulation units, per axis
+                float rotation = 0; // in radians
+                float fiber = 0; // distance of fiber points from the stored fibers, see fiber::EncodeFibers
+            };
+
+            /**
+             *   EncodeFrame
+             *
+             *   @param  frame       the frame to quantize
+             *   @param  options     the simulation box to normalize positions to
+             *   @param  error       receives the error bound for this frame
+             *
+             *   Positions are stored as 16-bit fixed point over the box, rotations
+             *   (Euler XYZ, radians) as smallest-three quaternions in 48 bits.
+             *   The chunk layout is:
+             *     float frame number, time, number of agents
+             *     float range origin[3], range step[3]
+             *     uint16 x[n], y[n], z[n]
+             *     uint16 rotation[3][n]
+             *     float vis_type[n], id[n], type[n], collision_radius[n], n-subpoints[n]
+             *     float subpoints, for every agent in order
+             */
+            std::vector<char> EncodeFrame(
+                const TrajectoryFrame& frame,
+                const QuantizationOptions& options,
+                QuantizationError& error);
+
+            /**
+             *   DecodeFrame
+             *
+             *   @param  data    a chunk written by EncodeFrame
+             *   @param  size    the size of data, in bytes
+             *   @param  frame   receives the decoded frame
+             */
+            bool DecodeFrame(const char* data, std::size_t size, TrajectoryFrame& frame);
+
+        } // namespace quantization
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_QUANTIZATION_H
@@ -0,0 +1,278 @@
+#ifndef AICS_SEGMENTED_BINARY_FILE_H
+#define AICS_SEGMENTED_BINARY_FILE_H
+
+#include "simularium/fileio/simularium_binary_file.h"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace segments {
+            // A segmented cache is a manifest, [cache path]MANIFEST_FILE_SUFFIX,
+            //  and segment n, a binary cache of its own, [cache path]SEGMENT_FILE_SUFFIX[n]
+            static const char* const MANIFEST_FILE_SUFFIX = ".manifest";
+            static const char* const SEGMENT_FILE_SUFFIX = ".seg";
+            static const std::size_t MANIFEST_HEADER_SIZE = 16;
+
+            struct SegmentInfo {
+                std::uint64_t numFrames = 0;
+                double startTime = 0; // simulation time of the first frame
+            };
+
+            /**
+             *   Manifest
+             *
+             *   Layout (little-endian): "SIMULARIUMSEG" followed by a major,
+             *   minor, and patch byte, uint64 frames per segment, uint64 number
+             *   of segments N, then N times: uint64 number of frames, float64
+             *   time of the first frame. Segment n starts at frame
+             *   n * 'segmentFrames', and holds up to that many; segments are
+             *   filled in any order, so some may have no frames yet
+             */
+            struct Manifest {
+                std::uint64_t segmentFrames = 0;
+                std::vector<SegmentInfo> segments;
+
+                std::size_t NumFrames() const;
+            };
+
+            bool ReadManifest(std::string filePath, Manifest& manifest);
+            bool WriteManifest(std::string filePath, const Manifest& manifest);
+
+            std::string ManifestPath(const std::string& cachePath);
+            std::string SegmentPath(const std::string& cachePath, std::size_t segment);
+        } // namespace segments
+
+        // A single binary cache that is downloaded a range at a time has a
+        //  sidecar [cache path]PARTIAL_FILE_SUFFIX with the number of frames
+        //  downloaded so far, which is removed once every frame is there
+        static const char* const PARTIAL_FILE_SUFFIX = ".partial";
+
+        // Frames [begin, end) of a cache
+        struct FrameRange {
+            std::size_t begin = 0;
+            std::size_t end = 0;
+        };
+
+        /**
+         *   SegmentedBinaryFile
+         *
+         *   A runtime cache that is either a single binary cache at the
+         *   cache path, or a manifest and segment files of a fixed number of
+         *   frames each. Segments can be transferred in parallel, and are
+         *   read as soon as their file is there, so a cache can be fetched,
+         *   and evicted, one segment at a time
+         *
+         *   Frames are numbered across the whole cache. Static agents and
+         *   attribute tables are kept per segment, so clients of a cache
+         *   with more than one segment get every frame with its static
+         *   agents and attributes
+         *
+         *   Segments of a segmented cache can be written out of order, e.g.
+         *   to fill the frames clients are watching first; each segment is
+         *   written from its first frame on, and frames of a segment that
+         *   isn't filled up to them yet are reported as not available
+         */
+        class SegmentedBinaryFile {
+        public:
+            ~SegmentedBinaryFile();
+
+            /**
+             *   SetSegmentSettings
+             *
+             *   @param  configure   applied to every segment before it is
+             *                       created or opened, e.g. to set compression
+             */
+            void SetSegmentSettings(std::function<void(SimulariumBinaryFile&)> configure) { this->m_configure = configure; }
+
+            /**
+             *   Create
+             *
+             *   @param  filePath        the cache path; existing files of a
+             *                           cache at this path are overwritten
+             *   @param  segmentFrames   the number of frames per segment;
+             *                           0 writes a single binary cache
+             */
+            void Create(std::string filePath, std::size_t segmentFrames = 0);
+
+            /**
+             *   Open
+             *
+             *   @param  filePath    the cache path of an existing cache, segmented
+             *                       if there is a manifest next to it
+             *
+             *   Segments that aren't there yet are opened once they are
+             */
+            void Open(std::string filePath);
+
+            /**
+             *   CreatePartial
+             *
+             *   @param  filePath    the cache path
+             *   @param  read        reads byte ranges of the single binary cache
+             *                       that is downloaded to the cache path
+             *   @param  fileSize    the size of that cache
+             *
+             *   Copies the layout of the cache without its frames, see
+             *   SimulariumBinaryFile::CopyLayout; once opened, frames are
+             *   readable as they are added by AddDownloadedFrames
+             */
+            static bool CreatePartial(std::string filePath, const RangeReader& read, std::uint64_t fileSize);
+
+            // Whether there is a cache, of either layout, at the cache path
+            static bool Exists(std::string filePath);
+
+            // Deletes every file of the cache at the cache path
+            static void Remove(std::string filePath);
+
+            /**
+             *   WriteFrame
+             *
+             *   Writes the frame at the write position, and moves past it;
+             *   returns false once the position reaches a frame that was
+             *   already written
+             */
+            bool WriteFrame(TrajectoryFrame frame);
+
+            /**
+             *   SetWritePosition
+             *
+             *   @param  frameNumber     the frame written next, which must be
+             *                           where its segment is filled up to,
+             *                           see GetFillPosition
+             *
+             *   Only segmented caches can be written out of order
+             */
+            bool SetWritePosition(std::size_t frameNumber);
+            std::size_t GetWritePosition() { return this->m_writePos; }
+
+            // The frame writing has to start at to get to the frame
+            std::size_t GetFillPosition(std::size_t frameNumber);
+
+            void Flush();
+            std::size_t Checkpoint();
+
+            bool IsSegmented() { return this->m_manifest.segmentFrames > 0; }
+            std::size_t NumSegments();
+            std::size_t SegmentFrames() { return this->m_manifest.segmentFrames; }
+
+            // Whether the segment is on local disk
+            bool HasSegment(std::size_t segment);
+
+            /**
+             *   EvictSegment
+             *
+             *   Closes a segment of a segmented cache and deletes its files;
+             *   the segment being written can't be evicted
+             */
+            bool EvictSegment(std::size_t segment);
+
+            // Whether frames of a single binary cache are still to be downloaded
+            bool IsPartial();
+
+            /**
+             *   GetMissingRange
+             *
+             *   @param  maxBytes    about how many bytes to download at once;
+             *                       the range always holds at least one frame
+             *   @param  offset      set to where the range starts in the cache
+             *   @param  size        set to the size of the range
+             *   @param  endFrame    set to one past the last frame it holds
+             *
+             *   The next frames of a partial cache to download, in playback
+             *   order; returns false once every frame is there
+             */
+            bool GetMissingRange(std::size_t maxBytes, std::uint64_t& offset, std::uint64_t& size, std::size_t& endFrame);
+
+            /**
+             *   AddDownloadedFrames
+             *
+             *   @param  offset      where the bytes go in the cache
+             *   @param  data        the bytes of a range from GetMissingRange
+             *   @param  endFrame    one past the last frame of the range
+             *
+             *   Writes the bytes into the cache, then makes its frames readable
+             */
+            bool AddDownloadedFrames(std::uint64_t offset, const std::vector<char>& data, std::size_t endFrame);
+
+            /**
+             *   GetFilePaths
+             *
+             *   Returns the local files of the cache: the manifest and the
+             *   segments with their frame indices, or the binary cache with
+             *   its frame index and pyramid levels; only files that exist are listed
+             */
+            std::vector<std::string> GetFilePaths();
+
+            std::vector<char> GetStaticLayer();
+            std::vector<char> GetAttributeRecords(std::size_t begin, std::size_t throughFrame);
+            quantization::QuantizationError GetQuantizationError();
+
+            /**
+             *   GetBroadcastFrame, GetBroadcastUpdate
+             *
+             *   As for SimulariumBinaryFile, with frames of one segment per
+             *   update; frames of a segment that isn't there yet are not
+             *   returned, and the position is left as it is
+             */
+            BroadcastUpdate GetBroadcastFrame(std::size_t frameNumber, StreamOptions options = StreamOptions());
+            BroadcastUpdate GetBroadcastUpdate(
+                std::size_t currentPos,
+                std::size_t bufferSize,
+                StreamOptions options = StreamOptions());
+
+            // One past the last saved frame, there may be holes before it
+            std::size_t NumSavedFrames();
+            // Whether the frame was written, its segment may still have to
+            //  be downloaded, see HasSegment
+            bool HasFrame(std::size_t frameNumber);
+
+            // The saved frames, in order, with adjacent ranges merged
+            std::vector<FrameRange> GetAvailableRanges();
+
+            bool FindFrameForTime(double time, std::size_t& frameNumber);
+            bool GetFrameStats(std::size_t frameNumber, FrameStats& stats);
+
+            std::size_t GetEndOfStreamPos() { return this->NumSavedFrames(); }
+            std::size_t GetFramePos(std::size_t frameNumber) { return frameNumber; }
+
+        private:
+            std::shared_ptr<SimulariumBinaryFile> GetSegment(std::size_t segment);
+            std::shared_ptr<SimulariumBinaryFile> CreateSegment(std::size_t segment, double startTime);
+            void WriteManifest();
+            void FlushWriteSegment();
+
+            // Frames in the segment, the caller holds m_segmentMutex
+            std::size_t NumSegmentFrames(std::size_t segment);
+            StreamOptions SegmentOptions(StreamOptions options);
+
+            std::string m_filePath;
+            std::function<void(SimulariumBinaryFile&)> m_configure;
+
+            // Segments are opened by reader threads as their files show up,
+            //  so the list is guarded by m_segmentMutex; a segment is only
+            //  closed when it is evicted
+            std::mutex m_segmentMutex;
+            segments::Manifest m_manifest;
+            std::vector<std::shared_ptr<SimulariumBinaryFile>> m_segments;
+
+            static const std::size_t kNoSegment = static_cast<std::size_t>(-1);
+
+            // Frames of a partial cache are downloaded in order; lock m_segmentMutex
+            bool m_isPartial = false;
+            std::size_t m_numDownloadedFrames = 0;
+
+            bool m_isWriting = false;
+            std::size_t m_writePos = 0;
+            std::size_t m_writeSegment = kNoSegment; // segment the frames before m_writePos went to
+        };
+
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_SEGMENTED_BINARY_FILE_H
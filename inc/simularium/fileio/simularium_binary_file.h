@@ -2,20 +2,81 @@
 #define AICS_SIMULARIUM_BINARY_FILE_H
 
 #include "simularium/agent_data.h"
+#include "simularium/fileio/append_only_array.h"
+#include "simularium/fileio/attribute_table.h"
+#include "simularium/fileio/columnar_frame.h"
+#include "simularium/fileio/compression.h"
+#include "simularium/fileio/fiber_codec.h"
+#include "simularium/fileio/frame_index.h"
+#include "simularium/fileio/mapped_file.h"
+#include "simularium/fileio/packed_frame.h"
+#include "simularium/fileio/positional_file.h"
+#include "simularium/fileio/quantization.h"
+#include "simularium/fileio/static_layer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace aics {
 namespace simularium {
     typedef std::vector<float> BroadcastDataBuffer;
 
+    // How the data of a FrameView is laid out
+    enum class FrameEncoding : std::uint32_t {
+        Full = 0, // a float chunk, see codec::SerializeFrame
+        Delta = 1, // a delta against the previous frame, see codec::EncodeDelta
+        Columnar = 2, // a columnar chunk, see columnar::Encode
+        Packed = 3, // a chunk of packed agent records, see packed::Encode
+        Transforms = 4 // a float chunk without attributes, see attributes::SerializeFrame
+    };
+
+    /**
+     *   FrameView
+     *
+     *   A read-only view of a single frame chunk (without the frame delimiter)
+     *   'owner' keeps the viewed memory alive; it is either the file
+     *   mapping the frame was read from, or a copy made for this view
+     */
+    struct FrameView {
+        std::size_t frameNumber = 0;
+        const char* data = nullptr;
+        std::size_t size = 0; // in bytes
+        FrameEncoding encoding = FrameEncoding::Full;
+        std::shared_ptr<const void> owner;
+    };
+
+    /**
+     *   StreamOptions
+     *
+     *   What the client receiving a broadcast update is able to decode
+     */
+    struct StreamOptions {
+        bool allowDeltas = false; // delta frames may be sent in place of full frames
+        bool hasPreviousFrame = false; // the client holds the frame before the first one sent
+        bool allowColumnar = false; // full frames are sent as columnar chunks
+        bool allowPacked = false; // full frames are sent as packed chunks, unless sent as columnar chunks
+        bool omitStaticAgents = false; // the client holds the static layer, frames are sent without its agents
+        bool omitAttributes = false; // the client holds the attribute table, full frames are sent without attributes
+        std::size_t frameStride = 1; // the client only needs every frameStride-th frame, e.g. while scrubbing
+    };
+
     struct BroadcastUpdate {
-        int new_pos;
-        BroadcastDataBuffer buffer;
+        std::size_t new_pos = 0;
+        std::vector<FrameView> frames;
     };
 
     namespace fileio {
         namespace binary {
+            // Frame delimiter expected by streaming clients
+            //  written to disk after every frame in v1 files; from v2 on it
+            //  is only appended to frames as they are broadcast
             const char eof[20] = {
                 '\\', 'E', 'O', 'F',
                 'T', 'H', 'E',
@@ -24,30 +85,485 @@ namespace simularium {
                 'H', 'E', 'R', 'E'
             };
 
+            static const int EOF_SIZE = 20;
+
+            // "SIMULARIUMBIN" followed by a major, minor, and patch byte
             static const int HEADER_SIZE = 16;
+            static const int MAJOR_VERSION_OFFSET = 13;
+
+            // v1: int32 frame count followed by a fixed size table of int32 offsets
             static const int TOC_ENTRY_COUNT_OFFSET = HEADER_SIZE;
             static const int TOC_ENTRY_START_OFFSET = HEADER_SIZE + 4;
 
+            // v2: fixed size header, followed by a chain of TOC blocks
+            //  that are appended to the end of the file as they fill up
+            //
+            //  [0, 16)   magic + version
+            //  [16, 24)  uint64 number of frames
+            //  [24, 32)  uint64 offset of the first TOC block
+            //  [32, 40)  float position and rotation quantization error (v2.3+)
+            //  [40, 44)  float fiber subpoint error (v2.6+)
+            //  [44, 52)  uint64 offset of the static layer, 0 if there is none (v2.7+)
+            //  [52, 56)  uint32 size of the static layer, see static_layer::Encode
+            //  [56, 64)  uint64 offset of the first attribute block, 0 if there is none (v2.8+)
+            //
+            //  TOC block: uint64 offset of the next block (0 if last)
+            //             uint64 number of entries in this block
+            //             TocEntry[capacity]
+            //
+            //  Attribute block: uint64 offset of the next block (0 if last)
+            //                   uint64 number of records in this block
+            //                   attributes::AttributeRecord[number of records]
+            static const unsigned char MAJOR_VERSION = 2;
+            static const unsigned char MINOR_VERSION = 8;
+            static const unsigned char PATCH_VERSION = 0;
+
+            static const int V2_HEADER_SIZE = 64;
+            static const int V2_FRAME_COUNT_OFFSET = HEADER_SIZE;
+            static const int V2_TOC_OFFSET = HEADER_SIZE + 8;
+            static const int V2_QUANTIZATION_ERROR_OFFSET = HEADER_SIZE + 16;
+            static const int V2_STATIC_LAYER_OFFSET = HEADER_SIZE + 28;
+            static const int V2_ATTRIBUTES_OFFSET = HEADER_SIZE + 40;
+            static const int V2_TOC_BLOCK_HEADER_SIZE = 16;
+            static const std::size_t V2_DEFAULT_TOC_BLOCK_CAPACITY = 4096;
+
+            // Per-frame stats are kept in a sidecar file, see FrameIndex
+            static const char* const INDEX_FILE_SUFFIX = ".idx";
+
+            // Level n of the temporal pyramid is a cache of every 2^n-th frame,
+            //  kept in a sidecar file named [cache path]PYRAMID_FILE_SUFFIX[n]
+            static const char* const PYRAMID_FILE_SUFFIX = ".lod";
+            static const std::size_t MAX_PYRAMID_LEVELS = 16;
+
+            struct TocEntry {
+                std::uint64_t offset = 0; // file position of the frame chunk
+                std::uint32_t size = 0; // size of the frame chunk in bytes
+                std::uint32_t flags = 0; // FrameFlags describing how the chunk is encoded
+            };
+
+            static_assert(sizeof(TocEntry) == 16, "TocEntry must be tightly packed");
+
+            // Per-frame encoding flags (v2.1+)
+            //  frames without any flags are stored as plain float chunks
+            enum FrameFlags : std::uint32_t {
+                FRAME_FLAG_BLOSC = 1 << 0, // chunk is a blosc compressed float chunk
+                FRAME_FLAG_DELTA = 1 << 1, // chunk is a delta against the previous frame (v2.2+)
+                FRAME_FLAG_QUANTIZED = 1 << 2, // chunk is a quantized keyframe (v2.3+)
+                FRAME_FLAG_COLUMNAR = 1 << 3, // chunk is a columnar keyframe (v2.4+)
+                FRAME_FLAG_PACKED = 1 << 4, // chunk is a packed keyframe (v2.5+)
+                FRAME_FLAG_FIBERS = 1 << 5, // chunk is followed by a fiber section (v2.6+)
+                FRAME_FLAG_ATTRIBUTES = 1 << 6 // chunk is a keyframe without attributes (v2.8+)
+            };
+
         }
 
+        // In-memory copy of a table of contents, see AppendOnlyArray
+        typedef AppendOnlyArray<binary::TocEntry> TocMirror;
+
+        // Reads 'size' bytes from 'offset' on of a file that isn't local,
+        //  e.g. with a ranged GET; returns false unless all of them were read
+        typedef std::function<bool(std::uint64_t offset, std::uint64_t size, std::vector<char>& out)> RangeReader;
+
+        /**
+         *   ToBroadcastBuffer
+         *
+         *   Copies the frames of a broadcast update into a single buffer,
+         *   each frame terminated with the frame delimiter
+         */
+        BroadcastDataBuffer ToBroadcastBuffer(const BroadcastUpdate& update);
+
         class SimulariumBinaryFile {
         public:
-            void Create(std::string filePath, std::size_t numFrames = 10000);
-            void Open(std::string filePath);
+            ~SimulariumBinaryFile();
+
+            /**
+             *   Create
+             *
+             *   @param  filePath            where to create the file; an existing
+             *                               file will be overwritten
+             *   @param  tocBlockCapacity    number of frames each table-of-contents
+             *                               block can hold before a new one is appended
+             */
+            void Create(
+                std::string filePath,
+                std::size_t tocBlockCapacity = binary::V2_DEFAULT_TOC_BLOCK_CAPACITY);
+
+            /**
+             *   Open
+             *
+             *   @param  filePath        an existing simularium binary file
+             *   @param  useMemoryMap    serve frames straight out of a read-only
+             *                           mapping of the file; frames appended after
+             *                           opening are read through the file stream
+             */
+            void Open(std::string filePath, bool useMemoryMap = true);
             void WriteFrame(TrajectoryFrame tf);
-            BroadcastUpdate GetBroadcastFrame(std::size_t frameNumber);
-            BroadcastUpdate GetBroadcastUpdate(std::size_t currentPos, std::size_t bufferSize);
+
+            /**
+             *   CopyLayout
+             *
+             *   @param  read        reads byte ranges of a v2 file that isn't local
+             *   @param  fileSize    the size of that file
+             *   @param  filePath    where to write the copy
+             *
+             *   Copies the header, table of contents, static layer, and
+             *   attribute table of the file to a sparse file of the same
+             *   size, leaving the frame chunks out, so the copy can be opened
+             *   and its frames filled in a range at a time, see
+             *   SetReadableFrames; returns false for v1 files, and files that
+             *   can't be read
+             */
+            static bool CopyLayout(const RangeReader& read, std::uint64_t fileSize, std::string filePath);
+
+            /**
+             *   SetReadableFrames
+             *
+             *   @param  numFrames   frames from this one on are reported as not
+             *                       saved yet, e.g. while their chunks are
+             *                       downloaded in order into a copy made by
+             *                       CopyLayout
+             */
+            void SetReadableFrames(std::size_t numFrames) { this->m_numReadableFrames = numFrames; }
+
+            // Frames listed in the table of contents, readable or not
+            std::size_t NumListedFrames() { return this->m_toc.Size(); }
+
+            // Where the chunk of a listed frame is in the file, and its size
+            bool GetChunkRange(std::size_t frameNumber, std::uint64_t& offset, std::uint64_t& size);
+
+            /**
+             *   SetWriteBuffer
+             *
+             *   @param  bufferSize      bytes of frame data to hold in memory before
+             *                           appending them to the file in a single write;
+             *                           0 writes every frame straight through
+             *   @param  flushInterval   most frames to hold before the table of contents
+             *                           and frame count on disk are brought up to date
+             *
+             *   Buffered frames can be read through this object right away;
+             *   other readers of the file only see them once they are flushed
+             */
+            void SetWriteBuffer(std::size_t bufferSize, std::size_t flushInterval = 1024);
+
+            /**
+             *   Flush
+             *
+             *   Writes out buffered frames, then their table of contents entries,
+             *   and only then the frame count, so the count never runs ahead of the data
+             */
+            void Flush();
+
+            /**
+             *   Checkpoint
+             *
+             *   Flushes the frames written so far, except those still held back
+             *   by the static agent detection, and returns the number of frames
+             *   on disk. Frames can be appended to the file after opening it
+             *   again, from that frame on
+             */
+            std::size_t Checkpoint();
+
+            /**
+             *   SetCompression
+             *
+             *   @param  options     how frames written from now on are compressed
+             *
+             *   Frames are compressed individually, and only kept compressed
+             *   if that makes them smaller; reading never depends on this setting
+             */
+            void SetCompression(compression::CompressionOptions options);
+
+            /**
+             *   SetKeyframeInterval
+             *
+             *   @param  interval    write a full frame at least every 'interval' frames,
+             *                       and deltas against the previous frame in between;
+             *                       1 writes full frames only
+             */
+            void SetKeyframeInterval(std::size_t interval);
+
+            /**
+             *   SetQuantization
+             *
+             *   @param  options     whether frames written from now on have their
+             *                       transforms quantized, see quantization::EncodeFrame
+             *
+             *   Quantization is lossy; the largest error introduced so far
+             *   is kept in the file header
+             */
+            void SetQuantization(quantization::QuantizationOptions options);
+            quantization::QuantizationError GetQuantizationError() { return this->m_quantizationError; }
+
+            /**
+             *   SetColumnarLayout
+             *
+             *   @param  enabled     store frames written from now on with agents
+             *                       grouped by type, and keyframes as columnar chunks
+             *
+             *   Grouping reorders the agents within a frame; quantized
+             *   keyframes keep the quantized layout, in grouped order
+             */
+            void SetColumnarLayout(bool enabled) { this->m_columnar = enabled; }
+
+            /**
+             *   SetPackedRecords
+             *
+             *   @param  enabled     store keyframes written from now on as packed
+             *                       agent records, see packed::Encode
+             *
+             *   Frames with ids that don't fit in a float are always stored packed,
+             *   or columnar, since the other layouts would round their ids
+             */
+            void SetPackedRecords(bool enabled) { this->m_packed = enabled; }
+
+            /**
+             *   SetFiberCoding
+             *
+             *   @param  options     how the subpoints of fibers written from now on
+             *                       are simplified and quantized, see fiber::EncodeFibers
+             *
+             *   Fiber subpoints are stored in a section after the frame chunk,
+             *   whatever its layout; the largest error is kept in the file header
+             */
+            void SetFiberCoding(fiber::FiberOptions options) { this->m_fiber = options; }
+
+            /**
+             *   SetStaticAgents
+             *
+             *   @param  minFrames   agents that stay the same, bit for bit, over at
+             *                       least this many frames written from now on are
+             *                       moved out of those frames into the static layer;
+             *                       0 keeps every agent in its frames
+             *
+             *   Up to minFrames - 1 frames are held back until Flush, to find out
+             *   whether their agents are static. Readers get the static agents
+             *   back in every frame, unless they hold the static layer themselves
+             */
+            void SetStaticAgents(std::size_t minFrames);
+
+            /**
+             *   GetStaticLayer
+             *
+             *   Returns the static layer, encoded by static_layer::Encode
+             */
+            std::vector<char> GetStaticLayer();
+            std::size_t NumStaticAgents();
+
+            /**
+             *   SetAttributeTable
+             *
+             *   @param  enabled     keep the vis_type, type, and collision radius of
+             *                       agents in frames written from now on in the
+             *                       attribute table, and store keyframes without them
+             *
+             *   The table only holds a record when an agent's attributes change;
+             *   readers get the attributes back in every frame, unless they
+             *   hold the attribute table themselves
+             */
+            void SetAttributeTable(bool enabled) { this->m_attributeTable = enabled; }
+
+            /**
+             *   GetAttributeRecords
+             *
+             *   @param  begin           the first record to return
+             *   @param  throughFrame    the last frame to return records for
+             *
+             *   Returns the records from 'begin' on that hold from 'throughFrame'
+             *   or earlier, encoded by attributes::Encode
+             */
+            std::vector<char> GetAttributeRecords(std::size_t begin, std::size_t throughFrame);
+
+            /**
+             *   SetTemporalPyramid
+             *
+             *   @param  numLevels   keep every 2nd, 4th, ... 2^numLevels-th frame of
+             *                       files created from now on in a sidecar cache per
+             *                       level; 0 keeps no levels
+             *
+             *   Levels hold complete keyframes, so clients that skip frames
+             *   read a level in order instead of seeking through the cache.
+             *   Levels found next to an opened file are always used
+             */
+            void SetTemporalPyramid(std::size_t numLevels) { this->m_pyramidLevels = std::min(numLevels, binary::MAX_PYRAMID_LEVELS); }
+            std::size_t NumPyramidLevels() { return this->m_pyramid.size(); }
+
+            // Frame counts, TOC lookups and frame reads below are safe to call
+            //  from any number of threads while another thread writes frames
+
+            /**
+             *   GetBroadcastFrame
+             *
+             *   Returns a view of a single frame
+             *   new_pos is set to the stream position of the following frame
+             *   With a frameStride above 1 the frame is snapped to the nearest
+             *   frame of the coarsest pyramid level at or below that stride
+             */
+            BroadcastUpdate GetBroadcastFrame(std::size_t frameNumber, StreamOptions options = StreamOptions());
+
+            /**
+             *   GetBroadcastUpdate
+             *
+             *   @param  currentPos  the stream position to start reading from
+             *   @param  bufferSize  the approximate amount of data to return, in bytes
+             *   @param  options     whether stored deltas can be sent as-is, whether
+             *                       full frames are sent as columnar chunks, and
+             *                       whether static agents and attributes are left out
+             *
+             *   Returns views of as many whole decoded frames as fit into
+             *   bufferSize (at least one), counting a frame delimiter for each
+             *   With a frameStride above 1 the frames are read from the coarsest
+             *   pyramid level at or below that stride
+             */
+            BroadcastUpdate GetBroadcastUpdate(
+                std::size_t currentPos,
+                std::size_t bufferSize,
+                StreamOptions options = StreamOptions());
 
             std::size_t NumSavedFrames();
-            std::size_t GetEndOfFilePos();
+
+            /**
+             *   FindFrameForTime
+             *
+             *   @param  time        the simulation time to look for
+             *   @param  frameNumber set to the saved frame closest in time
+             *
+             *   A binary search over the frame index; returns false if
+             *   there are no indexed frames
+             */
+            bool FindFrameForTime(double time, std::size_t& frameNumber);
+
+            /**
+             *   GetFrameStats
+             *
+             *   Time, agent count, streamed size, and bounds of a saved frame,
+             *   read from the frame index without touching the frame itself
+             */
+            bool GetFrameStats(std::size_t frameNumber, FrameStats& stats);
+
+            // Stream positions are frame indices; the end of the stream
+            //  is one past the last saved frame
+            std::size_t GetEndOfStreamPos();
             std::size_t GetFramePos(std::size_t frameNumber);
 
+            unsigned char GetMajorVersion() { return this->m_majorVersion; }
+
         private:
+            void AppendFrame(TrajectoryFrame frame);
+            void AppendReleasedFrames();
+            void FlushFrames();
             void WriteHeader();
-            void AllocateTOC(std::size_t size);
+            void WriteStaticLayer();
+            void AppendTOCBlock();
+            void ReadTOC();
+            void ReadTOCv1();
+            void ReadTOCv2();
+            void ReadStaticLayer(std::uint64_t offset, std::uint32_t size);
+            void WriteAttributes();
+            void ClearAttributes();
+            void ReadAttributes(std::uint64_t offset);
+            void ClearStaticLayer();
+            void OpenIndex(std::string indexPath);
+            void CreatePyramid(std::string filePath);
+            void OpenPyramid(std::string filePath);
+            std::size_t GetPyramidLevel(std::size_t frameStride);
+            FrameView GetPyramidView(std::size_t level, std::size_t levelFrame, const StreamOptions& options);
+            BroadcastUpdate GetPyramidUpdate(
+                std::size_t level,
+                std::size_t currentPos,
+                std::size_t bufferSize,
+                const StreamOptions& options);
+            bool HasStaticAgents(std::size_t frameNumber);
+            void AddStaticAgents(std::size_t frameNumber, TrajectoryFrame& frame);
+            void RemoveStaticAgents(std::size_t frameNumber, TrajectoryFrame& frame);
+            FrameView GetFrameView(std::size_t frameNumber, bool withStaticAgents = true);
+            FrameView GetStoredChunk(std::size_t frameNumber);
+            FrameView GetColumnarView(std::size_t frameNumber, bool withStaticAgents);
+            FrameView GetPackedView(std::size_t frameNumber, bool withStaticAgents);
+            FrameView GetTransformsView(std::size_t frameNumber, bool withStaticAgents, bool allowPacked);
+            FrameView Decompress(const FrameView& stored);
+            bool RebuildFrame(std::size_t frameNumber);
+            bool ParseKeyframe(const FrameView& chunk, std::uint32_t flags, TrajectoryFrame& frame);
+            bool ApplyDelta(const FrameView& chunk, std::uint32_t flags, TrajectoryFrame& frame);
 
+            // Frames are written through the stream, and read through
+            //  the mapping or with positional reads
             std::fstream m_fstream;
-            std::size_t m_endTOC;
+            std::shared_ptr<MappedFile> m_mapping;
+            std::shared_ptr<PositionalFile> m_reader;
+            unsigned char m_majorVersion = binary::MAJOR_VERSION;
+            compression::CompressionOptions m_compression;
+            quantization::QuantizationOptions m_quantization;
+            quantization::QuantizationError m_quantizationError;
+            bool m_columnar = false;
+            bool m_packed = false;
+            fiber::FiberOptions m_fiber;
+
+            // Agents moved out of the frames they are static in; the layer
+            //  is appended to by the writer and read by reader threads
+            //  through m_staticLayerMutex, and saved again on flush once changed
+            static_layer::StaticAgentDetector m_staticDetector;
+            std::size_t m_staticMinFrames = 0;
+            std::mutex m_staticLayerMutex;
+            static_layer::StaticLayer m_staticLayer;
+            bool m_staticLayerChanged = false;
+            bool m_closeStaticLayer = false; // set when opened, agents still static are closed off on the first write
+
+            // Attributes of the agents in written frames, kept out of keyframes;
+            //  shared with reader threads through m_attributeMutex, and
+            //  saved on flush as a block of the records added since the last one
+            bool m_attributeTable = false;
+            std::mutex m_attributeMutex;
+            attributes::AttributeTable m_attributes;
+            std::size_t m_numSavedAttributes = 0;
+            std::uint64_t m_lastAttributeBlock = 0; // 0 until a block is saved
+
+            // Frames appended since the last flush; the TOC entries
+            //  of these frames are only kept in memory until then
+            //  the buffer is shared with reader threads through m_writeBufferMutex
+            std::mutex m_writeBufferMutex;
+            std::vector<char> m_writeBuffer;
+            std::uint64_t m_writeBufferOffset = 0; // file position of m_writeBuffer[0]
+            std::size_t m_writeBufferSize = 0;
+            std::size_t m_flushInterval = 1;
+            std::size_t m_numFlushedFrames = 0;
+
+            // Scratch space reused between written frames
+            std::vector<float> m_frameChunk;
+            std::vector<char> m_compressedChunk;
+            std::vector<float> m_statsScratch;
+            fiber::EncodedFibers m_fibers;
+            std::vector<char> m_fiberChunk;
+
+            // Frames are written as deltas against the last written frame
+            std::size_t m_keyframeInterval = 1;
+            std::size_t m_lastKeyframe = 0;
+            TrajectoryFrame m_lastWrittenFrame;
+            bool m_hasLastWrittenFrame = false;
+
+            // The most recently rebuilt delta frame, so frames read in
+            //  order only need a single delta applied
+            //  shared by reader threads through m_rebuildMutex
+            std::mutex m_rebuildMutex;
+            TrajectoryFrame m_rebuiltFrame;
+            std::size_t m_rebuiltFrameNumber = 0;
+            bool m_hasRebuiltFrame = false;
+
+            // In-memory copy of the on-disk table of contents
+            TocMirror m_toc;
+            std::atomic<std::size_t> m_numReadableFrames { std::numeric_limits<std::size_t>::max() };
+            std::vector<std::uint64_t> m_tocBlocks;
+            std::uint64_t m_tocBlockCapacity = binary::V2_DEFAULT_TOC_BLOCK_CAPACITY;
+            std::uint64_t m_endOfFile = 0;
+
+            // Per-frame stats, saved next to the cache
+            //  in a file named [cache path]INDEX_FILE_SUFFIX
+            FrameIndex m_index;
+
+            // Temporal pyramid, level n at m_pyramid[n - 1]; frames are added to
+            //  the levels as they are passed to WriteFrame, with their static agents
+            std::size_t m_pyramidLevels = 0;
+            std::vector<std::unique_ptr<SimulariumBinaryFile>> m_pyramid;
+            std::size_t m_numPushedFrames = 0;
         };
 
     } // namespace fileio
@@ -0,0 +1,131 @@
+#ifndef AICS_STATIC_LAYER_H
+#define AICS_STATIC_LAYER_H
+
+#include "simularium/agent_data.h"
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace static_layer {
+
+            // End frame of an agent that is still static at the end of the cache
+            static const std::uint32_t kOpenEnd = 0xffffffff;
+
+            /**
+             *   StaticAgent
+             *
+             *   An agent that is left out of frames [first, end) of a cache,
+             *   since it is the same, bit for bit, in each of them; frames
+             *   are counted by their position in the cache
+             */
+            struct StaticAgent {
+                std::uint32_t first = 0;
+                std::uint32_t end = kOpenEnd;
+                AgentData agent;
+
+                bool Covers(std::size_t frame) const { return frame >= this->first && frame < this->end; }
+            };
+
+            typedef std::vector<StaticAgent> StaticLayer;
+
+            /**
+             *   AddStaticAgents
+             *
+             *   Appends the agents of the layer that cover 'frameIndex' to the frame
+             */
+            void AddStaticAgents(const StaticLayer& layer, std::size_t frameIndex, TrajectoryFrame& frame);
+            bool HasStaticAgents(const StaticLayer& layer, std::size_t frameIndex);
+
+            // Removes the agents of the layer that cover 'frameIndex' from a complete frame
+            void RemoveStaticAgents(const StaticLayer& layer, std::size_t frameIndex, TrajectoryFrame& frame);
+
+            /**
+             *   Encode
+             *
+             *   Layout (little-endian, 4 byte values):
+             *     uint32 number of static agents
+             *     per agent: uint32 first frame, uint32 end frame (kOpenEnd if open),
+             *       uint32 id, float vis_type, type, x, y, z, xrot, yrot, zrot,
+             *       collision_radius, uint32 n-subpoints, float subpoints[n]
+             */
+            std::vector<char> Encode(const StaticLayer& layer);
+            bool Decode(const char* data, std::size_t size, StaticLayer& layer);
+
+            /**
+             *   StaticAgentDetector
+             *
+             *   Finds agents that stay the same over at least 'minFrames'
+             *   consecutive frames. Frames are held back until no later frame
+             *   can make their agents static, which is at most minFrames - 1 frames
+             *
+             *   Push a frame, apply the layer changes with Update, then
+             *   write the frames returned by Pop, which no longer hold the
+             *   agents that went into the layer
+             */
+            class StaticAgentDetector {
+            public:
+                /**
+                 *   Reset
+                 *
+                 *   @param  minFrames   the shortest run of identical frames that
+                 *                       makes an agent static; 0 (or 1) turns detection off
+                 *   @param  firstFrame  the cache position of the next pushed frame
+                 *   @param  layerSize   the number of static agents already in the layer
+                 */
+                void Reset(std::size_t minFrames, std::size_t firstFrame, std::size_t layerSize);
+                bool IsEnabled() const { return this->m_minFrames > 1; }
+
+                void Push(TrajectoryFrame frame);
+
+                // Applies the agents that became static, or stopped being
+                //  static, since the last call; returns false if there were none
+                bool Update(StaticLayer& layer);
+
+                bool Pop(TrajectoryFrame& frame);
+
+                /**
+                 *   Drain
+                 *
+                 *   Releases every held back frame to Pop; agents that were the
+                 *   same in every frame pushed so far become static first
+                 */
+                void Drain();
+
+            private:
+                // A run of frames over which an agent stayed the same
+                struct Run {
+                    AgentData agent;
+                    std::size_t start = 0;
+                    std::size_t lastSeen = 0;
+                    bool isStatic = false;
+                    std::size_t layerIndex = 0;
+                };
+
+                void MakeStatic(Run& run);
+                void RemoveStaticAgents(std::size_t fromHeldFrame);
+
+                std::size_t m_minFrames = 0;
+                std::size_t m_firstFrame = 0;
+                std::size_t m_nextFrame = 0;
+                std::size_t m_layerSize = 0;
+
+                std::unordered_map<std::uint32_t, Run> m_runs;
+                std::deque<TrajectoryFrame> m_heldFrames; // the last held back frame is at m_nextFrame - 1
+                std::size_t m_numReleased = 0; // frames at the front of m_heldFrames that Pop can return
+
+                // Layer changes waiting for Update
+                StaticLayer m_started;
+                std::vector<std::pair<std::size_t, std::uint32_t>> m_ended; // layer index, end frame
+            };
+
+        } // namespace static_layer
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_STATIC_LAYER_H
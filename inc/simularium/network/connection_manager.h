@@ -45,6 +45,11 @@ namespace simularium {
         std::size_t playback_pos = 0;
         ClientPlayState play_state = ClientPlayState::Stopped;
         std::string sim_identifier = "runtime";
+        unsigned int capabilities = ClientCapabilities::id_capability_none;
+        std::size_t last_sent_frame = broadcast::eos;
+        std::size_t attribute_records_sent = 0;
+        std::size_t frame_stride = 1;
+        std::size_t pending_frame = broadcast::eos; // asked for before it was in the cache
     };
 
     struct NetMessage {
@@ -84,8 +89,14 @@ namespace simularium {
         void SetClientState(std::string connectionUID, ClientPlayState state);
         void SetClientPos(std::string connectionUID, std::size_t pos);
         void SetClientSimId(std::string connectionUID, std::string simId);
+        void SetClientCapabilities(std::string connectionUID, unsigned int capabilities);
+        void SetClientFrameStride(std::string connectionUID, std::size_t frameStride);
 
         void SendArrayBufferMessage(std::string connectionUID, std::vector<float> buffer);
+        void SendBroadcastUpdate(
+            std::string connectionUID,
+            std::string fileName,
+            const BroadcastUpdate& update);
         void SendWebsocketMessage(std::string connectionUID, Json::Value jsonMessage);
         void SendWebsocketMessageToAll(Json::Value jsonMessage, std::string description);
 
@@ -126,6 +137,13 @@ namespace simularium {
     private:
         void GenerateLocalUUID(std::string& uuid);
 
+        // Copies the state of the client; false if it isn't connected
+        bool GetNetState(std::string connectionUID, NetState& state);
+
+        // Pins the caches of the files clients have selected, see
+        //  SimulationCache::SetPinnedCaches; m_netStatesMutex is held
+        void UpdatePinnedCaches();
+
         void SendSingleFrameToClient(
             Simulation& simulation,
             std::string connectionUID,
@@ -135,6 +153,19 @@ namespace simularium {
             Simulation& simulation,
             std::string connectionUID);
 
+        void SendFrameStatsToClient(
+            Simulation& simulation,
+            std::string connectionUID);
+
+        void SendStaticLayerToClient(
+            Simulation& simulation,
+            std::string connectionUID);
+
+        void SendAttributesToClient(
+            Simulation& simulation,
+            std::string connectionUID,
+            const BroadcastUpdate& update);
+
         void CheckForFinishedClient(
             Simulation& simulation,
             std::string connectionUID);
@@ -150,10 +181,45 @@ namespace simularium {
          *   @param simulation: the simulation object used by the other functions
          *   in this class; responsible for loading trajectories, running simulations
          *   and keeping the run-time cache updated
+         *
+         *   Trajectory files are converted up to their first frame, and the
+         *   rest by the file IO thread, see ContinueConversion; pre-run
+         *   simulations are converted before this returns
          */
         void SetupRuntimeCache(
             Simulation& simulation);
 
+        /**
+         * ContinueConversion
+         *
+         *   @param numFrames: the most frames to convert
+         *
+         *   Converts the next frames of the trajectory SetupRuntimeCache
+         *   started on, and finishes, and uploads, its cache after the last.
+         *   Returns false once there is nothing left to convert
+         */
+        bool ContinueConversion(
+            Simulation& simulation,
+            std::size_t numFrames);
+
+        // Converts every frame left of the trajectory being converted
+        void FinishRuntimeCache(
+            Simulation& simulation);
+
+        /**
+         * SeekConversion
+         *
+         *   @param fileName: the trajectory a client is watching
+         *   @param frameNumber: the frame it asked for
+         *
+         *   If the trajectory is being converted and the frame isn't there
+         *   yet, moves the conversion to it, see Simulation::SeekConversion
+         */
+        void SeekConversion(
+            Simulation& simulation,
+            std::string fileName,
+            std::size_t frameNumber);
+
         /**
          *   TLS Functions
          */
@@ -172,9 +238,16 @@ namespace simularium {
 
         void LogClientEvent(std::string uid, std::string msg);
 
-        void PrependArraybufferHeader(BroadcastUpdate& update, std::string fileName);
+        BroadcastDataBuffer GetArraybufferHeader(
+            std::string fileName,
+            WebRequestTypes msgType = WebRequestTypes::id_vis_data_arrive);
 
+        // Clients are added and removed by the websocket thread while the
+        //  file thread reads their state, and pins the caches they stream;
+        //  both are guarded by m_netStatesMutex
+        std::mutex m_netStatesMutex;
         std::unordered_map<std::string, NetState> m_netStates;
+        Simulation* m_pinnedSimulation = nullptr;
         std::unordered_map<std::string, websocketpp::connection_hdl> m_netConnections;
         std::unordered_map<std::string, std::size_t> m_missedHeartbeats;
         server m_server;
@@ -208,6 +281,14 @@ namespace simularium {
         std::thread m_simThread;
         std::thread m_fileIoThread;
         std::mutex m_fileMutex;
+
+        // The trajectory converted between file requests; the file IO thread
+        //  converts it while the sim thread moves it to the frames clients
+        //  go to, both holding m_conversionMutex
+        std::mutex m_conversionMutex;
+        std::string m_convertingFile;
+        std::size_t m_numConvertedFrames = 0;
+        const std::size_t kConversionBatchFrames = 10;
     };
 
 } // namespace simularium
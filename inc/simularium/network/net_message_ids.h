@@ -23,7 +23,11 @@ namespace simularium {
         id_heartbeat_pong,
         id_trajectory_file_info,
         id_goto_simulation_time,
-        id_init_trajectory_file
+        id_init_trajectory_file,
+        id_vis_encoded_data_arrive,
+        id_frame_stats,
+        id_static_agents,
+        id_agent_attributes
     };
 
     //
@@ -43,6 +47,21 @@ namespace simularium {
         { id_trajectory_file_info, "trajectory file info" },
         { id_goto_simulation_time, "go to simulation time" },
         { id_init_trajectory_file, "init trajectory file" },
+        { id_vis_encoded_data_arrive, "stream encoded data" },
+        { id_frame_stats, "frame stats" },
+        { id_static_agents, "static agents" },
+        { id_agent_attributes, "agent attributes" },
+    };
+
+    // Sent by clients as a bitmask in the "capabilities" field
+    //  of stream requests; clients that don't send it get full frames
+    enum ClientCapabilities {
+        id_capability_none = 0,
+        id_capability_delta_frames = 1 << 0,
+        id_capability_columnar_frames = 1 << 1,
+        id_capability_packed_frames = 1 << 2,
+        id_capability_static_agents = 1 << 3,
+        id_capability_agent_attributes = 1 << 4
     };
 
     enum SimulationMode {
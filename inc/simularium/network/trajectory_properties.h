@@ -52,6 +52,11 @@ namespace simularium {
         std::unordered_map<std::size_t, TypeEntry> typeMapping;
         float boxX, boxY, boxZ;
 
+        // Largest error introduced by a lossy (quantized) cache, 0 if lossless
+        float positionError = 0;
+        float rotationError = 0;
+        float fiberError = 0;
+
         TimeUnits timeUnits;
         SpatialUnits spatialUnits;
         CameraPosition cameraDefault;
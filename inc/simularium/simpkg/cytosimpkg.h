@@ -33,6 +33,7 @@ namespace simularium {
             std::vector<std::shared_ptr<Agent>>& agents) override;
 
         virtual bool IsFinished() override;
+        virtual bool ResumeAtFrame(std::size_t frameNumber) override;
         virtual void LoadTrajectoryFile(
             std::string file_path,
             TrajectoryFileProperties& fileProps) override;
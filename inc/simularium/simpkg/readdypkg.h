@@ -38,6 +38,7 @@ namespace simularium {
             std::vector<std::shared_ptr<Agent>>& agents) override;
 
         virtual bool IsFinished() override;
+        virtual bool ResumeAtFrame(std::size_t frameNumber) override;
         virtual void Run(float timeStep, std::size_t nTimeStep) override;
 
         virtual void LoadTrajectoryFile(
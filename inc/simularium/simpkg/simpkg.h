@@ -76,6 +76,17 @@ namespace simularium {
          */
         virtual bool IsFinished() = 0;
 
+        /**
+         *	ResumeAtFrame
+         *
+         *	@param frameNumber	the next frame GetNextFrame should read
+         *
+         *	Moves the reader of a loaded trajectory file forward, so that an
+         *	interrupted conversion can continue where its cache left off.
+         *	Packages that can't do so return false, and are read from the start
+         */
+        virtual bool ResumeAtFrame(std::size_t frameNumber) { return false; }
+
         virtual void LoadTrajectoryFile(
             std::string file_path,
             TrajectoryFileProperties& fileProps)
@@ -60,7 +60,8 @@ namespace simularium {
          */
         BroadcastUpdate GetBroadcastFrame(
             std::string identifier,
-            std::size_t frame_no);
+            std::size_t frame_no,
+            StreamOptions options = StreamOptions());
 
         /**
          *   GetBroadcastUpdate
@@ -71,6 +72,7 @@ namespace simularium {
          *                                 position for the binary file being read/streamed
          *   @param    bufferSize        how many bits of data to include in this broadcast
          *                                 update
+         *   @param    options           what the requesting client can decode
          *
          *   Returns a BufferUpdate object, containing data to be transmited
          *     and a new playback-position for the requesting streamer to save
@@ -78,7 +80,8 @@ namespace simularium {
         BroadcastUpdate GetBroadcastUpdate(
             std::string identifier,
             std::size_t currentPosition,
-            std::size_t bufferSize);
+            std::size_t bufferSize,
+            StreamOptions options = StreamOptions());
 
         std::size_t GetFramePos(
             std::string identifier,
@@ -208,6 +211,14 @@ namespace simularium {
          */
         bool DownloadRuntimeCache(std::string fileName);
 
+        // Opens a cache kept from an earlier run, see SimulationCache::LoadWarmCache
+        bool LoadWarmCache(std::string fileName) { return this->m_cache.LoadWarmCache(fileName); }
+
+        // Caches of these files are not closed or evicted, see SimulationCache::SetPinnedCaches
+        void SetPinnedCaches(std::vector<std::string> fileNames) { this->m_cache.SetPinnedCaches(fileNames); }
+
+        fileio::FrameCacheStats GetFrameCacheStats() { return this->m_cache.GetFrameCacheStats(); }
+
         /**
          *   PreprocessRuntimeCache
          *
@@ -261,6 +272,11 @@ namespace simularium {
 
         bool HasFileInCache(std::string identifier) { return this->m_cache.HasIdentifier(identifier); }
 
+        bool HasFrame(std::string identifier, std::size_t frameNumber)
+        {
+            return this->m_cache.HasFrame(identifier, frameNumber);
+        }
+
         TrajectoryFileProperties GetFileProperties(std::string identifier)
         {
             return this->m_cache.GetFileProperties(identifier);
@@ -276,11 +292,51 @@ namespace simularium {
             return this->m_cache.GetNumFrames(identifier);
         }
 
+        bool GetFrameStats(std::string identifier, std::size_t frameNumber, fileio::FrameStats& stats)
+        {
+            return this->m_cache.GetFrameStats(identifier, frameNumber, stats);
+        }
+
+        std::vector<char> GetStaticLayer(std::string identifier)
+        {
+            return this->m_cache.GetStaticLayer(identifier);
+        }
+
+        std::vector<char> GetAttributeRecords(std::string identifier, std::size_t begin, std::size_t throughFrame)
+        {
+            return this->m_cache.GetAttributeRecords(identifier, begin, throughFrame);
+        }
+
         void SetSimId(std::string identifier) { this->m_simIdentifier = identifier; }
         std::string GetSimId() { return this->m_simIdentifier; }
 
         void CleanupTmpFiles(std::string identifier);
 
+        /**
+         *   ResumeConversion
+         *
+         *   For the trajectory loaded by LoadTrajectoryFile: if a checkpointed
+         *   conversion of it is in the cache, moves the SimPkg to the first frame
+         *   not yet cached, and returns true. Otherwise, or if the SimPkg can't
+         *   resume, the conversion starts from the first frame
+         */
+        bool ResumeConversion();
+
+        /**
+         *   SeekConversion
+         *
+         *   @param  frameNumber     a frame to convert next, e.g. the one
+         *                           clients are watching
+         *
+         *   Moves the SimPkg, and the cache, to where the segment holding
+         *   the frame is converted up to, so it is filled before the frames
+         *   after the current one; frames skipped are converted once the
+         *   SimPkg is finished. Returns false if the SimPkg can't move there
+         */
+        bool SeekConversion(std::size_t frameNumber);
+        void CheckpointConversion() { this->m_cache.CheckpointConversion(this->m_simIdentifier); }
+        void FinishConversion() { this->m_cache.FinishConversion(this->m_simIdentifier); }
+
     private:
         std::vector<std::shared_ptr<Agent>> m_agents;
         std::vector<std::shared_ptr<SimPkg>> m_SimPkgs;
@@ -290,6 +346,7 @@ namespace simularium {
         std::string m_simIdentifier = "runtime"; // identifier for currently running simulation
 
         std::size_t m_activeSimPkg = 0;
+        bool m_canSeek = true; // false once the SimPkg failed to move to a frame
     };
 
 }
@@ -2,20 +2,44 @@
 #define AICS_SIMULATION_CACHE_H
 
 #include "simularium/agent_data.h"
-#include "simularium/fileio/simularium_binary_file.h"
+#include "simularium/fileio/arrow_export.h"
+#include "simularium/fileio/frame_cache.h"
+#include "simularium/fileio/segmented_binary_file.h"
 #include "simularium/network/trajectory_properties.h"
+#include "simularium/storage/storage_backend.h"
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <json/json.h>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace aics {
 namespace simularium {
 
+    // A cache kept in the cache folder across server restarts, its
+    //  usage is stored with it
+    struct WarmCacheEntry {
+        std::string source; // S3 object the cache was made from, if there is one
+        std::string etag; // of the source, when the cache was made
+        std::uint64_t size = 0; // bytes of the cache and info files
+        std::string formatVersion; // of the binary cache
+    };
+
+    // How recently, and how often, clients read a cache
+    struct CacheUsage {
+        std::int64_t lastAccess = 0; // seconds since the epoch
+        std::uint64_t accessCount = 0; // single frame requests: loads and seeks
+    };
+
     class SimulationCache {
     public:
         SimulationCache();
@@ -43,7 +67,32 @@ namespace simularium {
          *   'identifier' parameter. The frame is returned as a broadcastable data
          *   buffer
          */
-        BroadcastUpdate GetBroadcastFrame(std::string identifier, std::size_t frameNumber);
+        BroadcastUpdate GetBroadcastFrame(
+            std::string identifier,
+            std::size_t frameNumber,
+            StreamOptions options = StreamOptions());
+
+        /**
+         *   GetStaticLayer
+         *
+         *   Returns the agents left out of the frames they are static in,
+         *   encoded by fileio::static_layer::Encode; empty if there is no cache
+         */
+        std::vector<char> GetStaticLayer(std::string identifier);
+
+        /**
+         *   GetAttributeRecords
+         *
+         *   @param      begin           the first attribute record to return
+         *   @param      throughFrame    the last frame to return records for
+         *
+         *   Returns the attribute records of agents, encoded by
+         *   fileio::attributes::Encode; empty if there is no cache
+         */
+        std::vector<char> GetAttributeRecords(
+            std::string identifier,
+            std::size_t begin,
+            std::size_t throughFrame);
 
         /**
          *   GetBroadcastUpdate
@@ -54,6 +103,7 @@ namespace simularium {
          *                                 position for the binary file being read/streamed
          *   @param    bufferSize        how many bits of data to include in this broadcast
          *                                 update
+         *   @param    options           what the requesting client can decode
          *
          *   Returns a BroadcastUpdate object, containing data to be transmited
          *     and a new playback-position for the requesting streamer to save
@@ -61,7 +111,8 @@ namespace simularium {
         BroadcastUpdate GetBroadcastUpdate(
             std::string identifier,
             std::size_t currentPosition,
-            std::size_t bufferSize);
+            std::size_t bufferSize,
+            StreamOptions options = StreamOptions());
 
         std::size_t GetEndOfStreamPos(
             std::string identifier);
@@ -72,6 +123,60 @@ namespace simularium {
 
         std::size_t GetNumFrames(std::string identifier);
 
+        /**
+         *   HasFrame, GetAvailableFrames
+         *
+         *   Frames of segmented caches can be filled out of order, so frames
+         *   before GetNumFrames may not be available yet
+         */
+        bool HasFrame(std::string identifier, std::size_t frameNumber);
+        std::vector<fileio::FrameRange> GetAvailableFrames(std::string identifier);
+
+        // The first frame from 'frameNumber' on that isn't available
+        std::size_t GetNextMissingFrame(std::string identifier, std::size_t frameNumber);
+
+        /**
+         *   GetWritePosition, SetWritePosition, GetFillPosition
+         *
+         *   The frame number the next added frame is written to; see
+         *   fileio::SegmentedBinaryFile for where writing can move to
+         */
+        std::size_t GetWritePosition(std::string identifier);
+        bool SetWritePosition(std::string identifier, std::size_t frameNumber);
+        std::size_t GetFillPosition(std::string identifier, std::size_t frameNumber);
+
+        /**
+         *   FindFrameForTime
+         *
+         *   @param  time        the simulation time to look for
+         *   @param  frameNumber set to the cached frame closest in time
+         *
+         *   Returns false if no frames of the identifier are cached
+         */
+        bool FindFrameForTime(
+            std::string identifier,
+            double time,
+            std::size_t& frameNumber);
+
+        bool GetFrameStats(
+            std::string identifier,
+            std::size_t frameNumber,
+            fileio::FrameStats& stats);
+
+        /**
+         *   ExportArrow
+         *
+         *   @param  filePath        where to write the Arrow IPC (Feather v2) file
+         *   @param  batchFrames     frames per record batch
+         *
+         *   Writes the cached frames of the identifier to an Arrow IPC file,
+         *   see fileio::arrow::ArrowFileWriter for the columns
+         */
+        bool ExportArrow(
+            std::string identifier,
+            std::string filePath,
+            std::size_t batchFrames = fileio::arrow::kDefaultBatchFrames);
+
         /**
          *   ClearCache
          *
@@ -82,14 +187,98 @@ namespace simularium {
         void Preprocess(std::string identifier);
 
         bool DownloadRuntimeCache(std::string identifier);
+
+        /**
+         *   LoadWarmCache
+         *
+         *   With SIMULARIUM_CACHE_PERSISTENT, caches are kept in the cache
+         *   folder when the server stops. Opens the kept cache of the
+         *   identifier, if its source on S3 hasn't changed since it was
+         *   made (checked with a HEAD request); a cache that is out of
+         *   date is deleted. Returns false if there is no cache to use
+         */
+        bool LoadWarmCache(std::string identifier);
         bool UploadRuntimeCache(std::string identifier);
 
+        /**
+         *   DownloadSegments
+         *
+         *   @param  firstFrame  the first frame needed
+         *   @param  numFrames   the number of frames needed from 'firstFrame' on
+         *
+         *   Downloads the segments of a segmented cache that hold the frames
+         *   and aren't on local disk, in parallel; the frames of a segment
+         *   can be read once it is complete. Single file caches are
+         *   downloaded by DownloadRuntimeCache, whole or a range at a time
+         */
+        bool DownloadSegments(
+            std::string identifier,
+            std::size_t firstFrame,
+            std::size_t numFrames);
+
+        /**
+         *   StartSegmentDownload
+         *
+         *   @param  frameNumber     where clients are reading from
+         *
+         *   Downloads the missing segments of a segmented cache in the
+         *   background, SIMULARIUM_CACHE_PREFETCH_SEGMENTS at a time, in
+         *   playback order from the segment clients last sought to or
+         *   are waiting on; frames are served as their segments arrive.
+         *   The frames of a partial single file cache are downloaded from
+         *   the first one missing on, SIMULARIUM_CACHE_RANGE_BYTES at a time
+         */
+        void StartSegmentDownload(std::string identifier, std::size_t frameNumber);
+        void StopSegmentDownload(std::string identifier);
+
+        /**
+         *   ResumeConversion
+         *
+         *   Returns the first frame of an interrupted conversion that isn't
+         *   in the local cache yet, or 0 if the identifier has no checkpoint;
+         *   frames added from then on are written from there
+         */
+        std::size_t ResumeConversion(std::string identifier);
+
+        /**
+         *   CheckpointConversion
+         *
+         *   Flushes the cache of a trajectory that is being converted, and
+         *   records how many of its frames are on disk, so a restarted server
+         *   can continue the conversion with ResumeConversion. Caches with
+         *   a checkpoint are kept when the server starts or stops
+         */
+        void CheckpointConversion(std::string identifier);
+
+        // Flushes a converted cache and removes its checkpoint
+        void FinishConversion(std::string identifier);
+
+        /**
+         *   SetPinnedCaches
+         *
+         *   @param  identifiers     the caches clients are streaming
+         *
+         *   Pinned caches are never evicted from disk, nor closed to stay
+         *   within the open file budget (SIMULARIUM_CACHE_DISK_QUOTA and
+         *   SIMULARIUM_CACHE_OPEN_FILES); the list replaces the previous one
+         */
+        void SetPinnedCaches(std::vector<std::string> identifiers);
+
+        /**
+         *   GetFrameCacheStats
+         *
+         *   Hits and misses of the in-memory cache of single frames
+         *   (SIMULARIUM_FRAME_CACHE_SIZE bytes), which serves repeated
+         *   seeks and frames several clients ask for at once
+         */
+        fileio::FrameCacheStats GetFrameCacheStats() { return this->m_frameCache.GetStats(); }
+
+        // Where caches are downloaded from and uploaded to, see storage::CreateStorageBackend
+        void SetStorageBackend(std::shared_ptr<storage::StorageBackend> backend) { this->m_storage = backend; }
+
         bool HasIdentifier(std::string identifier) { return this->m_fileProps.count(identifier); }
 
-        TrajectoryFileProperties GetFileProperties(std::string identifier)
-        {
-            return this->m_fileProps.count(identifier) ? this->m_fileProps[identifier] : TrajectoryFileProperties();
-        }
+        TrajectoryFileProperties GetFileProperties(std::string identifier);
 
         void SetFileProperties(std::string identifier, TrajectoryFileProperties tfp)
         {
@@ -124,20 +313,91 @@ namespace simularium {
         //  outdated cache-files will need to be manually removed from S3
         std::string GetLocalFilePath(std::string identifier);
         std::string GetLocalInfoFilePath(std::string identifier);
+        std::string GetLocalIndexFilePath(std::string identifier);
+        std::string GetLocalCheckpointFilePath(std::string identifier);
+        std::string GetLocalPyramidFilePath(std::string identifier, std::size_t level);
         std::string GetS3TrajectoryPath(std::string identifier);
         std::string GetS3TrajectoryCachePath(std::string identifier);
         std::string GetS3InfoPath(std::string identifier);
         std::string GetS3InfoCachePath(std::string identifer);
+        std::string GetS3IndexCachePath(std::string identifier);
+        std::string GetS3PyramidCachePath(std::string identifier, std::size_t level);
 
-        fileio::SimulariumBinaryFile* GetBinaryFile(std::string identifier);
+        // Callers hold on to the returned cache while they use it, it
+        //  may be closed for the open file budget by another thread
+        std::shared_ptr<fileio::SegmentedBinaryFile> GetBinaryFile(std::string identifier);
 
         void ParseFileProperties(std::string identifier);
         void ParseFileProperties(Json::Value& jsonRoot, std::string identifier);
         bool IsFilePropertiesValid(std::string identifier);
 
+        void LoadWarmCaches();
+        void SaveWarmCaches();
+        void AddWarmCache(std::string identifier, std::string sourceObject);
+        std::uint64_t GetCacheSize(std::string identifier, bool withRawTrajectory);
+
+        /**
+         *   FindBinaryFile
+         *
+         *   Returns the cache of the identifier, opening it again if it
+         *   was closed for the open file budget; nullptr if there is none
+         */
+        std::shared_ptr<fileio::SegmentedBinaryFile> FindBinaryFile(std::string identifier);
+        std::shared_ptr<fileio::SegmentedBinaryFile> OpenBinaryFile(std::string identifier);
+        void RecordAccess(std::string identifier, bool isLoad);
+
+        bool DownloadSegmentFiles(std::string identifier, const std::vector<std::size_t>& segmentNumbers);
+        // Downloads the next range of frames of a partial cache
+        bool DownloadFrames(std::string identifier);
+        // The first segment that isn't on local disk, from the frame's
+        //  segment on and then from the start; NumSegments if there is none
+        std::size_t GetNextMissingSegment(fileio::SegmentedBinaryFile& file, std::size_t frameNumber);
+        // Moves the background download of the cache to the frame
+        void RequestSegment(
+            std::string identifier,
+            fileio::SegmentedBinaryFile& file,
+            std::size_t frameNumber,
+            bool isSeek);
+
+        // Close, or delete, the least valuable caches other than 'identifier',
+        //  the pinned ones, and those being written until the cache is within its limits
+        void EnforceOpenFileBudget(std::string identifier);
+        void EnforceDiskQuota(std::string identifier);
+        std::string GetLocalWarmCacheManifestPath();
+
         std::unordered_map<std::string, TrajectoryFileProperties> m_fileProps;
         std::unordered_map<std::string, std::vector<std::string>> m_tmpFiles;
-        std::unordered_map<std::string, std::shared_ptr<fileio::SimulariumBinaryFile>> m_binaryFiles;
+        std::shared_ptr<storage::StorageBackend> m_storage;
+        std::unordered_map<std::string, std::shared_ptr<fileio::SegmentedBinaryFile>> m_binaryFiles;
+        // Kept caches are added and dropped by the loading, conversion, and
+        //  streaming threads; the lock is held while the manifest is written
+        std::mutex m_warmCachesMutex;
+        std::unordered_map<std::string, WarmCacheEntry> m_warmCaches;
+
+        // Caches are read by the streaming threads while others are opened,
+        //  closed, or evicted, so the open caches, those being opened, the
+        //  ones closed for the open file budget, usage, and pins are guarded
+        //  by m_binaryFilesMutex
+        std::mutex m_binaryFilesMutex;
+        std::unordered_set<std::string> m_closedFiles;
+        std::unordered_map<std::string, std::shared_future<std::shared_ptr<fileio::SegmentedBinaryFile>>> m_openingFiles;
+        std::unordered_map<std::string, CacheUsage> m_usage;
+        std::unordered_set<std::string> m_pinned;
+        std::unordered_set<std::string> m_writing; // caches frames are added to, until their conversion finishes
+
+        fileio::FrameCache m_frameCache;
+
+        struct SegmentDownload {
+            std::thread thread;
+            std::atomic<std::size_t> nextFrame { 0 };
+            std::atomic<bool> isStopping { false };
+            std::atomic<bool> isFinished { false };
+        };
+
+        // Background downloads, by identifier; lock m_downloadsMutex
+        //  before m_binaryFilesMutex
+        std::mutex m_downloadsMutex;
+        std::unordered_map<std::string, std::unique_ptr<SegmentDownload>> m_downloads;
     };
 }
 }
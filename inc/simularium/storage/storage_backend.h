@@ -0,0 +1,117 @@
+#ifndef AICS_STORAGE_BACKEND_H
+#define AICS_STORAGE_BACKEND_H
+
+#include "simularium/aws/aws_util.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace storage {
+        using FileTransfer = aws_util::FileTransfer;
+
+        /**
+         *   StorageBackend
+         *
+         *   Where trajectories and their caches are kept between runs, and
+         *   shared between servers; objects are named by paths relative to
+         *   the root of the storage (e.g. "trajectory/test.h5.bin")
+         *
+         *   Implementations are called from several threads at once
+         */
+        class StorageBackend {
+        public:
+            virtual ~StorageBackend() = default;
+
+            // Returns false if there is no such object, or it couldn't be copied
+            virtual bool Download(std::string objectName, std::string destination) = 0;
+            virtual bool Upload(std::string fileName, std::string objectName) = 0;
+
+            /**
+             *   DownloadAll, UploadAll
+             *
+             *   runs the transfers in parallel, and waits for all of them;
+             *   returns false if any of them failed
+             */
+            virtual bool DownloadAll(std::vector<FileTransfer> transfers) = 0;
+            virtual bool UploadAll(std::vector<FileTransfer> transfers) = 0;
+
+            /**
+             *   GetETag
+             *
+             *   Sets 'etag' to a tag that changes whenever the object does,
+             *   without downloading it; returns false if there is no such
+             *   object, or the storage can't be reached
+             */
+            virtual bool GetETag(std::string objectName, std::string& etag) = 0;
+
+            /**
+             *   GetSize, DownloadRange
+             *
+             *   The size of an object in bytes, and 'size' bytes of it from
+             *   'offset' on, read into 'out' without copying the rest of the
+             *   object; return false if there is no such object, or the
+             *   range runs past its end
+             */
+            virtual bool GetSize(std::string objectName, std::uint64_t& size) = 0;
+            virtual bool DownloadRange(
+                std::string objectName,
+                std::uint64_t offset,
+                std::uint64_t size,
+                std::vector<char>& out)
+                = 0;
+        };
+
+        // S3, or an S3-compatible store, see aws_util
+        class S3StorageBackend : public StorageBackend {
+        public:
+            bool Download(std::string objectName, std::string destination) override;
+            bool Upload(std::string fileName, std::string objectName) override;
+            bool DownloadAll(std::vector<FileTransfer> transfers) override;
+            bool UploadAll(std::vector<FileTransfer> transfers) override;
+            bool GetETag(std::string objectName, std::string& etag) override;
+            bool GetSize(std::string objectName, std::uint64_t& size) override;
+            bool DownloadRange(std::string objectName, std::uint64_t offset, std::uint64_t size, std::vector<char>& out) override;
+        };
+
+        /**
+         *   LocalStorageBackend
+         *
+         *   Objects are files under a local folder, with the object name as
+         *   their path relative to it; the folders of uploaded objects are
+         *   created as needed. The tag of an object is made of its size
+         *   and modification time
+         */
+        class LocalStorageBackend : public StorageBackend {
+        public:
+            explicit LocalStorageBackend(std::string rootFolder);
+
+            bool Download(std::string objectName, std::string destination) override;
+            bool Upload(std::string fileName, std::string objectName) override;
+            bool DownloadAll(std::vector<FileTransfer> transfers) override;
+            bool UploadAll(std::vector<FileTransfer> transfers) override;
+            bool GetETag(std::string objectName, std::string& etag) override;
+            bool GetSize(std::string objectName, std::uint64_t& size) override;
+            bool DownloadRange(std::string objectName, std::uint64_t offset, std::uint64_t size, std::vector<char>& out) override;
+
+            std::string GetObjectPath(std::string objectName);
+
+        private:
+            std::string m_rootFolder;
+        };
+
+        /**
+         *   CreateStorageBackend
+         *
+         *   The backend set by SIMULARIUM_STORAGE: "s3" (the default), or
+         *   "local" for the folder SIMULARIUM_STORAGE_FOLDER
+         */
+        std::shared_ptr<StorageBackend> CreateStorageBackend();
+
+    } // namespace storage
+} // namespace simularium
+} // namespace aics
+
+#endif // AICS_STORAGE_BACKEND_H
@@ -0,0 +1,33 @@
+#include "simularium/fileio/arrow_export.h"
+#include <cstdlib>
+#include <iostream>
+
+using namespace aics::simularium;
+
+// Arg List:
+//  [runtime cache] [output file] [frames per record batch]
+//
+// Writes a runtime cache (e.g. /tmp/aics/simularium/test.h5.bin, or a
+//  cache downloaded from S3) to an Arrow IPC file, for pandas or polars
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cout << "usage: " << argv[0] << " [runtime cache] [output file] [frames per record batch]" << std::endl;
+        return 1;
+    }
+
+    std::string cachePath = argv[1];
+    std::string outputPath = argv[2];
+    std::size_t batchFrames = argc > 3
+        ? std::strtoul(argv[3], nullptr, 10)
+        : fileio::arrow::kDefaultBatchFrames;
+
+    if (!fileio::SegmentedBinaryFile::Exists(cachePath)) {
+        std::cout << "No runtime cache at " << cachePath << std::endl;
+        return 1;
+    }
+
+    fileio::SegmentedBinaryFile cache;
+    cache.Open(cachePath);
+    return fileio::arrow::ExportCache(cache, outputPath, batchFrames) ? 0 : 1;
+}
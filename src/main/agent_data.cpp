@@ -31,7 +31,7 @@ namespace simularium {
     {
         std::vector<float> vals;
         vals.push_back(agentData.vis_type);
-        vals.push_back(agentData.id);
+        vals.push_back(float(agentData.id));
         vals.push_back(agentData.type);
         vals.push_back(agentData.x);
         vals.push_back(agentData.y);
@@ -0,0 +1,517 @@
+#include "simularium/fileio/arrow_export.h"
+#include "loguru/loguru.hpp"
+#include "simularium/fileio/frame_codec.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace arrow {
+
+            // Arrow metadata is a FlatBuffer; what is below covers the
+            //  tables, vectors and strings of Schema.fbs, Message.fbs and File.fbs
+            //  that these files need, see https://flatbuffers.dev/internals/
+            struct FlatObject;
+            typedef std::shared_ptr<FlatObject> FlatPtr;
+
+            struct FlatField {
+                std::uint16_t slot = 0; // field id in the schema
+                std::vector<char> scalar; // empty for fields referring to another object
+                FlatPtr child;
+            };
+
+            struct FlatObject {
+                enum class Kind { Table, Vector, StructVector, String };
+                Kind kind = Kind::Table;
+                std::vector<FlatField> fields; // Table
+                std::vector<FlatPtr> elements; // Vector of tables
+                std::vector<char> bytes; // StructVector, String
+                std::uint32_t count = 0; // StructVector
+            };
+
+            template <typename T>
+            FlatField Scalar(std::uint16_t slot, T value)
+            {
+                FlatField field;
+                field.slot = slot;
+                field.scalar.resize(sizeof(T));
+                std::memcpy(field.scalar.data(), &value, sizeof(T));
+                return field;
+            }
+
+            inline FlatField Offset(std::uint16_t slot, FlatPtr child)
+            {
+                FlatField field;
+                field.slot = slot;
+                field.child = child;
+                return field;
+            }
+
+            inline FlatPtr Table(std::vector<FlatField> fields)
+            {
+                auto table = std::make_shared<FlatObject>();
+                table->fields = fields;
+                return table;
+            }
+
+            inline FlatPtr Vector(std::vector<FlatPtr> elements)
+            {
+                auto vector = std::make_shared<FlatObject>();
+                vector->kind = FlatObject::Kind::Vector;
+                vector->elements = elements;
+                return vector;
+            }
+
+            inline FlatPtr String(const std::string& value)
+            {
+                auto string = std::make_shared<FlatObject>();
+                string->kind = FlatObject::Kind::String;
+                string->bytes.assign(value.begin(), value.end());
+                return string;
+            }
+
+            // Structs are 8 byte aligned, as all structs of the Arrow metadata are
+            template <typename T>
+            FlatPtr StructVector(const std::vector<T>& structs)
+            {
+                auto vector = std::make_shared<FlatObject>();
+                vector->kind = FlatObject::Kind::StructVector;
+                vector->count = std::uint32_t(structs.size());
+                vector->bytes.resize(structs.size() * sizeof(T));
+                std::memcpy(vector->bytes.data(), structs.data(), vector->bytes.size());
+                return vector;
+            }
+
+            /**
+             *   FlatWriter
+             *
+             *   Lays a FlatBuffer out front to back: every object comes after
+             *   the offsets that refer to it, and the vtable of a table right
+             *   before the table. Tables are 8 byte aligned, and their fields
+             *   are placed widest first, so every field is aligned to its size
+             */
+            class FlatWriter {
+            public:
+                std::vector<char> Finish(const FlatPtr& root)
+                {
+                    this->m_buffer.assign(sizeof(std::uint32_t), 0);
+                    this->Patch(0, this->Write(*root));
+                    this->Pad(8);
+                    return this->m_buffer;
+                }
+
+            private:
+                // Pads the buffer until 'extra' more bytes would end at a multiple of 'alignment'
+                void Pad(std::size_t alignment, std::size_t extra = 0)
+                {
+                    while ((this->m_buffer.size() + extra) % alignment != 0) {
+                        this->m_buffer.push_back(0);
+                    }
+                }
+
+                template <typename T>
+                void Put(T value)
+                {
+                    std::size_t start = this->m_buffer.size();
+                    this->m_buffer.resize(start + sizeof(T));
+                    std::memcpy(&this->m_buffer[start], &value, sizeof(T));
+                }
+
+                void Patch(std::size_t at, std::size_t target)
+                {
+                    std::uint32_t offset = std::uint32_t(target - at);
+                    std::memcpy(&this->m_buffer[at], &offset, sizeof(offset));
+                }
+
+                std::size_t Write(const FlatObject& object)
+                {
+                    switch (object.kind) {
+                    case FlatObject::Kind::Table:
+                        return this->WriteTable(object);
+                    case FlatObject::Kind::Vector: {
+                        this->Pad(4);
+                        std::size_t start = this->m_buffer.size();
+                        this->Put(std::uint32_t(object.elements.size()));
+                        this->m_buffer.resize(start + 4 * (object.elements.size() + 1), 0);
+                        for (std::size_t i = 0; i < object.elements.size(); ++i) {
+                            this->Patch(start + 4 * (i + 1), this->Write(*object.elements[i]));
+                        }
+                        return start;
+                    }
+                    case FlatObject::Kind::StructVector: {
+                        this->Pad(8, 4);
+                        std::size_t start = this->m_buffer.size();
+                        this->Put(object.count);
+                        this->m_buffer.insert(this->m_buffer.end(), object.bytes.begin(), object.bytes.end());
+                        return start;
+                    }
+                    case FlatObject::Kind::String: {
+                        this->Pad(4);
+                        std::size_t start = this->m_buffer.size();
+                        this->Put(std::uint32_t(object.bytes.size()));
+                        this->m_buffer.insert(this->m_buffer.end(), object.bytes.begin(), object.bytes.end());
+                        this->m_buffer.push_back(0);
+                        return start;
+                    }
+                    }
+
+                    return 0;
+                }
+
+                std::size_t WriteTable(const FlatObject& table)
+                {
+                    auto fieldSize = [](const FlatField& field) {
+                        return field.child ? sizeof(std::uint32_t) : field.scalar.size();
+                    };
+
+                    std::vector<const FlatField*> order;
+                    std::size_t numSlots = 0;
+                    for (auto& field : table.fields) {
+                        order.push_back(&field);
+                        numSlots = std::max(numSlots, std::size_t(field.slot) + 1);
+                    }
+                    std::stable_sort(order.begin(), order.end(), [&](const FlatField* a, const FlatField* b) {
+                        return fieldSize(*a) > fieldSize(*b);
+                    });
+
+                    // The table starts with the signed offset to its vtable
+                    std::vector<std::uint16_t> fieldOffsets(numSlots, 0);
+                    std::size_t tableSize = sizeof(std::int32_t);
+                    for (auto field : order) {
+                        std::size_t size = fieldSize(*field);
+                        tableSize = (tableSize + size - 1) / size * size;
+                        fieldOffsets[field->slot] = std::uint16_t(tableSize);
+                        tableSize += size;
+                    }
+
+                    this->Pad(2);
+                    std::size_t vtableStart = this->m_buffer.size();
+                    this->Put(std::uint16_t(2 * (numSlots + 2)));
+                    this->Put(std::uint16_t(tableSize));
+                    for (auto offset : fieldOffsets) {
+                        this->Put(offset);
+                    }
+
+                    this->Pad(8);
+                    std::size_t tableStart = this->m_buffer.size();
+                    this->m_buffer.resize(tableStart + tableSize, 0);
+                    std::int32_t vtableOffset = std::int32_t(tableStart - vtableStart);
+                    std::memcpy(&this->m_buffer[tableStart], &vtableOffset, sizeof(vtableOffset));
+                    for (auto& field : table.fields) {
+                        if (!field.child) {
+                            std::memcpy(&this->m_buffer[tableStart + fieldOffsets[field.slot]], field.scalar.data(), field.scalar.size());
+                        }
+                    }
+
+                    for (auto& field : table.fields) {
+                        if (field.child) {
+                            this->Patch(tableStart + fieldOffsets[field.slot], this->Write(*field.child));
+                        }
+                    }
+
+                    return tableStart;
+                }
+
+                std::vector<char> m_buffer;
+            };
+
+            // Enum values of the Arrow metadata
+            static const std::int16_t kMetadataV5 = 4;
+            static const std::uint8_t kHeaderSchema = 1;
+            static const std::uint8_t kHeaderRecordBatch = 3;
+            static const std::uint8_t kTypeInt = 2;
+            static const std::uint8_t kTypeFloatingPoint = 3;
+            static const std::uint8_t kTypeList = 12;
+            static const std::int16_t kPrecisionSingle = 1;
+
+            struct FieldNode {
+                std::int64_t length = 0;
+                std::int64_t nullCount = 0;
+            };
+
+            struct BufferSpec {
+                std::int64_t offset = 0;
+                std::int64_t length = 0;
+            };
+
+            inline FlatPtr IntType(std::int32_t bitWidth, bool isSigned)
+            {
+                return Table({ Scalar<std::int32_t>(0, bitWidth), Scalar<std::uint8_t>(1, isSigned) });
+            }
+
+            inline FlatPtr FloatType()
+            {
+                return Table({ Scalar<std::int16_t>(0, kPrecisionSingle) });
+            }
+
+            inline FlatPtr Field(const std::string& name, std::uint8_t typeType, FlatPtr type, std::vector<FlatPtr> children = {})
+            {
+                return Table({ Offset(0, String(name)),
+                    Scalar<std::uint8_t>(1, false),
+                    Scalar<std::uint8_t>(2, typeType),
+                    Offset(3, type),
+                    Offset(5, Vector(children)) });
+            }
+
+            // The columns, in the order their nodes and buffers are listed in a record batch
+            inline FlatPtr Schema()
+            {
+                std::vector<FlatPtr> fields = {
+                    Field("frame", kTypeInt, IntType(32, false)),
+                    Field("time", kTypeFloatingPoint, FloatType()),
+                    Field("id", kTypeInt, IntType(32, false)),
+                    Field("vis_type", kTypeInt, IntType(32, true)),
+                    Field("type", kTypeInt, IntType(32, true))
+                };
+                for (auto name : { "x", "y", "z", "xrot", "yrot", "zrot", "collision_radius" }) {
+                    fields.push_back(Field(name, kTypeFloatingPoint, FloatType()));
+                }
+                fields.push_back(Field("subpoints", kTypeList, Table({}),
+                    { Field("item", kTypeFloatingPoint, FloatType()) }));
+
+                return Table({ Scalar<std::int16_t>(0, 0), Offset(1, Vector(fields)) });
+            }
+
+            inline std::vector<char> Message(std::uint8_t headerType, FlatPtr header, std::int64_t bodyLength)
+            {
+                return FlatWriter().Finish(Table({ Scalar<std::int16_t>(0, kMetadataV5),
+                    Scalar<std::uint8_t>(1, headerType),
+                    Offset(2, header),
+                    Scalar<std::int64_t>(3, bodyLength) }));
+            }
+
+            template <typename T>
+            void AppendBuffer(std::vector<char>& body, std::vector<BufferSpec>& buffers, const std::vector<T>& values)
+            {
+                // Validity bitmaps are left out, none of the columns have nulls
+                BufferSpec validity;
+                validity.offset = std::int64_t(body.size());
+                buffers.push_back(validity);
+
+                BufferSpec data;
+                data.offset = std::int64_t(body.size());
+                data.length = std::int64_t(values.size() * sizeof(T));
+                buffers.push_back(data);
+
+                std::size_t start = body.size();
+                std::size_t padded = (data.length + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment;
+                body.resize(start + padded, 0);
+                if (!values.empty()) {
+                    std::memcpy(&body[start], values.data(), data.length);
+                }
+            }
+
+            ArrowFileWriter::~ArrowFileWriter()
+            {
+                this->Close();
+            }
+
+            bool ArrowFileWriter::Open(std::string filePath)
+            {
+                this->Close();
+                this->m_file.open(filePath.c_str(), std::ios_base::binary | std::ios_base::trunc);
+                this->m_position = 0;
+                this->m_batches.clear();
+                if (!this->m_file) {
+                    LOG_F(ERROR, "Failed to create Arrow file %s", filePath.c_str());
+                    return false;
+                }
+
+                // The magic is padded to 8 bytes, messages are 8 byte aligned
+                char header[8] = { 0 };
+                std::memcpy(header, kMagic, sizeof(kMagic));
+                this->m_file.write(header, sizeof(header));
+                this->m_position = sizeof(header);
+
+                Block block;
+                return this->WriteMessage(Message(kHeaderSchema, Schema(), 0), std::vector<char>(), block);
+            }
+
+            bool ArrowFileWriter::WriteBatch(const std::vector<TrajectoryFrame>& frames)
+            {
+                if (!this->m_file.is_open()) {
+                    LOG_F(WARNING, "No file opened. Call ArrowFileWriter.Open([filepath])");
+                    return false;
+                }
+
+                std::vector<std::uint32_t> frameNumbers;
+                std::vector<float> times;
+                std::vector<std::uint32_t> ids;
+                std::vector<std::int32_t> visTypes;
+                std::vector<std::int32_t> types;
+                std::vector<std::vector<float>> transforms(7);
+                std::vector<std::int32_t> subpointOffsets = { 0 };
+                std::vector<float> subpoints;
+                for (auto& frame : frames) {
+                    for (auto& agent : frame.data) {
+                        frameNumbers.push_back(std::uint32_t(frame.frameNumber));
+                        times.push_back(frame.time);
+                        ids.push_back(agent.id);
+                        visTypes.push_back(std::int32_t(agent.vis_type));
+                        types.push_back(std::int32_t(agent.type));
+
+                        const float values[7] = { agent.x, agent.y, agent.z,
+                            agent.xrot, agent.yrot, agent.zrot, agent.collision_radius };
+                        for (std::size_t i = 0; i < transforms.size(); ++i) {
+                            transforms[i].push_back(values[i]);
+                        }
+
+                        subpoints.insert(subpoints.end(), agent.subpoints.begin(), agent.subpoints.end());
+                        subpointOffsets.push_back(std::int32_t(subpoints.size()));
+                    }
+                }
+
+                std::int64_t numRows = std::int64_t(ids.size());
+                std::vector<char> body;
+                std::vector<BufferSpec> buffers;
+                AppendBuffer(body, buffers, frameNumbers);
+                AppendBuffer(body, buffers, times);
+                AppendBuffer(body, buffers, ids);
+                AppendBuffer(body, buffers, visTypes);
+                AppendBuffer(body, buffers, types);
+                for (auto& column : transforms) {
+                    AppendBuffer(body, buffers, column);
+                }
+                AppendBuffer(body, buffers, subpointOffsets); // the list's validity and offsets
+                AppendBuffer(body, buffers, subpoints); // its item column
+
+                std::vector<FieldNode> nodes(13);
+                for (auto& node : nodes) {
+                    node.length = numRows;
+                }
+                FieldNode items;
+                items.length = std::int64_t(subpoints.size());
+                nodes.push_back(items);
+
+                auto recordBatch = Table({ Scalar<std::int64_t>(0, numRows),
+                    Offset(1, StructVector(nodes)),
+                    Offset(2, StructVector(buffers)) });
+
+                Block block;
+                if (!this->WriteMessage(Message(kHeaderRecordBatch, recordBatch, std::int64_t(body.size())), body, block)) {
+                    return false;
+                }
+
+                this->m_batches.push_back(block);
+                return true;
+            }
+
+            bool ArrowFileWriter::Close()
+            {
+                if (!this->m_file.is_open()) {
+                    return true;
+                }
+
+                // End-of-stream marker, then the footer and its size
+                std::uint32_t endOfStream[2] = { 0xFFFFFFFF, 0 };
+                this->m_file.write((const char*)endOfStream, sizeof(endOfStream));
+
+                auto footer = FlatWriter().Finish(Table({ Scalar<std::int16_t>(0, kMetadataV5),
+                    Offset(1, Schema()),
+                    Offset(2, StructVector(std::vector<Block>())),
+                    Offset(3, StructVector(this->m_batches)) }));
+                std::int32_t footerSize = std::int32_t(footer.size());
+                this->m_file.write(footer.data(), footer.size());
+                this->m_file.write((const char*)&footerSize, sizeof(footerSize));
+                this->m_file.write(kMagic, sizeof(kMagic));
+
+                bool success = bool(this->m_file);
+                this->m_file.close();
+                if (!success) {
+                    LOG_F(ERROR, "Failed to write Arrow file footer");
+                }
+
+                return success;
+            }
+
+            bool ArrowFileWriter::WriteMessage(
+                const std::vector<char>& metadata,
+                const std::vector<char>& body,
+                Block& block)
+            {
+                // Continuation marker, metadata size, then the metadata, padded
+                //  so that the body, and with it every buffer, is 64 byte aligned
+                std::size_t padded = metadata.size();
+                while ((this->m_position + 8 + padded) % kBufferAlignment != 0) {
+                    padded += 8;
+                }
+
+                std::uint32_t prefix[2] = { 0xFFFFFFFF, std::uint32_t(padded) };
+                this->m_file.write((const char*)prefix, sizeof(prefix));
+                this->m_file.write(metadata.data(), metadata.size());
+                this->m_file.write(std::string(padded - metadata.size(), '\0').data(), padded - metadata.size());
+                this->m_file.write(body.data(), body.size());
+
+                block.offset = this->m_position;
+                block.metaDataLength = std::int32_t(sizeof(prefix) + padded);
+                block.bodyLength = std::int64_t(body.size());
+                this->m_position += block.metaDataLength + block.bodyLength;
+
+                if (!this->m_file) {
+                    LOG_F(ERROR, "Failed to write Arrow record batch");
+                    return false;
+                }
+
+                return true;
+            }
+
+            bool ExportCache(SegmentedBinaryFile& cache, std::string filePath, std::size_t batchFrames)
+            {
+                static const std::size_t kReadSize = 8 << 20;
+
+                ArrowFileWriter writer;
+                if (!writer.Open(filePath)) {
+                    return false;
+                }
+
+                // Frames that aren't filled in yet are left out, rows
+                //  carry their frame number
+                auto ranges = cache.GetAvailableRanges();
+                std::size_t numFrames = 0;
+                for (auto& range : ranges) {
+                    numFrames += range.end - range.begin;
+                }
+                LOG_F(INFO, "Exporting %zu frames to Arrow file %s", numFrames, filePath.c_str());
+
+                std::vector<TrajectoryFrame> batch;
+                for (auto& range : ranges) {
+                    std::size_t pos = range.begin;
+                    while (pos < range.end) {
+                        auto update = cache.GetBroadcastUpdate(pos, kReadSize);
+                        if (update.frames.empty()) {
+                            LOG_F(ERROR, "Frame %zu of the cache could not be read", pos);
+                            return false;
+                        }
+
+                        for (auto& view : update.frames) {
+                            TrajectoryFrame frame;
+                            if (!codec::ParseFrame(view.data, view.size, frame)) {
+                                LOG_F(ERROR, "Frame %zu of the cache could not be parsed", view.frameNumber);
+                                return false;
+                            }
+
+                            batch.push_back(std::move(frame));
+                            if (batch.size() >= std::max(batchFrames, std::size_t(1))) {
+                                if (!writer.WriteBatch(batch)) {
+                                    return false;
+                                }
+                                batch.clear();
+                            }
+                        }
+                        pos = update.new_pos;
+                    }
+                }
+
+                if (!batch.empty() && !writer.WriteBatch(batch)) {
+                    return false;
+                }
+
+                return writer.Close();
+            }
+
+        } // namespace arrow
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
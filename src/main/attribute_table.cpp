@@ -0,0 +1,230 @@
+#include "simularium/fileio/attribute_table.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace attributes {
+
+            static const std::size_t kEncodedHeaderSize = 2 * sizeof(std::uint32_t);
+
+            // Bitwise comparison, so -0 and NaN payloads are kept as they are
+            inline bool SameValue(float a, float b)
+            {
+                return std::memcmp(&a, &b, sizeof(float)) == 0;
+            }
+
+            inline bool SameAttributes(const AttributeRecord& record, const AgentData& agent)
+            {
+                return SameValue(record.visType, agent.vis_type)
+                    && SameValue(record.type, agent.type)
+                    && SameValue(record.collisionRadius, agent.collision_radius);
+            }
+
+            // Ids are stored as their uint32 bits, so they are exact whatever their size
+            inline float IdBits(std::uint32_t id)
+            {
+                float value;
+                std::memcpy(&value, &id, sizeof(value));
+                return value;
+            }
+
+            void AttributeTable::Clear()
+            {
+                this->m_records.clear();
+                this->m_recordsById.clear();
+            }
+
+            bool AttributeTable::Record(std::size_t frameIndex, const TrajectoryFrame& frame)
+            {
+                std::unordered_set<std::uint32_t> ids;
+                for (auto& agent : frame.data) {
+                    if (!ids.insert(agent.id).second) {
+                        return false;
+                    }
+                }
+
+                for (auto& agent : frame.data) {
+                    const AttributeRecord* current = this->Find(frameIndex, agent.id);
+                    if (current && SameAttributes(*current, agent)) {
+                        continue;
+                    }
+
+                    AttributeRecord record;
+                    record.frame = std::uint32_t(frameIndex);
+                    record.id = agent.id;
+                    record.visType = agent.vis_type;
+                    record.type = agent.type;
+                    record.collisionRadius = agent.collision_radius;
+                    this->Append(record);
+                }
+
+                return true;
+            }
+
+            void AttributeTable::Append(const AttributeRecord& record)
+            {
+                this->m_recordsById[record.id].push_back(this->m_records.size());
+                this->m_records.push_back(record);
+            }
+
+            const AttributeRecord* AttributeTable::Find(std::size_t frameIndex, std::uint32_t id) const
+            {
+                auto found = this->m_recordsById.find(id);
+                if (found == this->m_recordsById.end()) {
+                    return nullptr;
+                }
+
+                // The last record of the id at or before the frame
+                const std::vector<std::size_t>& indices = found->second;
+                auto next = std::upper_bound(indices.begin(), indices.end(), frameIndex,
+                    [this](std::size_t frame, std::size_t index) { return frame < this->m_records[index].frame; });
+                return next == indices.begin() ? nullptr : &this->m_records[*(next - 1)];
+            }
+
+            bool AttributeTable::Apply(std::size_t frameIndex, TrajectoryFrame& frame) const
+            {
+                for (auto& agent : frame.data) {
+                    const AttributeRecord* record = this->Find(frameIndex, agent.id);
+                    if (!record) {
+                        return false;
+                    }
+
+                    agent.vis_type = record->visType;
+                    agent.type = record->type;
+                    agent.collision_radius = record->collisionRadius;
+                }
+
+                return true;
+            }
+
+            bool AttributeTable::Matches(std::size_t frameIndex, const TrajectoryFrame& frame) const
+            {
+                std::unordered_set<std::uint32_t> ids;
+                for (auto& agent : frame.data) {
+                    const AttributeRecord* record = this->Find(frameIndex, agent.id);
+                    if (!record || !SameAttributes(*record, agent) || !ids.insert(agent.id).second) {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            std::size_t AttributeTable::NumRecordsThrough(std::size_t frameIndex) const
+            {
+                auto next = std::upper_bound(this->m_records.begin(), this->m_records.end(), frameIndex,
+                    [](std::size_t frame, const AttributeRecord& record) { return frame < record.frame; });
+                return std::size_t(next - this->m_records.begin());
+            }
+
+            std::vector<char> Encode(const AttributeTable& table, std::size_t begin, std::size_t end)
+            {
+                end = std::min(end, table.Size());
+                begin = std::min(begin, end);
+
+                std::uint32_t header[2] = { std::uint32_t(begin), std::uint32_t(end - begin) };
+                std::vector<char> out(kEncodedHeaderSize + (end - begin) * sizeof(AttributeRecord));
+                std::memcpy(&out[0], header, sizeof(header));
+                for (std::size_t i = begin; i < end; ++i) {
+                    std::memcpy(&out[kEncodedHeaderSize + (i - begin) * sizeof(AttributeRecord)], &table[i], sizeof(AttributeRecord));
+                }
+
+                return out;
+            }
+
+            bool Decode(const char* data, std::size_t size, std::vector<AttributeRecord>& records)
+            {
+                std::uint32_t header[2] = { 0, 0 };
+                if (size < kEncodedHeaderSize) {
+                    return false;
+                }
+
+                std::memcpy(header, data, sizeof(header));
+                if (size != kEncodedHeaderSize + std::size_t(header[1]) * sizeof(AttributeRecord)) {
+                    return false;
+                }
+
+                records.resize(header[1]);
+                if (!records.empty()) {
+                    std::memcpy(&records[0], data + kEncodedHeaderSize, records.size() * sizeof(AttributeRecord));
+                }
+                return true;
+            }
+
+            void SerializeFrame(const TrajectoryFrame& frame, std::vector<float>& out)
+            {
+                out.clear();
+                out.push_back(float(frame.frameNumber));
+                out.push_back(frame.time);
+                out.push_back(float(frame.data.size()));
+
+                for (auto& agent : frame.data) {
+                    out.push_back(IdBits(agent.id));
+                    out.push_back(agent.x);
+                    out.push_back(agent.y);
+                    out.push_back(agent.z);
+                    out.push_back(agent.xrot);
+                    out.push_back(agent.yrot);
+                    out.push_back(agent.zrot);
+                    out.push_back(agent.subpoints.size());
+                    out.insert(out.end(), agent.subpoints.begin(), agent.subpoints.end());
+                }
+            }
+
+            bool ParseFrame(const char* data, std::size_t size, TrajectoryFrame& frame)
+            {
+                // Chunks are read with memcpy, since they need not be aligned
+                const std::size_t count = size / sizeof(float);
+                std::size_t pos = 0;
+                auto read = [data, count, &pos](float* values, std::size_t n) {
+                    if (n > count - pos) {
+                        return false;
+                    }
+                    std::memcpy(values, data + pos * sizeof(float), n * sizeof(float));
+                    pos += n;
+                    return true;
+                };
+
+                float header[3];
+                if (size % sizeof(float) != 0 || !read(header, 3)) {
+                    return false;
+                }
+
+                frame.frameNumber = std::size_t(header[0]);
+                frame.time = header[1];
+                std::size_t numAgents = std::size_t(header[2]);
+
+                frame.data.clear();
+                frame.data.reserve(std::min(numAgents, count));
+                for (std::size_t i = 0; i < numAgents; ++i) {
+                    float fields[8];
+                    if (!read(fields, 8)) {
+                        return false;
+                    }
+
+                    AgentData agent;
+                    std::memcpy(&agent.id, &fields[0], sizeof(agent.id));
+                    agent.x = fields[1];
+                    agent.y = fields[2];
+                    agent.z = fields[3];
+                    agent.xrot = fields[4];
+                    agent.yrot = fields[5];
+                    agent.zrot = fields[6];
+
+                    agent.subpoints.resize(std::min(std::size_t(fields[7]), count));
+                    if (std::size_t(fields[7]) > count || !read(agent.subpoints.data(), agent.subpoints.size())) {
+                        return false;
+                    }
+                    frame.data.push_back(std::move(agent));
+                }
+
+                return pos == count;
+            }
+
+        } // namespace attributes
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
@@ -1,102 +1,271 @@
+#include "simularium/aws/aws_util.h"
+#include "simularium/config/config.h"
 #include <aws/core/Aws.h>
+#include <aws/core/auth/AWSAuthSigner.h>
 #include <aws/core/utils/logging/ConsoleLogSystem.h>
 #include <aws/core/utils/memory/AWSMemory.h>
 #include <aws/core/utils/threading/Executor.h>
 #include <aws/s3/S3Client.h>
+#include <aws/s3/model/GetObjectRequest.h>
+#include <aws/s3/model/HeadObjectRequest.h>
 #include <aws/transfer/TransferManager.h>
+#include <cstdio>
 #include <iostream>
+#include <memory>
 #include <string>
-
-static const Aws::String kBucketName = "aics-simularium-data";
-static const Aws::String kAwsRegion = "us-east-2";
+#include <vector>
 
 namespace aics {
 namespace simularium {
     namespace aws_util {
 
-        bool Download(std::string objectNameStr, std::string destinationStr)
+        static Aws::String ToAwsString(const std::string& str)
         {
-            auto objectName = Aws::String(objectNameStr.c_str(), objectNameStr.size());
-            auto destination = Aws::String(destinationStr.c_str(), destinationStr.size());
+            return Aws::String(str.c_str(), str.size());
+        }
 
-            bool success = true;
-            Aws::SDKOptions options;
-            options.loggingOptions.logLevel = Aws::Utils::Logging::LogLevel::Error;
-            options.loggingOptions.logger_create_fn =
-                [] {
-                    return std::make_shared<Aws::Utils::Logging::ConsoleLogSystem>(
-                        Aws::Utils::Logging::LogLevel::Error);
-                };
-
-            Aws::InitAPI(options);
+        /**
+         *   S3Session
+         *
+         *   The SDK, client, and transfer manager shared by every transfer
+         *   of the process; the client keeps its connections open between
+         *   requests. Set up on first use, and shut down at exit
+         */
+        class S3Session {
+        public:
+            static S3Session& Get()
             {
-                Aws::Client::ClientConfiguration config;
-                config.region = kAwsRegion;
+                static S3Session session;
+                return session;
+            }
 
-                auto executor = Aws::MakeShared<Aws::Utils::Threading::PooledThreadExecutor>("test-pool", 10);
-                Aws::Transfer::TransferManagerConfiguration tcc(executor.get());
-                tcc.s3Client = std::make_shared<Aws::S3::S3Client>(config);
+            const Aws::String& GetBucket() { return this->m_bucket; }
+            std::shared_ptr<Aws::S3::S3Client> GetClient() { return this->m_client; }
+            std::shared_ptr<Aws::Transfer::TransferManager> GetTransferManager() { return this->m_transferManager; }
 
-                auto transferManager = Aws::Transfer::TransferManager::Create(tcc);
-                auto downloadHandle = transferManager->DownloadFile(kBucketName, objectName, destination);
+        private:
+            S3Session()
+            {
+                this->m_options.loggingOptions.logLevel = Aws::Utils::Logging::LogLevel::Error;
+                this->m_options.loggingOptions.logger_create_fn =
+                    [] {
+                        return std::make_shared<Aws::Utils::Logging::ConsoleLogSystem>(
+                            Aws::Utils::Logging::LogLevel::Error);
+                    };
+                Aws::InitAPI(this->m_options);
 
-                downloadHandle->WaitUntilFinished();
+                this->m_bucket = ToAwsString(config::GetS3Bucket());
 
-                auto status = downloadHandle->GetStatus();
-                if (status == Aws::Transfer::TransferStatus::FAILED || status == Aws::Transfer::TransferStatus::CANCELED) {
-                    std::cerr << downloadHandle->GetLastError() << std::endl;
-                    success = false;
+                Aws::Client::ClientConfiguration clientConfig;
+                clientConfig.region = ToAwsString(config::GetS3Region());
+                clientConfig.maxConnections = kNumThreads;
+
+                // S3-compatible stand-ins are addressed by path, not by
+                //  virtual host, and are often served over plain http
+                std::string endpoint = config::GetS3Endpoint();
+                if (endpoint.rfind("http://", 0) == 0) {
+                    clientConfig.scheme = Aws::Http::Scheme::HTTP;
+                    endpoint = endpoint.substr(7);
+                } else if (endpoint.rfind("https://", 0) == 0) {
+                    endpoint = endpoint.substr(8);
+                }
+                if (!endpoint.empty()) {
+                    clientConfig.endpointOverride = ToAwsString(endpoint);
                 }
+
+                this->m_client = std::make_shared<Aws::S3::S3Client>(
+                    clientConfig,
+                    Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never,
+                    endpoint.empty());
+
+                this->m_executor = Aws::MakeShared<Aws::Utils::Threading::PooledThreadExecutor>("simularium-s3", kNumThreads);
+                Aws::Transfer::TransferManagerConfiguration tcc(this->m_executor.get());
+                tcc.s3Client = this->m_client;
+                this->m_transferManager = Aws::Transfer::TransferManager::Create(tcc);
             }
 
-            Aws::ShutdownAPI(options);
-            return success;
+            ~S3Session()
+            {
+                // Transfers finish before the pool they run on goes away,
+                //  and everything is released before the SDK shuts down
+                this->m_transferManager.reset();
+                this->m_executor.reset();
+                this->m_client.reset();
+                Aws::ShutdownAPI(this->m_options);
+            }
+
+            static constexpr std::size_t kNumThreads = 10;
+
+            Aws::SDKOptions m_options;
+            Aws::String m_bucket;
+            std::shared_ptr<Aws::S3::S3Client> m_client;
+            std::shared_ptr<Aws::Utils::Threading::PooledThreadExecutor> m_executor;
+            std::shared_ptr<Aws::Transfer::TransferManager> m_transferManager;
+        };
+
+        static bool WaitForTransfer(std::shared_ptr<Aws::Transfer::TransferHandle> handle)
+        {
+            handle->WaitUntilFinished();
+
+            auto status = handle->GetStatus();
+            if (status == Aws::Transfer::TransferStatus::FAILED || status == Aws::Transfer::TransferStatus::CANCELED) {
+                std::cerr << handle->GetLastError() << std::endl;
+                return false;
+            }
+
+            return true;
         }
 
-        bool Upload(std::string fileNameStr, std::string objectNameStr)
+        // Downloads are written next to their destination, then moved over it,
+        //  so a cache file that is mapped by a reader is never rewritten in place
+        static std::string GetDownloadPath(const FileTransfer& transfer)
         {
-            auto fileName = Aws::String(fileNameStr.c_str(), fileNameStr.size());
-            auto objectName = Aws::String(objectNameStr.c_str(), objectNameStr.size());
+            return transfer.fileName + ".download";
+        }
 
-            bool success = true;
-            Aws::SDKOptions options;
-            options.loggingOptions.logLevel = Aws::Utils::Logging::LogLevel::Error;
-            options.loggingOptions.logger_create_fn =
-                [] {
-                    return std::make_shared<Aws::Utils::Logging::ConsoleLogSystem>(
-                        Aws::Utils::Logging::LogLevel::Error);
-                };
-
-            Aws::InitAPI(options);
-            {
-                Aws::Client::ClientConfiguration config;
-                config.region = kAwsRegion;
+        static bool FinishDownload(const FileTransfer& transfer, bool success)
+        {
+            std::string downloadPath = GetDownloadPath(transfer);
+            if (success && std::rename(downloadPath.c_str(), transfer.fileName.c_str()) != 0) {
+                std::cerr << "Failed to move " << downloadPath << " to " << transfer.fileName << std::endl;
+                success = false;
+            }
+            if (!success) {
+                std::remove(downloadPath.c_str());
+            }
 
-                auto executor = Aws::MakeShared<Aws::Utils::Threading::PooledThreadExecutor>("test-pool", 10);
-                Aws::Transfer::TransferManagerConfiguration tcc(executor.get());
-                tcc.s3Client = std::make_shared<Aws::S3::S3Client>(config);
+            return success;
+        }
 
-                auto transferManager = Aws::Transfer::TransferManager::Create(tcc);
-                auto uploadHandle = transferManager->UploadFile(
+        static std::shared_ptr<Aws::Transfer::TransferHandle> StartTransfer(const FileTransfer& transfer, bool upload)
+        {
+            S3Session& session = S3Session::Get();
+            auto objectName = ToAwsString(transfer.objectName);
+            auto fileName = ToAwsString(upload ? transfer.fileName : GetDownloadPath(transfer));
+            return upload
+                ? session.GetTransferManager()->UploadFile(
                     fileName,
-                    kBucketName,
+                    session.GetBucket(),
                     objectName,
                     "text/binary",
-                    Aws::Map<Aws::String, Aws::String>());
+                    Aws::Map<Aws::String, Aws::String>())
+                : session.GetTransferManager()->DownloadFile(session.GetBucket(), objectName, fileName);
+        }
+
+        bool Download(std::string objectName, std::string destination)
+        {
+            FileTransfer transfer;
+            transfer.objectName = objectName;
+            transfer.fileName = destination;
+            return FinishDownload(transfer, WaitForTransfer(StartTransfer(transfer, false)));
+        }
+
+        bool Upload(std::string fileName, std::string objectName)
+        {
+            FileTransfer transfer;
+            transfer.objectName = objectName;
+            transfer.fileName = fileName;
+            return WaitForTransfer(StartTransfer(transfer, true));
+        }
 
-                uploadHandle->WaitUntilFinished();
+        static bool TransferAll(std::vector<FileTransfer> transfers, bool upload)
+        {
+            // All transfers are started before waiting on any of
+            //  them, so they share the pool of the transfer manager
+            std::vector<std::shared_ptr<Aws::Transfer::TransferHandle>> handles;
+            for (auto& transfer : transfers) {
+                handles.push_back(StartTransfer(transfer, upload));
+            }
 
-                auto status = uploadHandle->GetStatus();
-                if (status == Aws::Transfer::TransferStatus::FAILED || status == Aws::Transfer::TransferStatus::CANCELED) {
-                    std::cerr << uploadHandle->GetLastError() << std::endl;
-                    success = false;
+            bool success = true;
+            for (std::size_t i = 0; i < handles.size(); ++i) {
+                bool isDone = WaitForTransfer(handles[i]);
+                if (!upload) {
+                    isDone = FinishDownload(transfers[i], isDone);
                 }
+                success = isDone && success;
             }
 
-            Aws::ShutdownAPI(options);
             return success;
         }
 
+        bool DownloadAll(std::vector<FileTransfer> transfers)
+        {
+            return TransferAll(transfers, false);
+        }
+
+        bool UploadAll(std::vector<FileTransfer> transfers)
+        {
+            return TransferAll(transfers, true);
+        }
+
+        bool GetETag(std::string objectName, std::string& etag)
+        {
+            S3Session& session = S3Session::Get();
+            Aws::S3::Model::HeadObjectRequest request;
+            request.SetBucket(session.GetBucket());
+            request.SetKey(ToAwsString(objectName));
+
+            auto outcome = session.GetClient()->HeadObject(request);
+            if (!outcome.IsSuccess()) {
+                std::cerr << outcome.GetError().GetMessage() << std::endl;
+                return false;
+            }
+
+            auto& result = outcome.GetResult().GetETag();
+            etag = std::string(result.c_str(), result.size());
+            return true;
+        }
+
+        bool GetSize(std::string objectName, std::uint64_t& size)
+        {
+            S3Session& session = S3Session::Get();
+            Aws::S3::Model::HeadObjectRequest request;
+            request.SetBucket(session.GetBucket());
+            request.SetKey(ToAwsString(objectName));
+
+            auto outcome = session.GetClient()->HeadObject(request);
+            if (!outcome.IsSuccess()) {
+                std::cerr << outcome.GetError().GetMessage() << std::endl;
+                return false;
+            }
+
+            size = std::uint64_t(outcome.GetResult().GetContentLength());
+            return true;
+        }
+
+        bool DownloadRange(std::string objectName, std::uint64_t offset, std::uint64_t size, std::vector<char>& out)
+        {
+            if (size == 0) {
+                out.clear();
+                return true;
+            }
+
+            S3Session& session = S3Session::Get();
+            Aws::S3::Model::GetObjectRequest request;
+            request.SetBucket(session.GetBucket());
+            request.SetKey(ToAwsString(objectName));
+            request.SetRange(ToAwsString("bytes=" + std::to_string(offset) + "-" + std::to_string(offset + size - 1)));
+
+            auto outcome = session.GetClient()->GetObject(request);
+            if (!outcome.IsSuccess()) {
+                std::cerr << outcome.GetError().GetMessage() << std::endl;
+                return false;
+            }
+
+            // A range past the end of the object is cut short, not refused
+            out.resize(size);
+            auto& body = outcome.GetResult().GetBody();
+            body.read(out.data(), out.size());
+            if (std::uint64_t(body.gcount()) != size) {
+                std::cerr << "Read " << body.gcount() << " of " << size << " bytes of " << objectName << std::endl;
+                out.clear();
+                return false;
+            }
+
+            return true;
+        }
+
     } // namespace aws_util
 } // namespace simularium
 } // namespace aics
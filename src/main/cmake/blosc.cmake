@@ -0,0 +1,29 @@
+# c-blosc is used to compress frames in the runtime cache; ReaDDy builds
+#  it for its HDF5 filter, so ReaDDy's target is linked when there is one
+option(SIMULARIUM_BLOSC "Compress runtime cache frames with c-blosc" ON)
+
+add_library("bloscCompression" INTERFACE)
+if(SIMULARIUM_BLOSC)
+    set(BLOSC_SOURCE_DIRECTORY "${DEPENDENCY_DIRECTORY}/readdy/libraries/c-blosc")
+    if(TARGET "blosc_static")
+        set(BLOSC_LIBRARY "blosc_static")
+    elseif(TARGET "blosc_shared")
+        set(BLOSC_LIBRARY "blosc_shared")
+    else()
+        find_library(BLOSC_LIBRARY NAMES "blosc")
+    endif()
+    find_path(BLOSC_INCLUDE_DIR "blosc.h"
+        HINTS "${BLOSC_SOURCE_DIRECTORY}/blosc" "${BLOSC_SOURCE_DIRECTORY}/include"
+    )
+
+    if(NOT BLOSC_INCLUDE_DIR OR NOT BLOSC_LIBRARY)
+        message(FATAL_ERROR "blosc was not found; build ReaDDy's c-blosc or install c-blosc, "
+            "or configure with -DSIMULARIUM_BLOSC=OFF to store cached frames uncompressed")
+    endif()
+
+    target_include_directories("bloscCompression" INTERFACE "${BLOSC_INCLUDE_DIR}")
+    target_link_libraries("bloscCompression" INTERFACE "${BLOSC_LIBRARY}")
+    target_compile_definitions("bloscCompression" INTERFACE "SIMULARIUM_HAS_BLOSC")
+else()
+    message(STATUS "Building without blosc; cached frames will be stored uncompressed")
+endif()
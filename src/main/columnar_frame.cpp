@@ -0,0 +1,233 @@
+#include "simularium/fileio/columnar_frame.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace columnar {
+
+            static const std::size_t kHeaderSize = 4 * sizeof(std::uint32_t);
+            static const std::size_t kGroupSize = 3 * sizeof(std::uint32_t);
+
+            // Per-agent bytes, excluding subpoints: ids, types, vis types,
+            //  positions, rotations, radii and one subpoint offset
+            static const std::size_t kAgentSize = 10 * sizeof(float) + sizeof(std::uint32_t);
+
+            template <typename T>
+            inline void Append(std::vector<char>& out, const T* data, std::size_t count)
+            {
+                std::size_t start = out.size();
+                out.resize(start + count * sizeof(T));
+                if (count > 0) {
+                    std::memcpy(&out[start], data, count * sizeof(T));
+                }
+            }
+
+            template <typename T>
+            inline void Read(const char*& pos, std::vector<T>& values, std::size_t count)
+            {
+                values.resize(count);
+                if (count > 0) {
+                    std::memcpy(&values[0], pos, count * sizeof(T));
+                    pos += count * sizeof(T);
+                }
+            }
+
+            void GroupByType(TrajectoryFrame& frame)
+            {
+                std::stable_sort(frame.data.begin(), frame.data.end(),
+                    [](const AgentData& a, const AgentData& b) { return a.type < b.type; });
+            }
+
+            ColumnarFrame ToColumnar(const TrajectoryFrame& frame)
+            {
+                std::size_t n = frame.data.size();
+                ColumnarFrame out;
+                out.frameNumber = frame.frameNumber;
+                out.time = frame.time;
+                out.ids.resize(n);
+                out.types.resize(n);
+                out.visTypes.resize(n);
+                out.positions.resize(3 * n);
+                out.rotations.resize(3 * n);
+                out.radii.resize(n);
+                out.subpointOffsets.resize(n + 1);
+
+                std::size_t numSubpoints = 0;
+                for (auto& agent : frame.data) {
+                    numSubpoints += agent.subpoints.size();
+                }
+                out.subpoints.reserve(numSubpoints);
+
+                for (std::size_t i = 0; i < n; ++i) {
+                    const AgentData& agent = frame.data[i];
+
+                    // Groups are runs of one type; a frame that is not
+                    //  grouped by type still encodes, with repeated types
+                    if (out.groups.empty() || out.groups.back().type != agent.type) {
+                        TypeGroup group;
+                        group.type = agent.type;
+                        group.first = std::uint32_t(i);
+                        out.groups.push_back(group);
+                    }
+                    out.groups.back().count++;
+
+                    out.ids[i] = agent.id;
+                    out.types[i] = agent.type;
+                    out.visTypes[i] = agent.vis_type;
+                    out.positions[3 * i] = agent.x;
+                    out.positions[3 * i + 1] = agent.y;
+                    out.positions[3 * i + 2] = agent.z;
+                    out.rotations[3 * i] = agent.xrot;
+                    out.rotations[3 * i + 1] = agent.yrot;
+                    out.rotations[3 * i + 2] = agent.zrot;
+                    out.radii[i] = agent.collision_radius;
+                    out.subpointOffsets[i] = std::uint32_t(out.subpoints.size());
+                    out.subpoints.insert(out.subpoints.end(), agent.subpoints.begin(), agent.subpoints.end());
+                }
+                out.subpointOffsets[n] = std::uint32_t(out.subpoints.size());
+
+                return out;
+            }
+
+            TrajectoryFrame FromColumnar(const ColumnarFrame& frame)
+            {
+                std::size_t n = frame.NumAgents();
+                TrajectoryFrame out;
+                out.frameNumber = frame.frameNumber;
+                out.time = frame.time;
+                out.data.resize(n);
+
+                for (std::size_t i = 0; i < n; ++i) {
+                    AgentData& agent = out.data[i];
+                    agent.id = frame.ids[i];
+                    agent.type = frame.types[i];
+                    agent.vis_type = frame.visTypes[i];
+                    agent.x = frame.positions[3 * i];
+                    agent.y = frame.positions[3 * i + 1];
+                    agent.z = frame.positions[3 * i + 2];
+                    agent.xrot = frame.rotations[3 * i];
+                    agent.yrot = frame.rotations[3 * i + 1];
+                    agent.zrot = frame.rotations[3 * i + 2];
+                    agent.collision_radius = frame.radii[i];
+                    agent.subpoints.assign(
+                        frame.subpoints.begin() + frame.subpointOffsets[i],
+                        frame.subpoints.begin() + frame.subpointOffsets[i + 1]);
+                }
+
+                return out;
+            }
+
+            std::vector<char> Encode(const ColumnarFrame& frame)
+            {
+                std::size_t n = frame.NumAgents();
+                std::vector<char> out;
+                out.reserve(kHeaderSize + frame.groups.size() * kGroupSize
+                    + n * kAgentSize + sizeof(std::uint32_t) + frame.subpoints.size() * sizeof(float));
+
+                std::uint32_t header[4] = {
+                    std::uint32_t(frame.frameNumber), 0, std::uint32_t(n), std::uint32_t(frame.groups.size())
+                };
+                std::memcpy(&header[1], &frame.time, sizeof(float));
+                Append(out, header, 4);
+
+                for (auto& group : frame.groups) {
+                    std::uint32_t entry[3] = { 0, group.first, group.count };
+                    std::memcpy(&entry[0], &group.type, sizeof(float));
+                    Append(out, entry, 3);
+                }
+
+                Append(out, frame.ids.data(), n);
+                Append(out, frame.types.data(), n);
+                Append(out, frame.visTypes.data(), n);
+                Append(out, frame.positions.data(), 3 * n);
+                Append(out, frame.rotations.data(), 3 * n);
+                Append(out, frame.radii.data(), n);
+                Append(out, frame.subpointOffsets.data(), n + 1);
+                Append(out, frame.subpoints.data(), frame.subpoints.size());
+
+                return out;
+            }
+
+            bool Decode(const char* data, std::size_t size, ColumnarFrame& frame)
+            {
+                std::uint32_t header[4];
+                if (size < kHeaderSize) {
+                    return false;
+                }
+
+                std::memcpy(header, data, kHeaderSize);
+                std::size_t n = header[2];
+                std::size_t numGroups = header[3];
+                std::size_t fixedSize = kHeaderSize + numGroups * kGroupSize + n * kAgentSize + sizeof(std::uint32_t);
+                if (n > size || numGroups > size || size < fixedSize) {
+                    return false;
+                }
+
+                frame.frameNumber = header[0];
+                std::memcpy(&frame.time, &header[1], sizeof(float));
+
+                const char* pos = data + kHeaderSize;
+                frame.groups.resize(numGroups);
+                std::size_t grouped = 0;
+                for (auto& group : frame.groups) {
+                    std::memcpy(&group.type, pos, sizeof(float));
+                    std::memcpy(&group.first, pos + 4, sizeof(std::uint32_t));
+                    std::memcpy(&group.count, pos + 8, sizeof(std::uint32_t));
+                    pos += kGroupSize;
+
+                    if (group.first != grouped || group.count > n - grouped) {
+                        return false;
+                    }
+                    grouped += group.count;
+                }
+                if (grouped != n) {
+                    return false;
+                }
+
+                Read(pos, frame.ids, n);
+                Read(pos, frame.types, n);
+                Read(pos, frame.visTypes, n);
+                Read(pos, frame.positions, 3 * n);
+                Read(pos, frame.rotations, 3 * n);
+                Read(pos, frame.radii, n);
+                Read(pos, frame.subpointOffsets, n + 1);
+
+                for (std::size_t i = 0; i < n; ++i) {
+                    if (frame.subpointOffsets[i] > frame.subpointOffsets[i + 1]) {
+                        return false;
+                    }
+                }
+                if (frame.subpointOffsets[0] != 0
+                    || size != fixedSize + std::size_t(frame.subpointOffsets[n]) * sizeof(float)) {
+                    return false;
+                }
+
+                Read(pos, frame.subpoints, frame.subpointOffsets[n]);
+                return true;
+            }
+
+            void ComputeBounds(
+                const ColumnarFrame& frame,
+                std::array<float, 3>& lo,
+                std::array<float, 3>& hi)
+            {
+                lo.fill(std::numeric_limits<float>::max());
+                hi.fill(std::numeric_limits<float>::lowest());
+
+                const float* positions = frame.positions.data();
+                std::size_t n = frame.NumAgents();
+                for (std::size_t i = 0; i < n; ++i) {
+                    for (std::size_t axis = 0; axis < 3; ++axis) {
+                        lo[axis] = std::min(lo[axis], positions[3 * i + axis]);
+                        hi[axis] = std::max(hi[axis], positions[3 * i + axis]);
+                    }
+                }
+            }
+
+        } // namespace columnar
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
@@ -0,0 +1,126 @@
+#include "simularium/fileio/compression.h"
+#include "loguru/loguru.hpp"
+
+#ifdef SIMULARIUM_HAS_BLOSC
+#include <blosc.h>
+#endif
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace compression {
+
+            bool IsAvailable()
+            {
+#ifdef SIMULARIUM_HAS_BLOSC
+                return true;
+#else
+                return false;
+#endif
+            }
+
+            Compressor ParseCompressor(std::string name)
+            {
+                if (name == "lz4") {
+                    return Compressor::LZ4;
+                } else if (name == "zstd") {
+                    return Compressor::ZSTD;
+                } else if (!name.empty() && name != "none") {
+                    LOG_F(WARNING, "Unrecognized compressor %s, frames will not be compressed", name.c_str());
+                }
+
+                return Compressor::None;
+            }
+
+#ifdef SIMULARIUM_HAS_BLOSC
+            bool Compress(
+                const char* src,
+                std::size_t size,
+                const CompressionOptions& options,
+                std::vector<char>& out)
+            {
+                if (options.compressor == Compressor::None) {
+                    return false;
+                }
+
+                const char* compressorName = options.compressor == Compressor::ZSTD
+                    ? BLOSC_ZSTD_COMPNAME
+                    : BLOSC_LZ4_COMPNAME;
+
+                out.resize(size + BLOSC_MAX_OVERHEAD);
+                int compressedSize = blosc_compress_ctx(
+                    options.level,
+                    options.byteShuffle ? BLOSC_SHUFFLE : BLOSC_NOSHUFFLE,
+                    sizeof(float),
+                    size,
+                    src,
+                    out.data(),
+                    out.size(),
+                    compressorName,
+                    0, // automatic block size
+                    options.numThreads);
+
+                // Zero means the data would not fit; store it uncompressed
+                if (compressedSize <= 0 || std::size_t(compressedSize) >= size) {
+                    if (compressedSize < 0) {
+                        LOG_F(ERROR, "blosc compression failed with error %i", compressedSize);
+                    }
+                    out.clear();
+                    return false;
+                }
+
+                out.resize(compressedSize);
+                return true;
+            }
+
+            bool Decompress(
+                const char* src,
+                std::size_t size,
+                int numThreads,
+                std::vector<char>& out)
+            {
+                std::size_t nbytes = 0;
+                std::size_t cbytes = 0;
+                std::size_t blocksize = 0;
+                blosc_cbuffer_sizes(src, &nbytes, &cbytes, &blocksize);
+
+                if (cbytes != size) {
+                    LOG_F(ERROR, "Corrupt blosc chunk: expected %zu bytes, found %zu", cbytes, size);
+                    return false;
+                }
+
+                out.resize(nbytes);
+                int decompressedSize = blosc_decompress_ctx(src, out.data(), out.size(), numThreads);
+                if (decompressedSize < 0 || std::size_t(decompressedSize) != nbytes) {
+                    LOG_F(ERROR, "blosc decompression failed with error %i", decompressedSize);
+                    out.clear();
+                    return false;
+                }
+
+                return true;
+            }
+#else
+            bool Compress(
+                const char* src,
+                std::size_t size,
+                const CompressionOptions& options,
+                std::vector<char>& out)
+            {
+                return false;
+            }
+
+            bool Decompress(
+                const char* src,
+                std::size_t size,
+                int numThreads,
+                std::vector<char>& out)
+            {
+                LOG_F(ERROR, "Cannot read a compressed frame; blosc support was not built");
+                return false;
+            }
+#endif
+
+        } // namespace compression
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
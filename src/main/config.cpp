@@ -1,4 +1,6 @@
 #include "simularium/config/config.h"
+#include "simularium/fileio/compression.h"
+#include <cstdlib>
 
 namespace aics {
 namespace simularium {
@@ -7,6 +9,32 @@ namespace simularium {
         std::string GetS3Location() { return "trajectory/"; }
         std::string GetS3CacheLocation() { return "cache/trajectory/" + GetEnvironment() + "/"; }
         std::string GetEnvironment() { char* env = std::getenv("APP_ENVIRONMENT"); if (env) return env; else return ""; }
+        std::string GetCacheCompressor() { char* env = std::getenv("SIMULARIUM_CACHE_COMPRESSOR"); if (env) return env; else return fileio::compression::IsAvailable() ? "lz4" : "none"; }
+        int GetCacheCompressionLevel() { char* env = std::getenv("SIMULARIUM_CACHE_COMPRESSION_LEVEL"); if (env) return std::atoi(env); else return 5; }
+        std::size_t GetCacheKeyframeInterval() { char* env = std::getenv("SIMULARIUM_CACHE_KEYFRAME_INTERVAL"); if (env) return std::strtoul(env, nullptr, 10); else return 20; }
+        bool GetCacheQuantization() { char* env = std::getenv("SIMULARIUM_CACHE_QUANTIZE"); return env && std::string(env) == "1"; }
+        bool GetCacheColumnarLayout() { char* env = std::getenv("SIMULARIUM_CACHE_COLUMNAR"); return env && std::string(env) == "1"; }
+        bool GetCachePackedRecords() { char* env = std::getenv("SIMULARIUM_CACHE_PACKED"); return env && std::string(env) == "1"; }
+        float GetCacheFiberStep() { char* env = std::getenv("SIMULARIUM_CACHE_FIBER_STEP"); if (env) return std::atof(env); else return 0; }
+        float GetCacheFiberTolerance() { char* env = std::getenv("SIMULARIUM_CACHE_FIBER_TOLERANCE"); if (env) return std::atof(env); else return 0; }
+        std::size_t GetCacheStaticFrames() { char* env = std::getenv("SIMULARIUM_CACHE_STATIC_FRAMES"); if (env) return std::strtoul(env, nullptr, 10); else return 0; }
+        bool GetCacheAttributeTable() { char* env = std::getenv("SIMULARIUM_CACHE_ATTRIBUTE_TABLE"); return env && std::string(env) == "1"; }
+        std::size_t GetCachePyramidLevels() { char* env = std::getenv("SIMULARIUM_CACHE_PYRAMID_LEVELS"); if (env) return std::strtoul(env, nullptr, 10); else return 0; }
+        std::size_t GetCacheCheckpointInterval() { char* env = std::getenv("SIMULARIUM_CACHE_CHECKPOINT_INTERVAL"); if (env) return std::strtoul(env, nullptr, 10); else return 0; }
+        std::size_t GetCacheSegmentFrames() { char* env = std::getenv("SIMULARIUM_CACHE_SEGMENT_FRAMES"); if (env) return std::strtoul(env, nullptr, 10); else return 0; }
+        std::size_t GetCachePrefetchSegments() { char* env = std::getenv("SIMULARIUM_CACHE_PREFETCH_SEGMENTS"); if (env) return std::strtoul(env, nullptr, 10); else return 4; }
+        std::size_t GetCacheRangeBytes() { char* env = std::getenv("SIMULARIUM_CACHE_RANGE_BYTES"); if (env) return std::strtoull(env, nullptr, 10); else return 8 << 20; }
+        bool GetCachePersistent() { char* env = std::getenv("SIMULARIUM_CACHE_PERSISTENT"); return env && std::string(env) == "1"; }
+        std::size_t GetCacheDiskQuota() { char* env = std::getenv("SIMULARIUM_CACHE_DISK_QUOTA"); if (env) return std::strtoull(env, nullptr, 10); else return 0; }
+        std::size_t GetCacheOpenFiles() { char* env = std::getenv("SIMULARIUM_CACHE_OPEN_FILES"); if (env) return std::strtoul(env, nullptr, 10); else return 0; }
+        std::string GetCacheEvictionPolicy() { char* env = std::getenv("SIMULARIUM_CACHE_EVICTION"); if (env) return std::string(env); else return "lfu"; }
+        std::size_t GetCacheWriteBufferSize() { char* env = std::getenv("SIMULARIUM_CACHE_WRITE_BUFFER"); if (env) return std::strtoul(env, nullptr, 10); else return 8 << 20; }
+        std::size_t GetFrameCacheSize() { char* env = std::getenv("SIMULARIUM_FRAME_CACHE_SIZE"); if (env) return std::strtoull(env, nullptr, 10); else return 64 << 20; }
+        std::string GetStorageBackend() { char* env = std::getenv("SIMULARIUM_STORAGE"); if (env) return std::string(env); else return "s3"; }
+        std::string GetStorageFolder() { char* env = std::getenv("SIMULARIUM_STORAGE_FOLDER"); if (env) return std::string(env); else return "/tmp/aics/simularium-storage/"; }
+        std::string GetS3Bucket() { char* env = std::getenv("SIMULARIUM_S3_BUCKET"); if (env) return std::string(env); else return "aics-simularium-data"; }
+        std::string GetS3Region() { char* env = std::getenv("SIMULARIUM_S3_REGION"); if (env) return std::string(env); else return "us-east-2"; }
+        std::string GetS3Endpoint() { char* env = std::getenv("SIMULARIUM_S3_ENDPOINT"); if (env) return std::string(env); else return ""; }
 
     } // namespace config
 } // namespace simularium
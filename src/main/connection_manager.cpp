@@ -1,9 +1,12 @@
 #include "simularium/network/connection_manager.h"
 #include "loguru/loguru.hpp"
 #include "simularium/aws/aws_util.h"
+#include "simularium/config/config.h"
 #include "simularium/network/net_message_ids.h"
 #include "simularium/network/tfp_to_json.h"
 #include "simularium/network/trajectory_properties.h"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
@@ -191,6 +194,11 @@ namespace simularium {
         std::atomic<bool>& isRunning,
         Simulation& simulation)
     {
+        {
+            std::lock_guard<std::mutex> lock(this->m_netStatesMutex);
+            this->m_pinnedSimulation = &simulation;
+        }
+
         this->m_fileIoThread = std::thread([&isRunning, &simulation, this] {
             loguru::set_thread_name("File IO");
             while (isRunning) {
@@ -204,14 +212,14 @@ namespace simularium {
                     int frameNumber = request.frameNumber;
 
                     // Check that the client is still connected/valid
-                    if (!this->m_netStates.count(senderUid)) {
+                    NetState state;
+                    if (!this->GetNetState(senderUid, state)) {
                         LOG_F(ERROR, "No net state for client %s", senderUid.c_str());
                         this->m_fileRequests.pop();
                         this->m_fileMutex.unlock();
                         continue;
                     }
 
-                    auto state = this->m_netStates.at(senderUid);
                     std::string id = state.sim_identifier;
 
                     // Check that the requested file hasn't changed
@@ -230,14 +238,13 @@ namespace simularium {
                         fileName);
 
                     // Check that the client is still connected/valid
-                    if (!this->m_netStates.count(senderUid)) {
+                    if (!this->GetNetState(senderUid, state)) {
                         LOG_F(ERROR, "No net state for client %s", senderUid.c_str());
                         this->m_fileRequests.pop();
                         this->m_fileMutex.unlock();
                         continue;
                     }
 
-                    state = this->m_netStates.at(senderUid);
                     id = state.sim_identifier;
 
                     // Check again that the requested file hasn't changed
@@ -259,7 +266,11 @@ namespace simularium {
                     this->m_fileMutex.unlock();
                 }
 
-                std::this_thread::sleep_for(std::chrono::milliseconds(this->kFileIoCheckIntervalMilliSeconds));
+                // Trajectories are converted a batch of frames at a time
+                //  between requests, while clients stream what is there
+                if (!this->ContinueConversion(simulation, this->kConversionBatchFrames)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(this->kFileIoCheckIntervalMilliSeconds));
+                }
             }
         });
     }
@@ -268,7 +279,11 @@ namespace simularium {
     {
         std::string newUid;
         this->GenerateLocalUUID(newUid);
-        this->m_netStates[newUid] = NetState();
+        {
+            std::lock_guard<std::mutex> lock(this->m_netStatesMutex);
+            this->m_netStates[newUid] = NetState();
+            this->UpdatePinnedCaches();
+        }
         this->m_missedHeartbeats[newUid] = 0;
         this->m_netConnections[newUid] = hd1;
         this->m_latestConnectionUid = newUid;
@@ -284,10 +299,39 @@ namespace simularium {
             this->LogClientEvent(connectionUID, "Removing closed network connection");
             this->m_netConnections.erase(connectionUID);
             this->m_missedHeartbeats.erase(connectionUID);
+
+            std::lock_guard<std::mutex> lock(this->m_netStatesMutex);
             this->m_netStates.erase(connectionUID);
+            this->UpdatePinnedCaches();
         }
     }
 
+    bool ConnectionManager::GetNetState(std::string connectionUID, NetState& state)
+    {
+        std::lock_guard<std::mutex> lock(this->m_netStatesMutex);
+        auto found = this->m_netStates.find(connectionUID);
+        if (found == this->m_netStates.end()) {
+            return false;
+        }
+
+        state = found->second;
+        return true;
+    }
+
+    void ConnectionManager::UpdatePinnedCaches()
+    {
+        if (!this->m_pinnedSimulation) {
+            return;
+        }
+
+        // Caches clients are streaming are kept open and on disk
+        std::vector<std::string> streamedFiles;
+        for (auto& entry : this->m_netStates) {
+            streamedFiles.push_back(entry.second.sim_identifier);
+        }
+        this->m_pinnedSimulation->SetPinnedCaches(streamedFiles);
+    }
+
     void ConnectionManager::CloseConnection(std::string connectionUID)
     {
         this->LogClientEvent(connectionUID, "Closing network connection");
@@ -360,7 +404,24 @@ namespace simularium {
     void ConnectionManager::SetClientSimId(
         std::string connectionUID, std::string simId)
     {
+        // Attribute records are counted per trajectory
+        std::lock_guard<std::mutex> lock(this->m_netStatesMutex);
         this->m_netStates[connectionUID].sim_identifier = simId;
+        this->m_netStates[connectionUID].attribute_records_sent = 0;
+        this->m_netStates[connectionUID].pending_frame = broadcast::eos;
+        this->UpdatePinnedCaches();
+    }
+
+    void ConnectionManager::SetClientCapabilities(
+        std::string connectionUID, unsigned int capabilities)
+    {
+        this->m_netStates[connectionUID].capabilities = capabilities;
+    }
+
+    void ConnectionManager::SetClientFrameStride(
+        std::string connectionUID, std::size_t frameStride)
+    {
+        this->m_netStates[connectionUID].frame_stride = std::max(frameStride, std::size_t(1));
     }
 
     void ConnectionManager::CheckForFinishedClient(
@@ -602,13 +663,13 @@ namespace simularium {
         uuid = strUuid;
     }
 
-    void ConnectionManager::PrependArraybufferHeader(
-        BroadcastUpdate& update,
-        std::string fileName)
+    BroadcastDataBuffer ConnectionManager::GetArraybufferHeader(
+        std::string fileName,
+        WebRequestTypes msgType)
     {
         // Append the file-name and message-type
         BroadcastDataBuffer prefix;
-        prefix.push_back(static_cast<float>(id_vis_data_arrive));
+        prefix.push_back(static_cast<float>(msgType));
         float* tmp_buf = (float*)(fileName.c_str());
         auto tmp_buf_size = (fileName.length() + 3) / 4; // 4 char per float
 
@@ -618,10 +679,60 @@ namespace simularium {
             tmp_buf,
             tmp_buf + tmp_buf_size);
 
-        update.buffer.insert(
-            update.buffer.begin(),
-            prefix.begin(),
-            prefix.end());
+        return prefix;
+    }
+
+    void ConnectionManager::SendBroadcastUpdate(
+        std::string connectionUID,
+        std::string fileName,
+        const BroadcastUpdate& update)
+    {
+        if (!this->m_netConnections.count(connectionUID)) {
+            LOG_F(ERROR, "Ignoring message send to invalid/untracked client %s", connectionUID.c_str());
+            return;
+        }
+
+        if (update.frames.size() == 0) {
+            LOG_F(WARNING, "Ignoring empty arraybuffer message");
+            return;
+        }
+
+        // Clients that can decode other frame encodings get a message type
+        //  of their own, with every frame prefixed by its FrameEncoding
+        auto& netState = this->m_netStates[connectionUID];
+        bool encodedMessage = netState.capabilities != ClientCapabilities::id_capability_none;
+        BroadcastDataBuffer header = this->GetArraybufferHeader(
+            fileName,
+            encodedMessage ? id_vis_encoded_data_arrive : id_vis_data_arrive);
+
+        std::size_t payloadSize = header.size() * sizeof(float);
+        for (auto& frame : update.frames) {
+            payloadSize += frame.size + fileio::binary::EOF_SIZE + (encodedMessage ? sizeof(float) : 0);
+        }
+
+        try {
+            // Frames are copied straight from their views into the
+            //  outgoing message, without an intermediate buffer
+            auto& hdl = this->m_netConnections.at(connectionUID);
+            auto msg = this->m_server.get_con_from_hdl(hdl)->get_message(
+                websocketpp::frame::opcode::binary, payloadSize);
+            msg->append_payload(header.data(), header.size() * sizeof(float));
+            for (auto& frame : update.frames) {
+                if (encodedMessage) {
+                    float encoding = float(frame.encoding);
+                    msg->append_payload(&encoding, sizeof(encoding));
+                }
+                msg->append_payload(frame.data, frame.size);
+                msg->append_payload(fileio::binary::eof, fileio::binary::EOF_SIZE);
+            }
+
+            this->m_server.send(hdl, msg);
+            netState.last_sent_frame = update.frames.back().frameNumber;
+        } catch (...) {
+            this->LogClientEvent(connectionUID, "Failed to send websocket message to client");
+            LOG_F(ERROR, "Websocket send failed with exception, marking offending connection for removal...");
+            this->m_uidsToDelete.push_back(connectionUID);
+        }
     }
 
     void ConnectionManager::SendDataToClient(
@@ -641,18 +752,168 @@ namespace simularium {
             return; // no data to send
         }
 
+        // A frame the client went to before it was in the cache is sent
+        //  once it is there
+        if (netState.pending_frame != broadcast::eos && simulation.HasFrame(sid, netState.pending_frame)) {
+            std::size_t frameNumber = netState.pending_frame;
+            netState.pending_frame = broadcast::eos;
+            this->SendSingleFrameToClient(simulation, connectionUID, frameNumber);
+            return;
+        }
+
         if (netState.play_state != ClientPlayState::Playing) {
             return;
         }
 
+        StreamOptions options;
+        options.allowDeltas = netState.capabilities & ClientCapabilities::id_capability_delta_frames;
+        options.hasPreviousFrame = netState.playback_pos > 0
+            && netState.last_sent_frame == netState.playback_pos - 1;
+        options.allowColumnar = netState.capabilities & ClientCapabilities::id_capability_columnar_frames;
+        options.allowPacked = netState.capabilities & ClientCapabilities::id_capability_packed_frames;
+        options.omitStaticAgents = netState.capabilities & ClientCapabilities::id_capability_static_agents;
+        options.omitAttributes = netState.capabilities & ClientCapabilities::id_capability_agent_attributes;
+        options.frameStride = netState.frame_stride;
+
         auto update = simulation.GetBroadcastUpdate(
             sid,
             netState.playback_pos,
-            this->kBroadcastBufferSize);
-        this->PrependArraybufferHeader(update, sid);
+            this->kBroadcastBufferSize,
+            options);
 
         netState.playback_pos = update.new_pos;
-        this->SendArrayBufferMessage(connectionUID, update.buffer);
+
+        // Playback ran into frames that aren't converted yet, e.g. ones a
+        //  moved conversion skipped
+        if (update.frames.empty()) {
+            this->SeekConversion(simulation, sid, netState.playback_pos);
+            return;
+        }
+
+        this->SendAttributesToClient(simulation, connectionUID, update);
+        this->SendBroadcastUpdate(connectionUID, sid, update);
+    }
+
+    void ConnectionManager::SendFrameStatsToClient(
+        Simulation& simulation,
+        std::string connectionUID)
+    {
+        if (!this->m_netStates.count(connectionUID)) {
+            LOG_F(ERROR, "No net state for client %s", connectionUID.c_str());
+            return;
+        }
+
+        std::string sid = this->m_netStates.at(connectionUID).sim_identifier;
+        Json::Value times(Json::arrayValue);
+        Json::Value numAgents(Json::arrayValue);
+        Json::Value sizes(Json::arrayValue);
+
+        // Frames whose stats are missing end the list early
+        std::size_t numFrames = simulation.GetNumFrames(sid);
+        fileio::FrameStats stats;
+        for (std::size_t i = 0; i < numFrames && simulation.GetFrameStats(sid, i, stats); ++i) {
+            times.append(stats.time);
+            numAgents.append(stats.numAgents);
+            sizes.append(stats.frameSize);
+        }
+
+        Json::Value message;
+        message["msgType"] = WebRequestTypes::id_frame_stats;
+        message["fileName"] = sid;
+        message["time"] = times;
+        message["numAgents"] = numAgents;
+        message["size"] = sizes;
+
+        this->LogClientEvent(connectionUID, "Sending stats of " + std::to_string(times.size()) + " frames");
+        this->SendWebsocketMessage(connectionUID, message);
+    }
+
+    void ConnectionManager::SendStaticLayerToClient(
+        Simulation& simulation,
+        std::string connectionUID)
+    {
+        if (!this->m_netStates.count(connectionUID) || !this->m_netConnections.count(connectionUID)) {
+            LOG_F(ERROR, "No net state for client %s", connectionUID.c_str());
+            return;
+        }
+
+        auto& netState = this->m_netStates.at(connectionUID);
+        if (!(netState.capabilities & ClientCapabilities::id_capability_static_agents)) {
+            return;
+        }
+
+        // An empty layer is only its agent count, and is not sent
+        std::string sid = netState.sim_identifier;
+        std::vector<char> layer = simulation.GetStaticLayer(sid);
+        if (layer.size() <= sizeof(std::uint32_t)) {
+            return;
+        }
+
+        BroadcastDataBuffer header = this->GetArraybufferHeader(sid, id_static_agents);
+        try {
+            auto& hdl = this->m_netConnections.at(connectionUID);
+            auto msg = this->m_server.get_con_from_hdl(hdl)->get_message(
+                websocketpp::frame::opcode::binary, header.size() * sizeof(float) + layer.size());
+            msg->append_payload(header.data(), header.size() * sizeof(float));
+            msg->append_payload(layer.data(), layer.size());
+
+            this->LogClientEvent(connectionUID, "Sending static layer of " + std::to_string(layer.size()) + " bytes");
+            this->m_server.send(hdl, msg);
+        } catch (...) {
+            this->LogClientEvent(connectionUID, "Failed to send websocket message to client");
+            LOG_F(ERROR, "Websocket send failed with exception, marking offending connection for removal...");
+            this->m_uidsToDelete.push_back(connectionUID);
+        }
+    }
+
+    void ConnectionManager::SendAttributesToClient(
+        Simulation& simulation,
+        std::string connectionUID,
+        const BroadcastUpdate& update)
+    {
+        if (!this->m_netStates.count(connectionUID) || !this->m_netConnections.count(connectionUID)) {
+            LOG_F(ERROR, "No net state for client %s", connectionUID.c_str());
+            return;
+        }
+
+        auto& netState = this->m_netStates.at(connectionUID);
+        if (!(netState.capabilities & ClientCapabilities::id_capability_agent_attributes) || update.frames.empty()) {
+            return;
+        }
+
+        // Records are sent in order, up to the latest frame the client
+        //  is about to get; frames before it are covered by earlier records
+        std::size_t throughFrame = 0;
+        for (auto& frame : update.frames) {
+            throughFrame = std::max(throughFrame, frame.frameNumber);
+        }
+
+        std::string sid = netState.sim_identifier;
+        std::vector<char> records = simulation.GetAttributeRecords(sid, netState.attribute_records_sent, throughFrame);
+        std::uint32_t numRecords = 0;
+        if (records.size() >= 2 * sizeof(std::uint32_t)) {
+            std::memcpy(&numRecords, &records[sizeof(std::uint32_t)], sizeof(numRecords));
+        }
+
+        if (numRecords == 0) {
+            return;
+        }
+
+        BroadcastDataBuffer header = this->GetArraybufferHeader(sid, id_agent_attributes);
+        try {
+            auto& hdl = this->m_netConnections.at(connectionUID);
+            auto msg = this->m_server.get_con_from_hdl(hdl)->get_message(
+                websocketpp::frame::opcode::binary, header.size() * sizeof(float) + records.size());
+            msg->append_payload(header.data(), header.size() * sizeof(float));
+            msg->append_payload(records.data(), records.size());
+
+            this->m_server.send(hdl, msg);
+            netState.attribute_records_sent += numRecords;
+        } catch (...) {
+            this->LogClientEvent(connectionUID, "Failed to send websocket message to client");
+            LOG_F(ERROR, "Websocket send failed with exception, marking offending connection for removal...");
+            this->m_uidsToDelete.push_back(connectionUID);
+        }
     }
 
     void ConnectionManager::SendSingleFrameToClient(
@@ -675,14 +936,29 @@ namespace simularium {
             return; // no data to send
         }
 
+        // Clients that hold the static layer get frames without its agents,
+        //  and clients that hold the attribute table get frames without attributes
+        StreamOptions options;
+        options.omitStaticAgents = netState.capabilities & ClientCapabilities::id_capability_static_agents;
+        options.omitAttributes = netState.capabilities & ClientCapabilities::id_capability_agent_attributes;
+        options.frameStride = netState.frame_stride;
         auto update = simulation.GetBroadcastFrame(
-            sid, frameNumber);
-
-        this->PrependArraybufferHeader(update, sid);
+            sid, frameNumber, options);
+
+        // Frames that aren't converted, or downloaded, yet are sent by
+        //  SendDataToClient once they are; conversions move to them first
+        if (update.frames.empty()) {
+            netState.playback_pos = update.new_pos;
+            netState.pending_frame = frameNumber;
+            this->SeekConversion(simulation, sid, frameNumber);
+            return;
+        }
 
         // Send the message
+        netState.pending_frame = broadcast::eos;
         netState.playback_pos = update.new_pos;
-        this->SendArrayBufferMessage(connectionUID, update.buffer);
+        this->SendAttributesToClient(simulation, connectionUID, update);
+        this->SendBroadcastUpdate(connectionUID, sid, update);
     }
 
     void ConnectionManager::HandleMessage(NetMessage nm)
@@ -730,6 +1006,13 @@ namespace simularium {
                 Json::Value jsonMsg = messages[i].jsonMessage;
 
                 int msgType = jsonMsg["msgType"].asInt();
+                if (jsonMsg.isMember("capabilities")) {
+                    this->SetClientCapabilities(senderUid, jsonMsg["capabilities"].asUInt());
+                }
+                if (jsonMsg.isMember("frameStride")) {
+                    this->SetClientFrameStride(senderUid, jsonMsg["frameStride"].asUInt());
+                }
+
                 switch (msgType) {
                 case WebRequestTypes::id_vis_data_request: {
                     auto runMode = static_cast<SimulationMode>(jsonMsg["mode"].asInt());
@@ -855,6 +1138,9 @@ namespace simularium {
 
                     this->SendSingleFrameToClient(simulation, senderUid, frameNumber);
                 } break;
+                case WebRequestTypes::id_frame_stats: {
+                    this->SendFrameStatsToClient(simulation, senderUid);
+                } break;
                 case WebRequestTypes::id_init_trajectory_file: {
                     std::string trajectoryFileName = jsonMsg["fileName"].asString();
                     simulation.SetPlaybackMode(SimulationMode::id_traj_file_playback);
@@ -905,8 +1191,12 @@ namespace simularium {
                 LOG_F(INFO, "File %s has a simularium file extension", fileName.c_str());
             }
 
-            // Attempt to download an already processed runtime cache
+            // Use a cache kept from an earlier run, or attempt to download
+            //  an already processed runtime cache
             if (!this->m_argForceInit // this will force the server to re-download/process a trajectory
+                && simulation.LoadWarmCache(fileName)) {
+                LOG_F(INFO, "[%s] Using kept runtime cache", fileName.c_str());
+            } else if (!this->m_argForceInit
                 && simulation.DownloadRuntimeCache(fileName)) {
                 simulation.PreprocessRuntimeCache(fileName);
             } else if (simulation.FindSimulariumFile(fileName)) { // find .simularium file instead
@@ -915,7 +1205,9 @@ namespace simularium {
                     simulation.UploadRuntimeCache(fileName);
                 }
             } else {
-                // Reprocess a raw trajectory (if found)
+                // Reprocess a raw trajectory (if found); the SimPkg
+                //  is shared, so a conversion still running finishes first
+                this->FinishRuntimeCache(simulation);
                 simulation.SetPlaybackMode(id_traj_file_playback);
                 simulation.Reset();
                 if (simulation.LoadTrajectoryFile(fileName)) {
@@ -937,6 +1229,10 @@ namespace simularium {
 
         Json::Value fprops = tfp_to_json(tfp);
         this->SendWebsocketMessage(connectionUID, fprops);
+        this->SendStaticLayerToClient(simulation, connectionUID);
+
+        // The cache may have been processed again, so attribute records start over
+        this->m_netStates.at(connectionUID).attribute_records_sent = 0;
         this->SendSingleFrameToClient(simulation, connectionUID, 0);
     }
 
@@ -946,10 +1242,54 @@ namespace simularium {
         std::string fileName = simulation.GetSimId();
 
         LOG_F(INFO, "[%s] Loading trajectory file into runtime cache", fileName.c_str());
-        std::size_t fn = 0;
+        {
+            std::lock_guard<std::mutex> lock(this->m_conversionMutex);
+            this->m_convertingFile = fileName;
+            this->m_numConvertedFrames = 0;
+
+            // Conversions interrupted after a checkpoint continue from there
+            if (config::GetCacheCheckpointInterval() > 0) {
+                simulation.ResumeConversion();
+            }
+        }
+
+        // Clients of a trajectory file get its first frame while the rest
+        //  is converted in the background
+        if (!simulation.IsPlayingTrajectory()) {
+            this->FinishRuntimeCache(simulation);
+            return;
+        }
+
+        while (!simulation.HasFrame(fileName, 0) && this->ContinueConversion(simulation, 1)) {
+        }
+    }
+
+    bool ConnectionManager::ContinueConversion(
+        Simulation& simulation,
+        std::size_t numFrames)
+    {
+        std::string fileName;
+        {
+            std::lock_guard<std::mutex> lock(this->m_conversionMutex);
+            if (this->m_convertingFile.empty()) {
+                return false;
+            }
 
-        while (!simulation.HasLoadedAllFrames()) {
-            simulation.LoadNextFrame();
+            std::size_t checkpointInterval = config::GetCacheCheckpointInterval();
+            for (std::size_t i = 0; i < numFrames && !simulation.HasLoadedAllFrames(); ++i) {
+                simulation.LoadNextFrame();
+                if (checkpointInterval > 0 && ++this->m_numConvertedFrames % checkpointInterval == 0) {
+                    simulation.CheckpointConversion();
+                }
+            }
+
+            if (!simulation.HasLoadedAllFrames()) {
+                return true;
+            }
+
+            simulation.FinishConversion();
+            fileName = this->m_convertingFile;
+            this->m_convertingFile.clear();
         }
         LOG_F(INFO, "[%s] Finished loading trajectory into runtime cache", fileName.c_str());
 
@@ -959,6 +1299,29 @@ namespace simularium {
         }
 
         simulation.CleanupTmpFiles(fileName);
+        return false;
+    }
+
+    void ConnectionManager::FinishRuntimeCache(
+        Simulation& simulation)
+    {
+        while (this->ContinueConversion(simulation, this->kConversionBatchFrames)) {
+        }
+    }
+
+    void ConnectionManager::SeekConversion(
+        Simulation& simulation,
+        std::string fileName,
+        std::size_t frameNumber)
+    {
+        std::lock_guard<std::mutex> lock(this->m_conversionMutex);
+        if (fileName != this->m_convertingFile
+            || frameNumber >= simulation.GetFileProperties(fileName).numberOfFrames
+            || simulation.HasFrame(fileName, frameNumber)) {
+            return;
+        }
+
+        simulation.SeekConversion(frameNumber);
     }
 
 } // namespace simularium
@@ -204,6 +204,27 @@ namespace simularium {
         }
     }
 
+    bool CytosimPkg::ResumeAtFrame(std::size_t frameNumber)
+    {
+        if (!this->m_reader->hasFile()) {
+            return false;
+        }
+
+        // Frames are read, without copying their fibers, up to the frame to resume at
+        this->m_reader->rewind();
+        for (std::size_t i = 0; i < frameNumber; ++i) {
+            if (this->m_reader->eof() || this->m_reader->loadNextFrame(*(this->m_simul.get())) != 0) {
+                LOG_F(ERROR, "Cytosim trajectory ends before frame %zu", frameNumber);
+                this->m_reader->rewind();
+                return false;
+            }
+        }
+
+        LOG_F(INFO, "Resuming Cytosim trajectory at frame %zu", frameNumber);
+        this->m_hasFinishedStreaming = false;
+        return true;
+    }
+
     void CytosimPkg::LoadTrajectoryFile(
         std::string filePath,
         TrajectoryFileProperties& fileProps)
@@ -0,0 +1,281 @@
+#include "simularium/fileio/fiber_codec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace fiber {
+
+            static const std::size_t kHeaderSize = sizeof(std::uint32_t) + sizeof(float);
+            static const std::size_t kTrailerSize = sizeof(std::uint32_t);
+
+            inline float Distance(const float* a, const float* b)
+            {
+                float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+                return std::sqrt(dx * dx + dy * dy + dz * dz);
+            }
+
+            // Distance from p to the segment [a, b]
+            inline float SegmentDistance(const float* p, const float* a, const float* b)
+            {
+                float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                float ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+                float lengthSquared = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+                float t = lengthSquared > 0
+                    ? (ap[0] * ab[0] + ap[1] * ab[1] + ap[2] * ab[2]) / lengthSquared
+                    : 0.f;
+                t = std::min(std::max(t, 0.f), 1.f);
+
+                float closest[3] = { a[0] + t * ab[0], a[1] + t * ab[1], a[2] + t * ab[2] };
+                return Distance(p, closest);
+            }
+
+            template <typename T>
+            inline void Append(std::vector<char>& out, T value)
+            {
+                std::size_t start = out.size();
+                out.resize(start + sizeof(T));
+                std::memcpy(&out[start], &value, sizeof(T));
+            }
+
+            template <typename T>
+            inline bool Read(const char*& pos, const char* end, T& value)
+            {
+                if (std::size_t(end - pos) < sizeof(T)) {
+                    return false;
+                }
+
+                std::memcpy(&value, pos, sizeof(T));
+                pos += sizeof(T);
+                return true;
+            }
+
+            inline void AppendVarint(std::vector<char>& out, std::uint64_t value)
+            {
+                while (value >= 0x80) {
+                    out.push_back(char((value & 0x7f) | 0x80));
+                    value >>= 7;
+                }
+                out.push_back(char(value));
+            }
+
+            inline bool ReadVarint(const char*& pos, const char* end, std::uint64_t& value)
+            {
+                value = 0;
+                for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+                    std::uint8_t byte = std::uint8_t(*pos++);
+                    value |= std::uint64_t(byte & 0x7f) << shift;
+                    if (!(byte & 0x80)) {
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            // Zigzag, so small negative steps take as few bytes as positive ones
+            inline std::uint64_t ZigZag(std::int64_t value)
+            {
+                return (std::uint64_t(value) << 1) ^ std::uint64_t(value >> 63);
+            }
+
+            inline std::int64_t UnZigZag(std::uint64_t value)
+            {
+                return std::int64_t(value >> 1) ^ -std::int64_t(value & 1);
+            }
+
+            std::vector<std::size_t> Simplify(const std::vector<float>& points, float tolerance)
+            {
+                std::size_t n = points.size() / 3;
+                std::vector<bool> keep(n, tolerance <= 0);
+                if (n > 0) {
+                    keep[0] = keep[n - 1] = true;
+                }
+
+                // Keep the point furthest from each segment until
+                //  every dropped point is within tolerance
+                std::vector<std::pair<std::size_t, std::size_t>> segments;
+                if (n > 2 && tolerance > 0) {
+                    segments.emplace_back(0, n - 1);
+                }
+
+                while (!segments.empty()) {
+                    std::size_t a = segments.back().first;
+                    std::size_t b = segments.back().second;
+                    segments.pop_back();
+
+                    float furthest = 0;
+                    std::size_t index = a;
+                    for (std::size_t i = a + 1; i < b; ++i) {
+                        float d = SegmentDistance(&points[3 * i], &points[3 * a], &points[3 * b]);
+                        if (d > furthest) {
+                            furthest = d;
+                            index = i;
+                        }
+                    }
+
+                    if (furthest > tolerance) {
+                        keep[index] = true;
+                        segments.emplace_back(a, index);
+                        segments.emplace_back(index, b);
+                    }
+                }
+
+                std::vector<std::size_t> out;
+                for (std::size_t i = 0; i < n; ++i) {
+                    if (keep[i]) {
+                        out.push_back(i);
+                    }
+                }
+
+                return out;
+            }
+
+            bool EncodeFibers(TrajectoryFrame& frame, const FiberOptions& options, EncodedFibers& out)
+            {
+                out.section.clear();
+                out.error = 0;
+                out.numSubpoints = 0;
+                if (options.step <= 0) {
+                    return false;
+                }
+
+                Append(out.section, std::uint32_t(0));
+                Append(out.section, options.step);
+
+                std::uint32_t numRecords = 0;
+                std::vector<float> decoded;
+                for (auto& agent : frame.data) {
+                    if (agent.vis_type != kFiberVisType) {
+                        continue;
+                    }
+                    numRecords++;
+
+                    const std::vector<float>& points = agent.subpoints;
+                    bool finite = std::all_of(points.begin(), points.end(), [](float v) { return std::isfinite(v); });
+                    if (points.size() % 3 != 0 || !finite) {
+                        AppendVarint(out.section, 0);
+                        continue;
+                    }
+
+                    std::vector<std::size_t> kept = Simplify(points, options.tolerance);
+                    AppendVarint(out.section, kept.size() + 1);
+
+                    decoded.resize(3 * kept.size());
+                    for (std::size_t k = 0; k < kept.size(); ++k) {
+                        const float* p = &points[3 * kept[k]];
+                        float* d = &decoded[3 * k];
+                        for (std::size_t axis = 0; axis < 3; ++axis) {
+                            if (k == 0) {
+                                d[axis] = p[axis];
+                                Append(out.section, p[axis]);
+                                continue;
+                            }
+
+                            // Must match the arithmetic in DecodeFibers
+                            std::int64_t q = std::llrint((p[axis] - d[axis - 3]) / options.step);
+                            AppendVarint(out.section, ZigZag(q));
+                            d[axis] = d[axis - 3] + float(q) * options.step;
+                        }
+                    }
+
+                    // Error of the kept points, and of the points dropped between them
+                    for (std::size_t k = 0; k < kept.size(); ++k) {
+                        out.error = std::max(out.error, Distance(&points[3 * kept[k]], &decoded[3 * k]));
+                        for (std::size_t i = k > 0 ? kept[k - 1] + 1 : kept[k]; i < kept[k]; ++i) {
+                            out.error = std::max(out.error,
+                                SegmentDistance(&points[3 * i], &decoded[3 * (k - 1)], &decoded[3 * k]));
+                        }
+                    }
+
+                    out.numSubpoints += decoded.size();
+                    agent.subpoints.clear();
+                }
+
+                if (numRecords == 0) {
+                    out.section.clear();
+                    return false;
+                }
+
+                std::memcpy(&out.section[0], &numRecords, sizeof(numRecords));
+                Append(out.section, std::uint32_t(out.section.size() + kTrailerSize));
+                return true;
+            }
+
+            bool SplitChunk(const char* data, std::size_t size, std::size_t& bodySize)
+            {
+                std::uint32_t sectionSize = 0;
+                if (size < kHeaderSize + kTrailerSize) {
+                    return false;
+                }
+
+                std::memcpy(&sectionSize, data + size - kTrailerSize, sizeof(sectionSize));
+                if (sectionSize < kHeaderSize + kTrailerSize || sectionSize > size) {
+                    return false;
+                }
+
+                bodySize = size - sectionSize;
+                return true;
+            }
+
+            bool DecodeFibers(const char* data, std::size_t size, TrajectoryFrame& frame)
+            {
+                const char* pos = data;
+                const char* end = data + size - std::min(size, kTrailerSize);
+                std::uint32_t numRecords;
+                float step;
+                if (!Read(pos, end, numRecords) || !Read(pos, end, step)) {
+                    return false;
+                }
+
+                std::uint32_t numFibers = 0;
+                for (auto& agent : frame.data) {
+                    if (agent.vis_type != kFiberVisType) {
+                        continue;
+                    }
+
+                    std::uint64_t record;
+                    if (++numFibers > numRecords || !ReadVarint(pos, end, record)) {
+                        return false;
+                    }
+
+                    // Fibers that were left as-is keep their subpoints
+                    if (record == 0) {
+                        continue;
+                    }
+
+                    std::uint64_t numPoints = record - 1;
+                    if (numPoints > std::uint64_t(end - pos)) {
+                        return false;
+                    }
+
+                    agent.subpoints.resize(3 * numPoints);
+                    for (std::size_t k = 0; k < numPoints; ++k) {
+                        float* d = &agent.subpoints[3 * k];
+                        for (std::size_t axis = 0; axis < 3; ++axis) {
+                            if (k == 0) {
+                                if (!Read(pos, end, d[axis])) {
+                                    return false;
+                                }
+                                continue;
+                            }
+
+                            std::uint64_t q;
+                            if (!ReadVarint(pos, end, q)) {
+                                return false;
+                            }
+                            d[axis] = d[axis - 3] + float(UnZigZag(q)) * step;
+                        }
+                    }
+                }
+
+                return numFibers == numRecords && pos == end;
+            }
+
+        } // namespace fiber
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
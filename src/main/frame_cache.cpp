@@ -0,0 +1,181 @@
+#include "simularium/fileio/frame_cache.h"
+#include <algorithm>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+
+        FrameCache::FrameCache(std::size_t capacity, std::size_t numShards)
+        {
+            numShards = std::max(numShards, std::size_t(1));
+            this->m_shardCapacity = capacity / numShards;
+            for (std::size_t i = 0; i < numShards; ++i) {
+                this->m_shards.push_back(std::unique_ptr<Shard>(new Shard()));
+            }
+        }
+
+        std::string FrameCache::MakeKey(
+            const std::string& identifier,
+            std::size_t frameNumber,
+            const StreamOptions& options)
+        {
+            // Every option that changes what is read is part of the key
+            unsigned flags = (options.allowDeltas ? 1 : 0)
+                | (options.hasPreviousFrame ? 2 : 0)
+                | (options.allowColumnar ? 4 : 0)
+                | (options.allowPacked ? 8 : 0)
+                | (options.omitStaticAgents ? 16 : 0)
+                | (options.omitAttributes ? 32 : 0);
+
+            return identifier + '\0' + std::to_string(frameNumber)
+                + ':' + std::to_string(flags)
+                + ':' + std::to_string(options.frameStride);
+        }
+
+        FrameCache::Shard& FrameCache::GetShard(const std::string& key)
+        {
+            return *this->m_shards[std::hash<std::string>()(key) % this->m_shards.size()];
+        }
+
+        BroadcastUpdate FrameCache::GetOrLoad(
+            const std::string& identifier,
+            std::size_t frameNumber,
+            const StreamOptions& options,
+            std::function<BroadcastUpdate()> load)
+        {
+            if (!this->IsEnabled()) {
+                return load();
+            }
+
+            std::string key = MakeKey(identifier, frameNumber, options);
+            Shard& shard = this->GetShard(key);
+
+            std::promise<BroadcastUpdate> loaded;
+            std::uint64_t generation = 0;
+            {
+                std::unique_lock<std::mutex> lock(shard.mutex);
+                auto found = shard.entries.find(key);
+                if (found != shard.entries.end()) {
+                    shard.lru.splice(shard.lru.begin(), shard.lru, found->second.lruPos);
+                    this->m_hits++;
+                    return found->second.update;
+                }
+
+                auto inFlight = shard.loading.find(key);
+                if (inFlight != shard.loading.end()) {
+                    std::shared_future<BroadcastUpdate> pending = inFlight->second;
+                    lock.unlock();
+                    this->m_shared++;
+                    return pending.get();
+                }
+
+                shard.loading[key] = loaded.get_future().share();
+                generation = this->m_generation;
+            }
+
+            this->m_misses++;
+            BroadcastUpdate update;
+            try {
+                update = load();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.loading.erase(key);
+                loaded.set_exception(std::current_exception());
+                throw;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.loading.erase(key);
+                if (!update.frames.empty() && generation == this->m_generation) {
+                    this->Insert(shard, key, identifier, update);
+                    update = shard.entries.count(key) ? shard.entries.at(key).update : update;
+                }
+            }
+
+            loaded.set_value(update);
+            return update;
+        }
+
+        void FrameCache::Insert(Shard& shard, const std::string& key, const std::string& identifier, BroadcastUpdate update)
+        {
+            std::size_t size = 0;
+            for (auto& view : update.frames) {
+                size += view.size;
+            }
+            if (size > this->m_shardCapacity) {
+                return;
+            }
+
+            // Views of a mapped file would keep the whole file mapped,
+            //  and its disk space in use after it is deleted
+            for (auto& view : update.frames) {
+                auto copy = std::make_shared<std::vector<char>>(view.data, view.data + view.size);
+                view.data = copy->data();
+                view.owner = copy;
+            }
+
+            while (shard.bytes + size > this->m_shardCapacity && !shard.lru.empty()) {
+                auto victim = shard.entries.find(shard.lru.back());
+                shard.bytes -= victim->second.size;
+                shard.entries.erase(victim);
+                shard.lru.pop_back();
+                this->m_evictions++;
+            }
+
+            shard.lru.push_front(key);
+            Entry& entry = shard.entries[key];
+            entry.identifier = identifier;
+            entry.update = update;
+            entry.size = size;
+            entry.lruPos = shard.lru.begin();
+            shard.bytes += size;
+        }
+
+        void FrameCache::Invalidate(const std::string& identifier)
+        {
+            this->m_generation++;
+            for (auto& shard : this->m_shards) {
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                for (auto it = shard->entries.begin(); it != shard->entries.end();) {
+                    if (it->second.identifier == identifier) {
+                        shard->bytes -= it->second.size;
+                        shard->lru.erase(it->second.lruPos);
+                        it = shard->entries.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+        }
+
+        void FrameCache::Clear()
+        {
+            this->m_generation++;
+            for (auto& shard : this->m_shards) {
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                shard->entries.clear();
+                shard->lru.clear();
+                shard->bytes = 0;
+            }
+        }
+
+        FrameCacheStats FrameCache::GetStats()
+        {
+            FrameCacheStats stats;
+            stats.hits = this->m_hits;
+            stats.misses = this->m_misses;
+            stats.shared = this->m_shared;
+            stats.evictions = this->m_evictions;
+            for (auto& shard : this->m_shards) {
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                stats.bytes += shard->bytes;
+                stats.entries += shard->entries.size();
+            }
+
+            return stats;
+        }
+
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
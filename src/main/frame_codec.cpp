@@ -0,0 +1,434 @@
+#include "simularium/fileio/frame_codec.h"
+#include "loguru/loguru.hpp"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace codec {
+
+            // Scalar agent fields, in DeltaField bit order
+            static float AgentData::*const kDeltaFields[] = {
+                &AgentData::vis_type,
+                &AgentData::type,
+                &AgentData::x,
+                &AgentData::y,
+                &AgentData::z,
+                &AgentData::xrot,
+                &AgentData::yrot,
+                &AgentData::zrot,
+                &AgentData::collision_radius
+            };
+
+            static const std::size_t kNumDeltaFields = sizeof(kDeltaFields) / sizeof(kDeltaFields[0]);
+
+            // Bitwise comparison, so -0 and NaN payloads survive a round trip
+            inline bool SameValue(float a, float b)
+            {
+                return std::memcmp(&a, &b, sizeof(float)) == 0;
+            }
+
+            /**
+             *   FloatReader
+             *
+             *   Bounds-checked sequential reads from a float chunk
+             */
+            class FloatReader {
+            public:
+                FloatReader(const char* data, std::size_t size)
+                    : m_data(data)
+                    , m_count(size / sizeof(float))
+                {
+                }
+
+                bool Read(float& value)
+                {
+                    if (this->m_pos >= this->m_count) {
+                        return false;
+                    }
+
+                    std::memcpy(&value, this->m_data + this->m_pos * sizeof(float), sizeof(float));
+                    this->m_pos++;
+                    return true;
+                }
+
+                bool Read(std::vector<float>& values, std::size_t count)
+                {
+                    if (count > this->m_count - this->m_pos) {
+                        return false;
+                    }
+
+                    values.resize(count);
+                    if (count > 0) {
+                        std::memcpy(&values[0], this->m_data + this->m_pos * sizeof(float), count * sizeof(float));
+                    }
+                    this->m_pos += count;
+                    return true;
+                }
+
+                bool AtEnd() { return this->m_pos == this->m_count; }
+
+            private:
+                const char* m_data;
+                std::size_t m_count;
+                std::size_t m_pos = 0;
+            };
+
+            inline void AppendAgent(const AgentData& agent, std::vector<float>& out)
+            {
+                out.push_back(agent.vis_type);
+                out.push_back(float(agent.id));
+                out.push_back(agent.type);
+                out.push_back(agent.x);
+                out.push_back(agent.y);
+                out.push_back(agent.z);
+                out.push_back(agent.xrot);
+                out.push_back(agent.yrot);
+                out.push_back(agent.zrot);
+                out.push_back(agent.collision_radius);
+                out.push_back(agent.subpoints.size());
+                out.insert(out.end(), agent.subpoints.begin(), agent.subpoints.end());
+            }
+
+            bool IdsFitInFloat(const TrajectoryFrame& frame)
+            {
+                return std::all_of(frame.data.begin(), frame.data.end(),
+                    [](const AgentData& agent) { return agent.id <= kMaxFloatId; });
+            }
+
+            std::vector<float> SerializeFrame(const TrajectoryFrame& frame)
+            {
+                std::vector<float> out;
+                SerializeFrame(frame, out);
+                return out;
+            }
+
+            void SerializeFrame(const TrajectoryFrame& frame, std::vector<float>& out)
+            {
+                if (FrameCodec<FixedStrideLayout>::Accepts(frame)) {
+                    FrameCodec<FixedStrideLayout>::Serialize(frame, out);
+                } else {
+                    FrameCodec<GeneralLayout>::Serialize(frame, out);
+                }
+            }
+
+            bool ParseFrame(const char* data, std::size_t size, TrajectoryFrame& frame)
+            {
+                return FrameCodec<FixedStrideLayout>::Accepts(data, size)
+                    ? FrameCodec<FixedStrideLayout>::Parse(data, size, frame)
+                    : FrameCodec<GeneralLayout>::Parse(data, size, frame);
+            }
+
+            bool FrameCodec<FixedStrideLayout>::Accepts(const TrajectoryFrame& frame)
+            {
+                return std::all_of(frame.data.begin(), frame.data.end(),
+                    [](const AgentData& agent) { return agent.subpoints.empty(); });
+            }
+
+            bool FrameCodec<FixedStrideLayout>::Accepts(const char* data, std::size_t size)
+            {
+                // Every agent takes at least kAgentStride floats, so a chunk of
+                //  exactly that many per agent has no subpoints at all
+                float numAgents = 0;
+                if (size % sizeof(float) != 0 || size < 3 * sizeof(float)) {
+                    return false;
+                }
+
+                std::memcpy(&numAgents, data + 2 * sizeof(float), sizeof(numAgents));
+                return numAgents >= 0 && size / sizeof(float) == 3 + kAgentStride * std::size_t(numAgents);
+            }
+
+            void FrameCodec<FixedStrideLayout>::Serialize(const TrajectoryFrame& frame, std::vector<float>& out)
+            {
+                out.resize(3 + kAgentStride * frame.data.size());
+                out[0] = float(frame.frameNumber);
+                out[1] = frame.time;
+                out[2] = float(frame.data.size());
+
+                float* dst = &out[3];
+                for (auto& agent : frame.data) {
+                    dst[0] = agent.vis_type;
+                    dst[1] = float(agent.id);
+                    dst[2] = agent.type;
+                    dst[3] = agent.x;
+                    dst[4] = agent.y;
+                    dst[5] = agent.z;
+                    dst[6] = agent.xrot;
+                    dst[7] = agent.yrot;
+                    dst[8] = agent.zrot;
+                    dst[9] = agent.collision_radius;
+                    dst[10] = 0;
+                    dst += kAgentStride;
+                }
+            }
+
+            bool FrameCodec<FixedStrideLayout>::Parse(const char* data, std::size_t size, TrajectoryFrame& frame)
+            {
+                if (!Accepts(data, size)) {
+                    return false;
+                }
+
+                float header[3];
+                std::memcpy(header, data, sizeof(header));
+                frame.frameNumber = std::size_t(header[0]);
+                frame.time = header[1];
+
+                // Agents are overwritten in place, so frames parsed
+                //  into the same object reuse its storage
+                frame.data.resize(std::size_t(header[2]));
+                const char* src = data + sizeof(header);
+                for (auto& agent : frame.data) {
+                    float fields[kAgentStride];
+                    std::memcpy(fields, src, sizeof(fields));
+                    src += sizeof(fields);
+                    if (fields[10] != 0) {
+                        return false;
+                    }
+
+                    agent.vis_type = fields[0];
+                    agent.id = std::uint32_t(fields[1]);
+                    agent.type = fields[2];
+                    agent.x = fields[3];
+                    agent.y = fields[4];
+                    agent.z = fields[5];
+                    agent.xrot = fields[6];
+                    agent.yrot = fields[7];
+                    agent.zrot = fields[8];
+                    agent.collision_radius = fields[9];
+                    agent.subpoints.clear();
+                }
+
+                return true;
+            }
+
+            void FrameCodec<GeneralLayout>::Serialize(const TrajectoryFrame& frame, std::vector<float>& out)
+            {
+                out.clear();
+                out.push_back(float(frame.frameNumber));
+                out.push_back(frame.time);
+                out.push_back(float(frame.data.size()));
+
+                for (auto& agent : frame.data) {
+                    AppendAgent(agent, out);
+                }
+            }
+
+            bool FrameCodec<GeneralLayout>::Parse(const char* data, std::size_t size, TrajectoryFrame& frame)
+            {
+                FloatReader reader(data, size);
+                float frameNumber, time, numAgents;
+                if (!reader.Read(frameNumber) || !reader.Read(time) || !reader.Read(numAgents)) {
+                    return false;
+                }
+
+                frame.frameNumber = std::size_t(frameNumber);
+                frame.time = time;
+                frame.data.clear();
+                frame.data.reserve(std::min(std::size_t(numAgents), size / sizeof(float)));
+
+                for (std::size_t i = 0; i < std::size_t(numAgents); ++i) {
+                    AgentData agent;
+                    float id, numSubpoints;
+                    bool ok = reader.Read(agent.vis_type)
+                        && reader.Read(id)
+                        && reader.Read(agent.type)
+                        && reader.Read(agent.x)
+                        && reader.Read(agent.y)
+                        && reader.Read(agent.z)
+                        && reader.Read(agent.xrot)
+                        && reader.Read(agent.yrot)
+                        && reader.Read(agent.zrot)
+                        && reader.Read(agent.collision_radius)
+                        && reader.Read(numSubpoints)
+                        && reader.Read(agent.subpoints, std::size_t(numSubpoints));
+
+                    if (!ok) {
+                        return false;
+                    }
+
+                    agent.id = std::uint32_t(id);
+                    frame.data.push_back(std::move(agent));
+                }
+
+                return reader.AtEnd();
+            }
+
+            bool EncodeDelta(
+                const TrajectoryFrame& previous,
+                const TrajectoryFrame& current,
+                std::vector<float>& out)
+            {
+                // Ids are written as floats
+                if (!IdsFitInFloat(previous) || !IdsFitInFloat(current)) {
+                    return false;
+                }
+
+                std::unordered_map<std::uint32_t, std::size_t> previousIndex;
+                for (std::size_t i = 0; i < previous.data.size(); ++i) {
+                    if (!previousIndex.emplace(previous.data[i].id, i).second) {
+                        return false;
+                    }
+                }
+
+                std::unordered_set<std::uint32_t> currentIds;
+                for (auto& agent : current.data) {
+                    if (!currentIds.insert(agent.id).second) {
+                        return false;
+                    }
+                }
+
+                // Surviving agents must keep their relative order, and come
+                //  before any new agents, to be rebuilt in the same order
+                std::vector<float> removed;
+                std::size_t numSurvivors = 0;
+                for (auto& agent : previous.data) {
+                    if (!currentIds.count(agent.id)) {
+                        removed.push_back(float(agent.id));
+                    } else if (current.data[numSurvivors++].id != agent.id) {
+                        return false;
+                    }
+                }
+
+                out.clear();
+                out.push_back(float(current.frameNumber));
+                out.push_back(current.time);
+                out.push_back(float(current.data.size()));
+                out.push_back(float(removed.size()));
+                out.insert(out.end(), removed.begin(), removed.end());
+
+                std::size_t numRecordsPos = out.size();
+                std::size_t numRecords = 0;
+                out.push_back(0);
+
+                for (std::size_t i = 0; i < current.data.size(); ++i) {
+                    const AgentData& agent = current.data[i];
+                    std::uint32_t mask = delta_all_fields;
+
+                    if (i < numSurvivors) {
+                        const AgentData& before = previous.data[previousIndex[agent.id]];
+                        mask = 0;
+                        for (std::size_t f = 0; f < kNumDeltaFields; ++f) {
+                            if (!SameValue(agent.*kDeltaFields[f], before.*kDeltaFields[f])) {
+                                mask |= 1 << f;
+                            }
+                        }
+
+                        if (agent.subpoints.size() != before.subpoints.size()
+                            || (!agent.subpoints.empty()
+                                && std::memcmp(&agent.subpoints[0], &before.subpoints[0], agent.subpoints.size() * sizeof(float)) != 0)) {
+                            mask |= delta_subpoints;
+                        }
+
+                        if (mask == 0) {
+                            continue;
+                        }
+                    }
+
+                    out.push_back(float(agent.id));
+                    out.push_back(float(mask));
+                    for (std::size_t f = 0; f < kNumDeltaFields; ++f) {
+                        if (mask & (1 << f)) {
+                            out.push_back(agent.*kDeltaFields[f]);
+                        }
+                    }
+
+                    if (mask & delta_subpoints) {
+                        out.push_back(float(agent.subpoints.size()));
+                        out.insert(out.end(), agent.subpoints.begin(), agent.subpoints.end());
+                    }
+
+                    numRecords++;
+                }
+
+                out[numRecordsPos] = float(numRecords);
+
+                // Not worth it; a keyframe is no bigger and needs no rebuild
+                std::size_t keyframeSize = 3;
+                for (auto& agent : current.data) {
+                    keyframeSize += 11 + agent.subpoints.size();
+                }
+
+                return out.size() < keyframeSize;
+            }
+
+            bool ApplyDelta(const char* data, std::size_t size, TrajectoryFrame& frame)
+            {
+                FloatReader reader(data, size);
+                float frameNumber, time, numAgents, numRemoved;
+                if (!reader.Read(frameNumber) || !reader.Read(time)
+                    || !reader.Read(numAgents) || !reader.Read(numRemoved)) {
+                    return false;
+                }
+
+                std::vector<float> removed;
+                if (!reader.Read(removed, std::size_t(numRemoved))) {
+                    return false;
+                }
+
+                if (!removed.empty()) {
+                    std::unordered_set<std::uint32_t> removedIds;
+                    for (float id : removed) {
+                        removedIds.insert(std::uint32_t(id));
+                    }
+                    frame.data.erase(
+                        std::remove_if(frame.data.begin(), frame.data.end(),
+                            [&removedIds](const AgentData& agent) { return removedIds.count(agent.id) > 0; }),
+                        frame.data.end());
+                }
+
+                std::unordered_map<std::uint32_t, std::size_t> index;
+                for (std::size_t i = 0; i < frame.data.size(); ++i) {
+                    index[frame.data[i].id] = i;
+                }
+
+                float numRecords;
+                if (!reader.Read(numRecords)) {
+                    return false;
+                }
+
+                for (std::size_t r = 0; r < std::size_t(numRecords); ++r) {
+                    float id, maskValue;
+                    if (!reader.Read(id) || !reader.Read(maskValue)) {
+                        return false;
+                    }
+
+                    auto found = index.find(std::uint32_t(id));
+                    if (found == index.end()) {
+                        AgentData agent;
+                        agent.id = std::uint32_t(id);
+                        found = index.emplace(agent.id, frame.data.size()).first;
+                        frame.data.push_back(agent);
+                    }
+
+                    AgentData& agent = frame.data[found->second];
+                    std::uint32_t mask = std::uint32_t(maskValue);
+                    for (std::size_t f = 0; f < kNumDeltaFields; ++f) {
+                        if ((mask & (1 << f)) && !reader.Read(agent.*kDeltaFields[f])) {
+                            return false;
+                        }
+                    }
+
+                    float numSubpoints;
+                    if ((mask & delta_subpoints)
+                        && (!reader.Read(numSubpoints) || !reader.Read(agent.subpoints, std::size_t(numSubpoints)))) {
+                        return false;
+                    }
+                }
+
+                if (!reader.AtEnd() || frame.data.size() != std::size_t(numAgents)) {
+                    LOG_F(ERROR, "Delta for frame %zu does not match the frame it was applied to", std::size_t(frameNumber));
+                    return false;
+                }
+
+                frame.frameNumber = std::size_t(frameNumber);
+                frame.time = time;
+                return true;
+            }
+
+        } // namespace codec
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
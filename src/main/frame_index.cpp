@@ -0,0 +1,195 @@
+#include "simularium/fileio/frame_index.h"
+#include "loguru/loguru.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+
+        static const unsigned char kIndexMagic[13] = { 'S', 'I', 'M', 'U', 'L', 'A', 'R', 'I', 'U', 'M', 'I', 'D', 'X' };
+        static const unsigned char kIndexVersion[3] = { 1, 0, 0 };
+        static const std::size_t kIndexHeaderSize = 16;
+
+        // Independent accumulators, one per lane, so the loop below
+        //  turns into packed min/max instructions instead of a serial chain
+        static const std::size_t kLanes = 8;
+
+        inline void ColumnBounds(const float* values, std::size_t n, float& lo, float& hi)
+        {
+            float lanesLo[kLanes];
+            float lanesHi[kLanes];
+            std::fill(lanesLo, lanesLo + kLanes, lo);
+            std::fill(lanesHi, lanesHi + kLanes, hi);
+
+            std::size_t i = 0;
+            for (; i + kLanes <= n; i += kLanes) {
+                for (std::size_t l = 0; l < kLanes; ++l) {
+                    lanesLo[l] = std::min(lanesLo[l], values[i + l]);
+                    lanesHi[l] = std::max(lanesHi[l], values[i + l]);
+                }
+            }
+            for (; i < n; ++i) {
+                lanesLo[0] = std::min(lanesLo[0], values[i]);
+                lanesHi[0] = std::max(lanesHi[0], values[i]);
+            }
+
+            lo = *std::min_element(lanesLo, lanesLo + kLanes);
+            hi = *std::max_element(lanesHi, lanesHi + kLanes);
+        }
+
+        FrameStats ComputeFrameStats(const TrajectoryFrame& frame, std::vector<float>& scratch)
+        {
+            std::size_t n = frame.data.size();
+            FrameStats stats;
+            stats.time = frame.time;
+            stats.numAgents = std::uint32_t(n);
+
+            // frame number, time and agent count, then 11 values per agent
+            std::size_t numValues = 3;
+            scratch.resize(3 * n);
+            for (std::size_t i = 0; i < n; ++i) {
+                const AgentData& agent = frame.data[i];
+                scratch[i] = agent.x;
+                scratch[n + i] = agent.y;
+                scratch[2 * n + i] = agent.z;
+                numValues += 11 + agent.subpoints.size();
+            }
+            stats.frameSize = std::uint32_t(numValues * sizeof(float));
+
+            for (std::size_t axis = 0; axis < 3; ++axis) {
+                stats.lo[axis] = std::numeric_limits<float>::max();
+                stats.hi[axis] = std::numeric_limits<float>::lowest();
+                if (n > 0) {
+                    ColumnBounds(&scratch[axis * n], n, stats.lo[axis], stats.hi[axis]);
+                }
+            }
+
+            return stats;
+        }
+
+        bool FrameIndex::Create(std::string filePath)
+        {
+            if (this->m_fstream.is_open()) {
+                this->m_fstream.close();
+            }
+
+            this->m_stats.Clear();
+            this->m_numFlushed = 0;
+            this->m_fstream.open(
+                filePath.c_str(),
+                std::ios_base::binary | std::ios_base::in | std::ios_base::out | std::ios_base::trunc);
+
+            if (!this->m_fstream) {
+                LOG_F(WARNING, "Failed to create frame index %s", filePath.c_str());
+                return false;
+            }
+
+            this->m_fstream.write((const char*)kIndexMagic, sizeof(kIndexMagic));
+            this->m_fstream.write((const char*)kIndexVersion, sizeof(kIndexVersion));
+            this->m_fstream.flush();
+            return bool(this->m_fstream);
+        }
+
+        bool FrameIndex::Open(std::string filePath, std::size_t numFrames)
+        {
+            if (this->m_fstream.is_open()) {
+                this->m_fstream.close();
+            }
+
+            this->m_stats.Clear();
+            this->m_numFlushed = 0;
+            this->m_fstream.open(
+                filePath.c_str(),
+                std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+
+            unsigned char header[kIndexHeaderSize] = { 0 };
+            if (!this->m_fstream
+                || !this->m_fstream.read((char*)header, sizeof(header))
+                || std::memcmp(header, kIndexMagic, sizeof(kIndexMagic)) != 0
+                || header[sizeof(kIndexMagic)] != kIndexVersion[0]) {
+                LOG_F(INFO, "No usable frame index at %s, creating a new one", filePath.c_str());
+                return this->Create(filePath);
+            }
+
+            this->m_fstream.seekg(0, std::ios_base::end);
+            std::size_t numRecords = (std::size_t(this->m_fstream.tellg()) - kIndexHeaderSize) / sizeof(FrameStats);
+
+            std::vector<FrameStats> records(std::min(numRecords, numFrames));
+            this->m_fstream.seekg(kIndexHeaderSize, std::ios_base::beg);
+            if (!records.empty() && !this->m_fstream.read((char*)&records[0], records.size() * sizeof(FrameStats))) {
+                LOG_F(ERROR, "Failed to read frame index %s", filePath.c_str());
+                this->m_fstream.clear();
+                records.clear();
+            }
+
+            for (auto& record : records) {
+                this->m_stats.Append(record);
+            }
+            this->m_numFlushed = records.size();
+            return true;
+        }
+
+        void FrameIndex::Append(const FrameStats& stats)
+        {
+            this->m_stats.Append(stats);
+        }
+
+        void FrameIndex::Flush()
+        {
+            std::size_t size = this->m_stats.Size();
+            if (!this->m_fstream.is_open() || this->m_numFlushed == size) {
+                return;
+            }
+
+            std::vector<FrameStats> records;
+            records.reserve(size - this->m_numFlushed);
+            for (std::size_t i = this->m_numFlushed; i < size; ++i) {
+                records.push_back(this->m_stats[i]);
+            }
+
+            this->m_fstream.seekp(kIndexHeaderSize + this->m_numFlushed * sizeof(FrameStats), std::ios_base::beg);
+            this->m_fstream.write((const char*)&records[0], records.size() * sizeof(FrameStats));
+            this->m_fstream.flush();
+            if (!this->m_fstream) {
+                LOG_F(ERROR, "Failed to write %zu frame index records", records.size());
+                this->m_fstream.clear();
+            }
+
+            this->m_numFlushed = size;
+        }
+
+        std::size_t FrameIndex::FindFrameForTime(double time, std::size_t numFrames) const
+        {
+            numFrames = std::min(numFrames, this->m_stats.Size());
+            if (numFrames == 0) {
+                return 0;
+            }
+
+            // First frame at or after the requested time
+            std::size_t lo = 0;
+            std::size_t hi = numFrames;
+            while (lo < hi) {
+                std::size_t mid = lo + (hi - lo) / 2;
+                if (this->m_stats[mid].time < time) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+
+            if (lo == numFrames) {
+                return numFrames - 1;
+            }
+
+            if (lo > 0 && time - this->m_stats[lo - 1].time < this->m_stats[lo].time - time) {
+                return lo - 1;
+            }
+
+            return lo;
+        }
+
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
@@ -0,0 +1,82 @@
+#include "simularium/fileio/mapped_file.h"
+#include "loguru/loguru.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+
+        MappedFile::~MappedFile()
+        {
+            this->Unmap();
+        }
+
+        bool MappedFile::Map(std::string filePath)
+        {
+            this->Unmap();
+
+            int fd = ::open(filePath.c_str(), O_RDONLY);
+            if (fd < 0) {
+                LOG_F(WARNING, "Failed to open %s for memory mapping", filePath.c_str());
+                return false;
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                ::close(fd);
+                return false;
+            }
+
+            void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+            // The mapping keeps its own reference to the file
+            ::close(fd);
+
+            if (data == MAP_FAILED) {
+                LOG_F(WARNING, "Failed to memory map %s", filePath.c_str());
+                return false;
+            }
+
+            this->m_data = static_cast<char*>(data);
+            this->m_size = st.st_size;
+            return true;
+        }
+
+        void MappedFile::Unmap()
+        {
+            if (this->m_data) {
+                munmap(this->m_data, this->m_size);
+            }
+
+            this->m_data = nullptr;
+            this->m_size = 0;
+        }
+
+        void MappedFile::AdviseSequential()
+        {
+            if (this->m_data) {
+                madvise(this->m_data, this->m_size, MADV_SEQUENTIAL);
+            }
+        }
+
+        void MappedFile::AdviseWillNeed(std::size_t offset, std::size_t length)
+        {
+            if (!this->m_data || offset >= this->m_size) {
+                return;
+            }
+
+            // madvise needs a page aligned start address
+            static const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+            std::size_t start = offset - (offset % pageSize);
+            std::size_t end = std::min(offset + length, this->m_size);
+
+            madvise(this->m_data + start, end - start, MADV_WILLNEED);
+        }
+
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
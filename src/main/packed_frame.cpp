@@ -0,0 +1,181 @@
+#include "simularium/fileio/packed_frame.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace packed {
+
+            static const std::size_t kHeaderSize = 3 * sizeof(std::uint32_t);
+
+            // Bytes per agent, excluding the subpoint count and subpoints
+#define SIMULARIUM_PACKED_FIELD_SIZE(name, Stored, offset) +sizeof(Stored)
+            static const std::size_t kRecordSize = 0 SIMULARIUM_PACKED_AGENT_FIELDS(SIMULARIUM_PACKED_FIELD_SIZE);
+#undef SIMULARIUM_PACKED_FIELD_SIZE
+
+            // Offsets only apply to integer fields, floats are stored bit for bit
+            template <typename Stored, typename T>
+            inline bool Fits(T value, double offset)
+            {
+                if (std::is_floating_point<Stored>::value) {
+                    return true;
+                }
+
+                double v = double(value) - offset;
+                return v >= 0 && v <= double(std::numeric_limits<Stored>::max()) && v == std::floor(v);
+            }
+
+            template <typename Stored, typename T>
+            inline Stored ToStored(T value, double offset)
+            {
+                return std::is_floating_point<Stored>::value ? Stored(value) : Stored(double(value) - offset);
+            }
+
+            template <typename T, typename Stored>
+            inline T FromStored(Stored value, double offset)
+            {
+                return std::is_floating_point<Stored>::value ? T(value) : T(double(value) + offset);
+            }
+
+            template <typename Stored>
+            inline void Append(std::vector<char>& out, Stored value)
+            {
+                std::size_t start = out.size();
+                out.resize(start + sizeof(Stored));
+                std::memcpy(&out[start], &value, sizeof(Stored));
+            }
+
+            template <typename Stored>
+            inline bool Read(const char*& pos, const char* end, Stored& value)
+            {
+                if (std::size_t(end - pos) < sizeof(Stored)) {
+                    return false;
+                }
+
+                std::memcpy(&value, pos, sizeof(Stored));
+                pos += sizeof(Stored);
+                return true;
+            }
+
+            inline void AppendVarint(std::vector<char>& out, std::uint32_t value)
+            {
+                while (value >= 0x80) {
+                    out.push_back(char((value & 0x7f) | 0x80));
+                    value >>= 7;
+                }
+                out.push_back(char(value));
+            }
+
+            inline bool ReadVarint(const char*& pos, const char* end, std::uint32_t& value)
+            {
+                value = 0;
+                for (int shift = 0; shift < 35 && pos < end; shift += 7) {
+                    std::uint8_t byte = std::uint8_t(*pos++);
+                    value |= std::uint32_t(byte & 0x7f) << shift;
+                    if (!(byte & 0x80)) {
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            bool CanPack(const TrajectoryFrame& frame)
+            {
+                for (auto& agent : frame.data) {
+#define SIMULARIUM_PACKED_FIELD_FITS(name, Stored, offset) \
+    if (!Fits<Stored>(agent.name, offset)) {               \
+        return false;                                      \
+    }
+                    SIMULARIUM_PACKED_AGENT_FIELDS(SIMULARIUM_PACKED_FIELD_FITS)
+#undef SIMULARIUM_PACKED_FIELD_FITS
+                }
+
+                return true;
+            }
+
+            bool Encode(const TrajectoryFrame& frame, std::vector<char>& out)
+            {
+                out.clear();
+                if (!CanPack(frame)) {
+                    return false;
+                }
+
+                std::size_t numSubpoints = 0;
+                for (auto& agent : frame.data) {
+                    numSubpoints += agent.subpoints.size();
+                }
+                out.reserve(kHeaderSize + frame.data.size() * (kRecordSize + 1) + numSubpoints * sizeof(float));
+
+                Append(out, std::uint32_t(frame.frameNumber));
+                Append(out, frame.time);
+                Append(out, std::uint32_t(frame.data.size()));
+
+                for (auto& agent : frame.data) {
+#define SIMULARIUM_PACKED_FIELD_WRITE(name, Stored, offset) Append(out, ToStored<Stored>(agent.name, offset));
+                    SIMULARIUM_PACKED_AGENT_FIELDS(SIMULARIUM_PACKED_FIELD_WRITE)
+#undef SIMULARIUM_PACKED_FIELD_WRITE
+
+                    AppendVarint(out, std::uint32_t(agent.subpoints.size()));
+                    if (!agent.subpoints.empty()) {
+                        std::size_t start = out.size();
+                        out.resize(start + agent.subpoints.size() * sizeof(float));
+                        std::memcpy(&out[start], &agent.subpoints[0], agent.subpoints.size() * sizeof(float));
+                    }
+                }
+
+                // Padded so frames that follow in a message stay 4 byte aligned
+                out.resize((out.size() + 3) / 4 * 4, 0);
+                return true;
+            }
+
+            bool Decode(const char* data, std::size_t size, TrajectoryFrame& frame)
+            {
+                const char* pos = data;
+                const char* end = data + size;
+                std::uint32_t frameNumber, numAgents;
+                if (!Read(pos, end, frameNumber) || !Read(pos, end, frame.time) || !Read(pos, end, numAgents)
+                    || numAgents > (size - kHeaderSize) / (kRecordSize + 1)) {
+                    return false;
+                }
+
+                frame.frameNumber = frameNumber;
+                frame.data.clear();
+                frame.data.resize(numAgents);
+
+                for (auto& agent : frame.data) {
+#define SIMULARIUM_PACKED_FIELD_READ(name, Stored, offset)            \
+    {                                                                 \
+        Stored value;                                                 \
+        if (!Read(pos, end, value)) {                                 \
+            return false;                                             \
+        }                                                             \
+        agent.name = FromStored<decltype(agent.name)>(value, offset); \
+    }
+                    SIMULARIUM_PACKED_AGENT_FIELDS(SIMULARIUM_PACKED_FIELD_READ)
+#undef SIMULARIUM_PACKED_FIELD_READ
+
+                    std::uint32_t numSubpoints;
+                    if (!ReadVarint(pos, end, numSubpoints)
+                        || numSubpoints > std::size_t(end - pos) / sizeof(float)) {
+                        return false;
+                    }
+
+                    agent.subpoints.resize(numSubpoints);
+                    if (numSubpoints > 0) {
+                        std::memcpy(&agent.subpoints[0], pos, numSubpoints * sizeof(float));
+                        pos += numSubpoints * sizeof(float);
+                    }
+                }
+
+                return end - pos < 4 && std::all_of(pos, end, [](char c) { return c == 0; });
+            }
+
+        } // namespace packed
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
@@ -91,6 +91,18 @@ namespace simularium {
         }
     }
 
+    void parse_optional_quantization_error_v3(
+        TrajectoryFileProperties& out,
+        const Json::Value& root)
+    {
+        const Json::Value& quantizationError = root["quantizationError"];
+        if (quantizationError != Json::nullValue) {
+            out.positionError = quantizationError["position"].asFloat();
+            out.rotationError = quantizationError["rotation"].asFloat();
+            out.fiberError = quantizationError.get("fiber", 0).asFloat();
+        }
+    }
+
     void parse_v2_typemapping(
         TrajectoryFileProperties& out,
         const Json::Value& root)
@@ -166,6 +178,7 @@ namespace simularium {
         parse_optional_space_units_v2(tfp, fprops);
 
         parse_optional_v1_camera_default(tfp, fprops);
+        parse_optional_quantization_error_v3(tfp, fprops);
 
         return tfp;
     }
@@ -0,0 +1,61 @@
+#include "simularium/fileio/positional_file.h"
+#include "loguru/loguru.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+
+        PositionalFile::~PositionalFile()
+        {
+            this->Close();
+        }
+
+        bool PositionalFile::Open(std::string filePath)
+        {
+            this->Close();
+
+            this->m_fd = ::open(filePath.c_str(), O_RDONLY);
+            if (this->m_fd < 0) {
+                LOG_F(WARNING, "Failed to open %s for reading", filePath.c_str());
+                return false;
+            }
+
+            return true;
+        }
+
+        void PositionalFile::Close()
+        {
+            if (this->m_fd >= 0) {
+                ::close(this->m_fd);
+            }
+
+            this->m_fd = -1;
+        }
+
+        bool PositionalFile::Read(std::uint64_t offset, char* out, std::size_t size) const
+        {
+            // pread may return fewer bytes than asked for; keep reading until
+            //  the range is complete, or the end of the file is reached
+            std::size_t done = 0;
+            while (done < size) {
+                ssize_t n = ::pread(this->m_fd, out + done, size - done, off_t(offset + done));
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+
+                if (n <= 0) {
+                    return false;
+                }
+
+                done += std::size_t(n);
+            }
+
+            return true;
+        }
+
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
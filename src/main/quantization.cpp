@@ -0,0 +1,284 @@
+#include "simularium/fileio/quantization.h"
+#include "loguru/loguru.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace quantization {
+
+            static const std::size_t kHeaderFloats = 9;
+            static const float kMaxPositionValue = 65535.f;
+
+            // Smallest-three components are within [-1/sqrt(2), 1/sqrt(2)],
+            //  stored as 15-bit values centered on kQuaternionBias
+            static const float kQuaternionScale = 16383.f * 1.41421356f;
+            static const int kQuaternionBias = 16383;
+
+            // Euler XYZ (intrinsic) to quaternion (x, y, z, w)
+            inline void EulerToQuaternion(float x, float y, float z, float* q)
+            {
+                float c1 = std::cos(x / 2), s1 = std::sin(x / 2);
+                float c2 = std::cos(y / 2), s2 = std::sin(y / 2);
+                float c3 = std::cos(z / 2), s3 = std::sin(z / 2);
+
+                q[0] = s1 * c2 * c3 + c1 * s2 * s3;
+                q[1] = c1 * s2 * c3 - s1 * c2 * s3;
+                q[2] = c1 * c2 * s3 + s1 * s2 * c3;
+                q[3] = c1 * c2 * c3 - s1 * s2 * s3;
+            }
+
+            // Quaternion (x, y, z, w) to Euler XYZ, via the rotation matrix
+            //  adding 0 turns -0 into 0, so an identity rotation decodes to zeros
+            inline void QuaternionToEuler(const float* q, float& x, float& y, float& z)
+            {
+                float m11 = 1 - 2 * (q[1] * q[1] + q[2] * q[2]);
+                float m12 = 2 * (q[0] * q[1] - q[3] * q[2]);
+                float m13 = 2 * (q[0] * q[2] + q[3] * q[1]);
+                float m22 = 1 - 2 * (q[0] * q[0] + q[2] * q[2]);
+                float m23 = 2 * (q[1] * q[2] - q[3] * q[0]);
+                float m32 = 2 * (q[1] * q[2] + q[3] * q[0]);
+                float m33 = 1 - 2 * (q[0] * q[0] + q[1] * q[1]);
+
+                y = std::asin(std::min(std::max(m13, -1.f), 1.f)) + 0.f;
+                if (std::fabs(m13) < 0.9999999f) {
+                    x = std::atan2(-m23, m33) + 0.f;
+                    z = std::atan2(-m12, m11) + 0.f;
+                } else {
+                    x = std::atan2(m32, m22) + 0.f;
+                    z = 0;
+                }
+            }
+
+            inline void PackQuaternion(const float* q, std::uint16_t* out)
+            {
+                int largest = 0;
+                for (int i = 1; i < 4; ++i) {
+                    if (std::fabs(q[i]) > std::fabs(q[largest])) {
+                        largest = i;
+                    }
+                }
+
+                // q and -q are the same rotation; keep the dropped component positive
+                float sign = q[largest] < 0 ? -1.f : 1.f;
+                for (int i = 0, k = 0; i < 4; ++i) {
+                    if (i == largest) {
+                        continue;
+                    }
+
+                    long v = std::lrint(sign * q[i] * kQuaternionScale);
+                    v = std::min(std::max(v, -long(kQuaternionBias)), long(kQuaternionBias));
+                    out[k++] = std::uint16_t(v + kQuaternionBias);
+                }
+
+                out[0] |= (largest & 1) << 15;
+                out[1] |= (largest >> 1) << 15;
+            }
+
+            inline void UnpackQuaternion(const std::uint16_t* in, float* q)
+            {
+                int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+                float sum = 0;
+                for (int i = 0, k = 0; i < 4; ++i) {
+                    if (i == largest) {
+                        continue;
+                    }
+
+                    q[i] = float(int(in[k++] & 0x7fff) - kQuaternionBias) / kQuaternionScale;
+                    sum += q[i] * q[i];
+                }
+
+                q[largest] = std::sqrt(std::max(1.f - sum, 0.f));
+            }
+
+            // The loops below work on contiguous arrays so they can be vectorized
+            inline void QuantizeAxis(const float* in, std::size_t n, float origin, float step, std::uint16_t* out)
+            {
+                float scale = step > 0 ? 1.f / step : 0.f;
+                for (std::size_t i = 0; i < n; ++i) {
+                    float q = (in[i] - origin) * scale + 0.5f;
+                    q = std::min(std::max(q, 0.f), kMaxPositionValue);
+                    out[i] = std::uint16_t(q);
+                }
+            }
+
+            inline void DequantizeAxis(const std::uint16_t* in, std::size_t n, float origin, float step, float* out)
+            {
+                for (std::size_t i = 0; i < n; ++i) {
+                    out[i] = origin + float(in[i]) * step;
+                }
+            }
+
+            inline float MaxAbsDifference(const float* a, const float* b, std::size_t n)
+            {
+                float result = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    result = std::max(result, std::fabs(a[i] - b[i]));
+                }
+                return result;
+            }
+
+            template <typename T>
+            inline void Append(std::vector<char>& out, const T* data, std::size_t count)
+            {
+                std::size_t start = out.size();
+                out.resize(start + count * sizeof(T));
+                if (count > 0) {
+                    std::memcpy(&out[start], data, count * sizeof(T));
+                }
+            }
+
+            std::vector<char> EncodeFrame(
+                const TrajectoryFrame& frame,
+                const QuantizationOptions& options,
+                QuantizationError& error)
+            {
+                std::size_t n = frame.data.size();
+                error = QuantizationError();
+
+                // Gather into columns
+                std::vector<float> positions(3 * n);
+                std::vector<float> attributes(5 * n);
+                std::size_t numSubpoints = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    const AgentData& agent = frame.data[i];
+                    positions[i] = agent.x;
+                    positions[n + i] = agent.y;
+                    positions[2 * n + i] = agent.z;
+                    attributes[i] = agent.vis_type;
+                    attributes[n + i] = float(agent.id);
+                    attributes[2 * n + i] = agent.type;
+                    attributes[3 * n + i] = agent.collision_radius;
+                    attributes[4 * n + i] = float(agent.subpoints.size());
+                    numSubpoints += agent.subpoints.size();
+                }
+
+                // Quantized range: the box, widened to any agents outside of it
+                float header[kHeaderFloats] = { float(frame.frameNumber), frame.time, float(n) };
+                for (std::size_t axis = 0; axis < 3; ++axis) {
+                    float halfBox = std::isfinite(options.boxSize[axis]) ? std::fabs(options.boxSize[axis]) / 2 : 0.f;
+                    float lo = -halfBox;
+                    float hi = halfBox;
+                    const float* column = &positions[axis * n];
+                    for (std::size_t i = 0; i < n; ++i) {
+                        if (std::isfinite(column[i])) {
+                            lo = std::min(lo, column[i]);
+                            hi = std::max(hi, column[i]);
+                        }
+                    }
+
+                    header[3 + axis] = lo;
+                    header[6 + axis] = (hi - lo) / kMaxPositionValue;
+                }
+
+                std::vector<std::uint16_t> quantized(6 * n);
+                std::vector<float> decoded(3 * n);
+                for (std::size_t axis = 0; axis < 3; ++axis) {
+                    QuantizeAxis(&positions[axis * n], n, header[3 + axis], header[6 + axis], &quantized[axis * n]);
+                    DequantizeAxis(&quantized[axis * n], n, header[3 + axis], header[6 + axis], &decoded[axis * n]);
+                }
+                if (n > 0) {
+                    error.position = MaxAbsDifference(&positions[0], &decoded[0], 3 * n);
+                }
+
+                for (std::size_t i = 0; i < n; ++i) {
+                    const AgentData& agent = frame.data[i];
+                    float q[4], dq[4];
+                    std::uint16_t packed[3];
+                    EulerToQuaternion(agent.xrot, agent.yrot, agent.zrot, q);
+                    PackQuaternion(q, packed);
+                    UnpackQuaternion(packed, dq);
+
+                    float dot = std::fabs(q[0] * dq[0] + q[1] * dq[1] + q[2] * dq[2] + q[3] * dq[3]);
+                    error.rotation = std::max(error.rotation, 2 * std::acos(std::min(dot, 1.f)));
+
+                    quantized[3 * n + i] = packed[0];
+                    quantized[4 * n + i] = packed[1];
+                    quantized[5 * n + i] = packed[2];
+                }
+
+                std::vector<char> out;
+                out.reserve(sizeof(header) + quantized.size() * 2 + (attributes.size() + numSubpoints) * 4);
+                Append(out, header, kHeaderFloats);
+                Append(out, quantized.data(), quantized.size());
+                Append(out, attributes.data(), attributes.size());
+                for (auto& agent : frame.data) {
+                    Append(out, agent.subpoints.data(), agent.subpoints.size());
+                }
+
+                return out;
+            }
+
+            bool DecodeFrame(const char* data, std::size_t size, TrajectoryFrame& frame)
+            {
+                float header[kHeaderFloats];
+                if (size < sizeof(header)) {
+                    return false;
+                }
+
+                std::memcpy(header, data, sizeof(header));
+                std::size_t n = std::size_t(header[2]);
+                std::size_t fixedSize = sizeof(header) + n * (6 * sizeof(std::uint16_t) + 5 * sizeof(float));
+                if (size < fixedSize) {
+                    return false;
+                }
+
+                std::vector<std::uint16_t> quantized(6 * n);
+                std::vector<float> attributes(5 * n);
+                const char* pos = data + sizeof(header);
+                if (n > 0) {
+                    std::memcpy(&quantized[0], pos, quantized.size() * sizeof(std::uint16_t));
+                    pos += quantized.size() * sizeof(std::uint16_t);
+                    std::memcpy(&attributes[0], pos, attributes.size() * sizeof(float));
+                    pos += attributes.size() * sizeof(float);
+                }
+
+                std::size_t numSubpoints = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    numSubpoints += std::size_t(attributes[4 * n + i]);
+                }
+                if (size != fixedSize + numSubpoints * sizeof(float)) {
+                    return false;
+                }
+
+                std::vector<float> positions(3 * n);
+                for (std::size_t axis = 0; axis < 3; ++axis) {
+                    DequantizeAxis(&quantized[axis * n], n, header[3 + axis], header[6 + axis], &positions[axis * n]);
+                }
+
+                frame.frameNumber = std::size_t(header[0]);
+                frame.time = header[1];
+                frame.data.resize(n);
+                for (std::size_t i = 0; i < n; ++i) {
+                    AgentData& agent = frame.data[i];
+                    agent.x = positions[i];
+                    agent.y = positions[n + i];
+                    agent.z = positions[2 * n + i];
+
+                    float q[4];
+                    std::uint16_t packed[3] = { quantized[3 * n + i], quantized[4 * n + i], quantized[5 * n + i] };
+                    UnpackQuaternion(packed, q);
+                    QuaternionToEuler(q, agent.xrot, agent.yrot, agent.zrot);
+
+                    agent.vis_type = attributes[i];
+                    agent.id = std::uint32_t(attributes[n + i]);
+                    agent.type = attributes[2 * n + i];
+                    agent.collision_radius = attributes[3 * n + i];
+
+                    agent.subpoints.resize(std::size_t(attributes[4 * n + i]));
+                    if (!agent.subpoints.empty()) {
+                        std::memcpy(&agent.subpoints[0], pos, agent.subpoints.size() * sizeof(float));
+                        pos += agent.subpoints.size() * sizeof(float);
+                    }
+                }
+
+                return true;
+            }
+
+        } // namespace quantization
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
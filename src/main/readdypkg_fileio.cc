@@ -281,6 +281,20 @@ namespace simularium {
         return this->m_hasFinishedStreaming;
     }
 
+    bool ReaDDyPkg::ResumeAtFrame(std::size_t frameNumber)
+    {
+        // The whole trajectory is read when the file is loaded,
+        //  so resuming only moves the frame counter
+        if (!this->m_hasLoadedRunFile
+            || frameNumber > std::get<1>(this->m_fileInfo->trajectoryInfo).size()) {
+            return false;
+        }
+
+        frame_no = frameNumber;
+        this->m_hasFinishedStreaming = false;
+        return true;
+    }
+
     void ReaDDyPkg::Run(float timeStep, std::size_t nTimeStep)
     {
         if (this->m_hasAlreadyRun)
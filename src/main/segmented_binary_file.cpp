@@ -0,0 +1,843 @@
+#include "simularium/fileio/segmented_binary_file.h"
+#include "loguru/loguru.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+
+        static const unsigned char kManifestMagic[13] = { 'S', 'I', 'M', 'U', 'L', 'A', 'R', 'I', 'U', 'M', 'S', 'E', 'G' };
+        static const unsigned char kManifestVersion[3] = { 1, 0, 0 };
+
+        inline bool FileExists(const std::string& filePath)
+        {
+            return bool(std::ifstream(filePath.c_str()));
+        }
+
+        inline void RemoveWithIndex(const std::string& filePath)
+        {
+            std::remove(filePath.c_str());
+            std::remove((filePath + binary::INDEX_FILE_SUFFIX).c_str());
+        }
+
+        inline std::string PartialPath(const std::string& filePath)
+        {
+            return filePath + PARTIAL_FILE_SUFFIX;
+        }
+
+        // Written next to the sidecar, then moved over it, like the manifest
+        static bool WritePartial(const std::string& filePath, std::size_t numFrames)
+        {
+            std::string partialPath = PartialPath(filePath);
+            std::string tmpPath = partialPath + ".tmp";
+            {
+                std::ofstream os(tmpPath.c_str(), std::ios_base::trunc);
+                os << numFrames;
+                if (!os) {
+                    LOG_F(ERROR, "Failed to write %s", tmpPath.c_str());
+                    return false;
+                }
+            }
+
+            if (std::rename(tmpPath.c_str(), partialPath.c_str()) != 0) {
+                LOG_F(ERROR, "Failed to write %s", partialPath.c_str());
+                return false;
+            }
+
+            return true;
+        }
+
+        namespace segments {
+
+            std::size_t Manifest::NumFrames() const
+            {
+                std::size_t numFrames = 0;
+                for (auto& segment : this->segments) {
+                    numFrames += segment.numFrames;
+                }
+
+                return numFrames;
+            }
+
+            bool ReadManifest(std::string filePath, Manifest& manifest)
+            {
+                std::ifstream is(filePath.c_str(), std::ios_base::binary);
+                if (!is) {
+                    return false;
+                }
+
+                unsigned char header[MANIFEST_HEADER_SIZE] = { 0 };
+                std::uint64_t segmentFrames = 0;
+                std::uint64_t numSegments = 0;
+                is.read((char*)header, sizeof(header));
+                is.read((char*)&segmentFrames, sizeof(segmentFrames));
+                is.read((char*)&numSegments, sizeof(numSegments));
+                if (!is || std::memcmp(header, kManifestMagic, sizeof(kManifestMagic)) != 0 || segmentFrames == 0) {
+                    LOG_F(ERROR, "%s is not a segment manifest", filePath.c_str());
+                    return false;
+                }
+
+                // Minor and patch versions only add to the layout
+                const unsigned char* version = header + sizeof(kManifestMagic);
+                if (version[0] != kManifestVersion[0]) {
+                    LOG_F(ERROR, "Segment manifest %s has unsupported version %i.%i.%i",
+                        filePath.c_str(), int(version[0]), int(version[1]), int(version[2]));
+                    return false;
+                }
+
+                Manifest out;
+                out.segmentFrames = segmentFrames;
+                for (std::uint64_t i = 0; i < numSegments; ++i) {
+                    SegmentInfo info;
+                    is.read((char*)&info.numFrames, sizeof(info.numFrames));
+                    is.read((char*)&info.startTime, sizeof(info.startTime));
+                    if (!is) {
+                        LOG_F(ERROR, "Segment manifest %s is truncated", filePath.c_str());
+                        return false;
+                    }
+                    out.segments.push_back(info);
+                }
+
+                manifest = out;
+                return true;
+            }
+
+            bool WriteManifest(std::string filePath, const Manifest& manifest)
+            {
+                // Written next to the manifest, then moved over it, so
+                //  readers never see a manifest that is half written
+                std::string tmpPath = filePath + ".tmp";
+                {
+                    std::ofstream os(tmpPath.c_str(), std::ios_base::binary | std::ios_base::trunc);
+                    unsigned char header[MANIFEST_HEADER_SIZE] = { 0 };
+                    std::memcpy(header, kManifestMagic, sizeof(kManifestMagic));
+                    std::memcpy(header + sizeof(kManifestMagic), kManifestVersion, sizeof(kManifestVersion));
+                    std::uint64_t numSegments = manifest.segments.size();
+
+                    os.write((const char*)header, sizeof(header));
+                    os.write((const char*)&manifest.segmentFrames, sizeof(manifest.segmentFrames));
+                    os.write((const char*)&numSegments, sizeof(numSegments));
+                    for (auto& info : manifest.segments) {
+                        os.write((const char*)&info.numFrames, sizeof(info.numFrames));
+                        os.write((const char*)&info.startTime, sizeof(info.startTime));
+                    }
+
+                    if (!os) {
+                        LOG_F(ERROR, "Failed to write segment manifest %s", tmpPath.c_str());
+                        return false;
+                    }
+                }
+
+                if (std::rename(tmpPath.c_str(), filePath.c_str()) != 0) {
+                    LOG_F(ERROR, "Failed to write segment manifest %s", filePath.c_str());
+                    return false;
+                }
+
+                return true;
+            }
+
+            std::string ManifestPath(const std::string& cachePath)
+            {
+                return cachePath + MANIFEST_FILE_SUFFIX;
+            }
+
+            std::string SegmentPath(const std::string& cachePath, std::size_t segment)
+            {
+                return cachePath + SEGMENT_FILE_SUFFIX + std::to_string(segment);
+            }
+
+        } // namespace segments
+
+        SegmentedBinaryFile::~SegmentedBinaryFile()
+        {
+            this->Flush();
+        }
+
+        void SegmentedBinaryFile::Create(std::string filePath, std::size_t segmentFrames)
+        {
+            // Files of an earlier cache at this path, of either layout,
+            //  would be picked up when the new cache is opened again
+            Remove(filePath);
+
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            this->m_filePath = filePath;
+            this->m_segments.clear();
+            this->m_manifest = segments::Manifest();
+            this->m_manifest.segmentFrames = segmentFrames;
+            this->m_writePos = 0;
+            this->m_writeSegment = kNoSegment;
+            this->m_isWriting = true;
+            this->m_isPartial = false;
+
+            if (segmentFrames == 0) {
+                auto segment = std::make_shared<SimulariumBinaryFile>();
+                if (this->m_configure) {
+                    this->m_configure(*segment);
+                }
+                segment->Create(filePath);
+                this->m_manifest.segments.resize(1);
+                this->m_segments.push_back(segment);
+                return;
+            }
+
+            LOG_F(INFO, "Creating segmented cache at %s, %zu frames per segment", filePath.c_str(), segmentFrames);
+            segments::WriteManifest(segments::ManifestPath(filePath), this->m_manifest);
+        }
+
+        void SegmentedBinaryFile::Open(std::string filePath)
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+                this->m_filePath = filePath;
+                this->m_segments.clear();
+                this->m_manifest = segments::Manifest();
+                this->m_writeSegment = kNoSegment;
+                this->m_isWriting = false;
+                this->m_isPartial = false;
+
+                if (segments::ReadManifest(segments::ManifestPath(filePath), this->m_manifest)) {
+                    LOG_F(INFO, "Opening segmented cache at %s with %zu segments",
+                        filePath.c_str(), this->m_manifest.segments.size());
+                } else {
+                    this->m_manifest = segments::Manifest();
+                    this->m_manifest.segments.resize(1);
+                }
+            }
+
+            // Frames flushed to the last segment after the manifest
+            //  was written are in the cache too
+            std::size_t last = this->NumSegments();
+            if (last > 0) {
+                auto segment = this->GetSegment(last - 1);
+                if (segment && this->IsSegmented()) {
+                    std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+                    this->m_manifest.segments.back().numFrames = segment->NumSavedFrames();
+                }
+            }
+
+            this->m_writePos = this->NumSavedFrames();
+        }
+
+        bool SegmentedBinaryFile::CreatePartial(std::string filePath, const RangeReader& read, std::uint64_t fileSize)
+        {
+            // The sidecar is there before the cache, so the cache is
+            //  never opened with frames that are still to be downloaded
+            std::string tmpPath = filePath + ".tmp";
+            if (!WritePartial(filePath, 0) || !SimulariumBinaryFile::CopyLayout(read, fileSize, tmpPath)
+                || std::rename(tmpPath.c_str(), filePath.c_str()) != 0) {
+                std::remove(tmpPath.c_str());
+                std::remove(PartialPath(filePath).c_str());
+                return false;
+            }
+
+            return true;
+        }
+
+        bool SegmentedBinaryFile::Exists(std::string filePath)
+        {
+            return FileExists(filePath) || FileExists(segments::ManifestPath(filePath));
+        }
+
+        void SegmentedBinaryFile::Remove(std::string filePath)
+        {
+            RemoveWithIndex(filePath);
+            std::remove(PartialPath(filePath).c_str());
+            for (std::size_t level = 1; level <= binary::MAX_PYRAMID_LEVELS; ++level) {
+                RemoveWithIndex(filePath + binary::PYRAMID_FILE_SUFFIX + std::to_string(level));
+            }
+
+            // Segments past the end of the manifest may be left from a
+            //  conversion that was interrupted before it was rewritten
+            segments::Manifest manifest;
+            std::string manifestPath = segments::ManifestPath(filePath);
+            segments::ReadManifest(manifestPath, manifest);
+            for (std::size_t segment = 0;
+                 segment < manifest.segments.size() || FileExists(segments::SegmentPath(filePath, segment));
+                 ++segment) {
+                RemoveWithIndex(segments::SegmentPath(filePath, segment));
+            }
+            std::remove(manifestPath.c_str());
+        }
+
+        std::shared_ptr<SimulariumBinaryFile> SegmentedBinaryFile::GetSegment(std::size_t segment)
+        {
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            if (segment < this->m_segments.size() && this->m_segments[segment]) {
+                return this->m_segments[segment];
+            }
+
+            std::string segmentPath = this->IsSegmented()
+                ? segments::SegmentPath(this->m_filePath, segment)
+                : this->m_filePath;
+            if (segment >= this->m_manifest.segments.size() || !FileExists(segmentPath)) {
+                return nullptr;
+            }
+
+            auto file = std::make_shared<SimulariumBinaryFile>();
+            if (this->m_configure) {
+                this->m_configure(*file);
+            }
+            if (this->IsSegmented()) {
+                file->SetTemporalPyramid(0);
+            }
+            file->Open(segmentPath);
+
+            // Frames of a partial cache past those downloaded are a hole
+            std::size_t numDownloaded = 0;
+            if (!this->IsSegmented() && std::ifstream(PartialPath(this->m_filePath).c_str()) >> numDownloaded) {
+                LOG_F(INFO, "%zu of %zu frames of %s are downloaded", numDownloaded, file->NumListedFrames(), segmentPath.c_str());
+                file->SetReadableFrames(numDownloaded);
+                this->m_isPartial = true;
+                this->m_numDownloadedFrames = numDownloaded;
+            }
+
+            this->m_segments.resize(std::max(this->m_segments.size(), segment + 1));
+            this->m_segments[segment] = file;
+            return file;
+        }
+
+        std::shared_ptr<SimulariumBinaryFile> SegmentedBinaryFile::CreateSegment(std::size_t segment, double startTime)
+        {
+            auto file = std::make_shared<SimulariumBinaryFile>();
+            if (this->m_configure) {
+                this->m_configure(*file);
+            }
+            file->SetTemporalPyramid(0);
+            file->Create(segments::SegmentPath(this->m_filePath, segment));
+
+            // Segments before this one that weren't written yet
+            //  are listed in the manifest without any frames
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            this->m_manifest.segments.resize(std::max(this->m_manifest.segments.size(), segment + 1));
+            this->m_manifest.segments[segment] = segments::SegmentInfo();
+            this->m_manifest.segments[segment].startTime = startTime;
+            this->m_segments.resize(std::max(this->m_segments.size(), segment + 1));
+            this->m_segments[segment] = file;
+            return file;
+        }
+
+        std::size_t SegmentedBinaryFile::NumSegmentFrames(std::size_t segment)
+        {
+            if (segment >= this->m_manifest.segments.size()) {
+                return 0;
+            }
+
+            // The manifest is behind on segments that are written to,
+            //  so the count comes from the file once it is open
+            if (segment < this->m_segments.size() && this->m_segments[segment]) {
+                return this->m_segments[segment]->NumSavedFrames();
+            }
+
+            return this->m_manifest.segments[segment].numFrames;
+        }
+
+        void SegmentedBinaryFile::FlushWriteSegment()
+        {
+            auto file = this->m_writeSegment != kNoSegment ? this->GetSegment(this->m_writeSegment) : nullptr;
+            if (file) {
+                file->Flush();
+                std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+                this->m_manifest.segments[this->m_writeSegment].numFrames = file->NumSavedFrames();
+            }
+        }
+
+        void SegmentedBinaryFile::WriteManifest()
+        {
+            segments::Manifest manifest;
+            {
+                std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+                manifest = this->m_manifest;
+            }
+
+            segments::WriteManifest(segments::ManifestPath(this->m_filePath), manifest);
+        }
+
+        bool SegmentedBinaryFile::WriteFrame(TrajectoryFrame frame)
+        {
+            if (this->m_filePath.empty()) {
+                LOG_F(WARNING, "No file opened. Call SegmentedBinaryFile.Create([filepath])");
+                return false;
+            }
+            this->m_isWriting = true;
+
+            if (!this->IsSegmented()) {
+                auto file = this->GetSegment(0);
+                if (!file) {
+                    return false;
+                }
+
+                file->WriteFrame(std::move(frame));
+                this->m_writePos++;
+                return true;
+            }
+
+            std::size_t segmentFrames = this->m_manifest.segmentFrames;
+            std::size_t segment = this->m_writePos / segmentFrames;
+            if (segment != this->m_writeSegment) {
+                // Flushing the segment that was written drains the
+                //  frames held back by the static agent detection
+                this->FlushWriteSegment();
+                this->m_writeSegment = kNoSegment;
+
+                std::size_t numFrames = 0;
+                {
+                    std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+                    numFrames = this->NumSegmentFrames(segment);
+                }
+                if (numFrames != this->m_writePos % segmentFrames) {
+                    LOG_F(WARNING, "Frame %zu of %s was already written", this->m_writePos, this->m_filePath.c_str());
+                    return false;
+                }
+
+                if (!this->GetSegment(segment)) {
+                    this->CreateSegment(segment, frame.time);
+                }
+                this->m_writeSegment = segment;
+                this->WriteManifest();
+            }
+
+            auto file = this->GetSegment(segment);
+            if (!file) {
+                return false;
+            }
+
+            file->WriteFrame(std::move(frame));
+            this->m_writePos++;
+            return true;
+        }
+
+        bool SegmentedBinaryFile::SetWritePosition(std::size_t frameNumber)
+        {
+            if (frameNumber == this->m_writePos) {
+                return true;
+            }
+            if (!this->IsSegmented()) {
+                LOG_F(WARNING, "Frames can only be appended to %s, it isn't segmented", this->m_filePath.c_str());
+                return false;
+            }
+
+            // Frames of a segment are written in order, so writing can
+            //  only pick up where the segment of the frame leaves off
+            std::size_t segmentFrames = this->m_manifest.segmentFrames;
+            std::size_t segment = frameNumber / segmentFrames;
+            std::size_t fillPos = this->GetFillPosition(frameNumber);
+            if (fillPos != frameNumber) {
+                LOG_F(WARNING, "Frame %zu of %s can't be written, segment %zu is filled up to frame %zu",
+                    frameNumber, this->m_filePath.c_str(), segment, fillPos);
+                return false;
+            }
+
+            this->FlushWriteSegment();
+            this->m_writeSegment = kNoSegment;
+            this->WriteManifest();
+            this->m_writePos = frameNumber;
+            return true;
+        }
+
+        std::size_t SegmentedBinaryFile::GetFillPosition(std::size_t frameNumber)
+        {
+            if (!this->IsSegmented()) {
+                return this->m_writePos;
+            }
+
+            std::size_t segmentFrames = this->m_manifest.segmentFrames;
+            std::size_t segment = frameNumber / segmentFrames;
+            if (segment == this->m_writeSegment) {
+                return this->m_writePos;
+            }
+
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            if (segment >= this->m_manifest.segments.size()) {
+                return segment * segmentFrames;
+            }
+
+            return segment * segmentFrames + this->NumSegmentFrames(segment);
+        }
+
+        void SegmentedBinaryFile::Flush()
+        {
+            if (!this->m_isWriting) {
+                return;
+            }
+
+            if (!this->IsSegmented()) {
+                auto file = this->GetSegment(0);
+                if (file) {
+                    file->Flush();
+                }
+                return;
+            }
+
+            this->FlushWriteSegment();
+            this->WriteManifest();
+        }
+
+        std::size_t SegmentedBinaryFile::Checkpoint()
+        {
+            if (!this->IsSegmented()) {
+                auto file = this->GetSegment(0);
+                return file ? file->Checkpoint() : 0;
+            }
+
+            auto file = this->m_writeSegment != kNoSegment ? this->GetSegment(this->m_writeSegment) : nullptr;
+            if (!file) {
+                this->WriteManifest();
+                return this->m_writePos;
+            }
+
+            std::size_t numFrames = file->Checkpoint();
+            {
+                std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+                this->m_manifest.segments[this->m_writeSegment].numFrames = numFrames;
+            }
+            this->WriteManifest();
+
+            return this->m_writeSegment * this->m_manifest.segmentFrames + numFrames;
+        }
+
+        std::size_t SegmentedBinaryFile::NumSegments()
+        {
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            return this->m_manifest.segments.size();
+        }
+
+        bool SegmentedBinaryFile::HasSegment(std::size_t segment)
+        {
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            if (segment < this->m_segments.size() && this->m_segments[segment]) {
+                return true;
+            }
+
+            return segment < this->m_manifest.segments.size()
+                && FileExists(this->IsSegmented() ? segments::SegmentPath(this->m_filePath, segment) : this->m_filePath);
+        }
+
+        bool SegmentedBinaryFile::EvictSegment(std::size_t segment)
+        {
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            if (!this->IsSegmented() || segment >= this->m_manifest.segments.size()) {
+                return false;
+            }
+
+            if (segment == this->m_writeSegment) {
+                LOG_F(WARNING, "Segment %zu of %s is being written and can't be evicted", segment, this->m_filePath.c_str());
+                return false;
+            }
+
+            // Readers holding on to the segment keep reading the removed file
+            if (segment < this->m_segments.size()) {
+                this->m_segments[segment].reset();
+            }
+            RemoveWithIndex(segments::SegmentPath(this->m_filePath, segment));
+            return true;
+        }
+
+        bool SegmentedBinaryFile::IsPartial()
+        {
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            return this->m_isPartial;
+        }
+
+        bool SegmentedBinaryFile::GetMissingRange(std::size_t maxBytes, std::uint64_t& offset, std::uint64_t& size, std::size_t& endFrame)
+        {
+            std::size_t begin = 0;
+            {
+                std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+                if (!this->m_isPartial) {
+                    return false;
+                }
+                begin = this->m_numDownloadedFrames;
+            }
+
+            auto file = this->GetSegment(0);
+            std::uint64_t chunkOffset = 0;
+            std::uint64_t chunkSize = 0;
+            if (!file || !file->GetChunkRange(begin, offset, size)) {
+                return false;
+            }
+
+            // Chunks are appended in frame order, so the next frames are a
+            //  single range, with any TOC or attribute blocks between them
+            std::size_t numFrames = file->NumListedFrames();
+            endFrame = begin + 1;
+            while (endFrame < numFrames && file->GetChunkRange(endFrame, chunkOffset, chunkSize)
+                && chunkOffset >= offset && chunkOffset + chunkSize - offset <= maxBytes) {
+                size = chunkOffset + chunkSize - offset;
+                endFrame++;
+            }
+
+            return true;
+        }
+
+        bool SegmentedBinaryFile::AddDownloadedFrames(std::uint64_t offset, const std::vector<char>& data, std::size_t endFrame)
+        {
+            auto file = this->IsPartial() ? this->GetSegment(0) : nullptr;
+            if (!file) {
+                return false;
+            }
+
+            {
+                std::fstream fs(this->m_filePath.c_str(), std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+                fs.seekp(offset, std::ios_base::beg);
+                fs.write(data.data(), data.size());
+                if (!fs) {
+                    LOG_F(ERROR, "Failed to write downloaded frames to %s", this->m_filePath.c_str());
+                    return false;
+                }
+            }
+
+            // The count is saved once the frames are written, so it never
+            //  runs ahead of them
+            std::size_t numFrames = std::min(endFrame, file->NumListedFrames());
+            bool isComplete = numFrames == file->NumListedFrames();
+            if (isComplete) {
+                std::remove(PartialPath(this->m_filePath).c_str());
+                file->SetReadableFrames(std::numeric_limits<std::size_t>::max());
+            } else {
+                WritePartial(this->m_filePath, numFrames);
+                file->SetReadableFrames(numFrames);
+            }
+
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            this->m_numDownloadedFrames = numFrames;
+            this->m_isPartial = !isComplete;
+            return true;
+        }
+
+        std::vector<std::string> SegmentedBinaryFile::GetFilePaths()
+        {
+            std::vector<std::string> candidates;
+            if (this->IsSegmented()) {
+                candidates.push_back(segments::ManifestPath(this->m_filePath));
+                for (std::size_t segment = 0; segment < this->NumSegments(); ++segment) {
+                    std::string segmentPath = segments::SegmentPath(this->m_filePath, segment);
+                    candidates.push_back(segmentPath);
+                    candidates.push_back(segmentPath + binary::INDEX_FILE_SUFFIX);
+                }
+            } else {
+                candidates.push_back(this->m_filePath);
+                candidates.push_back(this->m_filePath + binary::INDEX_FILE_SUFFIX);
+                for (std::size_t level = 1; level <= binary::MAX_PYRAMID_LEVELS; ++level) {
+                    std::string levelPath = this->m_filePath + binary::PYRAMID_FILE_SUFFIX + std::to_string(level);
+                    candidates.push_back(levelPath);
+                    candidates.push_back(levelPath + binary::INDEX_FILE_SUFFIX);
+                }
+            }
+
+            std::vector<std::string> out;
+            std::copy_if(candidates.begin(), candidates.end(), std::back_inserter(out), FileExists);
+            return out;
+        }
+
+        std::vector<char> SegmentedBinaryFile::GetStaticLayer()
+        {
+            auto file = this->IsSegmented() ? nullptr : this->GetSegment(0);
+            return file ? file->GetStaticLayer() : std::vector<char>();
+        }
+
+        std::vector<char> SegmentedBinaryFile::GetAttributeRecords(std::size_t begin, std::size_t throughFrame)
+        {
+            auto file = this->IsSegmented() ? nullptr : this->GetSegment(0);
+            return file ? file->GetAttributeRecords(begin, throughFrame) : std::vector<char>();
+        }
+
+        quantization::QuantizationError SegmentedBinaryFile::GetQuantizationError()
+        {
+            quantization::QuantizationError out;
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            for (auto& file : this->m_segments) {
+                if (file) {
+                    auto error = file->GetQuantizationError();
+                    out.position = std::max(out.position, error.position);
+                    out.rotation = std::max(out.rotation, error.rotation);
+                    out.fiber = std::max(out.fiber, error.fiber);
+                }
+            }
+
+            return out;
+        }
+
+        StreamOptions SegmentedBinaryFile::SegmentOptions(StreamOptions options)
+        {
+            // Static layers and attribute tables differ from segment to
+            //  segment, clients only hold those of a single cache
+            if (this->IsSegmented()) {
+                options.omitStaticAgents = false;
+                options.omitAttributes = false;
+            }
+
+            return options;
+        }
+
+        BroadcastUpdate SegmentedBinaryFile::GetBroadcastFrame(std::size_t frameNumber, StreamOptions options)
+        {
+            auto numFrames = this->NumSavedFrames();
+            if (frameNumber >= numFrames) {
+                LOG_F(WARNING, "Frame %zu requested when there are only %zu saved", frameNumber, numFrames);
+                return BroadcastUpdate();
+            }
+
+            std::size_t segmentFrames = this->m_manifest.segmentFrames;
+            std::size_t segment = segmentFrames > 0 ? frameNumber / segmentFrames : 0;
+            std::size_t firstFrame = segment * segmentFrames;
+            auto file = this->HasFrame(frameNumber) ? this->GetSegment(segment) : nullptr;
+            if (!file) {
+                BroadcastUpdate out;
+                out.new_pos = frameNumber;
+                return out;
+            }
+
+            BroadcastUpdate out = file->GetBroadcastFrame(frameNumber - firstFrame, this->SegmentOptions(options));
+            out.new_pos += firstFrame;
+            for (auto& view : out.frames) {
+                view.frameNumber += firstFrame;
+            }
+
+            return out;
+        }
+
+        BroadcastUpdate SegmentedBinaryFile::GetBroadcastUpdate(
+            std::size_t currentPos,
+            std::size_t bufferSize,
+            StreamOptions options)
+        {
+            BroadcastUpdate out;
+            out.new_pos = currentPos;
+            if (currentPos >= this->NumSavedFrames()) {
+                return out;
+            }
+
+            // An update holds frames of a single segment, the
+            //  next update picks up where this one leaves off
+            std::size_t segmentFrames = this->m_manifest.segmentFrames;
+            std::size_t segment = segmentFrames > 0 ? currentPos / segmentFrames : 0;
+            std::size_t firstFrame = segment * segmentFrames;
+            auto file = this->HasFrame(currentPos) ? this->GetSegment(segment) : nullptr;
+            if (!file) {
+                return out;
+            }
+
+            out = file->GetBroadcastUpdate(currentPos - firstFrame, bufferSize, this->SegmentOptions(options));
+            out.new_pos += firstFrame;
+            for (auto& view : out.frames) {
+                view.frameNumber += firstFrame;
+            }
+
+            return out;
+        }
+
+        std::size_t SegmentedBinaryFile::NumSavedFrames()
+        {
+            // Segments are filled in any order, so this is one past the
+            //  last frame that is there, with any holes before it
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            for (std::size_t segment = this->m_manifest.segments.size(); segment > 0; --segment) {
+                std::size_t numFrames = this->NumSegmentFrames(segment - 1);
+                if (numFrames > 0) {
+                    return (segment - 1) * this->m_manifest.segmentFrames + numFrames;
+                }
+            }
+
+            return 0;
+        }
+
+        bool SegmentedBinaryFile::HasFrame(std::size_t frameNumber)
+        {
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            std::size_t segmentFrames = this->m_manifest.segmentFrames;
+            if (segmentFrames == 0) {
+                return frameNumber < this->NumSegmentFrames(0);
+            }
+
+            return frameNumber % segmentFrames < this->NumSegmentFrames(frameNumber / segmentFrames);
+        }
+
+        std::vector<FrameRange> SegmentedBinaryFile::GetAvailableRanges()
+        {
+            std::vector<FrameRange> out;
+            std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+            for (std::size_t segment = 0; segment < this->m_manifest.segments.size(); ++segment) {
+                std::size_t numFrames = this->NumSegmentFrames(segment);
+                if (numFrames == 0) {
+                    continue;
+                }
+
+                FrameRange range;
+                range.begin = segment * this->m_manifest.segmentFrames;
+                range.end = range.begin + numFrames;
+                if (!out.empty() && out.back().end == range.begin) {
+                    out.back().end = range.end;
+                } else {
+                    out.push_back(range);
+                }
+            }
+
+            return out;
+        }
+
+        bool SegmentedBinaryFile::FindFrameForTime(double time, std::size_t& frameNumber)
+        {
+            if (!this->IsSegmented()) {
+                auto file = this->GetSegment(0);
+                return file && file->FindFrameForTime(time, frameNumber);
+            }
+
+            // The last filled segment starting at or before the time,
+            //  unless the next filled one starts closer to it
+            std::vector<std::size_t> filled;
+            std::vector<double> startTimes;
+            {
+                std::lock_guard<std::mutex> lock(this->m_segmentMutex);
+                for (std::size_t segment = 0; segment < this->m_manifest.segments.size(); ++segment) {
+                    if (this->NumSegmentFrames(segment) > 0) {
+                        filled.push_back(segment);
+                        startTimes.push_back(this->m_manifest.segments[segment].startTime);
+                    }
+                }
+            }
+            if (filled.empty()) {
+                return false;
+            }
+
+            std::size_t i = 0;
+            while (i + 1 < filled.size() && startTimes[i + 1] <= time) {
+                i++;
+            }
+            std::size_t segment = filled[i];
+            bool hasNext = i + 1 < filled.size();
+            double nextStart = hasNext ? startTimes[i + 1] : 0;
+
+            std::size_t segmentFrames = this->m_manifest.segmentFrames;
+            std::size_t firstFrame = segment * segmentFrames;
+            std::size_t localFrame = 0;
+            FrameStats stats;
+            auto file = this->GetSegment(segment);
+            if (!file || !file->FindFrameForTime(time, localFrame) || !file->GetFrameStats(localFrame, stats)) {
+                frameNumber = firstFrame;
+                return true;
+            }
+
+            frameNumber = firstFrame + localFrame;
+            if (hasNext && std::abs(nextStart - time) < std::abs(stats.time - time)) {
+                frameNumber = filled[i + 1] * segmentFrames;
+            }
+
+            return true;
+        }
+
+        bool SegmentedBinaryFile::GetFrameStats(std::size_t frameNumber, FrameStats& stats)
+        {
+            std::size_t segmentFrames = this->m_manifest.segmentFrames;
+            std::size_t segment = segmentFrames > 0 ? frameNumber / segmentFrames : 0;
+            auto file = this->GetSegment(segment);
+            return file && file->GetFrameStats(frameNumber - segment * segmentFrames, stats);
+        }
+
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
@@ -1,29 +1,95 @@
 #include "simularium/fileio/simularium_binary_file.h"
 #include "loguru/loguru.hpp"
+#include "simularium/fileio/frame_codec.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
 
 namespace aics {
 namespace simularium {
     namespace fileio {
 
-        void SimulariumBinaryFile::Create(std::string filePath, std::size_t numFrames)
+        static const unsigned char kMagic[13] = { 'S', 'I', 'M', 'U', 'L', 'A', 'R', 'I', 'U', 'M', 'B', 'I', 'N' };
+
+        inline void AppendFrameDelimiter(BroadcastDataBuffer& buffer)
+        {
+            std::size_t start = buffer.size();
+            buffer.resize(start + binary::EOF_SIZE / sizeof(float));
+            std::memcpy(&buffer[start], binary::eof, binary::EOF_SIZE);
+        }
+
+        BroadcastDataBuffer ToBroadcastBuffer(const BroadcastUpdate& update)
+        {
+            BroadcastDataBuffer out;
+            for (auto& frame : update.frames) {
+                std::size_t start = out.size();
+                out.resize(start + frame.size / sizeof(float));
+                std::memcpy(&out[start], frame.data, frame.size);
+                AppendFrameDelimiter(out);
+            }
+
+            return out;
+        }
+
+        inline std::string PyramidLevelPath(const std::string& filePath, std::size_t level)
+        {
+            return filePath + binary::PYRAMID_FILE_SUFFIX + std::to_string(level);
+        }
+
+        SimulariumBinaryFile::~SimulariumBinaryFile()
+        {
+            this->Flush();
+        }
+
+        void SimulariumBinaryFile::Create(std::string filePath, std::size_t tocBlockCapacity)
         {
             if (this->m_fstream) {
+                this->Flush();
                 this->m_fstream.close();
             }
 
             LOG_F(INFO, "Creating new simularium binary file at %s", filePath.c_str());
 
+            // A file at the path may be mapped by another reader; truncating
+            //  it would fault their views, so a new file replaces it
+            std::remove(filePath.c_str());
             this->m_fstream.open(
                 filePath.c_str(),
                 std::ios_base::binary | std::ios_base::in | std::ios_base::out | std::ios_base::trunc);
 
+            // Files that are being written are read through the file stream
+            this->m_mapping.reset();
+            this->m_numReadableFrames = std::numeric_limits<std::size_t>::max();
+            this->m_majorVersion = binary::MAJOR_VERSION;
+            this->m_tocBlockCapacity = std::max(tocBlockCapacity, std::size_t(1));
+            this->m_toc.Clear();
+            this->m_tocBlocks.clear();
+            this->m_endOfFile = 0;
+            this->m_writeBuffer.clear();
+            this->m_numFlushedFrames = 0;
+            this->m_hasLastWrittenFrame = false;
+            this->m_hasRebuiltFrame = false;
+            this->m_quantizationError = quantization::QuantizationError();
+            this->ClearStaticLayer();
+            this->m_staticDetector.Reset(this->m_staticMinFrames, 0, 0);
+            this->ClearAttributes();
+            this->m_closeStaticLayer = false;
+
             this->WriteHeader();
-            this->AllocateTOC(numFrames);
+            this->AppendTOCBlock();
+            this->m_fstream.flush();
+            this->m_index.Create(filePath + binary::INDEX_FILE_SUFFIX);
+            this->CreatePyramid(filePath);
+
+            this->m_reader = std::make_shared<PositionalFile>();
+            this->m_reader->Open(filePath);
         }
 
-        void SimulariumBinaryFile::Open(std::string filePath)
+        void SimulariumBinaryFile::Open(std::string filePath, bool useMemoryMap)
         {
             if (this->m_fstream) {
+                this->Flush();
                 this->m_fstream.close();
             }
 
@@ -32,6 +98,246 @@ namespace simularium {
             this->m_fstream.open(
                 filePath.c_str(),
                 std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+
+            this->m_numReadableFrames = std::numeric_limits<std::size_t>::max();
+            this->m_toc.Clear();
+            this->m_tocBlocks.clear();
+            this->m_mapping.reset();
+            this->m_reader.reset();
+            this->m_writeBuffer.clear();
+            this->m_numFlushedFrames = 0;
+            this->m_hasLastWrittenFrame = false;
+            this->m_hasRebuiltFrame = false;
+            this->m_quantizationError = quantization::QuantizationError();
+            this->ClearStaticLayer();
+            this->m_staticDetector.Reset(0, 0, 0);
+            this->ClearAttributes();
+            this->m_pyramid.clear();
+            this->m_numPushedFrames = 0;
+            this->m_closeStaticLayer = true;
+
+            if (!this->m_fstream) {
+                LOG_F(ERROR, "Failed to open simularium binary file %s", filePath.c_str());
+                return;
+            }
+
+            this->m_fstream.seekg(0, std::ios_base::end);
+            this->m_endOfFile = std::uint64_t(this->m_fstream.tellg());
+
+            unsigned char header[binary::HEADER_SIZE] = { 0 };
+            this->m_fstream.seekg(0, std::ios_base::beg);
+            this->m_fstream.read((char*)header, sizeof(header));
+            if (!this->m_fstream || std::memcmp(header, kMagic, sizeof(kMagic)) != 0) {
+                LOG_F(ERROR, "%s is not a simularium binary file", filePath.c_str());
+                this->m_fstream.clear();
+                return;
+            }
+
+            this->m_majorVersion = header[binary::MAJOR_VERSION_OFFSET];
+            LOG_F(INFO, "Simularium binary file version %i.%i.%i",
+                int(header[binary::MAJOR_VERSION_OFFSET]),
+                int(header[binary::MAJOR_VERSION_OFFSET + 1]),
+                int(header[binary::MAJOR_VERSION_OFFSET + 2]));
+
+            this->ReadTOC();
+            this->m_numFlushedFrames = this->m_toc.Size();
+            this->m_staticDetector.Reset(this->m_staticMinFrames, this->m_toc.Size(), this->m_staticLayer.size());
+
+            this->m_reader = std::make_shared<PositionalFile>();
+            this->m_reader->Open(filePath);
+
+            if (useMemoryMap) {
+                auto mapping = std::make_shared<MappedFile>();
+                if (mapping->Map(filePath)) {
+                    mapping->AdviseSequential();
+                    this->m_mapping = mapping;
+                } else {
+                    LOG_F(WARNING, "Falling back to stream reads for %s", filePath.c_str());
+                }
+            }
+
+            this->OpenIndex(filePath + binary::INDEX_FILE_SUFFIX);
+            this->m_numPushedFrames = this->m_toc.Size();
+            this->OpenPyramid(filePath);
+        }
+
+        bool SimulariumBinaryFile::CopyLayout(const RangeReader& read, std::uint64_t fileSize, std::string filePath)
+        {
+            std::ofstream os(filePath.c_str(), std::ios_base::binary | std::ios_base::trunc);
+            auto copy = [&](std::uint64_t offset, std::uint64_t size, std::vector<char>& out) {
+                if (offset > fileSize || size > fileSize - offset || !read(offset, size, out)) {
+                    LOG_F(ERROR, "Failed to read bytes %llu to %llu of %s",
+                        (unsigned long long)offset, (unsigned long long)(offset + size), filePath.c_str());
+                    return false;
+                }
+
+                os.seekp(offset, std::ios_base::beg);
+                os.write(out.data(), out.size());
+                return bool(os);
+            };
+
+            std::vector<char> header;
+            if (!os || !copy(0, binary::V2_HEADER_SIZE, header)) {
+                return false;
+            }
+            if (std::memcmp(header.data(), kMagic, sizeof(kMagic)) != 0
+                || (unsigned char)header[binary::MAJOR_VERSION_OFFSET] != binary::MAJOR_VERSION) {
+                LOG_F(WARNING, "%s is not a v%i simularium binary file", filePath.c_str(), int(binary::MAJOR_VERSION));
+                return false;
+            }
+
+            std::uint64_t nFrames = 0;
+            std::uint64_t blockPos = 0;
+            std::uint64_t layerPos = 0;
+            std::uint32_t layerSize = 0;
+            std::uint64_t attributePos = 0;
+            std::memcpy(&nFrames, &header[binary::V2_FRAME_COUNT_OFFSET], sizeof(nFrames));
+            std::memcpy(&blockPos, &header[binary::V2_TOC_OFFSET], sizeof(blockPos));
+            std::memcpy(&layerPos, &header[binary::V2_STATIC_LAYER_OFFSET], sizeof(layerPos));
+            std::memcpy(&layerSize, &header[binary::V2_STATIC_LAYER_OFFSET + 8], sizeof(layerSize));
+            std::memcpy(&attributePos, &header[binary::V2_ATTRIBUTES_OFFSET], sizeof(attributePos));
+
+            // Only the entries in use are read, TOC blocks are mostly empty
+            //  space reserved for frames appended later
+            std::uint64_t numEntries = 0;
+            std::vector<char> block;
+            while (blockPos != 0) {
+                std::uint64_t blockHeader[2] = { 0, 0 };
+                if (!copy(blockPos, binary::V2_TOC_BLOCK_HEADER_SIZE, block)) {
+                    return false;
+                }
+                std::memcpy(blockHeader, block.data(), sizeof(blockHeader));
+
+                std::uint64_t blockEntries = std::min(blockHeader[1], nFrames - numEntries);
+                if (blockEntries > 0 && !copy(blockPos + sizeof(blockHeader), blockEntries * sizeof(binary::TocEntry), block)) {
+                    return false;
+                }
+                numEntries += blockEntries;
+                blockPos = blockHeader[0];
+            }
+            if (numEntries != nFrames) {
+                LOG_F(ERROR, "Table of contents lists %zu frames, %zu could be read", std::size_t(nFrames), std::size_t(numEntries));
+                return false;
+            }
+
+            if (layerPos != 0 && !copy(layerPos, layerSize, block)) {
+                return false;
+            }
+
+            while (attributePos != 0) {
+                std::uint64_t blockHeader[2] = { 0, 0 };
+                if (!copy(attributePos, sizeof(blockHeader), block)) {
+                    return false;
+                }
+                std::memcpy(blockHeader, block.data(), sizeof(blockHeader));
+
+                if (blockHeader[1] > fileSize / sizeof(attributes::AttributeRecord)
+                    || !copy(attributePos + sizeof(blockHeader), blockHeader[1] * sizeof(attributes::AttributeRecord), block)) {
+                    return false;
+                }
+                attributePos = blockHeader[0];
+            }
+
+            // The frame chunks are left as a hole, filled in as they are read
+            os.close();
+            if (!os || ::truncate(filePath.c_str(), off_t(fileSize)) != 0) {
+                LOG_F(ERROR, "Failed to write %s", filePath.c_str());
+                return false;
+            }
+
+            return true;
+        }
+
+        bool SimulariumBinaryFile::GetChunkRange(std::size_t frameNumber, std::uint64_t& offset, std::uint64_t& size)
+        {
+            if (frameNumber >= this->m_toc.Size()) {
+                return false;
+            }
+
+            const binary::TocEntry& entry = this->m_toc[frameNumber];
+            offset = entry.offset;
+            size = entry.size;
+            return true;
+        }
+
+        void SimulariumBinaryFile::OpenIndex(std::string indexPath)
+        {
+            // Caches written before the index existed, or whose index
+            //  was lost, are indexed by decoding the missing frames once
+            std::size_t numFrames = this->m_toc.Size();
+            this->m_index.Open(indexPath, numFrames);
+            if (this->m_index.Size() == numFrames) {
+                return;
+            }
+
+            LOG_F(INFO, "Indexing frames %zu to %zu of simularium binary file", this->m_index.Size(), numFrames);
+            std::vector<float> scratch;
+            for (std::size_t i = this->m_index.Size(); i < numFrames; ++i) {
+                TrajectoryFrame frame;
+                FrameView view = this->GetFrameView(i);
+                if (!view.data || !codec::ParseFrame(view.data, view.size, frame)) {
+                    LOG_F(ERROR, "Failed to index frame %zu, the frame index stops at frame %zu", i, i);
+                    break;
+                }
+                this->m_index.Append(ComputeFrameStats(frame, scratch));
+            }
+            this->m_index.Flush();
+        }
+
+        void SimulariumBinaryFile::CreatePyramid(std::string filePath)
+        {
+            this->m_pyramid.clear();
+            this->m_numPushedFrames = 0;
+
+            // Levels left over from an earlier file at this path would
+            //  be picked up when the new file is opened again
+            for (std::size_t level = this->m_pyramidLevels + 1; level <= binary::MAX_PYRAMID_LEVELS; ++level) {
+                std::string levelPath = PyramidLevelPath(filePath, level);
+                std::remove(levelPath.c_str());
+                std::remove((levelPath + binary::INDEX_FILE_SUFFIX).c_str());
+            }
+
+            // Every level frame is a keyframe, so a level can be read from any frame
+            for (std::size_t level = 1; level <= this->m_pyramidLevels; ++level) {
+                auto levelFile = std::make_unique<SimulariumBinaryFile>();
+                levelFile->SetCompression(this->m_compression);
+                levelFile->SetQuantization(this->m_quantization);
+                levelFile->SetColumnarLayout(this->m_columnar);
+                levelFile->SetPackedRecords(this->m_packed);
+                levelFile->SetFiberCoding(this->m_fiber);
+                levelFile->SetWriteBuffer(this->m_writeBufferSize, this->m_flushInterval);
+                levelFile->Create(PyramidLevelPath(filePath, level));
+                this->m_pyramid.push_back(std::move(levelFile));
+            }
+        }
+
+        void SimulariumBinaryFile::OpenPyramid(std::string filePath)
+        {
+            // Level n holds frames 0, 2^n, 2*2^n, ... of this file; a level
+            //  that doesn't, and every coarser level, is left unused
+            std::size_t numFrames = this->m_toc.Size();
+            for (std::size_t level = 1; level <= binary::MAX_PYRAMID_LEVELS; ++level) {
+                std::string levelPath = PyramidLevelPath(filePath, level);
+                if (!std::ifstream(levelPath.c_str())) {
+                    break;
+                }
+
+                auto levelFile = std::make_unique<SimulariumBinaryFile>();
+                levelFile->SetCompression(this->m_compression);
+                levelFile->Open(levelPath, this->m_mapping != nullptr);
+
+                std::size_t expected = (numFrames + (std::size_t(1) << level) - 1) >> level;
+                if (levelFile->NumSavedFrames() != expected) {
+                    LOG_F(WARNING, "Pyramid level %zu has %zu frames instead of %zu, levels from %zu on are not used",
+                        level, levelFile->NumSavedFrames(), expected, level);
+                    break;
+                }
+                this->m_pyramid.push_back(std::move(levelFile));
+            }
+
+            if (!this->m_pyramid.empty()) {
+                LOG_F(INFO, "Using %zu pyramid levels", this->m_pyramid.size());
+            }
         }
 
         void SimulariumBinaryFile::WriteFrame(TrajectoryFrame frame)
@@ -41,53 +347,380 @@ namespace simularium {
                 return;
             }
 
-            std::vector<float> frameChunk;
+            if (this->m_majorVersion < binary::MAJOR_VERSION) {
+                LOG_F(ERROR, "Appending frames to a v%i simularium binary file is not supported", int(this->m_majorVersion));
+                return;
+            }
+
+            // Agents of an opened file that were static up to its last frame
+            //  are static no longer, new frames hold them again if they are there
+            if (this->m_closeStaticLayer) {
+                std::lock_guard<std::mutex> lock(this->m_staticLayerMutex);
+                for (auto& entry : this->m_staticLayer) {
+                    if (entry.end == static_layer::kOpenEnd) {
+                        entry.end = std::uint32_t(this->m_toc.Size());
+                        this->m_staticLayerChanged = true;
+                    }
+                }
+                this->m_closeStaticLayer = false;
+            }
+
+            // Levels get the frame as it was passed in, static agents included
+            for (std::size_t level = 1; level <= this->m_pyramid.size(); ++level) {
+                if (this->m_numPushedFrames % (std::size_t(1) << level) == 0) {
+                    this->m_pyramid[level - 1]->WriteFrame(frame);
+                }
+            }
+            this->m_numPushedFrames++;
 
-            frameChunk.push_back(float(frame.frameNumber));
-            frameChunk.push_back(frame.time);
-            frameChunk.push_back(float(frame.data.size()));
+            if (!this->m_staticDetector.IsEnabled()) {
+                this->AppendFrame(std::move(frame));
+                return;
+            }
 
-            for (auto& agentData : frame.data) {
-                frameChunk.push_back(agentData.vis_type);
-                frameChunk.push_back(agentData.id);
-                frameChunk.push_back(agentData.type);
-                frameChunk.push_back(agentData.x);
-                frameChunk.push_back(agentData.y);
-                frameChunk.push_back(agentData.z);
-                frameChunk.push_back(agentData.xrot);
-                frameChunk.push_back(agentData.yrot);
-                frameChunk.push_back(agentData.zrot);
-                frameChunk.push_back(agentData.collision_radius);
-                frameChunk.push_back(agentData.subpoints.size());
+            // Frames are held back until it is known which of their agents are static
+            this->m_staticDetector.Push(std::move(frame));
+            this->AppendReleasedFrames();
+        }
 
-                for (std::size_t j = 0; j < agentData.subpoints.size(); ++j) {
-                    frameChunk.push_back(agentData.subpoints[j]);
+        void SimulariumBinaryFile::AppendReleasedFrames()
+        {
+            // The layer is brought up to date first, so readers
+            //  never see a frame without its static agents
+            {
+                std::lock_guard<std::mutex> lock(this->m_staticLayerMutex);
+                if (this->m_staticDetector.Update(this->m_staticLayer)) {
+                    this->m_staticLayerChanged = true;
                 }
             }
 
-            // Read the current number of frames saved to the file
-            this->m_fstream.seekg(fileio::binary::TOC_ENTRY_COUNT_OFFSET, std::ios_base::beg);
-            int nFrames;
-            this->m_fstream.read((char*)&nFrames, sizeof(nFrames));
+            TrajectoryFrame frame;
+            while (this->m_staticDetector.Pop(frame)) {
+                this->AppendFrame(std::move(frame));
+            }
+        }
 
-            // Get the stream position of the new frame chunk
-            this->m_fstream.seekg(0, std::ios_base::end);
-            int framePos = int(this->m_fstream.tellg());
+        void SimulariumBinaryFile::AppendFrame(TrajectoryFrame frame)
+        {
+            // Buffered frames are written out first, so the new
+            //  TOC block does not land in the middle of them
+            std::size_t frameIndex = this->m_toc.Size();
+            if (frameIndex >= this->m_tocBlocks.size() * this->m_tocBlockCapacity) {
+                this->FlushFrames();
+                this->AppendTOCBlock();
+            }
 
-            // Save the frame-chunk stream position in the offset look-up
-            int tocPos = fileio::binary::TOC_ENTRY_START_OFFSET + nFrames * 4;
-            this->m_fstream.seekp(tocPos, std::ios_base::beg);
-            this->m_fstream.write((char*)&framePos, sizeof(framePos));
+            binary::TocEntry entry;
+            entry.offset = this->m_endOfFile;
 
-            // Save the frame chunk data out
-            this->m_fstream.seekp(0, std::ios_base::end);
-            this->m_fstream.write((char*)&frameChunk[0], frameChunk.size() * sizeof(frameChunk[0]));
-            this->m_fstream.write((char*)fileio::binary::eof, sizeof(unsigned char) * 20);
+            // Frames are grouped and quantized before anything else, so deltas
+            //  are taken between the frames that readers will see
+            if (this->m_columnar) {
+                columnar::GroupByType(frame);
+            }
+
+            // Fiber subpoints are moved into a section of their own, which
+            //  is appended to the frame chunk, whatever its layout
+            bool hasFibers = fiber::EncodeFibers(frame, this->m_fiber, this->m_fibers);
+            if (hasFibers) {
+                this->m_quantizationError.fiber = std::max(this->m_quantizationError.fiber, this->m_fibers.error);
+            }
+
+            // Quantized keyframes and deltas store ids as floats, so frames
+            //  with larger ids are written as columnar or packed keyframes
+            bool exactIds = codec::IdsFitInFloat(frame);
+            bool quantize = this->m_quantization.enabled && exactIds;
+
+            std::vector<char> keyframeChunk;
+            if (quantize) {
+                quantization::QuantizationError error;
+                keyframeChunk = quantization::EncodeFrame(frame, this->m_quantization, error);
+                quantization::DecodeFrame(keyframeChunk.data(), keyframeChunk.size(), frame);
+
+                this->m_quantizationError.position = std::max(this->m_quantizationError.position, error.position);
+                this->m_quantizationError.rotation = std::max(this->m_quantizationError.rotation, error.rotation);
+            }
+
+            // Stats and attributes are taken from the frame as readers
+            //  will see it, static agents included
+            TrajectoryFrame merged;
+            bool hasStatic = this->HasStaticAgents(frameIndex);
+            if (hasStatic) {
+                merged = frame;
+                this->AddStaticAgents(frameIndex, merged);
+            }
+
+            FrameStats stats = ComputeFrameStats(hasStatic ? merged : frame, this->m_statsScratch);
+            stats.frameSize += std::uint32_t(this->m_fibers.numSubpoints * sizeof(float));
+
+            bool hasAttributes = false;
+            if (this->m_attributeTable) {
+                std::lock_guard<std::mutex> lock(this->m_attributeMutex);
+                hasAttributes = this->m_attributes.Record(frameIndex, hasStatic ? merged : frame);
+            }
+
+            // Deltas are only written against the frame that was written
+            //  last through this object, otherwise a keyframe starts the run
+            std::vector<float>& frameChunk = this->m_frameChunk;
+            const char* chunkData = nullptr;
+            bool isKeyframe = !this->m_hasLastWrittenFrame
+                || frameIndex - this->m_lastKeyframe >= this->m_keyframeInterval;
+            if (!isKeyframe && codec::EncodeDelta(this->m_lastWrittenFrame, frame, frameChunk)) {
+                entry.flags |= binary::FRAME_FLAG_DELTA;
+            } else if (quantize) {
+                entry.flags |= binary::FRAME_FLAG_QUANTIZED;
+                this->m_lastKeyframe = frameIndex;
+            } else if (this->m_columnar) {
+                keyframeChunk = columnar::Encode(columnar::ToColumnar(frame));
+                entry.flags |= binary::FRAME_FLAG_COLUMNAR;
+                this->m_lastKeyframe = frameIndex;
+            } else if (hasAttributes) {
+                attributes::SerializeFrame(frame, frameChunk);
+                entry.flags |= binary::FRAME_FLAG_ATTRIBUTES;
+                this->m_lastKeyframe = frameIndex;
+            } else if ((this->m_packed || !exactIds) && packed::Encode(frame, keyframeChunk)) {
+                entry.flags |= binary::FRAME_FLAG_PACKED;
+                this->m_lastKeyframe = frameIndex;
+            } else {
+                if (!exactIds) {
+                    LOG_F(WARNING, "Frame %zu can't be packed, ids above %u will be rounded", frameIndex, codec::kMaxFloatId);
+                }
+                codec::SerializeFrame(frame, frameChunk);
+                this->m_lastKeyframe = frameIndex;
+            }
+
+            if (entry.flags & (binary::FRAME_FLAG_QUANTIZED | binary::FRAME_FLAG_COLUMNAR | binary::FRAME_FLAG_PACKED)) {
+                chunkData = keyframeChunk.data();
+                entry.size = std::uint32_t(keyframeChunk.size());
+            } else {
+                chunkData = (char*)&frameChunk[0];
+                entry.size = std::uint32_t(frameChunk.size() * sizeof(frameChunk[0]));
+            }
+
+            if (hasFibers) {
+                const std::vector<char>& section = this->m_fibers.section;
+                this->m_fiberChunk.assign(chunkData, chunkData + entry.size);
+                this->m_fiberChunk.insert(this->m_fiberChunk.end(), section.begin(), section.end());
+                chunkData = this->m_fiberChunk.data();
+                entry.size = std::uint32_t(this->m_fiberChunk.size());
+                entry.flags |= binary::FRAME_FLAG_FIBERS;
+            }
+
+            if (compression::Compress(chunkData, entry.size, this->m_compression, this->m_compressedChunk)) {
+                chunkData = this->m_compressedChunk.data();
+                entry.size = std::uint32_t(this->m_compressedChunk.size());
+                entry.flags |= binary::FRAME_FLAG_BLOSC;
+            }
+
+            // Append the frame chunk to the write buffer; the chunk
+            //  and its TOC entry reach the file on the next flush
+            std::size_t bufferedSize = 0;
+            {
+                std::lock_guard<std::mutex> lock(this->m_writeBufferMutex);
+                if (this->m_writeBuffer.empty()) {
+                    this->m_writeBufferOffset = entry.offset;
+                }
+                this->m_writeBuffer.insert(this->m_writeBuffer.end(), chunkData, chunkData + entry.size);
+                bufferedSize = this->m_writeBuffer.size();
+            }
+
+            // The frame is visible to readers from here on
+            this->m_endOfFile += entry.size;
+            this->m_index.Append(stats);
+            this->m_toc.Append(entry);
+
+            if (bufferedSize >= this->m_writeBufferSize
+                || this->m_toc.Size() - this->m_numFlushedFrames >= this->m_flushInterval) {
+                this->FlushFrames();
+            }
+
+            if (this->m_keyframeInterval > 1) {
+                this->m_lastWrittenFrame = std::move(frame);
+                this->m_hasLastWrittenFrame = true;
+            }
+        }
+
+        void SimulariumBinaryFile::SetWriteBuffer(std::size_t bufferSize, std::size_t flushInterval)
+        {
+            this->m_writeBufferSize = bufferSize;
+            this->m_flushInterval = bufferSize > 0 ? std::max(flushInterval, std::size_t(1)) : 1;
+
+            std::lock_guard<std::mutex> lock(this->m_writeBufferMutex);
+            this->m_writeBuffer.reserve(bufferSize);
+        }
+
+        void SimulariumBinaryFile::Flush()
+        {
+            // Held back frames are written with the agents that
+            //  turned out to be static so far
+            if (this->m_staticDetector.IsEnabled()) {
+                this->m_staticDetector.Drain();
+                this->AppendReleasedFrames();
+            }
+
+            this->FlushFrames();
+            for (auto& levelFile : this->m_pyramid) {
+                levelFile->Flush();
+            }
+        }
+
+        std::size_t SimulariumBinaryFile::Checkpoint()
+        {
+            this->FlushFrames();
+            for (auto& levelFile : this->m_pyramid) {
+                levelFile->Flush();
+            }
+
+            return this->m_numFlushedFrames;
+        }
+
+        void SimulariumBinaryFile::FlushFrames()
+        {
+            if (!this->m_fstream || (this->m_numFlushedFrames == this->m_toc.Size() && !this->m_staticLayerChanged)) {
+                return;
+            }
+
+            // Save the buffered frame chunks out; readers copy buffered
+            //  frames under the same lock, so the buffer is only
+            //  cleared once the chunks can be read from the file
+            {
+                std::lock_guard<std::mutex> lock(this->m_writeBufferMutex);
+                if (!this->m_writeBuffer.empty()) {
+                    this->m_fstream.seekp(this->m_writeBufferOffset, std::ios_base::beg);
+                    this->m_fstream.write(this->m_writeBuffer.data(), this->m_writeBuffer.size());
+                    this->m_fstream.flush();
+                    this->m_writeBuffer.clear();
+                }
+            }
+
+            // Save their TOC entries, with one write per TOC block
+            std::size_t frameIndex = this->m_numFlushedFrames;
+            std::vector<binary::TocEntry> entries;
+            while (frameIndex < this->m_toc.Size()) {
+                std::size_t blockIndex = frameIndex / this->m_tocBlockCapacity;
+                std::size_t blockEnd = std::min(this->m_toc.Size(), (blockIndex + 1) * this->m_tocBlockCapacity);
+                std::uint64_t tocPos = this->m_tocBlocks[blockIndex] + binary::V2_TOC_BLOCK_HEADER_SIZE
+                    + (frameIndex % this->m_tocBlockCapacity) * sizeof(binary::TocEntry);
+
+                entries.clear();
+                for (; frameIndex < blockEnd; ++frameIndex) {
+                    entries.push_back(this->m_toc[frameIndex]);
+                }
+
+                this->m_fstream.seekp(tocPos, std::ios_base::beg);
+                this->m_fstream.write((char*)&entries[0], entries.size() * sizeof(binary::TocEntry));
+            }
+
+            // The static layer and the attribute table cover every frame counted below
+            if (this->m_staticLayerChanged) {
+                this->WriteStaticLayer();
+            }
+
+            if (this->m_attributes.Size() > this->m_numSavedAttributes) {
+                this->WriteAttributes();
+            }
 
             // Update the number of frames loaded in the file
-            nFrames++;
-            this->m_fstream.seekp(fileio::binary::TOC_ENTRY_COUNT_OFFSET, std::ios_base::beg);
+            //  this is written last so the count never runs ahead of the data
+            this->m_fstream.flush();
+            std::uint64_t nFrames = this->m_toc.Size();
+            this->m_fstream.seekp(binary::V2_FRAME_COUNT_OFFSET, std::ios_base::beg);
             this->m_fstream.write((char*)&nFrames, sizeof(nFrames));
+
+            if (this->m_quantization.enabled || this->m_fiber.step > 0) {
+                float error[3] = {
+                    this->m_quantizationError.position, this->m_quantizationError.rotation, this->m_quantizationError.fiber
+                };
+                this->m_fstream.seekp(binary::V2_QUANTIZATION_ERROR_OFFSET, std::ios_base::beg);
+                this->m_fstream.write((char*)error, sizeof(error));
+            }
+
+            this->m_fstream.flush();
+            if (!this->m_fstream) {
+                LOG_F(ERROR, "Failed to write %zu frames to simularium binary file", this->m_toc.Size() - this->m_numFlushedFrames);
+                this->m_fstream.clear();
+            }
+
+            this->m_numFlushedFrames = this->m_toc.Size();
+            this->m_index.Flush();
+        }
+
+        void SimulariumBinaryFile::SetCompression(compression::CompressionOptions options)
+        {
+            if (options.compressor != compression::Compressor::None && !compression::IsAvailable()) {
+                LOG_F(WARNING, "Built without blosc support, frames will be stored uncompressed");
+                options.compressor = compression::Compressor::None;
+            }
+
+            this->m_compression = options;
+        }
+
+        void SimulariumBinaryFile::SetKeyframeInterval(std::size_t interval)
+        {
+            this->m_keyframeInterval = std::max(interval, std::size_t(1));
+        }
+
+        void SimulariumBinaryFile::SetQuantization(quantization::QuantizationOptions options)
+        {
+            this->m_quantization = options;
+        }
+
+        void SimulariumBinaryFile::SetStaticAgents(std::size_t minFrames)
+        {
+            this->Flush();
+            this->m_staticMinFrames = minFrames;
+            this->m_staticDetector.Reset(minFrames, this->m_toc.Size(), this->m_staticLayer.size());
+        }
+
+        std::vector<char> SimulariumBinaryFile::GetStaticLayer()
+        {
+            std::lock_guard<std::mutex> lock(this->m_staticLayerMutex);
+            return static_layer::Encode(this->m_staticLayer);
+        }
+
+        std::size_t SimulariumBinaryFile::NumStaticAgents()
+        {
+            std::lock_guard<std::mutex> lock(this->m_staticLayerMutex);
+            return this->m_staticLayer.size();
+        }
+
+        void SimulariumBinaryFile::ClearStaticLayer()
+        {
+            std::lock_guard<std::mutex> lock(this->m_staticLayerMutex);
+            this->m_staticLayer.clear();
+            this->m_staticLayerChanged = false;
+        }
+
+        bool SimulariumBinaryFile::HasStaticAgents(std::size_t frameNumber)
+        {
+            std::lock_guard<std::mutex> lock(this->m_staticLayerMutex);
+            return static_layer::HasStaticAgents(this->m_staticLayer, frameNumber);
+        }
+
+        void SimulariumBinaryFile::AddStaticAgents(std::size_t frameNumber, TrajectoryFrame& frame)
+        {
+            std::lock_guard<std::mutex> lock(this->m_staticLayerMutex);
+            static_layer::AddStaticAgents(this->m_staticLayer, frameNumber, frame);
+        }
+
+        void SimulariumBinaryFile::RemoveStaticAgents(std::size_t frameNumber, TrajectoryFrame& frame)
+        {
+            std::lock_guard<std::mutex> lock(this->m_staticLayerMutex);
+            static_layer::RemoveStaticAgents(this->m_staticLayer, frameNumber, frame);
+        }
+
+        std::vector<char> SimulariumBinaryFile::GetAttributeRecords(std::size_t begin, std::size_t throughFrame)
+        {
+            std::lock_guard<std::mutex> lock(this->m_attributeMutex);
+            return attributes::Encode(this->m_attributes, begin, this->m_attributes.NumRecordsThrough(throughFrame));
+        }
+
+        void SimulariumBinaryFile::ClearAttributes()
+        {
+            std::lock_guard<std::mutex> lock(this->m_attributeMutex);
+            this->m_attributes.Clear();
+            this->m_numSavedAttributes = 0;
+            this->m_lastAttributeBlock = 0;
         }
 
         void SimulariumBinaryFile::WriteHeader()
@@ -97,49 +730,657 @@ namespace simularium {
                 return;
             }
 
-            std::vector<unsigned char> header({ 'S', 'I', 'M', 'U', 'L', 'A', 'R', 'I', 'U', 'M', 'B', 'I', 'N' });
+            std::vector<unsigned char> header(kMagic, kMagic + sizeof(kMagic));
 
-            header.push_back(char(1)); // major version
-            header.push_back(char(0)); // minor version
-            header.push_back(char(0)); // patch version
+            header.push_back(binary::MAJOR_VERSION);
+            header.push_back(binary::MINOR_VERSION);
+            header.push_back(binary::PATCH_VERSION);
+
+            // frame count, first TOC block, and reserved space
+            header.resize(binary::V2_HEADER_SIZE, 0);
 
             this->m_fstream.seekp(0, std::ios_base::beg);
             this->m_fstream.write((char*)&header[0], header.size() * sizeof(header[0]));
+            this->m_endOfFile = header.size();
+        }
+
+        void SimulariumBinaryFile::WriteStaticLayer()
+        {
+            // The layer only changes on this thread, so it is read without
+            //  the lock; earlier copies of it are left in place, unreferenced
+            std::vector<char> layer = static_layer::Encode(this->m_staticLayer);
+            std::uint64_t layerPos = this->m_endOfFile;
+            std::uint32_t layerSize = std::uint32_t(layer.size());
+            this->m_fstream.seekp(layerPos, std::ios_base::beg);
+            this->m_fstream.write(layer.data(), layer.size());
+            this->m_endOfFile += layer.size();
+
+            this->m_fstream.flush();
+            this->m_fstream.seekp(binary::V2_STATIC_LAYER_OFFSET, std::ios_base::beg);
+            this->m_fstream.write((char*)&layerPos, sizeof(layerPos));
+            this->m_fstream.write((char*)&layerSize, sizeof(layerSize));
+            this->m_staticLayerChanged = false;
         }
 
-        void SimulariumBinaryFile::AllocateTOC(std::size_t size)
+        void SimulariumBinaryFile::WriteAttributes()
+        {
+            // Records are only added on this thread, so they are read without the lock
+            std::vector<attributes::AttributeRecord> records;
+            for (std::size_t i = this->m_numSavedAttributes; i < this->m_attributes.Size(); ++i) {
+                records.push_back(this->m_attributes[i]);
+            }
+
+            std::uint64_t blockPos = this->m_endOfFile;
+            std::uint64_t blockHeader[2] = { 0, records.size() };
+            this->m_fstream.seekp(blockPos, std::ios_base::beg);
+            this->m_fstream.write((char*)blockHeader, sizeof(blockHeader));
+            this->m_fstream.write((char*)&records[0], records.size() * sizeof(records[0]));
+            this->m_endOfFile += sizeof(blockHeader) + records.size() * sizeof(records[0]);
+
+            // Link the new block from the previous one, or from the header
+            //  if this is the first block in the file
+            std::uint64_t linkPos = this->m_lastAttributeBlock != 0
+                ? this->m_lastAttributeBlock
+                : binary::V2_ATTRIBUTES_OFFSET;
+            this->m_fstream.flush();
+            this->m_fstream.seekp(linkPos, std::ios_base::beg);
+            this->m_fstream.write((char*)&blockPos, sizeof(blockPos));
+
+            this->m_lastAttributeBlock = blockPos;
+            this->m_numSavedAttributes = this->m_attributes.Size();
+        }
+
+        void SimulariumBinaryFile::AppendTOCBlock()
         {
             if (!this->m_fstream) {
                 LOG_F(WARNING, "No file opened. Call SimulariumBinaryFile.Create([filepath])");
                 return;
             }
 
-            std::vector<int> tocChunk(size + 1, 0);
+            std::uint64_t blockPos = this->m_endOfFile;
+            std::uint64_t blockHeader[2] = { 0, this->m_tocBlockCapacity };
+            std::vector<binary::TocEntry> entries(this->m_tocBlockCapacity);
 
-            this->m_fstream.seekp(fileio::binary::HEADER_SIZE, std::ios_base::beg);
-            this->m_fstream.write((char*)&tocChunk[0], tocChunk.size() * sizeof(tocChunk[0]));
+            this->m_fstream.seekp(blockPos, std::ios_base::beg);
+            this->m_fstream.write((char*)blockHeader, sizeof(blockHeader));
+            this->m_fstream.write((char*)&entries[0], entries.size() * sizeof(entries[0]));
+            this->m_endOfFile += sizeof(blockHeader) + entries.size() * sizeof(entries[0]);
 
-            this->m_fstream.seekg(0, std::ios_base::end);
-            this->m_endTOC = std::size_t(this->m_fstream.tellg());
+            // Link the new block from the previous one, or from the header
+            //  if this is the first block in the file
+            std::uint64_t linkPos = this->m_tocBlocks.empty()
+                ? binary::V2_TOC_OFFSET
+                : this->m_tocBlocks.back();
+            this->m_fstream.seekp(linkPos, std::ios_base::beg);
+            this->m_fstream.write((char*)&blockPos, sizeof(blockPos));
+
+            this->m_tocBlocks.push_back(blockPos);
         }
 
-        std::size_t SimulariumBinaryFile::NumSavedFrames()
+        void SimulariumBinaryFile::ReadTOC()
+        {
+            if (this->m_majorVersion == 1) {
+                this->ReadTOCv1();
+            } else if (this->m_majorVersion == binary::MAJOR_VERSION) {
+                this->ReadTOCv2();
+            } else {
+                LOG_F(ERROR, "Unsupported simularium binary file version %i", int(this->m_majorVersion));
+            }
+        }
+
+        void SimulariumBinaryFile::ReadTOCv1()
         {
-            if (!this->m_fstream || !this->m_fstream.good()) {
-                LOG_F(WARNING, "fstream is invalid, resetting...");
+            std::int32_t nFrames = 0;
+            this->m_fstream.seekg(binary::TOC_ENTRY_COUNT_OFFSET, std::ios_base::beg);
+            this->m_fstream.read((char*)&nFrames, sizeof(nFrames));
+
+            std::vector<std::int32_t> offsets(std::max(nFrames, 0));
+            if (!offsets.empty()) {
+                this->m_fstream.read((char*)&offsets[0], offsets.size() * sizeof(offsets[0]));
+            }
+
+            if (!this->m_fstream) {
+                LOG_F(ERROR, "Failed to read v1 table of contents");
                 this->m_fstream.clear();
-                this->m_fstream.seekg(0, std::ios_base::beg);
-                this->m_fstream.seekp(0, std::ios_base::beg);
+                return;
+            }
+
+            // v1 frames run up to the start of the next frame (or the end of file)
+            //  and are terminated with a delimiter that is not part of the frame
+            for (std::size_t i = 0; i < offsets.size(); ++i) {
+                std::uint64_t start = std::uint32_t(offsets[i]);
+                std::uint64_t end = i + 1 < offsets.size() ? std::uint32_t(offsets[i + 1]) : this->m_endOfFile;
+
+                binary::TocEntry entry;
+                entry.offset = start;
+                entry.size = end >= start + binary::EOF_SIZE ? std::uint32_t(end - start - binary::EOF_SIZE) : 0;
+                this->m_toc.Append(entry);
             }
+        }
 
-            this->m_fstream.seekg(fileio::binary::TOC_ENTRY_COUNT_OFFSET, std::ios_base::beg);
-            int nFrames;
+        void SimulariumBinaryFile::ReadTOCv2()
+        {
+            std::uint64_t nFrames = 0;
+            std::uint64_t blockPos = 0;
+            this->m_fstream.seekg(binary::V2_FRAME_COUNT_OFFSET, std::ios_base::beg);
             this->m_fstream.read((char*)&nFrames, sizeof(nFrames));
-            return nFrames;
+            this->m_fstream.read((char*)&blockPos, sizeof(blockPos));
+
+            float error[3] = { 0, 0, 0 };
+            this->m_fstream.read((char*)error, sizeof(error));
+            this->m_quantizationError.position = error[0];
+            this->m_quantizationError.rotation = error[1];
+            this->m_quantizationError.fiber = error[2];
+
+            std::uint64_t layerPos = 0;
+            std::uint32_t layerSize = 0;
+            this->m_fstream.read((char*)&layerPos, sizeof(layerPos));
+            this->m_fstream.read((char*)&layerSize, sizeof(layerSize));
+
+            std::uint64_t attributePos = 0;
+            this->m_fstream.read((char*)&attributePos, sizeof(attributePos));
+
+            while (blockPos != 0 && this->m_fstream) {
+                std::uint64_t blockHeader[2] = { 0, 0 };
+                this->m_fstream.seekg(blockPos, std::ios_base::beg);
+                this->m_fstream.read((char*)blockHeader, sizeof(blockHeader));
+
+                this->m_tocBlocks.push_back(blockPos);
+                this->m_tocBlockCapacity = blockHeader[1];
+
+                std::vector<binary::TocEntry> entries(std::min(blockHeader[1], nFrames - this->m_toc.Size()));
+                if (!entries.empty() && this->m_fstream.read((char*)&entries[0], entries.size() * sizeof(binary::TocEntry))) {
+                    for (auto& entry : entries) {
+                        this->m_toc.Append(entry);
+                    }
+                }
+
+                blockPos = blockHeader[0];
+            }
+
+            if (!this->m_fstream || this->m_toc.Size() != nFrames) {
+                LOG_F(ERROR, "Table of contents lists %zu frames, %zu could be read",
+                    std::size_t(nFrames), this->m_toc.Size());
+                this->m_fstream.clear();
+            }
+
+            if (layerPos != 0) {
+                this->ReadStaticLayer(layerPos, layerSize);
+            }
+
+            if (attributePos != 0) {
+                this->ReadAttributes(attributePos);
+            }
+        }
+
+        void SimulariumBinaryFile::ReadStaticLayer(std::uint64_t offset, std::uint32_t size)
+        {
+            std::vector<char> layer(size);
+            this->m_fstream.seekg(offset, std::ios_base::beg);
+            if (size == 0 || !this->m_fstream.read(layer.data(), size)) {
+                LOG_F(ERROR, "Failed to read the static layer");
+                this->m_fstream.clear();
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(this->m_staticLayerMutex);
+            if (!static_layer::Decode(layer.data(), layer.size(), this->m_staticLayer)) {
+                LOG_F(ERROR, "Static layer is malformed, static agents will be missing from frames");
+                this->m_staticLayer.clear();
+            }
+        }
+
+        void SimulariumBinaryFile::ReadAttributes(std::uint64_t offset)
+        {
+            std::lock_guard<std::mutex> lock(this->m_attributeMutex);
+            std::uint64_t blockPos = offset;
+            while (blockPos != 0) {
+                std::uint64_t blockHeader[2] = { 0, 0 };
+                this->m_fstream.seekg(blockPos, std::ios_base::beg);
+                this->m_fstream.read((char*)blockHeader, sizeof(blockHeader));
+
+                std::vector<attributes::AttributeRecord> records;
+                if (this->m_fstream && blockHeader[1] <= this->m_endOfFile / sizeof(attributes::AttributeRecord)) {
+                    records.resize(blockHeader[1]);
+                    this->m_fstream.read((char*)records.data(), records.size() * sizeof(records[0]));
+                }
+
+                if (!this->m_fstream || records.size() != blockHeader[1]) {
+                    LOG_F(ERROR, "Failed to read the attribute table, %zu records could be read", this->m_attributes.Size());
+                    this->m_fstream.clear();
+                    break;
+                }
+
+                for (auto& record : records) {
+                    this->m_attributes.Append(record);
+                }
+
+                this->m_lastAttributeBlock = blockPos;
+                blockPos = blockHeader[0];
+            }
+
+            this->m_numSavedAttributes = this->m_attributes.Size();
+        }
+
+        FrameView SimulariumBinaryFile::GetFrameView(std::size_t frameNumber, bool withStaticAgents)
+        {
+            std::uint32_t flags = this->m_toc[frameNumber].flags;
+            bool addStatic = withStaticAgents && this->HasStaticAgents(frameNumber);
+            if (!addStatic && !(flags & (binary::FRAME_FLAG_DELTA | binary::FRAME_FLAG_QUANTIZED | binary::FRAME_FLAG_COLUMNAR | binary::FRAME_FLAG_PACKED | binary::FRAME_FLAG_FIBERS | binary::FRAME_FLAG_ATTRIBUTES))) {
+                return this->GetStoredChunk(frameNumber);
+            }
+
+            FrameView view;
+            view.frameNumber = frameNumber;
+            std::lock_guard<std::mutex> lock(this->m_rebuildMutex);
+            if (!this->RebuildFrame(frameNumber)) {
+                return view;
+            }
+
+            TrajectoryFrame merged;
+            if (addStatic) {
+                merged = this->m_rebuiltFrame;
+                this->AddStaticAgents(frameNumber, merged);
+            }
+
+            auto rebuilt = std::make_shared<std::vector<float>>(codec::SerializeFrame(addStatic ? merged : this->m_rebuiltFrame));
+            view.data = (const char*)rebuilt->data();
+            view.size = rebuilt->size() * sizeof(float);
+            view.owner = rebuilt;
+            return view;
+        }
+
+        FrameView SimulariumBinaryFile::GetStoredChunk(std::size_t frameNumber)
+        {
+            const binary::TocEntry& entry = this->m_toc[frameNumber];
+
+            FrameView view;
+            view.frameNumber = frameNumber;
+            view.size = entry.size;
+            if (entry.flags & binary::FRAME_FLAG_DELTA) {
+                view.encoding = FrameEncoding::Delta;
+            } else if (entry.flags & binary::FRAME_FLAG_COLUMNAR) {
+                view.encoding = FrameEncoding::Columnar;
+            } else if (entry.flags & binary::FRAME_FLAG_PACKED) {
+                view.encoding = FrameEncoding::Packed;
+            } else if (entry.flags & binary::FRAME_FLAG_ATTRIBUTES) {
+                view.encoding = FrameEncoding::Transforms;
+            }
+
+            // Frames that are still buffered are served from the write buffer
+            {
+                std::lock_guard<std::mutex> lock(this->m_writeBufferMutex);
+                if (!this->m_writeBuffer.empty() && entry.offset >= this->m_writeBufferOffset) {
+                    const char* buffered = this->m_writeBuffer.data() + (entry.offset - this->m_writeBufferOffset);
+                    auto copy = std::make_shared<std::vector<char>>(buffered, buffered + entry.size);
+                    view.data = copy->data();
+                    view.owner = copy;
+                    return (entry.flags & binary::FRAME_FLAG_BLOSC) ? this->Decompress(view) : view;
+                }
+            }
+
+            // Frames covered by the mapping are served without a copy
+            if (this->m_mapping && entry.offset + entry.size <= this->m_mapping->GetSize()) {
+                view.data = this->m_mapping->GetData() + entry.offset;
+                view.owner = this->m_mapping;
+                return (entry.flags & binary::FRAME_FLAG_BLOSC) ? this->Decompress(view) : view;
+            }
+
+            // Everything else is read at its offset, without touching
+            //  the seek position of the stream that frames are written through
+            auto copy = std::make_shared<std::vector<char>>(entry.size);
+            if (!this->m_reader || !this->m_reader->Read(entry.offset, copy->data(), entry.size)) {
+                LOG_F(ERROR, "Failed to read frame %zu", frameNumber);
+                view.size = 0;
+                return view;
+            }
+
+            view.data = copy->data();
+            view.owner = copy;
+            return (entry.flags & binary::FRAME_FLAG_BLOSC) ? this->Decompress(view) : view;
+        }
+
+        FrameView SimulariumBinaryFile::GetColumnarView(std::size_t frameNumber, bool withStaticAgents)
+        {
+            std::uint32_t flags = this->m_toc[frameNumber].flags;
+            bool addStatic = withStaticAgents && this->HasStaticAgents(frameNumber);
+            if (!addStatic && (flags & binary::FRAME_FLAG_COLUMNAR) && !(flags & (binary::FRAME_FLAG_DELTA | binary::FRAME_FLAG_FIBERS))) {
+                return this->GetStoredChunk(frameNumber);
+            }
+
+            FrameView view;
+            view.frameNumber = frameNumber;
+            view.encoding = FrameEncoding::Columnar;
+            TrajectoryFrame grouped;
+            {
+                std::lock_guard<std::mutex> lock(this->m_rebuildMutex);
+                if (!this->RebuildFrame(frameNumber)) {
+                    return view;
+                }
+                grouped = this->m_rebuiltFrame;
+            }
+
+            if (addStatic) {
+                this->AddStaticAgents(frameNumber, grouped);
+            }
+
+            // Frames written without the columnar layout are grouped here
+            columnar::GroupByType(grouped);
+
+            auto encoded = std::make_shared<std::vector<char>>(columnar::Encode(columnar::ToColumnar(grouped)));
+            view.data = encoded->data();
+            view.size = encoded->size();
+            view.owner = encoded;
+            return view;
+        }
+
+        FrameView SimulariumBinaryFile::GetPackedView(std::size_t frameNumber, bool withStaticAgents)
+        {
+            std::uint32_t flags = this->m_toc[frameNumber].flags;
+            bool addStatic = withStaticAgents && this->HasStaticAgents(frameNumber);
+            if (!addStatic && (flags & binary::FRAME_FLAG_PACKED) && !(flags & (binary::FRAME_FLAG_DELTA | binary::FRAME_FLAG_FIBERS))) {
+                return this->GetStoredChunk(frameNumber);
+            }
+
+            FrameView view;
+            view.frameNumber = frameNumber;
+            auto encoded = std::make_shared<std::vector<char>>();
+            {
+                std::lock_guard<std::mutex> lock(this->m_rebuildMutex);
+                if (!this->RebuildFrame(frameNumber)) {
+                    return view;
+                }
+
+                TrajectoryFrame merged;
+                if (addStatic) {
+                    merged = this->m_rebuiltFrame;
+                    this->AddStaticAgents(frameNumber, merged);
+                }
+                const TrajectoryFrame& frame = addStatic ? merged : this->m_rebuiltFrame;
+
+                // Frames with fields that don't fit a packed record are sent in full
+                if (!packed::Encode(frame, *encoded)) {
+                    auto rebuilt = std::make_shared<std::vector<float>>(codec::SerializeFrame(frame));
+                    view.data = (const char*)rebuilt->data();
+                    view.size = rebuilt->size() * sizeof(float);
+                    view.owner = rebuilt;
+                    return view;
+                }
+            }
+
+            view.encoding = FrameEncoding::Packed;
+            view.data = encoded->data();
+            view.size = encoded->size();
+            view.owner = encoded;
+            return view;
+        }
+
+        FrameView SimulariumBinaryFile::GetTransformsView(std::size_t frameNumber, bool withStaticAgents, bool allowPacked)
+        {
+            std::uint32_t flags = this->m_toc[frameNumber].flags;
+            bool addStatic = withStaticAgents && this->HasStaticAgents(frameNumber);
+            if (!addStatic && (flags & ~binary::FRAME_FLAG_BLOSC) == binary::FRAME_FLAG_ATTRIBUTES) {
+                return this->GetStoredChunk(frameNumber);
+            }
+
+            FrameView view;
+            view.frameNumber = frameNumber;
+            TrajectoryFrame frame;
+            {
+                std::lock_guard<std::mutex> lock(this->m_rebuildMutex);
+                if (!this->RebuildFrame(frameNumber)) {
+                    return view;
+                }
+                frame = this->m_rebuiltFrame;
+            }
+
+            if (addStatic) {
+                this->AddStaticAgents(frameNumber, frame);
+            }
+
+            // Frames with attributes the table doesn't hold are sent in full
+            bool matches = false;
+            {
+                std::lock_guard<std::mutex> lock(this->m_attributeMutex);
+                matches = this->m_attributes.Matches(frameNumber, frame);
+            }
+
+            if (!matches) {
+                return allowPacked
+                    ? this->GetPackedView(frameNumber, withStaticAgents)
+                    : this->GetFrameView(frameNumber, withStaticAgents);
+            }
+
+            auto encoded = std::make_shared<std::vector<float>>();
+            attributes::SerializeFrame(frame, *encoded);
+            view.encoding = FrameEncoding::Transforms;
+            view.data = (const char*)encoded->data();
+            view.size = encoded->size() * sizeof(float);
+            view.owner = encoded;
+            return view;
+        }
+
+        FrameView SimulariumBinaryFile::GetPyramidView(std::size_t level, std::size_t levelFrame, const StreamOptions& options)
+        {
+            SimulariumBinaryFile* levelFile = this->m_pyramid[level - 1].get();
+            std::size_t frameNumber = levelFrame << level;
+
+            // Level frames hold the static agents, which
+            //  are taken out for clients that hold the layer
+            FrameView view;
+            if (options.omitStaticAgents && this->HasStaticAgents(frameNumber)) {
+                TrajectoryFrame frame;
+                FrameView stored = levelFile->GetFrameView(levelFrame, false);
+                if (!stored.data || !codec::ParseFrame(stored.data, stored.size, frame)) {
+                    LOG_F(ERROR, "Failed to read frame %zu of pyramid level %zu", levelFrame, level);
+                    return FrameView();
+                }
+
+                this->RemoveStaticAgents(frameNumber, frame);
+                auto serialized = std::make_shared<std::vector<float>>(codec::SerializeFrame(frame));
+                view.data = (const char*)serialized->data();
+                view.size = serialized->size() * sizeof(float);
+                view.owner = serialized;
+            } else if (options.allowColumnar) {
+                view = levelFile->GetColumnarView(levelFrame, false);
+            } else if (options.allowPacked) {
+                view = levelFile->GetPackedView(levelFrame, false);
+            } else {
+                view = levelFile->GetFrameView(levelFrame, false);
+            }
+
+            view.frameNumber = frameNumber;
+            return view;
+        }
+
+        BroadcastUpdate SimulariumBinaryFile::GetPyramidUpdate(
+            std::size_t level,
+            std::size_t currentPos,
+            std::size_t bufferSize,
+            const StreamOptions& options)
+        {
+            // Level frames past the frames of this file are
+            //  still held back by the static agent detection
+            std::size_t numFrames = this->NumSavedFrames();
+            std::size_t step = std::size_t(1) << level;
+            std::size_t numLevelFrames = std::min(
+                this->m_pyramid[level - 1]->NumSavedFrames(),
+                (numFrames + step - 1) >> level);
+
+            BroadcastUpdate out;
+            out.new_pos = currentPos;
+
+            std::size_t totalSize = 0;
+            for (std::size_t levelFrame = (currentPos + step - 1) >> level; levelFrame < numLevelFrames; ++levelFrame) {
+                FrameView view = this->GetPyramidView(level, levelFrame, options);
+                if (!view.data) {
+                    break;
+                }
+
+                std::size_t chunkSize = view.size + binary::EOF_SIZE;
+                if (totalSize > 0 && totalSize + chunkSize > bufferSize) {
+                    break;
+                }
+
+                out.frames.push_back(view);
+                totalSize += chunkSize;
+                out.new_pos = std::min((levelFrame + 1) << level, numFrames);
+            }
+
+            return out;
+        }
+
+        std::size_t SimulariumBinaryFile::GetPyramidLevel(std::size_t frameStride)
+        {
+            // The coarsest level whose step doesn't exceed the stride
+            std::size_t level = 0;
+            while (level < this->m_pyramid.size() && (std::size_t(2) << level) <= frameStride) {
+                level++;
+            }
+
+            return level;
+        }
+
+        FrameView SimulariumBinaryFile::Decompress(const FrameView& stored)
+        {
+            FrameView view;
+            view.frameNumber = stored.frameNumber;
+            view.encoding = stored.encoding;
+
+            auto decoded = std::make_shared<std::vector<char>>();
+            if (!compression::Decompress(stored.data, stored.size, this->m_compression.numThreads, *decoded)) {
+                LOG_F(ERROR, "Failed to decompress frame %zu", stored.frameNumber);
+                return view;
+            }
+
+            view.data = decoded->data();
+            view.size = decoded->size();
+            view.owner = decoded;
+            return view;
+        }
+
+        bool SimulariumBinaryFile::RebuildFrame(std::size_t frameNumber)
+        {
+            // Continue from the last rebuilt frame if it is part of the
+            //  same run of deltas, otherwise start from the keyframe
+            std::size_t keyframe = frameNumber;
+            while (keyframe > 0 && (this->m_toc[keyframe].flags & binary::FRAME_FLAG_DELTA)) {
+                keyframe--;
+            }
+
+            std::size_t next = keyframe + 1;
+            if (this->m_hasRebuiltFrame
+                && this->m_rebuiltFrameNumber >= keyframe
+                && this->m_rebuiltFrameNumber <= frameNumber) {
+                next = this->m_rebuiltFrameNumber + 1;
+            } else {
+                this->m_hasRebuiltFrame = false;
+                auto chunk = this->GetStoredChunk(keyframe);
+                if (chunk.encoding == FrameEncoding::Delta || !chunk.data
+                    || !this->ParseKeyframe(chunk, this->m_toc[keyframe].flags, this->m_rebuiltFrame)) {
+                    LOG_F(ERROR, "Failed to read keyframe %zu", keyframe);
+                    return false;
+                }
+            }
+
+            for (; next <= frameNumber; ++next) {
+                auto chunk = this->GetStoredChunk(next);
+                if (!chunk.data || !this->ApplyDelta(chunk, this->m_toc[next].flags, this->m_rebuiltFrame)) {
+                    LOG_F(ERROR, "Failed to apply delta for frame %zu", next);
+                    this->m_hasRebuiltFrame = false;
+                    return false;
+                }
+            }
+
+            this->m_rebuiltFrameNumber = frameNumber;
+            this->m_hasRebuiltFrame = true;
+            return true;
+        }
+
+        bool SimulariumBinaryFile::ParseKeyframe(
+            const FrameView& chunk,
+            std::uint32_t flags,
+            TrajectoryFrame& frame)
+        {
+            // Fibers are restored once the rest of the frame is parsed
+            if (flags & binary::FRAME_FLAG_FIBERS) {
+                FrameView body = chunk;
+                return fiber::SplitChunk(chunk.data, chunk.size, body.size)
+                    && this->ParseKeyframe(body, flags & ~binary::FRAME_FLAG_FIBERS, frame)
+                    && fiber::DecodeFibers(chunk.data + body.size, chunk.size - body.size, frame);
+            }
+
+            if (flags & binary::FRAME_FLAG_QUANTIZED) {
+                return quantization::DecodeFrame(chunk.data, chunk.size, frame);
+            }
+
+            if (flags & binary::FRAME_FLAG_COLUMNAR) {
+                columnar::ColumnarFrame columns;
+                if (!columnar::Decode(chunk.data, chunk.size, columns)) {
+                    return false;
+                }
+
+                frame = columnar::FromColumnar(columns);
+                return true;
+            }
+
+            if (flags & binary::FRAME_FLAG_PACKED) {
+                return packed::Decode(chunk.data, chunk.size, frame);
+            }
+
+            if (flags & binary::FRAME_FLAG_ATTRIBUTES) {
+                std::lock_guard<std::mutex> lock(this->m_attributeMutex);
+                return attributes::ParseFrame(chunk.data, chunk.size, frame)
+                    && this->m_attributes.Apply(chunk.frameNumber, frame);
+            }
+
+            return codec::ParseFrame(chunk.data, chunk.size, frame);
+        }
+
+        bool SimulariumBinaryFile::ApplyDelta(
+            const FrameView& chunk,
+            std::uint32_t flags,
+            TrajectoryFrame& frame)
+        {
+            if (flags & binary::FRAME_FLAG_FIBERS) {
+                std::size_t bodySize = 0;
+                return fiber::SplitChunk(chunk.data, chunk.size, bodySize)
+                    && codec::ApplyDelta(chunk.data, bodySize, frame)
+                    && fiber::DecodeFibers(chunk.data + bodySize, chunk.size - bodySize, frame);
+            }
+
+            return codec::ApplyDelta(chunk.data, chunk.size, frame);
+        }
+
+        bool SimulariumBinaryFile::FindFrameForTime(double time, std::size_t& frameNumber)
+        {
+            std::size_t numFrames = std::min(this->m_index.Size(), this->m_toc.Size());
+            if (numFrames == 0) {
+                return false;
+            }
+
+            frameNumber = this->m_index.FindFrameForTime(time, numFrames);
+            return true;
+        }
+
+        bool SimulariumBinaryFile::GetFrameStats(std::size_t frameNumber, FrameStats& stats)
+        {
+            if (frameNumber >= std::min(this->m_index.Size(), this->m_toc.Size())) {
+                return false;
+            }
+
+            stats = this->m_index[frameNumber];
+            return true;
+        }
+
+        std::size_t SimulariumBinaryFile::NumSavedFrames()
+        {
+            return std::min(this->m_toc.Size(), this->m_numReadableFrames.load());
         }
 
         BroadcastUpdate SimulariumBinaryFile::GetBroadcastFrame(
-            std::size_t frameNumber)
+            std::size_t frameNumber,
+            StreamOptions options)
         {
             auto numFrames = this->NumSavedFrames();
             if (frameNumber >= numFrames) {
@@ -147,66 +1388,123 @@ namespace simularium {
                 return BroadcastUpdate();
             }
 
-            bool isLastFrame = (frameNumber == (numFrames - 1));
+            // Frames are snapped to the nearest frame the level holds
+            std::size_t level = this->GetPyramidLevel(options.frameStride);
+            std::size_t step = std::size_t(1) << level;
+            std::size_t numLevelFrames = level > 0
+                ? std::min(this->m_pyramid[level - 1]->NumSavedFrames(), (numFrames + step - 1) >> level)
+                : 0;
+            if (numLevelFrames > 0) {
+                std::size_t levelFrame = std::min((frameNumber + step / 2) >> level, numLevelFrames - 1);
 
-            // Get the stored offset for the frame from the 'table of contents' block
-            int tocPos = fileio::binary::TOC_ENTRY_START_OFFSET + frameNumber * 4;
-            this->m_fstream.seekg(tocPos, std::ios_base::beg);
-            int frameStart;
-            this->m_fstream.read((char*)&frameStart, sizeof(frameStart));
+                BroadcastUpdate out;
+                auto view = this->GetPyramidView(level, levelFrame, options);
+                if (view.data) {
+                    out.frames.push_back(view);
+                }
 
-            int frameEnd; // start of the next frame
-            if (isLastFrame) {
-                frameEnd = this->GetEndOfFilePos(); // if yes, read to end of file
-            } else {
-                this->m_fstream.seekg(tocPos + 4, std::ios_base::beg);
-                this->m_fstream.read((char*)&frameEnd, sizeof(frameEnd));
+                out.new_pos = std::min((levelFrame + 1) << level, numFrames);
+                return out;
             }
 
-            this->m_fstream.seekg(frameStart, std::ios_base::beg);
-
             BroadcastUpdate out;
-            out.buffer.resize((frameEnd - frameStart) / 4);
-            this->m_fstream.read(
-                reinterpret_cast<char*>(out.buffer.data()), out.buffer.size() * sizeof(out.buffer[0]));
+            auto view = options.omitAttributes
+                ? this->GetTransformsView(frameNumber, !options.omitStaticAgents, false)
+                : this->GetFrameView(frameNumber, !options.omitStaticAgents);
+            if (view.data) {
+                out.frames.push_back(view);
+            }
 
-            out.new_pos = frameEnd;
+            out.new_pos = frameNumber + 1;
 
             return out;
         }
 
         BroadcastUpdate SimulariumBinaryFile::GetBroadcastUpdate(
             std::size_t currentPos,
-            std::size_t bufferSize)
+            std::size_t bufferSize,
+            StreamOptions options)
         {
-            auto start = std::max(currentPos, this->m_endTOC);
-            this->m_fstream.seekg(start, std::ios_base::beg);
+            auto numFrames = this->NumSavedFrames();
+
+            // Strided reads come from a pyramid level, until it runs out of frames
+            std::size_t level = this->GetPyramidLevel(options.frameStride);
+            if (level > 0) {
+                BroadcastUpdate strided = this->GetPyramidUpdate(level, currentPos, bufferSize, options);
+                if (!strided.frames.empty()) {
+                    return strided;
+                }
+            }
 
             BroadcastUpdate out;
-            out.buffer.resize(bufferSize / 4);
-            this->m_fstream.read(
-                reinterpret_cast<char*>(out.buffer.data()), out.buffer.size() * sizeof(out.buffer[0]));
+            out.new_pos = currentPos;
 
-            out.new_pos = start + bufferSize;
+            // Send whole frames only, always at least one
+            //  the size check uses the decoded size, which for compressed
+            //  frames is only known once the frame has been decoded
+            std::size_t frame = currentPos;
+            std::size_t totalSize = 0;
+            bool withStatic = !options.omitStaticAgents;
+            bool hasStaticLayer = this->NumStaticAgents() > 0;
+            while (frame < numFrames) {
+                const binary::TocEntry& entry = this->m_toc[frame];
+                bool isEncoded = entry.flags != 0 || options.allowColumnar || options.allowPacked
+                    || options.omitAttributes || (withStatic && hasStaticLayer);
+                if (!isEncoded && totalSize > 0 && totalSize + entry.size + binary::EOF_SIZE > bufferSize) {
+                    break;
+                }
+
+                // A stored delta can be sent as-is once the client holds
+                //  the frame before it; deltas with a fiber section are rebuilt,
+                //  and so are deltas for clients that get static agents in every frame
+                bool clientHasPrevious = frame > currentPos || options.hasPreviousFrame;
+                bool sendDelta = options.allowDeltas && clientHasPrevious
+                    && (entry.flags & binary::FRAME_FLAG_DELTA) && !(entry.flags & binary::FRAME_FLAG_FIBERS)
+                    && !(withStatic && hasStaticLayer);
+
+                FrameView view;
+                if (sendDelta) {
+                    view = this->GetStoredChunk(frame);
+                } else if (options.allowColumnar) {
+                    view = this->GetColumnarView(frame, withStatic);
+                } else if (options.omitAttributes) {
+                    view = this->GetTransformsView(frame, withStatic, options.allowPacked);
+                } else if (options.allowPacked) {
+                    view = this->GetPackedView(frame, withStatic);
+                } else {
+                    view = this->GetFrameView(frame, withStatic);
+                }
+                if (!view.data) {
+                    break;
+                }
+
+                std::size_t chunkSize = view.size + binary::EOF_SIZE;
+                if (totalSize > 0 && totalSize + chunkSize > bufferSize) {
+                    break;
+                }
+
+                out.frames.push_back(view);
+                totalSize += chunkSize;
+                out.new_pos = ++frame;
+            }
+
+            // Start paging in the next update while this one is sent
+            if (this->m_mapping && frame < numFrames) {
+                this->m_mapping->AdviseWillNeed(this->m_toc[frame].offset, bufferSize);
+            }
 
             return out;
         }
 
-        std::size_t SimulariumBinaryFile::GetEndOfFilePos()
+        std::size_t SimulariumBinaryFile::GetEndOfStreamPos()
         {
-            this->m_fstream.seekg(0, std::ios_base::end);
-            return std::size_t(this->m_fstream.tellg());
+            return this->NumSavedFrames();
         }
 
         std::size_t SimulariumBinaryFile::GetFramePos(
             std::size_t frameNumber)
         {
-            int tocPos = fileio::binary::TOC_ENTRY_START_OFFSET + frameNumber * 4;
-            this->m_fstream.seekg(tocPos, std::ios_base::beg);
-            int framePos;
-            this->m_fstream.read((char*)&framePos, sizeof(framePos));
-
-            return framePos;
+            return frameNumber;
         }
 
     } // namespace fileio
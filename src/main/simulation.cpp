@@ -53,20 +53,23 @@ namespace simularium {
 
     BroadcastUpdate Simulation::GetBroadcastFrame(
         std::string identifier,
-        std::size_t frame_no)
+        std::size_t frame_no,
+        StreamOptions options)
     {
-        return this->m_cache.GetBroadcastFrame(identifier, frame_no);
+        return this->m_cache.GetBroadcastFrame(identifier, frame_no, options);
     }
 
     BroadcastUpdate Simulation::GetBroadcastUpdate(
         std::string identifier,
         std::size_t currentPosition,
-        std::size_t bufferSize)
+        std::size_t bufferSize,
+        StreamOptions options)
     {
         return this->m_cache.GetBroadcastUpdate(
             identifier,
             currentPosition,
-            bufferSize);
+            bufferSize,
+            options);
     }
 
     std::size_t Simulation::GetEndOfStreamPos(
@@ -123,7 +126,14 @@ namespace simularium {
 
     bool Simulation::HasLoadedAllFrames()
     {
-        return this->m_SimPkgs[this->m_activeSimPkg]->IsFinished();
+        if (!this->m_SimPkgs[this->m_activeSimPkg]->IsFinished()) {
+            return false;
+        }
+
+        // Frames before the ones converted last are left out if the
+        //  conversion was moved ahead by SeekConversion
+        return !this->m_canSeek
+            || this->m_cache.GetNextMissingFrame(this->m_simIdentifier, 0) >= this->GetNumFrames(this->m_simIdentifier);
     }
 
     void Simulation::LoadNextFrame()
@@ -132,10 +142,19 @@ namespace simularium {
         //  file loading
         //  Assumption: Only 1 SimPKG is needed in the use case
         auto simPkg = this->m_SimPkgs[this->m_activeSimPkg];
+
+        // Frames from the write position on may have been filled out
+        //  of order, conversion picks up at the next ones missing
+        std::size_t writePos = this->m_cache.GetWritePosition(this->m_simIdentifier);
+        if (simPkg->IsFinished() || this->m_cache.HasFrame(this->m_simIdentifier, writePos)) {
+            std::size_t from = simPkg->IsFinished() ? 0 : writePos;
+            this->SeekConversion(this->m_cache.GetNextMissingFrame(this->m_simIdentifier, from));
+        }
+
         if (!simPkg->IsFinished()) {
             simPkg->GetNextFrame(this->m_agents);
 
-            auto frameNumber = this->GetNumFrames(this->m_simIdentifier);
+            auto frameNumber = this->m_cache.GetWritePosition(this->m_simIdentifier);
             auto time = simPkg->GetSimulationTimeAtFrame(frameNumber);
             this->CacheAgents(this->m_agents, frameNumber, time);
         }
@@ -189,6 +208,7 @@ namespace simularium {
                 simPkg->LoadTrajectoryFile(filePath, tfp);
                 this->m_cache.SetFileProperties(fileName, tfp);
                 this->m_simIdentifier = fileName;
+                this->m_canSeek = true;
                 return true;
             }
         }
@@ -197,6 +217,45 @@ namespace simularium {
         return false;
     }
 
+    bool Simulation::ResumeConversion()
+    {
+        std::size_t numFrames = this->m_cache.ResumeConversion(this->m_simIdentifier);
+        if (numFrames == 0) {
+            return false;
+        }
+
+        auto simPkg = this->m_SimPkgs[this->m_activeSimPkg];
+        if (simPkg->ResumeAtFrame(numFrames)) {
+            LOG_F(INFO, "[%s] Resuming conversion at frame %zu", this->m_simIdentifier.c_str(), numFrames);
+            return true;
+        }
+
+        // The partial cache is dropped, keeping the properties of the loaded file
+        LOG_F(WARNING, "[%s] Can't resume conversion at frame %zu, starting over", this->m_simIdentifier.c_str(), numFrames);
+        TrajectoryFileProperties tfp = this->m_cache.GetFileProperties(this->m_simIdentifier);
+        this->m_cache.ClearCache(this->m_simIdentifier);
+        this->m_cache.SetFileProperties(this->m_simIdentifier, tfp);
+        return false;
+    }
+
+    bool Simulation::SeekConversion(std::size_t frameNumber)
+    {
+        std::size_t fillPos = this->m_cache.GetFillPosition(this->m_simIdentifier, frameNumber);
+        if (fillPos == this->m_cache.GetWritePosition(this->m_simIdentifier)) {
+            return true;
+        }
+
+        auto simPkg = this->m_SimPkgs[this->m_activeSimPkg];
+        if (!this->m_canSeek || !simPkg->ResumeAtFrame(fillPos)) {
+            LOG_F(WARNING, "[%s] Can't move conversion to frame %zu", this->m_simIdentifier.c_str(), fillPos);
+            this->m_canSeek = false;
+            return false;
+        }
+
+        LOG_F(INFO, "[%s] Moving conversion to frame %zu", this->m_simIdentifier.c_str(), fillPos);
+        return this->m_cache.SetWritePosition(this->m_simIdentifier, fillPos);
+    }
+
     void Simulation::CleanupTmpFiles(std::string identifier)
     {
         this->m_cache.DeleteTmpFiles(identifier);
@@ -272,6 +331,12 @@ namespace simularium {
             return frameNumber;
         }
 
+        // Cached frames know their exact time
+        fileio::FrameStats stats;
+        if (this->m_cache.GetFrameStats(identifier, frameNumber, stats)) {
+            return stats.time;
+        }
+
         if (frameNumber == 0) {
             return 0;
         } // Assumption: the first frame is at 0
@@ -314,6 +379,16 @@ namespace simularium {
 
         auto tfp = this->GetFileProperties(identifier);
 
+        // Search the times of the cached frames, unless the time
+        //  may belong to a frame that has not been cached yet
+        std::size_t cachedFrame = 0;
+        if (this->m_cache.FindFrameForTime(identifier, simulationTimeNs, cachedFrame)) {
+            std::size_t numCachedFrames = this->m_cache.GetNumFrames(identifier);
+            if (cachedFrame + 1 < numCachedFrames || numCachedFrames >= tfp.numberOfFrames) {
+                return cachedFrame;
+            }
+        }
+
         // If there is cached meta-data for the simulation,
         //  assume we are running using a cache pulled down from the network
         if (tfp.numberOfFrames != 0) {
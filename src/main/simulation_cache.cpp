@@ -1,14 +1,17 @@
 #include "simularium/simulation_cache.h"
 #include "loguru/loguru.hpp"
-#include "simularium/aws/aws_util.h"
 #include "simularium/config/config.h"
 #include "simularium/fileio/parse_traj_info.h"
 #include "simularium/fileio/simularium_file_reader.h"
 #include "simularium/network/tfp_to_json.h"
+#include "simularium/storage/storage_backend.h"
 #include <algorithm>
 #include <csignal>
 #include <cstdio>
+#include <ctime>
+#include <dirent.h>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <iterator>
 #include <json/json.h>
@@ -40,87 +43,378 @@ namespace simularium {
         int ignore = system(cmd.c_str());
     }
 
+    // Regular files in the cache folder
+    inline std::vector<std::string> ListCacheFolder()
+    {
+        std::vector<std::string> files;
+        std::string folder = config::GetCacheFolder();
+        DIR* dir = opendir(folder.c_str());
+        if (!dir) {
+            return files;
+        }
+
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            struct stat info;
+            if (stat((folder + name).c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+                files.push_back(name);
+            }
+        }
+        closedir(dir);
+
+        return files;
+    }
+
+    // The files of a trajectory are named [identifier] or [identifier].*
+    inline bool IsFileOf(const std::string& name, const std::string& identifier)
+    {
+        return name == identifier || name.compare(0, identifier.size() + 1, identifier + ".") == 0;
+    }
+
+    // Identifiers of the trajectories with a conversion checkpoint ([identifier].ckpt)
+    inline std::vector<std::string> GetCheckpointedIdentifiers()
+    {
+        static const std::string kCheckpointSuffix = ".ckpt";
+        std::vector<std::string> checkpointed;
+        for (auto& name : ListCacheFolder()) {
+            if (name.size() > kCheckpointSuffix.size()
+                && name.compare(name.size() - kCheckpointSuffix.size(), kCheckpointSuffix.size(), kCheckpointSuffix) == 0) {
+                checkpointed.push_back(name.substr(0, name.size() - kCheckpointSuffix.size()));
+            }
+        }
+
+        return checkpointed;
+    }
+
+    /**
+     *   DeleteFilesExcept
+     *
+     *   Deletes the files of the cache folder, except for those of the
+     *   identifiers that are kept
+     */
+    inline void DeleteFilesExcept(const std::vector<std::string>& kept)
+    {
+        std::string folder = config::GetCacheFolder();
+        for (auto& name : ListCacheFolder()) {
+            bool keep = std::any_of(kept.begin(), kept.end(), [&name](const std::string& identifier) {
+                return IsFileOf(name, identifier);
+            });
+            if (keep) {
+                LOG_F(INFO, "Keeping %s", name.c_str());
+            } else {
+                std::remove((folder + name).c_str());
+            }
+        }
+    }
+
+    // Interrupted conversions are only kept if they can be resumed
+    inline void ClearCacheFolder()
+    {
+        if (config::GetCacheCheckpointInterval() > 0) {
+            DeleteFilesExcept(GetCheckpointedIdentifiers());
+        } else {
+            DeleteCacheFolder();
+        }
+    }
+
+    // Whether a cache is evicted before another: the least recently read,
+    //  or by frequency, the least often loaded, then least recently read
+    inline bool IsLessValuable(const CacheUsage& a, const CacheUsage& b, bool byFrequency)
+    {
+        if (byFrequency && a.accessCount != b.accessCount) {
+            return a.accessCount < b.accessCount;
+        }
+
+        return a.lastAccess < b.lastAccess;
+    }
+
+    inline std::string GetBinaryFormatVersion()
+    {
+        return std::to_string(fileio::binary::MAJOR_VERSION) + "."
+            + std::to_string(fileio::binary::MINOR_VERSION) + "."
+            + std::to_string(fileio::binary::PATCH_VERSION);
+    }
+
     SimulationCache::SimulationCache()
+        : m_storage(storage::CreateStorageBackend())
+        , m_frameCache(config::GetFrameCacheSize())
     {
-        DeleteCacheFolder();
+        if (config::GetCachePersistent()) {
+            CreateCacheFolder();
+            this->LoadWarmCaches();
+            this->EnforceDiskQuota("");
+            return;
+        }
+
+        ClearCacheFolder();
         CreateCacheFolder();
     }
 
     SimulationCache::~SimulationCache()
     {
-        DeleteCacheFolder();
+        std::vector<std::string> downloads;
+        {
+            std::lock_guard<std::mutex> lock(this->m_downloadsMutex);
+            for (auto& entry : this->m_downloads) {
+                downloads.push_back(entry.first);
+            }
+        }
+        for (auto& identifier : downloads) {
+            this->StopSegmentDownload(identifier);
+        }
+
+        // Closed first, so the sizes saved are those of the final files,
+        //  and nothing is flushed to a cache folder that was removed
+        {
+            std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+            this->m_binaryFiles.clear();
+        }
+
+        if (config::GetCachePersistent()) {
+            this->SaveWarmCaches();
+            return;
+        }
+
+        ClearCacheFolder();
     }
 
     void SimulationCache::AddFrame(std::string identifier, TrajectoryFrame frame)
     {
-        fileio::SimulariumBinaryFile* file = this->GetBinaryFile(identifier);
+        // Marked before it is opened, so the cache isn't closed or evicted
+        //  while frames are added to it. Strided frames are snapped to the
+        //  pyramid levels written so far, so those read before frames were
+        //  added may no longer be right
+        bool isFirstWrite = false;
+        {
+            std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+            isFirstWrite = this->m_writing.insert(identifier).second;
+        }
+        if (isFirstWrite) {
+            this->m_frameCache.Invalidate(identifier);
+        }
+
+        auto file = this->GetBinaryFile(identifier);
         file->WriteFrame(frame);
     }
 
-    BroadcastUpdate SimulationCache::GetBroadcastFrame(std::string identifier, std::size_t frameNumber)
+    BroadcastUpdate SimulationCache::GetBroadcastFrame(
+        std::string identifier,
+        std::size_t frameNumber,
+        StreamOptions options)
     {
-        if (!this->m_binaryFiles.count(identifier)) {
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
             LOG_F(ERROR, "Request for identifier %s, which is not in cache", identifier.c_str());
             return BroadcastUpdate();
         }
 
-        std::size_t numFrames = this->GetNumFrames(identifier);
-        if (frameNumber > numFrames || numFrames == 0) {
-            LOG_F(ERROR, "Request for frame %zu of identifier %s, which is not in cache", frameNumber, identifier.c_str());
-            return BroadcastUpdate();
+        this->RecordAccess(identifier, true);
+        this->RequestSegment(identifier, *file, frameNumber, true);
+        if (!this->HasFrame(identifier, frameNumber)) {
+            LOG_F(INFO, "Request for frame %zu of identifier %s, which is not available yet", frameNumber, identifier.c_str());
+            BroadcastUpdate out;
+            out.new_pos = frameNumber;
+            return out;
+        }
+
+        // A written frame doesn't change, but strided reads of a cache
+        //  that is still being written do
+        bool isWriting = false;
+        {
+            std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+            isWriting = this->m_writing.count(identifier) > 0;
+        }
+        if (isWriting && options.frameStride > 1) {
+            return file->GetBroadcastFrame(frameNumber, options);
         }
 
-        return this->m_binaryFiles.at(identifier)->GetBroadcastFrame(frameNumber);
+        return this->m_frameCache.GetOrLoad(identifier, frameNumber, options, [&]() {
+            return file->GetBroadcastFrame(frameNumber, options);
+        });
+    }
+
+    std::vector<char> SimulationCache::GetStaticLayer(std::string identifier)
+    {
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
+            LOG_F(ERROR, "Request for identifier %s, which is not in cache", identifier.c_str());
+            return std::vector<char>();
+        }
+
+        return file->GetStaticLayer();
+    }
+
+    std::vector<char> SimulationCache::GetAttributeRecords(
+        std::string identifier,
+        std::size_t begin,
+        std::size_t throughFrame)
+    {
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
+            LOG_F(ERROR, "Request for identifier %s, which is not in cache", identifier.c_str());
+            return std::vector<char>();
+        }
+
+        return file->GetAttributeRecords(begin, throughFrame);
     }
 
     BroadcastUpdate SimulationCache::GetBroadcastUpdate(
         std::string identifier,
         std::size_t currentPosition,
-        std::size_t bufferSize)
+        std::size_t bufferSize,
+        StreamOptions options)
     {
-        if (!this->m_binaryFiles.count(identifier)) {
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
             LOG_F(ERROR, "Request for identifier %s, which is not in cache", identifier.c_str());
             return BroadcastUpdate();
         }
 
-        return this->m_binaryFiles.at(identifier)->GetBroadcastUpdate(currentPosition, bufferSize);
+        this->RecordAccess(identifier, false);
+        this->RequestSegment(identifier, *file, currentPosition, false);
+        return file->GetBroadcastUpdate(currentPosition, bufferSize, options);
     }
 
     std::size_t SimulationCache::GetEndOfStreamPos(
         std::string identifier)
     {
-        if (!this->m_binaryFiles.count(identifier)) {
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
             LOG_F(ERROR, "Request for identifier %s, which is not in cache", identifier.c_str());
             return 0;
         }
 
-        return this->m_binaryFiles.at(identifier)->GetEndOfFilePos();
+        return file->GetEndOfStreamPos();
     }
 
     std::size_t SimulationCache::GetFramePos(
         std::string identifier,
         std::size_t frameNumber)
     {
-        if (!this->m_binaryFiles.count(identifier)) {
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
             LOG_F(ERROR, "Request for identifier %s, which is not in cache", identifier.c_str());
             return 0;
         }
 
-        return this->m_binaryFiles.at(identifier)->GetFramePos(frameNumber);
+        return file->GetFramePos(frameNumber);
     }
 
     std::size_t SimulationCache::GetNumFrames(std::string identifier)
     {
-        return this->m_binaryFiles.count(identifier) ? this->m_binaryFiles.at(identifier)->NumSavedFrames() : 0;
+        auto file = this->FindBinaryFile(identifier);
+        return file ? file->NumSavedFrames() : 0;
     }
 
-    void SimulationCache::ClearCache(std::string identifier)
+    bool SimulationCache::HasFrame(std::string identifier, std::size_t frameNumber)
+    {
+        auto file = this->FindBinaryFile(identifier);
+        return file && file->HasFrame(frameNumber);
+    }
+
+    std::vector<fileio::FrameRange> SimulationCache::GetAvailableFrames(std::string identifier)
+    {
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
+            return std::vector<fileio::FrameRange>();
+        }
+
+        return file->GetAvailableRanges();
+    }
+
+    std::size_t SimulationCache::GetNextMissingFrame(std::string identifier, std::size_t frameNumber)
+    {
+        for (auto& range : this->GetAvailableFrames(identifier)) {
+            if (range.begin <= frameNumber && frameNumber < range.end) {
+                return range.end;
+            }
+        }
+
+        return frameNumber;
+    }
+
+    std::size_t SimulationCache::GetWritePosition(std::string identifier)
+    {
+        return this->GetBinaryFile(identifier)->GetWritePosition();
+    }
+
+    bool SimulationCache::SetWritePosition(std::string identifier, std::size_t frameNumber)
+    {
+        return this->GetBinaryFile(identifier)->SetWritePosition(frameNumber);
+    }
+
+    std::size_t SimulationCache::GetFillPosition(std::string identifier, std::size_t frameNumber)
+    {
+        return this->GetBinaryFile(identifier)->GetFillPosition(frameNumber);
+    }
+
+    bool SimulationCache::FindFrameForTime(
+        std::string identifier,
+        double time,
+        std::size_t& frameNumber)
+    {
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
+            return false;
+        }
+
+        return file->FindFrameForTime(time, frameNumber);
+    }
+
+    bool SimulationCache::GetFrameStats(
+        std::string identifier,
+        std::size_t frameNumber,
+        fileio::FrameStats& stats)
     {
-        std::string filePath = this->GetLocalFilePath(identifier);
-        std::remove(filePath.c_str());
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
+            return false;
+        }
+
+        return file->GetFrameStats(frameNumber, stats);
+    }
 
-        this->m_binaryFiles.erase(identifier);
+    bool SimulationCache::ExportArrow(
+        std::string identifier,
+        std::string filePath,
+        std::size_t batchFrames)
+    {
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
+            LOG_F(ERROR, "Export of identifier %s, which is not in cache", identifier.c_str());
+            return false;
+        }
+
+        file->Flush();
+        return fileio::arrow::ExportCache(*file, filePath, batchFrames);
+    }
+
+    void SimulationCache::ClearCache(std::string identifier)
+    {
+        // Closed first, so nothing is written to the cache after it is removed
+        this->StopSegmentDownload(identifier);
+        {
+            std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+            this->m_binaryFiles.erase(identifier);
+            this->m_closedFiles.erase(identifier);
+            this->m_usage.erase(identifier);
+            this->m_writing.erase(identifier);
+        }
+        this->m_frameCache.Invalidate(identifier);
         this->m_fileProps.erase(identifier);
+
+        fileio::SegmentedBinaryFile::Remove(this->GetLocalFilePath(identifier));
+        std::string checkpointPath = this->GetLocalCheckpointFilePath(identifier);
+        std::remove(checkpointPath.c_str());
+
+        bool wasKept = false;
+        {
+            std::lock_guard<std::mutex> lock(this->m_warmCachesMutex);
+            wasKept = this->m_warmCaches.erase(identifier) > 0;
+        }
+        if (wasKept) {
+            this->SaveWarmCaches();
+        }
     }
 
     void SimulationCache::Preprocess(std::string identifier)
@@ -134,16 +428,46 @@ namespace simularium {
         bool isSimulariumFile = false;
         bool filesFound = true;
 
+        // A failed download can truncate the local file, which
+        //  would lose the frames of an interrupted conversion
+        if (FileExists(this->GetLocalCheckpointFilePath(identifier))) {
+            LOG_F(INFO, "Resuming the conversion of %s instead of downloading its cache", identifier.c_str());
+            return false;
+        }
+
         LOG_F(INFO, "Downloading runtime cache for file %s", awsFilePath.c_str());
         std::string ext = identifier.substr(identifier.find_last_of(".") + 1);
         if (ext == "simularium") {
             isSimulariumFile = true;
         }
 
-        // Otherwise, look for the binary cache file
-        std::string fpropsFilePath = this->GetS3InfoCachePath(identifier);
+        // The info file, the manifest of a segmented cache, and the cache
+        //  with its frame index are fetched at once; a segmented cache has
+        //  a manifest, its segments are fetched once the cache is opened.
+        //  A single file cache is fetched whole, or with ranged reads its
+        //  size is looked up, and its frames are fetched once it is opened
+        LOG_F(INFO, "Downloading cache for %s from S3", awsFilePath.c_str());
+        bool isRanged = config::GetCacheRangeBytes() > 0;
         std::string fpropsDestination = this->GetLocalInfoFilePath(identifier);
-        if (!aics::simularium::aws_util::Download(fpropsFilePath, fpropsDestination)) {
+        std::string destination = this->GetLocalFilePath(identifier);
+        std::string manifestDestination = fileio::segments::ManifestPath(destination);
+        std::string indexDestination = this->GetLocalIndexFilePath(identifier);
+        auto download = [this](std::string objectName, std::string fileDestination) {
+            return std::async(std::launch::async, [this, objectName, fileDestination]() {
+                return this->m_storage->Download(objectName, fileDestination);
+            });
+        };
+        auto fpropsDownload = download(this->GetS3InfoCachePath(identifier), fpropsDestination);
+        auto manifestDownload = download(fileio::segments::ManifestPath(awsFilePath), manifestDestination);
+        std::uint64_t cacheSize = 0;
+        auto cacheDownload = isRanged
+            ? std::async(std::launch::async, [this, awsFilePath, &cacheSize]() {
+                  return this->m_storage->GetSize(awsFilePath, cacheSize);
+              })
+            : download(awsFilePath, destination);
+        auto indexDownload = download(this->GetS3IndexCachePath(identifier), indexDestination);
+
+        if (!fpropsDownload.get()) {
             LOG_F(WARNING, "Info file for %s not found on AWS S3", awsFilePath.c_str());
             filesFound = false;
         } else if (!this->IsFilePropertiesValid(identifier)) {
@@ -151,16 +475,72 @@ namespace simularium {
             filesFound = false;
         }
 
-        LOG_F(INFO, "Downloading cache for %s from S3", awsFilePath.c_str());
-        std::string destination = this->GetLocalFilePath(identifier);
-        if (!aics::simularium::aws_util::Download(awsFilePath, destination)) {
+        bool isSegmented = manifestDownload.get();
+        bool isCacheFound = cacheDownload.get();
+        bool isIndexFound = indexDownload.get();
+        if (!isSegmented) {
+            std::remove(manifestDestination.c_str());
+        } else if (isCacheFound && !isRanged) {
+            std::remove(destination.c_str());
+        }
+
+        // Frames are only read as they are downloaded when there is a frame
+        //  index, a missing one is rebuilt by decoding every frame
+        bool isPartial = false;
+        if (!isSegmented && isCacheFound && isRanged) {
+            auto read = [this, awsFilePath](std::uint64_t offset, std::uint64_t size, std::vector<char>& out) {
+                return this->m_storage->DownloadRange(awsFilePath, offset, size, out);
+            };
+            isPartial = isIndexFound && fileio::SegmentedBinaryFile::CreatePartial(destination, read, cacheSize);
+            if (!isPartial) {
+                LOG_F(INFO, "Downloading the cache of %s whole", identifier.c_str());
+                isCacheFound = this->m_storage->Download(awsFilePath, destination);
+            }
+        }
+
+        if (!isSegmented && !isCacheFound) {
             LOG_F(WARNING, "Cache file for %s not found on AWS S3", identifier.c_str());
             filesFound = false;
         }
 
+        // The frame index is optional, a missing one is rebuilt when the cache is opened
+        if (isSegmented || !isIndexFound) {
+            std::remove(indexDestination.c_str());
+        }
+        if (filesFound && !isSegmented && !isIndexFound) {
+            LOG_F(INFO, "Frame index for %s not found on AWS S3", identifier.c_str());
+        }
+
+        // Pyramid levels are optional too, levels are fetched until one is missing
+        for (std::size_t level = 1; filesFound && !isSegmented && level <= fileio::binary::MAX_PYRAMID_LEVELS; ++level) {
+            std::string levelFilePath = this->GetS3PyramidCachePath(identifier, level);
+            std::string levelDestination = this->GetLocalPyramidFilePath(identifier, level);
+            if (!this->m_storage->Download(levelFilePath, levelDestination)) {
+                break;
+            }
+
+            this->m_storage->Download(
+                levelFilePath + fileio::binary::INDEX_FILE_SUFFIX,
+                levelDestination + fileio::binary::INDEX_FILE_SUFFIX);
+            LOG_F(INFO, "Downloaded pyramid level %zu for %s", level, identifier.c_str());
+        }
+
+        // Only the first segment, or range of frames, is waited for, the
+        //  others are downloaded while clients stream the frames that are there
+        if (filesFound && isSegmented) {
+            auto ignore = this->GetBinaryFile(identifier);
+            filesFound = this->DownloadSegments(identifier, 0, 1);
+        } else if (filesFound && isPartial) {
+            auto ignore = this->GetBinaryFile(identifier);
+            filesFound = this->DownloadFrames(identifier);
+        }
+
         // @HACK: called to add the file to the 'list'
         if (filesFound) {
             auto ignore = this->GetBinaryFile(identifier);
+            this->AddWarmCache(identifier, isSegmented ? fileio::segments::ManifestPath(awsFilePath) : awsFilePath);
+            this->EnforceDiskQuota(identifier);
+            this->StartSegmentDownload(identifier, 0);
         }
 
         return filesFound;
@@ -171,6 +551,7 @@ namespace simularium {
         std::string tmpkey = "tmp";
         std::string tmpFile = this->GetLocalFilePath(tmpkey);
         bool fileFound = false;
+        std::string foundPath;
 
         // try replacing the file extension with .simularium (e.g. test.h5 -> test.simularium)
         //  then try appending .simularium (e.g. test.h5 -> test.h5.simularium)
@@ -183,11 +564,12 @@ namespace simularium {
             if (!fileFound) {
                 std::string awsPath = this->GetS3TrajectoryPath(path);
 
-                if (!aics::simularium::aws_util::Download(awsPath, tmpFile)) {
+                if (!this->m_storage->Download(awsPath, tmpFile)) {
                     LOG_F(INFO, "Simularium file %s not found on AWS S3", awsPath.c_str());
                 } else {
                     LOG_F(INFO, "Simularium file %s found on AWS S3", awsPath.c_str());
                     fileFound = true;
+                    foundPath = awsPath;
                 }
             }
         }
@@ -211,7 +593,11 @@ namespace simularium {
 
         // Convert the simularium file to a binary cache file
         fileio::SimulariumFileReader simulariumFileReader;
-        fileio::SimulariumBinaryFile* outFile = this->GetBinaryFile(fileName);
+        auto outFile = this->GetBinaryFile(fileName);
+        {
+            std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+            this->m_writing.insert(fileName);
+        }
 
         Json::Value& spatialData = simJson["spatialData"];
         int nFrames = spatialData["bundleSize"].asInt();
@@ -224,6 +610,13 @@ namespace simularium {
                 LOG_F(ERROR, "Failed to deserialize frame from simularium JSON");
             }
         }
+        outFile->Flush();
+        {
+            std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+            this->m_writing.erase(fileName);
+        }
+        this->AddWarmCache(fileName, foundPath);
+        this->EnforceDiskQuota(fileName);
 
         std::remove(tmpFile.c_str());
 
@@ -238,7 +631,7 @@ namespace simularium {
         // Download the file from AWS if it is not present locally
         if (!FileExists(rawPath)) {
             LOG_F(INFO, "%s doesn't exist locally, checking S3...", fileName.c_str());
-            if (!aics::simularium::aws_util::Download(awsPath, rawPath)) {
+            if (!this->m_storage->Download(awsPath, rawPath)) {
                 LOG_F(WARNING, "%s not found on AWS S3", fileName.c_str());
                 return false;
             }
@@ -293,11 +686,25 @@ namespace simularium {
     {
         std::string awsFilePath = this->GetS3TrajectoryCachePath(identifier);
         this->WriteFilePropertiesToDisk(identifier);
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
+            LOG_F(ERROR, "Upload of identifier %s, which is not in cache", identifier.c_str());
+            return false;
+        }
+        file->Flush();
+
+        // Every file of the cache is stored under the same name in S3
+        std::string localPath = this->GetLocalFilePath(identifier);
+        std::vector<storage::FileTransfer> transfers;
+        for (auto& path : file->GetFilePaths()) {
+            storage::FileTransfer transfer;
+            transfer.fileName = path;
+            transfer.objectName = awsFilePath + path.substr(localPath.size());
+            transfers.push_back(transfer);
+        }
 
-        std::string destination = awsFilePath;
-        std::string source = this->GetLocalFilePath(identifier);
-        LOG_F(INFO, "Uploading cache file for %s to S3", identifier.c_str());
-        if (!aics::simularium::aws_util::Upload(source, destination)) {
+        LOG_F(INFO, "Uploading %zu cache files for %s to S3", transfers.size(), identifier.c_str());
+        if (!this->m_storage->UploadAll(transfers)) {
             return false;
         }
 
@@ -305,13 +712,636 @@ namespace simularium {
         std::string filePropsDest = this->GetS3InfoCachePath(identifier);
 
         LOG_F(INFO, "Uploading info file for %s to S3", identifier.c_str());
-        if (!aics::simularium::aws_util::Upload(filePropsPath, filePropsDest)) {
+        if (!this->m_storage->Upload(filePropsPath, filePropsDest)) {
             return false;
         }
 
         return true;
     }
 
+    bool SimulationCache::DownloadSegments(
+        std::string identifier,
+        std::size_t firstFrame,
+        std::size_t numFrames)
+    {
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
+            LOG_F(ERROR, "Request for identifier %s, which is not in cache", identifier.c_str());
+            return false;
+        }
+
+        if (!file->IsSegmented() || numFrames == 0) {
+            return true;
+        }
+
+        std::size_t segmentFrames = file->SegmentFrames();
+        std::size_t endSegment = std::min(
+            (firstFrame + numFrames + segmentFrames - 1) / segmentFrames,
+            file->NumSegments());
+
+        std::vector<std::size_t> segments;
+        for (std::size_t segment = firstFrame / segmentFrames; segment < endSegment; ++segment) {
+            segments.push_back(segment);
+        }
+
+        return this->DownloadSegmentFiles(identifier, segments);
+    }
+
+    bool SimulationCache::DownloadSegmentFiles(
+        std::string identifier,
+        const std::vector<std::size_t>& segmentNumbers)
+    {
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
+            LOG_F(ERROR, "Request for identifier %s, which is not in cache", identifier.c_str());
+            return false;
+        }
+
+        // Segments are downloaded next to where they go, and only moved
+        //  there once complete, so readers never open a partial segment
+        static const std::string kPartSuffix = ".part";
+        std::string localPath = this->GetLocalFilePath(identifier);
+        std::string awsPath = this->GetS3TrajectoryCachePath(identifier);
+
+        std::vector<storage::FileTransfer> segments;
+        std::vector<storage::FileTransfer> indices;
+        for (std::size_t segment : segmentNumbers) {
+            if (file->HasSegment(segment)) {
+                continue;
+            }
+
+            storage::FileTransfer transfer;
+            transfer.objectName = fileio::segments::SegmentPath(awsPath, segment);
+            transfer.fileName = fileio::segments::SegmentPath(localPath, segment) + kPartSuffix;
+            segments.push_back(transfer);
+
+            transfer.objectName += fileio::binary::INDEX_FILE_SUFFIX;
+            transfer.fileName = fileio::segments::SegmentPath(localPath, segment)
+                + fileio::binary::INDEX_FILE_SUFFIX + kPartSuffix;
+            indices.push_back(transfer);
+        }
+
+        if (segments.empty()) {
+            return true;
+        }
+
+        auto moveInPlace = [](std::vector<storage::FileTransfer>& transfers, bool success) {
+            for (auto& transfer : transfers) {
+                std::string target = transfer.fileName.substr(0, transfer.fileName.size() - kPartSuffix.size());
+                if (!success || std::rename(transfer.fileName.c_str(), target.c_str()) != 0) {
+                    std::remove(transfer.fileName.c_str());
+                }
+            }
+        };
+
+        // Frame indices are optional, missing ones are rebuilt when a segment is opened
+        LOG_F(INFO, "Downloading %zu segments of %s from S3", segments.size(), identifier.c_str());
+        moveInPlace(indices, this->m_storage->DownloadAll(indices));
+
+        bool success = this->m_storage->DownloadAll(segments);
+        if (!success) {
+            LOG_F(WARNING, "Segments of %s not found on AWS S3", identifier.c_str());
+        }
+        moveInPlace(segments, success);
+
+        return success;
+    }
+
+    bool SimulationCache::DownloadFrames(std::string identifier)
+    {
+        auto file = this->FindBinaryFile(identifier);
+        if (!file) {
+            LOG_F(ERROR, "Request for identifier %s, which is not in cache", identifier.c_str());
+            return false;
+        }
+
+        std::uint64_t offset = 0;
+        std::uint64_t size = 0;
+        std::size_t endFrame = 0;
+        if (!file->GetMissingRange(config::GetCacheRangeBytes(), offset, size, endFrame)) {
+            return true;
+        }
+
+        std::vector<char> data;
+        if (!this->m_storage->DownloadRange(this->GetS3TrajectoryCachePath(identifier), offset, size, data)
+            || !file->AddDownloadedFrames(offset, data, endFrame)) {
+            LOG_F(WARNING, "Frames of %s up to %zu could not be downloaded", identifier.c_str(), endFrame);
+            return false;
+        }
+
+        return true;
+    }
+
+    void SimulationCache::StartSegmentDownload(std::string identifier, std::size_t frameNumber)
+    {
+        std::lock_guard<std::mutex> lock(this->m_downloadsMutex);
+        auto found = this->m_downloads.find(identifier);
+        if (found != this->m_downloads.end()) {
+            if (!found->second->isFinished) {
+                found->second->nextFrame = frameNumber;
+                return;
+            }
+
+            found->second->thread.join();
+            this->m_downloads.erase(found);
+        }
+
+        auto file = this->FindBinaryFile(identifier);
+        bool isMissing = file
+            && (file->IsSegmented() ? this->GetNextMissingSegment(*file, frameNumber) < file->NumSegments() : file->IsPartial());
+        if (!isMissing) {
+            return;
+        }
+
+        std::unique_ptr<SegmentDownload> download(new SegmentDownload());
+        download->nextFrame = frameNumber;
+        SegmentDownload* state = download.get();
+        download->thread = std::thread([this, identifier, state]() {
+            // Segments are fetched a batch at a time, from the frame clients
+            //  asked for last on, then the ones before it
+            std::size_t batchSize = std::max(config::GetCachePrefetchSegments(), std::size_t(1));
+            while (!state->isStopping) {
+                auto file = this->FindBinaryFile(identifier);
+                if (!file) {
+                    break;
+                }
+
+                // Frames of a single file cache are in playback order already
+                if (!file->IsSegmented()) {
+                    if (!file->IsPartial()) {
+                        LOG_F(INFO, "Downloaded every frame of %s", identifier.c_str());
+                        break;
+                    }
+                    if (!this->DownloadFrames(identifier)) {
+                        LOG_F(WARNING, "Stopped downloading the frames of %s", identifier.c_str());
+                        break;
+                    }
+                    continue;
+                }
+
+                std::vector<std::size_t> batch;
+                std::size_t numSegments = file->NumSegments();
+                std::size_t start = std::min(state->nextFrame / file->SegmentFrames(), numSegments);
+                for (std::size_t i = 0; i < numSegments && batch.size() < batchSize; ++i) {
+                    std::size_t segment = (start + i) % numSegments;
+                    if (!file->HasSegment(segment)) {
+                        batch.push_back(segment);
+                    }
+                }
+
+                if (batch.empty()) {
+                    LOG_F(INFO, "Downloaded every segment of %s", identifier.c_str());
+                    break;
+                }
+                if (!this->DownloadSegmentFiles(identifier, batch)) {
+                    LOG_F(WARNING, "Stopped downloading the segments of %s", identifier.c_str());
+                    break;
+                }
+            }
+
+            state->isFinished = true;
+        });
+
+        this->m_downloads[identifier] = std::move(download);
+    }
+
+    void SimulationCache::StopSegmentDownload(std::string identifier)
+    {
+        std::unique_ptr<SegmentDownload> download;
+        {
+            std::lock_guard<std::mutex> lock(this->m_downloadsMutex);
+            auto found = this->m_downloads.find(identifier);
+            if (found == this->m_downloads.end()) {
+                return;
+            }
+
+            download = std::move(found->second);
+            this->m_downloads.erase(found);
+        }
+
+        // The batch being downloaded is finished first
+        download->isStopping = true;
+        download->thread.join();
+    }
+
+    std::size_t SimulationCache::GetNextMissingSegment(fileio::SegmentedBinaryFile& file, std::size_t frameNumber)
+    {
+        std::size_t numSegments = file.NumSegments();
+        std::size_t start = std::min(frameNumber / std::max(file.SegmentFrames(), std::size_t(1)), numSegments);
+        for (std::size_t i = 0; i < numSegments; ++i) {
+            std::size_t segment = (start + i) % numSegments;
+            if (!file.HasSegment(segment)) {
+                return segment;
+            }
+        }
+
+        return numSegments;
+    }
+
+    void SimulationCache::RequestSegment(
+        std::string identifier,
+        fileio::SegmentedBinaryFile& file,
+        std::size_t frameNumber,
+        bool isSeek)
+    {
+        if (!file.IsSegmented()) {
+            return;
+        }
+
+        // Seeks move the download to where the client is, playback only
+        //  when it runs into a segment that isn't there yet
+        bool isMissing = !file.HasSegment(std::min(frameNumber / file.SegmentFrames(), file.NumSegments()));
+        if (isSeek || isMissing) {
+            std::lock_guard<std::mutex> lock(this->m_downloadsMutex);
+            auto found = this->m_downloads.find(identifier);
+            if (found != this->m_downloads.end() && !found->second->isFinished) {
+                found->second->nextFrame = frameNumber;
+            }
+        }
+    }
+
+    std::size_t SimulationCache::ResumeConversion(std::string identifier)
+    {
+        std::ifstream is(this->GetLocalCheckpointFilePath(identifier));
+        Json::Value checkpoint;
+        if (!is.is_open() || !(is >> checkpoint) || !fileio::SegmentedBinaryFile::Exists(this->GetLocalFilePath(identifier))) {
+            return 0;
+        }
+
+        // Frames flushed after the checkpoint was written are on disk too;
+        //  segments filled out of order may have left frames before them out
+        auto file = this->GetBinaryFile(identifier);
+        std::size_t numFrames = this->GetNextMissingFrame(identifier, 0);
+        file->SetWritePosition(numFrames);
+        LOG_F(INFO, "Checkpoint for %s at frame %u, %zu frames in the cache, the first missing is %zu",
+            identifier.c_str(), checkpoint["numFrames"].asUInt(), file->NumSavedFrames(), numFrames);
+        return numFrames;
+    }
+
+    void SimulationCache::CheckpointConversion(std::string identifier)
+    {
+        std::size_t numFrames = this->GetBinaryFile(identifier)->Checkpoint();
+
+        // Written next to the checkpoint, then moved over it, so a
+        //  checkpoint is never read while it is half written
+        Json::Value checkpoint;
+        checkpoint["fileName"] = identifier;
+        checkpoint["numFrames"] = Json::UInt64(numFrames);
+
+        std::string checkpointPath = this->GetLocalCheckpointFilePath(identifier);
+        std::string tmpPath = checkpointPath + ".tmp";
+        {
+            std::ofstream os(tmpPath);
+            os << checkpoint;
+            if (!os) {
+                LOG_F(ERROR, "Failed to write conversion checkpoint %s", tmpPath.c_str());
+                return;
+            }
+        }
+
+        if (std::rename(tmpPath.c_str(), checkpointPath.c_str()) != 0) {
+            LOG_F(ERROR, "Failed to write conversion checkpoint %s", checkpointPath.c_str());
+        }
+    }
+
+    void SimulationCache::FinishConversion(std::string identifier)
+    {
+        auto file = this->FindBinaryFile(identifier);
+        if (file) {
+            file->Flush();
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+            this->m_writing.erase(identifier);
+        }
+
+        std::string checkpointPath = this->GetLocalCheckpointFilePath(identifier);
+        std::remove(checkpointPath.c_str());
+
+        // Kept caches are opened with the info file next to them
+        if (config::GetCachePersistent()) {
+            this->WriteFilePropertiesToDisk(identifier);
+            this->AddWarmCache(identifier, this->GetS3TrajectoryPath(identifier));
+        }
+        this->EnforceDiskQuota(identifier);
+    }
+
+    bool SimulationCache::LoadWarmCache(std::string identifier)
+    {
+        WarmCacheEntry entry;
+        {
+            std::lock_guard<std::mutex> lock(this->m_warmCachesMutex);
+            auto found = this->m_warmCaches.find(identifier);
+            if (found == this->m_warmCaches.end()) {
+                return false;
+            }
+            entry = found->second;
+        }
+
+        // The source may have been replaced since the cache was made;
+        //  if S3 can't be reached, the kept cache is the best there is
+        std::string etag;
+        if (!entry.source.empty()) {
+            if (!this->m_storage->GetETag(entry.source, etag)) {
+                LOG_F(WARNING, "Could not check %s on S3, using the kept cache of %s as it is",
+                    entry.source.c_str(), identifier.c_str());
+            } else if (etag != entry.etag) {
+                LOG_F(INFO, "Kept cache of %s is out of date with %s, deleting it", identifier.c_str(), entry.source.c_str());
+                this->ClearCache(identifier);
+                std::remove(this->GetLocalInfoFilePath(identifier).c_str());
+                return false;
+            }
+        }
+
+        LOG_F(INFO, "Using the cache of %s kept from an earlier run", identifier.c_str());
+        this->ParseFileProperties(identifier);
+        auto ignore = this->GetBinaryFile(identifier);
+        this->SaveWarmCaches();
+        this->EnforceDiskQuota(identifier);
+
+        // Segments that weren't downloaded before the server stopped
+        bool hasSource = false;
+        {
+            std::lock_guard<std::mutex> lock(this->m_warmCachesMutex);
+            hasSource = this->m_warmCaches.count(identifier) && !this->m_warmCaches.at(identifier).source.empty();
+        }
+        if (hasSource) {
+            this->StartSegmentDownload(identifier, 0);
+        }
+        return true;
+    }
+
+    void SimulationCache::LoadWarmCaches()
+    {
+        Json::Value manifest;
+        {
+            std::ifstream is(this->GetLocalWarmCacheManifestPath());
+            if (is.is_open() && !(is >> manifest)) {
+                LOG_F(WARNING, "Failed to read the kept cache manifest, the cache folder is emptied");
+                manifest = Json::Value();
+            }
+        }
+
+        // Caches are only used if their files are as they were left
+        std::string formatVersion = GetBinaryFormatVersion();
+        const Json::Value& caches = manifest["caches"];
+        std::vector<std::string> identifiers = caches.isObject() ? caches.getMemberNames() : std::vector<std::string>();
+        for (auto& identifier : identifiers) {
+            const Json::Value& cache = caches[identifier];
+            WarmCacheEntry entry;
+            entry.source = cache["source"].asString();
+            entry.etag = cache["etag"].asString();
+            entry.size = cache["size"].asUInt64();
+            entry.formatVersion = cache["formatVersion"].asString();
+
+            bool isValid = entry.formatVersion == formatVersion
+                && fileio::SegmentedBinaryFile::Exists(this->GetLocalFilePath(identifier))
+                && FileExists(this->GetLocalInfoFilePath(identifier))
+                && entry.size == this->GetCacheSize(identifier, false);
+            if (isValid) {
+                {
+                    std::lock_guard<std::mutex> lock(this->m_warmCachesMutex);
+                    this->m_warmCaches[identifier] = entry;
+                }
+
+                std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+                CacheUsage& usage = this->m_usage[identifier];
+                usage.lastAccess = cache["lastAccess"].asInt64();
+                usage.accessCount = cache["accessCount"].asUInt64();
+            } else {
+                LOG_F(INFO, "Dropping the kept cache of %s, its files have changed", identifier.c_str());
+            }
+        }
+
+        // Anything else is left from caches that weren't finished
+        std::vector<std::string> kept;
+        if (config::GetCacheCheckpointInterval() > 0) {
+            kept = GetCheckpointedIdentifiers();
+        }
+        std::size_t numKept = 0;
+        {
+            std::lock_guard<std::mutex> lock(this->m_warmCachesMutex);
+            for (auto& entry : this->m_warmCaches) {
+                kept.push_back(entry.first);
+            }
+            numKept = this->m_warmCaches.size();
+        }
+        std::string manifestPath = this->GetLocalWarmCacheManifestPath();
+        kept.push_back(manifestPath.substr(manifestPath.find_last_of('/') + 1));
+        DeleteFilesExcept(kept);
+
+        LOG_F(INFO, "%zu caches kept from earlier runs", numKept);
+        this->SaveWarmCaches();
+    }
+
+    void SimulationCache::SaveWarmCaches()
+    {
+        // Held until the manifest is in place, so saves from
+        //  different threads don't write over each other
+        std::lock_guard<std::mutex> warmLock(this->m_warmCachesMutex);
+        Json::Value caches(Json::objectValue);
+        for (auto& entry : this->m_warmCaches) {
+            entry.second.size = this->GetCacheSize(entry.first, false);
+            CacheUsage usage;
+            {
+                std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+                if (this->m_usage.count(entry.first)) {
+                    usage = this->m_usage.at(entry.first);
+                }
+            }
+
+            Json::Value cache;
+            cache["source"] = entry.second.source;
+            cache["etag"] = entry.second.etag;
+            cache["size"] = Json::UInt64(entry.second.size);
+            cache["formatVersion"] = entry.second.formatVersion;
+            cache["lastAccess"] = Json::Int64(usage.lastAccess);
+            cache["accessCount"] = Json::UInt64(usage.accessCount);
+            caches[entry.first] = cache;
+        }
+
+        Json::Value manifest;
+        manifest["caches"] = caches;
+
+        // Written next to the manifest, then moved over it, like checkpoints
+        std::string manifestPath = this->GetLocalWarmCacheManifestPath();
+        std::string tmpPath = manifestPath + ".tmp";
+        {
+            std::ofstream os(tmpPath);
+            os << manifest;
+            if (!os) {
+                LOG_F(ERROR, "Failed to write the kept cache manifest %s", tmpPath.c_str());
+                return;
+            }
+        }
+
+        if (std::rename(tmpPath.c_str(), manifestPath.c_str()) != 0) {
+            LOG_F(ERROR, "Failed to write the kept cache manifest %s", manifestPath.c_str());
+        }
+    }
+
+    void SimulationCache::AddWarmCache(std::string identifier, std::string sourceObject)
+    {
+        if (!config::GetCachePersistent()) {
+            return;
+        }
+
+        WarmCacheEntry entry;
+        std::string etag;
+        if (this->m_storage->GetETag(sourceObject, etag)) {
+            entry.source = sourceObject;
+            entry.etag = etag;
+        } else {
+            LOG_F(WARNING, "%s not found on AWS S3, the kept cache of %s won't be checked against it",
+                sourceObject.c_str(), identifier.c_str());
+        }
+        entry.formatVersion = GetBinaryFormatVersion();
+
+        {
+            std::lock_guard<std::mutex> lock(this->m_warmCachesMutex);
+            this->m_warmCaches[identifier] = entry;
+        }
+        this->SaveWarmCaches();
+    }
+
+    std::uint64_t SimulationCache::GetCacheSize(std::string identifier, bool withRawTrajectory)
+    {
+        std::string folder = config::GetCacheFolder();
+        std::uint64_t size = 0;
+        for (auto& name : ListCacheFolder()) {
+            struct stat info;
+            bool isCacheFile = IsFileOf(name, identifier + ".bin") || name == identifier + ".info"
+                || (withRawTrajectory && name == identifier);
+            if (isCacheFile && stat((folder + name).c_str(), &info) == 0) {
+                size += info.st_size;
+            }
+        }
+
+        return size;
+    }
+
+    void SimulationCache::SetPinnedCaches(std::vector<std::string> identifiers)
+    {
+        std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+        this->m_pinned = std::unordered_set<std::string>(identifiers.begin(), identifiers.end());
+    }
+
+    void SimulationCache::RecordAccess(std::string identifier, bool isLoad)
+    {
+        std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+        CacheUsage& usage = this->m_usage[identifier];
+        usage.lastAccess = std::time(nullptr);
+        if (isLoad) {
+            usage.accessCount++;
+        }
+    }
+
+    void SimulationCache::EnforceOpenFileBudget(std::string identifier)
+    {
+        std::size_t budget = config::GetCacheOpenFiles();
+        if (budget == 0) {
+            return;
+        }
+
+        // Released after the lock, so the caches are flushed and closed outside of it
+        std::vector<std::shared_ptr<fileio::SegmentedBinaryFile>> closed;
+        std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+        while (this->m_binaryFiles.size() > budget) {
+            // Idle caches are closed least recently used first, whatever the
+            //  eviction policy, they are opened again when they are read
+            auto victim = this->m_binaryFiles.end();
+            for (auto it = this->m_binaryFiles.begin(); it != this->m_binaryFiles.end(); ++it) {
+                if (it->first == identifier || this->m_pinned.count(it->first) || this->m_writing.count(it->first)) {
+                    continue;
+                }
+                if (victim == this->m_binaryFiles.end()
+                    || this->m_usage[it->first].lastAccess < this->m_usage[victim->first].lastAccess) {
+                    victim = it;
+                }
+            }
+
+            if (victim == this->m_binaryFiles.end()) {
+                LOG_F(WARNING, "%zu caches are open, over the budget of %zu, but all of them are in use",
+                    this->m_binaryFiles.size(), budget);
+                break;
+            }
+
+            LOG_F(INFO, "Closing the cache of %s, %zu caches can be open", victim->first.c_str(), budget);
+            closed.push_back(victim->second);
+            this->m_closedFiles.insert(victim->first);
+            this->m_binaryFiles.erase(victim);
+        }
+    }
+
+    void SimulationCache::EnforceDiskQuota(std::string identifier)
+    {
+        std::uint64_t quota = config::GetCacheDiskQuota();
+        if (quota == 0) {
+            return;
+        }
+
+        // Every file in the cache folder counts towards the quota,
+        //  but only caches the server has opened are evicted
+        std::string folder = config::GetCacheFolder();
+        std::uint64_t total = 0;
+        for (auto& name : ListCacheFolder()) {
+            struct stat info;
+            if (stat((folder + name).c_str(), &info) == 0) {
+                total += info.st_size;
+            }
+        }
+
+        std::vector<std::string> checkpointed = GetCheckpointedIdentifiers();
+        bool byFrequency = config::GetCacheEvictionPolicy() != "lru";
+        while (total > quota) {
+            std::string victim;
+            {
+                std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+                for (auto& entry : this->m_usage) {
+                    bool isInUse = entry.first == identifier
+                        || this->m_pinned.count(entry.first)
+                        || this->m_writing.count(entry.first)
+                        || std::find(checkpointed.begin(), checkpointed.end(), entry.first) != checkpointed.end();
+                    if (!isInUse && (victim.empty() || IsLessValuable(entry.second, this->m_usage.at(victim), byFrequency))) {
+                        victim = entry.first;
+                    }
+                }
+            }
+
+            if (victim.empty()) {
+                LOG_F(WARNING, "The cache folder holds %llu bytes, over the quota of %llu, but every cache in it is in use",
+                    (unsigned long long)total, (unsigned long long)quota);
+                return;
+            }
+
+            std::uint64_t size = this->GetCacheSize(victim, true);
+            LOG_F(INFO, "Evicting the cache of %s, %llu bytes, to stay within the disk quota",
+                victim.c_str(), (unsigned long long)size);
+            this->ClearCache(victim);
+            std::remove(this->GetLocalInfoFilePath(victim).c_str());
+            std::remove(this->GetLocalRawTrajectoryFilePath(victim).c_str());
+            total -= std::min(total, size);
+        }
+    }
+
+    TrajectoryFileProperties SimulationCache::GetFileProperties(std::string identifier)
+    {
+        TrajectoryFileProperties tfp = this->m_fileProps.count(identifier)
+            ? this->m_fileProps[identifier]
+            : TrajectoryFileProperties();
+
+        // The binary cache knows how lossy its own encoding is
+        auto file = this->FindBinaryFile(identifier);
+        if (file) {
+            auto error = file->GetQuantizationError();
+            tfp.positionError = error.position;
+            tfp.rotationError = error.rotation;
+            tfp.fiberError = error.fiber;
+        }
+
+        return tfp;
+    }
+
     void SimulationCache::ParseFileProperties(std::string identifier)
     {
         std::string filePath = this->GetLocalInfoFilePath(identifier);
@@ -374,6 +1404,26 @@ namespace simularium {
         return config::GetCacheFolder() + identifier + ".info";
     }
 
+    std::string SimulationCache::GetLocalIndexFilePath(std::string identifier)
+    {
+        return this->GetLocalFilePath(identifier) + fileio::binary::INDEX_FILE_SUFFIX;
+    }
+
+    std::string SimulationCache::GetLocalCheckpointFilePath(std::string identifier)
+    {
+        return config::GetCacheFolder() + identifier + ".ckpt";
+    }
+
+    std::string SimulationCache::GetLocalWarmCacheManifestPath()
+    {
+        return config::GetCacheFolder() + "warm_caches.json";
+    }
+
+    std::string SimulationCache::GetLocalPyramidFilePath(std::string identifier, std::size_t level)
+    {
+        return this->GetLocalFilePath(identifier) + fileio::binary::PYRAMID_FILE_SUFFIX + std::to_string(level);
+    }
+
     std::string SimulationCache::GetS3TrajectoryPath(std::string identifier)
     {
         return config::GetS3Location() + identifier;
@@ -394,21 +1444,120 @@ namespace simularium {
         return config::GetS3CacheLocation() + identifier + ".info";
     }
 
-    fileio::SimulariumBinaryFile* SimulationCache::GetBinaryFile(std::string identifier)
+    std::string SimulationCache::GetS3IndexCachePath(std::string identifier)
     {
-        std::string path = this->GetLocalFilePath(identifier);
+        return this->GetS3TrajectoryCachePath(identifier) + fileio::binary::INDEX_FILE_SUFFIX;
+    }
 
-        if (!this->m_binaryFiles.count(identifier)) {
-            this->m_binaryFiles[identifier] = std::make_shared<fileio::SimulariumBinaryFile>();
+    std::string SimulationCache::GetS3PyramidCachePath(std::string identifier, std::size_t level)
+    {
+        return this->GetS3TrajectoryCachePath(identifier) + fileio::binary::PYRAMID_FILE_SUFFIX + std::to_string(level);
+    }
 
-            if (FileExists(path)) {
-                this->m_binaryFiles[identifier]->Open(path);
-            } else {
-                this->m_binaryFiles[identifier]->Create(path);
+    std::shared_ptr<fileio::SegmentedBinaryFile> SimulationCache::GetBinaryFile(std::string identifier)
+    {
+        auto file = this->FindBinaryFile(identifier);
+        return file ? file : this->OpenBinaryFile(identifier);
+    }
+
+    std::shared_ptr<fileio::SegmentedBinaryFile> SimulationCache::FindBinaryFile(std::string identifier)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+            auto found = this->m_binaryFiles.find(identifier);
+            if (found != this->m_binaryFiles.end()) {
+                return found->second;
+            }
+            if (!this->m_closedFiles.count(identifier)) {
+                return nullptr;
+            }
+        }
+
+        if (!fileio::SegmentedBinaryFile::Exists(this->GetLocalFilePath(identifier))) {
+            std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+            this->m_closedFiles.erase(identifier);
+            return nullptr;
+        }
+
+        LOG_F(INFO, "Opening the closed cache of %s again", identifier.c_str());
+        return this->OpenBinaryFile(identifier);
+    }
+
+    std::shared_ptr<fileio::SegmentedBinaryFile> SimulationCache::OpenBinaryFile(std::string identifier)
+    {
+        // Whether the cache is opened or created is decided once, threads
+        //  that open it at the same time wait for the first one; creating it
+        //  twice would truncate a cache that is already being written
+        std::promise<std::shared_ptr<fileio::SegmentedBinaryFile>> opened;
+        {
+            std::unique_lock<std::mutex> lock(this->m_binaryFilesMutex);
+            auto found = this->m_binaryFiles.find(identifier);
+            if (found != this->m_binaryFiles.end()) {
+                return found->second;
+            }
+
+            auto inFlight = this->m_openingFiles.find(identifier);
+            if (inFlight != this->m_openingFiles.end()) {
+                auto pending = inFlight->second;
+                lock.unlock();
+                return pending.get();
             }
+
+            this->m_openingFiles[identifier] = opened.get_future().share();
+        }
+
+        std::string path = this->GetLocalFilePath(identifier);
+
+        fileio::compression::CompressionOptions compression;
+        compression.compressor = fileio::compression::ParseCompressor(config::GetCacheCompressor());
+        compression.level = config::GetCacheCompressionLevel();
+
+        fileio::quantization::QuantizationOptions quantization;
+        quantization.enabled = config::GetCacheQuantization();
+        if (this->m_fileProps.count(identifier)) {
+            auto& tfp = this->m_fileProps[identifier];
+            quantization.boxSize = { { tfp.boxX, tfp.boxY, tfp.boxZ } };
         }
 
-        return this->m_binaryFiles[identifier].get();
+        fileio::fiber::FiberOptions fiberOptions;
+        fiberOptions.step = config::GetCacheFiberStep();
+        fiberOptions.tolerance = config::GetCacheFiberTolerance();
+
+        // Opened caches are written with the same settings, frames are
+        //  appended to them when an interrupted conversion is resumed
+        auto file = std::make_shared<fileio::SegmentedBinaryFile>();
+        file->SetSegmentSettings([=](fileio::SimulariumBinaryFile& segment) {
+            segment.SetCompression(compression);
+            segment.SetKeyframeInterval(config::GetCacheKeyframeInterval());
+            segment.SetQuantization(quantization);
+            segment.SetColumnarLayout(config::GetCacheColumnarLayout());
+            segment.SetPackedRecords(config::GetCachePackedRecords());
+            segment.SetFiberCoding(fiberOptions);
+            segment.SetStaticAgents(config::GetCacheStaticFrames());
+            segment.SetAttributeTable(config::GetCacheAttributeTable());
+            segment.SetWriteBuffer(config::GetCacheWriteBufferSize());
+            segment.SetTemporalPyramid(config::GetCachePyramidLevels());
+        });
+
+        if (fileio::SegmentedBinaryFile::Exists(path)) {
+            file->Open(path);
+        } else {
+            file->Create(path, config::GetCacheSegmentFrames());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->m_binaryFilesMutex);
+            this->m_openingFiles.erase(identifier);
+            this->m_binaryFiles[identifier] = file;
+            this->m_closedFiles.erase(identifier);
+            auto& usage = this->m_usage[identifier];
+            usage.lastAccess = std::max(usage.lastAccess, std::int64_t(std::time(nullptr)));
+        }
+
+        opened.set_value(file);
+
+        this->EnforceOpenFileBudget(identifier);
+        return file;
     }
 
 } // namespace simularium
@@ -0,0 +1,329 @@
+#include "simularium/fileio/static_layer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace aics {
+namespace simularium {
+    namespace fileio {
+        namespace static_layer {
+
+            // Scalar agent fields, in the order they are encoded
+            static float AgentData::*const kFields[] = {
+                &AgentData::vis_type,
+                &AgentData::type,
+                &AgentData::x,
+                &AgentData::y,
+                &AgentData::z,
+                &AgentData::xrot,
+                &AgentData::yrot,
+                &AgentData::zrot,
+                &AgentData::collision_radius
+            };
+
+            // Bitwise comparison, an agent is only static if it is sent as-is
+            inline bool SameAgent(const AgentData& a, const AgentData& b)
+            {
+                for (auto field : kFields) {
+                    if (std::memcmp(&(a.*field), &(b.*field), sizeof(float)) != 0) {
+                        return false;
+                    }
+                }
+
+                return a.subpoints.size() == b.subpoints.size()
+                    && (a.subpoints.empty()
+                        || std::memcmp(&a.subpoints[0], &b.subpoints[0], a.subpoints.size() * sizeof(float)) == 0);
+            }
+
+            template <typename T>
+            inline void Append(std::vector<char>& out, T value)
+            {
+                std::size_t start = out.size();
+                out.resize(start + sizeof(T));
+                std::memcpy(&out[start], &value, sizeof(T));
+            }
+
+            template <typename T>
+            inline bool Read(const char*& pos, const char* end, T& value)
+            {
+                if (std::size_t(end - pos) < sizeof(T)) {
+                    return false;
+                }
+
+                std::memcpy(&value, pos, sizeof(T));
+                pos += sizeof(T);
+                return true;
+            }
+
+            void AddStaticAgents(const StaticLayer& layer, std::size_t frameIndex, TrajectoryFrame& frame)
+            {
+                for (auto& entry : layer) {
+                    if (entry.Covers(frameIndex)) {
+                        frame.data.push_back(entry.agent);
+                    }
+                }
+            }
+
+            bool HasStaticAgents(const StaticLayer& layer, std::size_t frameIndex)
+            {
+                return std::any_of(layer.begin(), layer.end(),
+                    [frameIndex](const StaticAgent& entry) { return entry.Covers(frameIndex); });
+            }
+
+            void RemoveStaticAgents(const StaticLayer& layer, std::size_t frameIndex, TrajectoryFrame& frame)
+            {
+                std::unordered_map<std::uint32_t, const AgentData*> covering;
+                for (auto& entry : layer) {
+                    if (entry.Covers(frameIndex)) {
+                        covering[entry.agent.id] = &entry.agent;
+                    }
+                }
+
+                frame.data.erase(
+                    std::remove_if(frame.data.begin(), frame.data.end(),
+                        [&covering](const AgentData& agent) {
+                            auto found = covering.find(agent.id);
+                            return found != covering.end() && SameAgent(*found->second, agent);
+                        }),
+                    frame.data.end());
+            }
+
+            std::vector<char> Encode(const StaticLayer& layer)
+            {
+                std::vector<char> out;
+                Append(out, std::uint32_t(layer.size()));
+                for (auto& entry : layer) {
+                    Append(out, entry.first);
+                    Append(out, entry.end);
+                    Append(out, entry.agent.id);
+                    for (auto field : kFields) {
+                        Append(out, entry.agent.*field);
+                    }
+
+                    Append(out, std::uint32_t(entry.agent.subpoints.size()));
+                    for (float value : entry.agent.subpoints) {
+                        Append(out, value);
+                    }
+                }
+
+                return out;
+            }
+
+            bool Decode(const char* data, std::size_t size, StaticLayer& layer)
+            {
+                const char* pos = data;
+                const char* end = data + size;
+                std::uint32_t numAgents;
+                if (!Read(pos, end, numAgents)) {
+                    return false;
+                }
+
+                layer.clear();
+                for (std::uint32_t i = 0; i < numAgents; ++i) {
+                    StaticAgent entry;
+                    std::uint32_t numSubpoints;
+                    if (!Read(pos, end, entry.first) || !Read(pos, end, entry.end) || !Read(pos, end, entry.agent.id)) {
+                        return false;
+                    }
+
+                    for (auto field : kFields) {
+                        if (!Read(pos, end, entry.agent.*field)) {
+                            return false;
+                        }
+                    }
+
+                    if (!Read(pos, end, numSubpoints) || numSubpoints > std::size_t(end - pos) / sizeof(float)) {
+                        return false;
+                    }
+
+                    entry.agent.subpoints.resize(numSubpoints);
+                    for (auto& value : entry.agent.subpoints) {
+                        Read(pos, end, value);
+                    }
+
+                    layer.push_back(std::move(entry));
+                }
+
+                return pos == end;
+            }
+
+            void StaticAgentDetector::Reset(std::size_t minFrames, std::size_t firstFrame, std::size_t layerSize)
+            {
+                this->m_minFrames = minFrames;
+                this->m_firstFrame = firstFrame;
+                this->m_nextFrame = firstFrame;
+                this->m_layerSize = layerSize;
+                this->m_runs.clear();
+                this->m_heldFrames.clear();
+                this->m_numReleased = 0;
+                this->m_started.clear();
+                this->m_ended.clear();
+            }
+
+            void StaticAgentDetector::Push(TrajectoryFrame frame)
+            {
+                if (!this->IsEnabled()) {
+                    this->m_heldFrames.push_back(std::move(frame));
+                    this->m_numReleased++;
+                    this->m_nextFrame++;
+                    return;
+                }
+
+                std::size_t n = this->m_nextFrame++;
+
+                // Agents that share an id can't be told apart, so they are never static
+                std::unordered_map<std::uint32_t, std::size_t> counts;
+                for (auto& agent : frame.data) {
+                    counts[agent.id]++;
+                }
+
+                std::size_t numStarted = this->m_started.size();
+                for (auto& agent : frame.data) {
+                    if (counts[agent.id] > 1) {
+                        continue;
+                    }
+
+                    auto found = this->m_runs.find(agent.id);
+                    if (found != this->m_runs.end() && SameAgent(found->second.agent, agent)) {
+                        Run& run = found->second;
+                        run.lastSeen = n;
+                        if (!run.isStatic && n + 1 - run.start >= this->m_minFrames) {
+                            this->MakeStatic(run);
+                        }
+                        continue;
+                    }
+
+                    if (found != this->m_runs.end() && found->second.isStatic) {
+                        this->m_ended.emplace_back(found->second.layerIndex, std::uint32_t(n));
+                    }
+
+                    Run run;
+                    run.agent = agent;
+                    run.start = n;
+                    run.lastSeen = n;
+                    this->m_runs[agent.id] = std::move(run);
+                }
+
+                // Runs of agents that are gone from this frame end here
+                for (auto it = this->m_runs.begin(); it != this->m_runs.end();) {
+                    if (it->second.lastSeen == n) {
+                        ++it;
+                        continue;
+                    }
+
+                    if (it->second.isStatic) {
+                        this->m_ended.emplace_back(it->second.layerIndex, std::uint32_t(n));
+                    }
+                    it = this->m_runs.erase(it);
+                }
+
+                // Agents that just became static are also removed from the held back frames
+                this->m_heldFrames.push_back(std::move(frame));
+                this->RemoveStaticAgents(this->m_started.size() > numStarted ? 0 : this->m_heldFrames.size() - 1);
+
+                // A later frame can only make agents static from
+                //  frame n + 2 - minFrames on, so frames before it are done
+                std::size_t frontFrame = this->m_nextFrame - this->m_heldFrames.size();
+                std::size_t doneFrames = n + 2 > this->m_minFrames + frontFrame ? n + 2 - this->m_minFrames - frontFrame : 0;
+                this->m_numReleased = std::max(this->m_numReleased, std::min(doneFrames, this->m_heldFrames.size()));
+            }
+
+            bool StaticAgentDetector::Update(StaticLayer& layer)
+            {
+                if (this->m_started.empty() && this->m_ended.empty()) {
+                    return false;
+                }
+
+                // Layer indices were handed out in order, so the started
+                //  agents are appended before the ends that refer to them
+                for (auto& entry : this->m_started) {
+                    layer.push_back(std::move(entry));
+                }
+
+                for (auto& ended : this->m_ended) {
+                    if (ended.first < layer.size()) {
+                        layer[ended.first].end = ended.second;
+                    }
+                }
+
+                this->m_started.clear();
+                this->m_ended.clear();
+                return true;
+            }
+
+            bool StaticAgentDetector::Pop(TrajectoryFrame& frame)
+            {
+                if (this->m_numReleased == 0) {
+                    return false;
+                }
+
+                frame = std::move(this->m_heldFrames.front());
+                this->m_heldFrames.pop_front();
+                this->m_numReleased--;
+                return true;
+            }
+
+            void StaticAgentDetector::Drain()
+            {
+                if (!this->IsEnabled() || this->m_heldFrames.empty()) {
+                    this->m_numReleased = this->m_heldFrames.size();
+                    return;
+                }
+
+                // Agents that are the same over every frame so far are static,
+                //  however few frames there are, as long as none of those frames was released
+                std::size_t numStarted = this->m_started.size();
+                std::size_t firstHeldFrame = this->m_nextFrame - this->m_heldFrames.size() + this->m_numReleased;
+                for (auto& entry : this->m_runs) {
+                    Run& run = entry.second;
+                    if (!run.isStatic && run.start == this->m_firstFrame && run.start >= firstHeldFrame && run.lastSeen > run.start) {
+                        this->MakeStatic(run);
+                    }
+                }
+
+                if (this->m_started.size() > numStarted) {
+                    this->RemoveStaticAgents(0);
+                }
+
+                // The frames of runs that are not static yet are written as they
+                //  are, so those runs start over from the next frame
+                for (auto& entry : this->m_runs) {
+                    if (!entry.second.isStatic) {
+                        entry.second.start = this->m_nextFrame;
+                    }
+                }
+
+                this->m_numReleased = this->m_heldFrames.size();
+            }
+
+            void StaticAgentDetector::MakeStatic(Run& run)
+            {
+                run.isStatic = true;
+                run.layerIndex = this->m_layerSize++;
+
+                StaticAgent entry;
+                entry.first = std::uint32_t(run.start);
+                entry.agent = run.agent;
+                this->m_started.push_back(std::move(entry));
+            }
+
+            void StaticAgentDetector::RemoveStaticAgents(std::size_t fromHeldFrame)
+            {
+                std::size_t frontFrame = this->m_nextFrame - this->m_heldFrames.size();
+                for (std::size_t i = std::max(fromHeldFrame, this->m_numReleased); i < this->m_heldFrames.size(); ++i) {
+                    std::size_t frameIndex = frontFrame + i;
+                    auto& agents = this->m_heldFrames[i].data;
+                    agents.erase(
+                        std::remove_if(agents.begin(), agents.end(),
+                            [this, frameIndex](const AgentData& agent) {
+                                auto found = this->m_runs.find(agent.id);
+                                return found != this->m_runs.end() && found->second.isStatic
+                                    && frameIndex >= found->second.start && frameIndex <= found->second.lastSeen;
+                            }),
+                        agents.end());
+                }
+            }
+
+        } // namespace static_layer
+    } // namespace fileio
+} // namespace simularium
+} // namespace aics
@@ -0,0 +1,230 @@
+#include "simularium/storage/storage_backend.h"
+#include "loguru/loguru.hpp"
+#include "simularium/config/config.h"
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <sys/stat.h>
+
+namespace aics {
+namespace simularium {
+    namespace storage {
+
+        bool S3StorageBackend::Download(std::string objectName, std::string destination)
+        {
+            return aws_util::Download(objectName, destination);
+        }
+
+        bool S3StorageBackend::Upload(std::string fileName, std::string objectName)
+        {
+            return aws_util::Upload(fileName, objectName);
+        }
+
+        bool S3StorageBackend::DownloadAll(std::vector<FileTransfer> transfers)
+        {
+            return aws_util::DownloadAll(transfers);
+        }
+
+        bool S3StorageBackend::UploadAll(std::vector<FileTransfer> transfers)
+        {
+            return aws_util::UploadAll(transfers);
+        }
+
+        bool S3StorageBackend::GetETag(std::string objectName, std::string& etag)
+        {
+            return aws_util::GetETag(objectName, etag);
+        }
+
+        bool S3StorageBackend::GetSize(std::string objectName, std::uint64_t& size)
+        {
+            return aws_util::GetSize(objectName, size);
+        }
+
+        bool S3StorageBackend::DownloadRange(std::string objectName, std::uint64_t offset, std::uint64_t size, std::vector<char>& out)
+        {
+            return aws_util::DownloadRange(objectName, offset, size, out);
+        }
+
+        // Copies through a temporary file, so readers never see part of a file
+        static bool CopyFile(const std::string& from, const std::string& to)
+        {
+            std::string tmpPath = to + ".tmp";
+            {
+                std::ifstream is(from, std::ios::binary);
+                std::ofstream os(tmpPath, std::ios::binary | std::ios::trunc);
+                if (!is.is_open() || !os.is_open() || !(os << is.rdbuf())) {
+                    LOG_F(WARNING, "Failed to copy %s to %s", from.c_str(), to.c_str());
+                    std::remove(tmpPath.c_str());
+                    return false;
+                }
+            }
+
+            if (std::rename(tmpPath.c_str(), to.c_str()) != 0) {
+                LOG_F(WARNING, "Failed to move %s into place", to.c_str());
+                std::remove(tmpPath.c_str());
+                return false;
+            }
+
+            return true;
+        }
+
+        // Creates the folders leading up to the file
+        static bool CreateParentFolders(const std::string& filePath)
+        {
+            for (std::size_t pos = filePath.find('/', 1); pos != std::string::npos; pos = filePath.find('/', pos + 1)) {
+                std::string folder = filePath.substr(0, pos);
+                if (::mkdir(folder.c_str(), 0755) != 0 && errno != EEXIST) {
+                    LOG_F(WARNING, "Failed to create folder %s", folder.c_str());
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        LocalStorageBackend::LocalStorageBackend(std::string rootFolder)
+            : m_rootFolder(rootFolder)
+        {
+            if (!this->m_rootFolder.empty() && this->m_rootFolder.back() != '/') {
+                this->m_rootFolder += '/';
+            }
+        }
+
+        std::string LocalStorageBackend::GetObjectPath(std::string objectName)
+        {
+            // Object names come from clients, and must stay within the folder
+            bool isEscaping = objectName.empty() || objectName[0] == '/'
+                || objectName == ".." || objectName.rfind("../", 0) == 0
+                || objectName.find("/../") != std::string::npos
+                || (objectName.size() >= 3 && objectName.compare(objectName.size() - 3, 3, "/..") == 0);
+            if (isEscaping) {
+                LOG_F(WARNING, "Object name %s is outside of the storage folder", objectName.c_str());
+                return "";
+            }
+
+            return this->m_rootFolder + objectName;
+        }
+
+        bool LocalStorageBackend::Download(std::string objectName, std::string destination)
+        {
+            std::string objectPath = this->GetObjectPath(objectName);
+            struct stat info;
+            if (objectPath.empty() || stat(objectPath.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+                return false;
+            }
+
+            return CopyFile(objectPath, destination);
+        }
+
+        bool LocalStorageBackend::Upload(std::string fileName, std::string objectName)
+        {
+            std::string objectPath = this->GetObjectPath(objectName);
+            if (objectPath.empty() || !CreateParentFolders(objectPath)) {
+                return false;
+            }
+
+            return CopyFile(fileName, objectPath);
+        }
+
+        bool LocalStorageBackend::DownloadAll(std::vector<FileTransfer> transfers)
+        {
+            std::vector<std::future<bool>> results;
+            for (auto& transfer : transfers) {
+                results.push_back(std::async(std::launch::async, [this, transfer]() {
+                    return this->Download(transfer.objectName, transfer.fileName);
+                }));
+            }
+
+            bool success = true;
+            for (auto& result : results) {
+                success = result.get() && success;
+            }
+
+            return success;
+        }
+
+        bool LocalStorageBackend::UploadAll(std::vector<FileTransfer> transfers)
+        {
+            std::vector<std::future<bool>> results;
+            for (auto& transfer : transfers) {
+                results.push_back(std::async(std::launch::async, [this, transfer]() {
+                    return this->Upload(transfer.fileName, transfer.objectName);
+                }));
+            }
+
+            bool success = true;
+            for (auto& result : results) {
+                success = result.get() && success;
+            }
+
+            return success;
+        }
+
+        bool LocalStorageBackend::GetETag(std::string objectName, std::string& etag)
+        {
+            std::string objectPath = this->GetObjectPath(objectName);
+            struct stat info;
+            if (objectPath.empty() || stat(objectPath.c_str(), &info) != 0) {
+                return false;
+            }
+
+#ifdef __APPLE__
+            const struct timespec& modified = info.st_mtimespec;
+#else
+            const struct timespec& modified = info.st_mtim;
+#endif
+            etag = std::to_string(info.st_size) + "-" + std::to_string(modified.tv_sec)
+                + "." + std::to_string(modified.tv_nsec);
+            return true;
+        }
+
+        bool LocalStorageBackend::GetSize(std::string objectName, std::uint64_t& size)
+        {
+            std::string objectPath = this->GetObjectPath(objectName);
+            struct stat info;
+            if (objectPath.empty() || stat(objectPath.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+                return false;
+            }
+
+            size = std::uint64_t(info.st_size);
+            return true;
+        }
+
+        bool LocalStorageBackend::DownloadRange(std::string objectName, std::uint64_t offset, std::uint64_t size, std::vector<char>& out)
+        {
+            std::uint64_t objectSize = 0;
+            if (!this->GetSize(objectName, objectSize) || offset > objectSize || size > objectSize - offset) {
+                return false;
+            }
+
+            std::ifstream is(this->GetObjectPath(objectName), std::ios::binary);
+            out.resize(size);
+            is.seekg(offset, std::ios::beg);
+            if (!is.read(out.data(), out.size())) {
+                LOG_F(WARNING, "Failed to read %llu bytes of %s", (unsigned long long)size, objectName.c_str());
+                out.clear();
+                return false;
+            }
+
+            return true;
+        }
+
+        std::shared_ptr<StorageBackend> CreateStorageBackend()
+        {
+            std::string backend = config::GetStorageBackend();
+            if (backend == "local") {
+                LOG_F(INFO, "Using the local storage folder %s", config::GetStorageFolder().c_str());
+                return std::make_shared<LocalStorageBackend>(config::GetStorageFolder());
+            }
+
+            if (backend != "s3") {
+                LOG_F(WARNING, "Unknown storage backend %s, using S3", backend.c_str());
+            }
+
+            return std::make_shared<S3StorageBackend>();
+        }
+
+    } // namespace storage
+} // namespace simularium
+} // namespace aics
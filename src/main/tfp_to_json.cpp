@@ -47,6 +47,14 @@ namespace simularium {
         fprops["typeMapping"] = typeMapping;
         fprops["size"] = size;
 
+        if (tfp.positionError > 0 || tfp.rotationError > 0 || tfp.fiberError > 0) {
+            Json::Value quantizationError;
+            quantizationError["position"] = tfp.positionError;
+            quantizationError["rotation"] = tfp.rotationError;
+            quantizationError["fiber"] = tfp.fiberError;
+            fprops["quantizationError"] = quantizationError;
+        }
+
         Json::Value cameraDefault;
         Json::Value camPos, camLook, upVec;
 
@@ -0,0 +1,93 @@
+#include "simularium/fileio/compression.h"
+#include "simularium/fileio/simularium_binary_file.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ *   Compression ratio vs. decode throughput for the runtime cache
+ *
+ *   usage: bench_cache_compression [path to a cached .bin file]
+ *
+ *   Re-encodes every frame of an existing cache (e.g. one produced from a
+ *   ReaDDy or Cytosim trajectory) with each compressor and level
+ */
+using namespace aics::simularium;
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::printf("usage: %s [cache file]\n", argv[0]);
+        return 1;
+    }
+
+    fileio::SimulariumBinaryFile file;
+    file.Open(argv[1]);
+
+    std::vector<std::vector<char>> frames;
+    std::size_t rawBytes = 0;
+    for (std::size_t i = 0; i < file.NumSavedFrames(); ++i) {
+        auto update = file.GetBroadcastFrame(i);
+        if (update.frames.empty()) {
+            continue;
+        }
+
+        auto& view = update.frames[0];
+        frames.emplace_back(view.data, view.data + view.size);
+        rawBytes += view.size;
+    }
+
+    if (rawBytes == 0) {
+        std::printf("No frames found in %s\n", argv[1]);
+        return 1;
+    }
+
+    std::printf("%zu frames, %.1f MB uncompressed\n", frames.size(), rawBytes / 1e6);
+    std::printf("%-6s %-6s %-8s %-14s %-14s\n", "codec", "level", "ratio", "encode MB/s", "decode MB/s");
+
+    const std::vector<std::pair<std::string, fileio::compression::Compressor>> compressors = {
+        { "lz4", fileio::compression::Compressor::LZ4 },
+        { "zstd", fileio::compression::Compressor::ZSTD }
+    };
+
+    for (auto& compressor : compressors) {
+        for (int level : { 1, 5, 9 }) {
+            fileio::compression::CompressionOptions options;
+            options.compressor = compressor.second;
+            options.level = level;
+
+            std::vector<std::vector<char>> encoded(frames.size());
+            std::size_t compressedBytes = 0;
+
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < frames.size(); ++i) {
+                if (!fileio::compression::Compress(frames[i].data(), frames[i].size(), options, encoded[i])) {
+                    encoded[i] = frames[i];
+                }
+                compressedBytes += encoded[i].size();
+            }
+            auto encodedAt = std::chrono::steady_clock::now();
+
+            std::vector<char> decoded;
+            for (std::size_t i = 0; i < frames.size(); ++i) {
+                if (encoded[i].size() < frames[i].size()) {
+                    fileio::compression::Decompress(encoded[i].data(), encoded[i].size(), options.numThreads, decoded);
+                }
+            }
+            auto decodedAt = std::chrono::steady_clock::now();
+
+            double encodeSeconds = std::chrono::duration<double>(encodedAt - start).count();
+            double decodeSeconds = std::chrono::duration<double>(decodedAt - encodedAt).count();
+
+            std::printf("%-6s %-6i %-8.2f %-14.1f %-14.1f\n",
+                compressor.first.c_str(),
+                level,
+                double(rawBytes) / compressedBytes,
+                rawBytes / 1e6 / encodeSeconds,
+                rawBytes / 1e6 / decodeSeconds);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "simularium/fileio/frame_codec.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/**
+ *   Encode and decode throughput of the float chunk codecs
+ *
+ *   usage: bench_frame_codec [agents per frame] [number of frames]
+ *
+ *   Times FrameCodec<FixedStrideLayout> and FrameCodec<GeneralLayout> on
+ *   particle frames (no subpoints, as in most ReaDDy trajectories), and
+ *   FrameCodec<GeneralLayout> on fiber frames
+ */
+using namespace aics::simularium;
+using namespace aics::simularium::fileio;
+
+std::vector<TrajectoryFrame> MakeFrames(std::size_t numFrames, std::size_t numAgents, std::size_t numSubpoints)
+{
+    std::vector<TrajectoryFrame> frames(numFrames);
+    for (std::size_t i = 0; i < numFrames; ++i) {
+        frames[i].frameNumber = i;
+        frames[i].time = i * 0.1f;
+        frames[i].data.resize(numAgents);
+        for (std::size_t j = 0; j < numAgents; ++j) {
+            AgentData& agent = frames[i].data[j];
+            agent.vis_type = numSubpoints > 0 ? 1001 : 1000;
+            agent.id = j;
+            agent.type = j % 7;
+            agent.x = i + j * 0.5f;
+            agent.y = i - j * 0.25f;
+            agent.z = j * 0.125f;
+            agent.collision_radius = 1;
+            agent.subpoints.assign(numSubpoints, float(j));
+        }
+    }
+
+    return frames;
+}
+
+template <typename Layout>
+void Run(const char* name, const std::vector<TrajectoryFrame>& frames)
+{
+    std::vector<std::vector<float>> chunks(frames.size());
+    std::size_t bytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        codec::FrameCodec<Layout>::Serialize(frames[i], chunks[i]);
+        bytes += chunks[i].size() * sizeof(float);
+    }
+    auto encodedAt = std::chrono::steady_clock::now();
+
+    // Frames are parsed into the same object, as the cache does when rebuilding
+    TrajectoryFrame parsed;
+    std::size_t failed = 0;
+    for (auto& chunk : chunks) {
+        if (!codec::FrameCodec<Layout>::Parse((const char*)chunk.data(), chunk.size() * sizeof(float), parsed)) {
+            failed++;
+        }
+    }
+    auto decodedAt = std::chrono::steady_clock::now();
+
+    double encodeSeconds = std::chrono::duration<double>(encodedAt - start).count();
+    double decodeSeconds = std::chrono::duration<double>(decodedAt - encodedAt).count();
+    std::printf("%-24s %-10.1f %-14.1f %-14.1f%s\n",
+        name,
+        bytes / 1e6,
+        bytes / 1e6 / encodeSeconds,
+        bytes / 1e6 / decodeSeconds,
+        failed ? " (parse failures)" : "");
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t numAgents = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    std::size_t numFrames = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+
+    auto particles = MakeFrames(numFrames, numAgents, 0);
+    auto fibers = MakeFrames(numFrames, numAgents / 10, 3 * 30);
+
+    std::printf("%zu frames of %zu agents\n", numFrames, numAgents);
+    std::printf("%-24s %-10s %-14s %-14s\n", "codec", "MB", "encode MB/s", "decode MB/s");
+    Run<codec::FixedStrideLayout>("fixed stride, particles", particles);
+    Run<codec::GeneralLayout>("general, particles", particles);
+    Run<codec::GeneralLayout>("general, fibers", fibers);
+
+    return 0;
+}
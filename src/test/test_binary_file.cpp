@@ -0,0 +1,1679 @@
+#include "simularium/fileio/simularium_binary_file.h"
+#include "simularium/fileio/arrow_export.h"
+#include "simularium/fileio/attribute_table.h"
+#include "simularium/fileio/compression.h"
+#include "simularium/fileio/fiber_codec.h"
+#include "simularium/fileio/frame_cache.h"
+#include "simularium/fileio/frame_codec.h"
+#include "simularium/fileio/packed_frame.h"
+#include "simularium/fileio/segmented_binary_file.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <thread>
+
+namespace aics {
+namespace simularium {
+    namespace test {
+        class BinaryFileTests : public ::testing::Test {
+        protected:
+            TrajectoryFrame MakeFrame(std::size_t frameNumber, std::size_t numAgents)
+            {
+                TrajectoryFrame frame;
+                frame.frameNumber = frameNumber;
+                frame.time = frameNumber * 0.5f;
+
+                for (std::size_t i = 0; i < numAgents; ++i) {
+                    AgentData ad;
+                    ad.vis_type = 1000;
+                    ad.id = i;
+                    ad.type = i % 3;
+                    ad.x = frameNumber + i;
+                    ad.y = frameNumber - 1.5f * i;
+                    ad.z = 2.f * i;
+                    ad.collision_radius = 1;
+                    if (i % 2) {
+                        ad.subpoints = { 1.f, 2.f, 3.f, 4.f, 5.f, 6.f };
+                    }
+                    frame.data.push_back(ad);
+                }
+
+                return frame;
+            }
+
+            // Frame chunk as broadcast to clients: agent data + frame delimiter
+            BroadcastDataBuffer ExpectedBuffer(TrajectoryFrame frame)
+            {
+                BroadcastDataBuffer out;
+                out.push_back(frame.frameNumber);
+                out.push_back(frame.time);
+                out.push_back(frame.data.size());
+                for (auto& ad : frame.data) {
+                    std::vector<float> vals = Serialize(ad);
+                    out.insert(out.end(), vals.begin(), vals.end());
+                }
+
+                std::size_t start = out.size();
+                out.resize(start + fileio::binary::EOF_SIZE / sizeof(float));
+                std::memcpy(&out[start], fileio::binary::eof, fileio::binary::EOF_SIZE);
+                return out;
+            }
+
+            // Distance from p to the segment [a, b], all x, y, z
+            float SegmentDistance(const float* p, const float* a, const float* b)
+            {
+                float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                float lengthSquared = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+                float t = 0;
+                for (std::size_t axis = 0; axis < 3 && lengthSquared > 0; ++axis) {
+                    t += (p[axis] - a[axis]) * ab[axis] / lengthSquared;
+                }
+                t = std::min(std::max(t, 0.f), 1.f);
+
+                float distanceSquared = 0;
+                for (std::size_t axis = 0; axis < 3; ++axis) {
+                    float d = p[axis] - (a[axis] + t * ab[axis]);
+                    distanceSquared += d * d;
+                }
+                return std::sqrt(distanceSquared);
+            }
+
+            std::string m_filePath = "trajectory/test_binary_file.bin";
+
+            void TearDown() override
+            {
+                std::remove(this->m_filePath.c_str());
+                std::remove((this->m_filePath + fileio::binary::INDEX_FILE_SUFFIX).c_str());
+                for (std::size_t level = 1; level <= fileio::binary::MAX_PYRAMID_LEVELS; ++level) {
+                    std::string levelPath = this->m_filePath + fileio::binary::PYRAMID_FILE_SUFFIX + std::to_string(level);
+                    std::remove(levelPath.c_str());
+                    std::remove((levelPath + fileio::binary::INDEX_FILE_SUFFIX).c_str());
+                }
+                fileio::SegmentedBinaryFile::Remove(this->m_filePath);
+            }
+        };
+
+        TEST_F(BinaryFileTests, WriteAndReadFrames)
+        {
+            fileio::SimulariumBinaryFile file;
+            file.Create(this->m_filePath);
+
+            std::size_t numFrames = 10;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                file.WriteFrame(MakeFrame(i, 5));
+            }
+
+            EXPECT_EQ(file.NumSavedFrames(), numFrames);
+            EXPECT_EQ(file.GetEndOfStreamPos(), numFrames);
+
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                auto update = file.GetBroadcastFrame(i);
+                EXPECT_EQ(fileio::ToBroadcastBuffer(update), ExpectedBuffer(MakeFrame(i, 5)));
+                EXPECT_EQ(update.new_pos, i + 1);
+            }
+
+            EXPECT_TRUE(fileio::ToBroadcastBuffer(file.GetBroadcastFrame(numFrames)).empty());
+        }
+
+        TEST_F(BinaryFileTests, TableOfContentsGrows)
+        {
+            std::size_t numFrames = 50;
+            {
+                fileio::SimulariumBinaryFile file;
+                file.Create(this->m_filePath, 8);
+                for (std::size_t i = 0; i < numFrames; ++i) {
+                    file.WriteFrame(MakeFrame(i, i % 4));
+                }
+            }
+
+            fileio::SimulariumBinaryFile file;
+            file.Open(this->m_filePath);
+            EXPECT_EQ(file.GetMajorVersion(), fileio::binary::MAJOR_VERSION);
+            ASSERT_EQ(file.NumSavedFrames(), numFrames);
+
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                EXPECT_EQ(fileio::ToBroadcastBuffer(file.GetBroadcastFrame(i)), ExpectedBuffer(MakeFrame(i, i % 4)));
+            }
+
+            // Appending to a re-opened file continues the existing table
+            file.WriteFrame(MakeFrame(numFrames, 2));
+            EXPECT_EQ(file.NumSavedFrames(), numFrames + 1);
+            EXPECT_EQ(fileio::ToBroadcastBuffer(file.GetBroadcastFrame(numFrames)), ExpectedBuffer(MakeFrame(numFrames, 2)));
+        }
+
+        TEST_F(BinaryFileTests, MappedAndStreamReadsMatch)
+        {
+            std::size_t numFrames = 20;
+            {
+                fileio::SimulariumBinaryFile file;
+                file.Create(this->m_filePath);
+                for (std::size_t i = 0; i < numFrames; ++i) {
+                    file.WriteFrame(MakeFrame(i, 7));
+                }
+            }
+
+            fileio::SimulariumBinaryFile mapped;
+            fileio::SimulariumBinaryFile streamed;
+            mapped.Open(this->m_filePath, true);
+            streamed.Open(this->m_filePath, false);
+
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                auto mappedFrame = mapped.GetBroadcastFrame(i);
+                auto streamedFrame = streamed.GetBroadcastFrame(i);
+                ASSERT_EQ(mappedFrame.frames.size(), 1);
+                EXPECT_EQ(mappedFrame.frames[0].frameNumber, i);
+                EXPECT_EQ(fileio::ToBroadcastBuffer(mappedFrame), fileio::ToBroadcastBuffer(streamedFrame));
+            }
+        }
+
+        TEST_F(BinaryFileTests, MappedViewsOutliveRewrite)
+        {
+            {
+                fileio::SimulariumBinaryFile file;
+                file.Create(this->m_filePath);
+                for (std::size_t i = 0; i < 10; ++i) {
+                    file.WriteFrame(MakeFrame(i, 50));
+                }
+            }
+
+            fileio::SimulariumBinaryFile mapped;
+            mapped.Open(this->m_filePath, true);
+            auto before = mapped.GetBroadcastFrame(9);
+            ASSERT_EQ(before.frames.size(), 1u);
+
+            // A new file at the path leaves the views of the old one intact
+            {
+                fileio::SimulariumBinaryFile file;
+                file.Create(this->m_filePath);
+                file.WriteFrame(MakeFrame(0, 1));
+            }
+            EXPECT_EQ(fileio::ToBroadcastBuffer(before), ExpectedBuffer(MakeFrame(9, 50)));
+        }
+
+        TEST_F(BinaryFileTests, StreamWholeFrames)
+        {
+            fileio::SimulariumBinaryFile file;
+            file.Create(this->m_filePath);
+
+            std::size_t numFrames = 6;
+            BroadcastDataBuffer expected;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                file.WriteFrame(MakeFrame(i, 3));
+                auto frame = ExpectedBuffer(MakeFrame(i, 3));
+                expected.insert(expected.end(), frame.begin(), frame.end());
+            }
+
+            // Room for two frames per update
+            std::size_t bufferSize = 2 * ExpectedBuffer(MakeFrame(0, 3)).size() * sizeof(float);
+
+            BroadcastDataBuffer streamed;
+            std::size_t pos = file.GetFramePos(0);
+            while (pos < file.GetEndOfStreamPos()) {
+                auto update = file.GetBroadcastUpdate(pos, bufferSize);
+                EXPECT_EQ(update.new_pos, pos + 2);
+                auto buffer = fileio::ToBroadcastBuffer(update);
+                streamed.insert(streamed.end(), buffer.begin(), buffer.end());
+                pos = update.new_pos;
+            }
+
+            EXPECT_EQ(streamed, expected);
+        }
+
+        TEST_F(BinaryFileTests, CompressedFrames)
+        {
+            std::size_t numFrames = 10;
+            std::string rawFilePath = this->m_filePath + ".raw";
+            {
+                fileio::compression::CompressionOptions options;
+                options.compressor = fileio::compression::Compressor::LZ4;
+
+                fileio::SimulariumBinaryFile compressed;
+                fileio::SimulariumBinaryFile raw;
+                compressed.SetCompression(options);
+                compressed.Create(this->m_filePath);
+                raw.Create(rawFilePath);
+                for (std::size_t i = 0; i < numFrames; ++i) {
+                    compressed.WriteFrame(MakeFrame(i, 200));
+                    raw.WriteFrame(MakeFrame(i, 200));
+                }
+            }
+
+            // Frames decode to the same chunks regardless of how they were read
+            fileio::SimulariumBinaryFile mapped;
+            fileio::SimulariumBinaryFile streamed;
+            mapped.Open(this->m_filePath, true);
+            streamed.Open(this->m_filePath, false);
+            ASSERT_EQ(mapped.NumSavedFrames(), numFrames);
+
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                auto expected = ExpectedBuffer(MakeFrame(i, 200));
+                EXPECT_EQ(fileio::ToBroadcastBuffer(mapped.GetBroadcastFrame(i)), expected);
+                EXPECT_EQ(fileio::ToBroadcastBuffer(streamed.GetBroadcastFrame(i)), expected);
+            }
+
+            // Updates are sized by the decoded frames
+            std::size_t frameSize = ExpectedBuffer(MakeFrame(0, 200)).size() * sizeof(float);
+            auto update = mapped.GetBroadcastUpdate(0, 3 * frameSize);
+            EXPECT_EQ(update.new_pos, 3);
+
+            if (fileio::compression::IsAvailable()) {
+                std::ifstream compressedStream(this->m_filePath, std::ios_base::binary | std::ios_base::ate);
+                std::ifstream rawStream(rawFilePath, std::ios_base::binary | std::ios_base::ate);
+                EXPECT_LT(compressedStream.tellg(), rawStream.tellg());
+            }
+
+            std::remove(rawFilePath.c_str());
+            std::remove((rawFilePath + fileio::binary::INDEX_FILE_SUFFIX).c_str());
+        }
+
+        TEST_F(BinaryFileTests, CompressionRoundTrip)
+        {
+            if (!fileio::compression::IsAvailable()) {
+                GTEST_SKIP() << "Built with SIMULARIUM_BLOSC=OFF";
+            }
+
+            std::vector<float> chunk = fileio::codec::SerializeFrame(MakeFrame(4, 200));
+            const char* src = (const char*)chunk.data();
+            std::size_t size = chunk.size() * sizeof(float);
+
+            for (auto compressor : { fileio::compression::Compressor::LZ4, fileio::compression::Compressor::ZSTD }) {
+                fileio::compression::CompressionOptions options;
+                options.compressor = compressor;
+
+                std::vector<char> compressed;
+                ASSERT_TRUE(fileio::compression::Compress(src, size, options, compressed));
+                EXPECT_LT(compressed.size(), size);
+
+                std::vector<char> decompressed;
+                ASSERT_TRUE(fileio::compression::Decompress(compressed.data(), compressed.size(), options.numThreads, decompressed));
+                ASSERT_EQ(decompressed.size(), size);
+                EXPECT_EQ(std::memcmp(decompressed.data(), src, size), 0);
+
+                // Chunks that don't add up are rejected, not decoded
+                EXPECT_FALSE(fileio::compression::Decompress(compressed.data(), compressed.size() - 1, options.numThreads, decompressed));
+            }
+
+            // Frames of a compressed cache are smaller on disk, and read back whole
+            std::size_t fileSizes[2];
+            for (auto compressor : { fileio::compression::Compressor::None, fileio::compression::Compressor::LZ4 }) {
+                {
+                    fileio::compression::CompressionOptions options;
+                    options.compressor = compressor;
+                    fileio::SimulariumBinaryFile file;
+                    file.SetCompression(options);
+                    file.Create(this->m_filePath);
+                    file.WriteFrame(MakeFrame(4, 200));
+                }
+                std::ifstream is(this->m_filePath, std::ios_base::binary | std::ios_base::ate);
+                fileSizes[compressor == fileio::compression::Compressor::None ? 0 : 1] = is.tellg();
+            }
+            EXPECT_LT(fileSizes[1], fileSizes[0]);
+
+            fileio::SimulariumBinaryFile file;
+            file.Open(this->m_filePath);
+            EXPECT_EQ(fileio::ToBroadcastBuffer(file.GetBroadcastFrame(0)), ExpectedBuffer(MakeFrame(4, 200)));
+        }
+
+        TEST_F(BinaryFileTests, FixedStrideCodec)
+        {
+            TrajectoryFrame particles = MakeFrame(3, 8);
+            for (auto& agent : particles.data) {
+                agent.subpoints.clear();
+            }
+            TrajectoryFrame fibers = MakeFrame(3, 8);
+
+            typedef fileio::codec::FrameCodec<fileio::codec::FixedStrideLayout> FixedCodec;
+            typedef fileio::codec::FrameCodec<fileio::codec::GeneralLayout> GeneralCodec;
+            EXPECT_TRUE(FixedCodec::Accepts(particles));
+            EXPECT_FALSE(FixedCodec::Accepts(fibers));
+
+            // Both layouts write the same chunk
+            std::vector<float> fixedChunk, generalChunk, fiberChunk;
+            FixedCodec::Serialize(particles, fixedChunk);
+            GeneralCodec::Serialize(particles, generalChunk);
+            GeneralCodec::Serialize(fibers, fiberChunk);
+            EXPECT_EQ(fixedChunk, generalChunk);
+            EXPECT_TRUE(FixedCodec::Accepts((const char*)fixedChunk.data(), fixedChunk.size() * sizeof(float)));
+            EXPECT_FALSE(FixedCodec::Accepts((const char*)fiberChunk.data(), fiberChunk.size() * sizeof(float)));
+
+            // Parsing into a frame that held subpoints clears them
+            TrajectoryFrame parsed = fibers;
+            ASSERT_TRUE(FixedCodec::Parse((const char*)fixedChunk.data(), fixedChunk.size() * sizeof(float), parsed));
+            EXPECT_EQ(fileio::codec::SerializeFrame(parsed), generalChunk);
+
+            ASSERT_TRUE(fileio::codec::ParseFrame((const char*)fiberChunk.data(), fiberChunk.size() * sizeof(float), parsed));
+            EXPECT_EQ(fileio::codec::SerializeFrame(parsed), fiberChunk);
+
+            fixedChunk.pop_back();
+            EXPECT_FALSE(fileio::codec::ParseFrame((const char*)fixedChunk.data(), fixedChunk.size() * sizeof(float), parsed));
+        }
+
+        TEST_F(BinaryFileTests, DeltaFrames)
+        {
+            // Agents move a little every frame, and every 7th frame one
+            //  agent is removed and a new one is added at the end
+            std::vector<TrajectoryFrame> frames;
+            TrajectoryFrame frame = MakeFrame(0, 20);
+            for (std::size_t i = 0; i < 30; ++i) {
+                frame.frameNumber = i;
+                frame.time = i * 0.5f;
+                frame.data[i % 20].x += 0.25f;
+                if (i % 7 == 6) {
+                    AgentData added = frame.data.front();
+                    added.id = 100 + i;
+                    frame.data.erase(frame.data.begin());
+                    frame.data.push_back(added);
+                }
+                frames.push_back(frame);
+            }
+
+            {
+                // Deltas are compressed like any other frame
+                fileio::compression::CompressionOptions compression;
+                compression.compressor = fileio::compression::Compressor::LZ4;
+
+                fileio::SimulariumBinaryFile file;
+                file.SetKeyframeInterval(8);
+                file.SetCompression(compression);
+                file.Create(this->m_filePath);
+                for (auto& f : frames) {
+                    file.WriteFrame(f);
+                }
+            }
+
+            fileio::SimulariumBinaryFile file;
+            file.Open(this->m_filePath);
+            ASSERT_EQ(file.NumSavedFrames(), frames.size());
+
+            // Any frame can be rebuilt, in any order
+            for (std::size_t i = frames.size(); i-- > 0;) {
+                EXPECT_EQ(fileio::ToBroadcastBuffer(file.GetBroadcastFrame(i)), ExpectedBuffer(frames[i]));
+            }
+            for (std::size_t i = 0; i < frames.size(); ++i) {
+                EXPECT_EQ(fileio::ToBroadcastBuffer(file.GetBroadcastFrame(i)), ExpectedBuffer(frames[i]));
+            }
+
+            // Delta capable clients get the stored deltas, which rebuild
+            //  the same frames when applied in order
+            StreamOptions options;
+            options.allowDeltas = true;
+            auto update = file.GetBroadcastUpdate(0, std::numeric_limits<std::size_t>::max(), options);
+            ASSERT_EQ(update.frames.size(), frames.size());
+            EXPECT_EQ(update.frames[0].encoding, FrameEncoding::Full);
+
+            std::size_t numDeltas = 0;
+            TrajectoryFrame client;
+            for (auto& view : update.frames) {
+                if (view.encoding == FrameEncoding::Delta) {
+                    ASSERT_TRUE(fileio::codec::ApplyDelta(view.data, view.size, client));
+                    numDeltas++;
+                } else {
+                    ASSERT_TRUE(fileio::codec::ParseFrame(view.data, view.size, client));
+                }
+
+                EXPECT_EQ(fileio::codec::SerializeFrame(client), fileio::codec::SerializeFrame(frames[view.frameNumber]));
+            }
+
+            EXPECT_GE(numDeltas, frames.size() - frames.size() / 8 - 1);
+
+            // The first frame of an update is only a delta if the client has the frame before it
+            EXPECT_EQ(file.GetBroadcastUpdate(5, 1, options).frames[0].encoding, FrameEncoding::Full);
+            options.hasPreviousFrame = true;
+            EXPECT_EQ(file.GetBroadcastUpdate(5, 1, options).frames[0].encoding, FrameEncoding::Delta);
+        }
+
+        TEST_F(BinaryFileTests, QuantizedFrames)
+        {
+            std::vector<TrajectoryFrame> frames;
+            for (std::size_t i = 0; i < 12; ++i) {
+                TrajectoryFrame frame = MakeFrame(i, 50);
+                for (std::size_t j = 0; j < frame.data.size(); ++j) {
+                    frame.data[j].x = 0.37f * j - i;
+                    frame.data[j].y = 0.5f * j - 10;
+                    frame.data[j].z = -0.25f * j;
+                    frame.data[j].xrot = 0.01f * j;
+                    frame.data[j].yrot = -0.02f * i;
+                    frame.data[j].zrot = j % 2 ? 0.5f : 0.f;
+                }
+                frames.push_back(frame);
+            }
+
+            fileio::quantization::QuantizationOptions quantization;
+            quantization.enabled = true;
+            quantization.boxSize = { { 100, 100, 100 } };
+            {
+                fileio::SimulariumBinaryFile file;
+                file.SetQuantization(quantization);
+                file.SetKeyframeInterval(4);
+                file.Create(this->m_filePath);
+                for (auto& frame : frames) {
+                    file.WriteFrame(frame);
+                }
+            }
+
+            fileio::SimulariumBinaryFile file;
+            file.Open(this->m_filePath);
+            ASSERT_EQ(file.NumSavedFrames(), frames.size());
+
+            // 16 bits over a 100 unit box
+            auto error = file.GetQuantizationError();
+            EXPECT_GT(error.position, 0);
+            EXPECT_LE(error.position, 100.f / 65535 / 2 * 1.01f);
+            EXPECT_LT(error.rotation, 1e-3f);
+
+            for (std::size_t i = 0; i < frames.size(); ++i) {
+                auto update = file.GetBroadcastFrame(i);
+                ASSERT_EQ(update.frames.size(), 1);
+
+                TrajectoryFrame decoded;
+                ASSERT_TRUE(fileio::codec::ParseFrame(update.frames[0].data, update.frames[0].size, decoded));
+                ASSERT_EQ(decoded.data.size(), frames[i].data.size());
+                EXPECT_EQ(decoded.frameNumber, i);
+
+                for (std::size_t j = 0; j < decoded.data.size(); ++j) {
+                    const AgentData& expected = frames[i].data[j];
+                    const AgentData& actual = decoded.data[j];
+                    EXPECT_EQ(actual.id, expected.id);
+                    EXPECT_EQ(actual.type, expected.type);
+                    EXPECT_EQ(actual.subpoints, expected.subpoints);
+                    EXPECT_NEAR(actual.x, expected.x, error.position * 1.01f);
+                    EXPECT_NEAR(actual.y, expected.y, error.position * 1.01f);
+                    EXPECT_NEAR(actual.z, expected.z, error.position * 1.01f);
+                    EXPECT_NEAR(actual.xrot, expected.xrot, 1e-3f);
+                    EXPECT_NEAR(actual.yrot, expected.yrot, 1e-3f);
+                    EXPECT_NEAR(actual.zrot, expected.zrot, 1e-3f);
+                }
+            }
+        }
+
+        TEST_F(BinaryFileTests, ColumnarFrames)
+        {
+            std::vector<TrajectoryFrame> frames;
+            for (std::size_t i = 0; i < 10; ++i) {
+                frames.push_back(MakeFrame(i, 30));
+            }
+
+            {
+                fileio::SimulariumBinaryFile file;
+                file.SetColumnarLayout(true);
+                file.SetKeyframeInterval(4);
+                file.Create(this->m_filePath);
+                for (auto& f : frames) {
+                    file.WriteFrame(f);
+                }
+            }
+
+            // Agents come back grouped by type, in their original order within a type
+            for (auto& f : frames) {
+                fileio::columnar::GroupByType(f);
+            }
+            EXPECT_EQ(frames[0].data[1].id, 3u);
+
+            fileio::SimulariumBinaryFile file;
+            file.Open(this->m_filePath);
+            ASSERT_EQ(file.NumSavedFrames(), frames.size());
+            for (std::size_t i = 0; i < frames.size(); ++i) {
+                EXPECT_EQ(fileio::ToBroadcastBuffer(file.GetBroadcastFrame(i)), ExpectedBuffer(frames[i]));
+            }
+
+            StreamOptions options;
+            options.allowColumnar = true;
+            auto update = file.GetBroadcastUpdate(0, std::numeric_limits<std::size_t>::max(), options);
+            ASSERT_EQ(update.frames.size(), frames.size());
+            for (auto& view : update.frames) {
+                ASSERT_EQ(view.encoding, FrameEncoding::Columnar);
+
+                fileio::columnar::ColumnarFrame columns;
+                ASSERT_TRUE(fileio::columnar::Decode(view.data, view.size, columns));
+                ASSERT_EQ(columns.groups.size(), 3u);
+                for (std::size_t g = 0; g < 3; ++g) {
+                    EXPECT_EQ(columns.groups[g].type, float(g));
+                    EXPECT_EQ(columns.groups[g].first, 10 * g);
+                    EXPECT_EQ(columns.groups[g].count, 10u);
+                }
+
+                EXPECT_EQ(
+                    fileio::codec::SerializeFrame(fileio::columnar::FromColumnar(columns)),
+                    fileio::codec::SerializeFrame(frames[view.frameNumber]));
+            }
+
+            // Deltas are still preferred when the client can apply them
+            options.allowDeltas = true;
+            update = file.GetBroadcastUpdate(0, std::numeric_limits<std::size_t>::max(), options);
+            EXPECT_EQ(update.frames[0].encoding, FrameEncoding::Columnar);
+            EXPECT_EQ(update.frames[1].encoding, FrameEncoding::Delta);
+        }
+
+        TEST_F(BinaryFileTests, PackedFrames)
+        {
+            // Frames 3 to 5 have ids that floats would round, and are
+            //  packed even though packed records were not asked for
+            std::vector<TrajectoryFrame> frames;
+            for (std::size_t i = 0; i < 7; ++i) {
+                frames.push_back(MakeFrame(i, 20));
+                for (std::size_t j = 0; i >= 3 && i <= 5 && j < 20; ++j) {
+                    frames[i].data[j].id = 4000000000u + j;
+                }
+            }
+            frames[4].data[1].subpoints.assign(200, 0.25f); // multi-byte subpoint count
+            frames[6].data[0].type = 70000; // too large for a packed record
+
+            {
+                fileio::SimulariumBinaryFile file;
+                file.SetKeyframeInterval(4);
+                file.Create(this->m_filePath);
+                for (auto& f : frames) {
+                    file.WriteFrame(f);
+                }
+            }
+
+            fileio::SimulariumBinaryFile file;
+            file.Open(this->m_filePath);
+            ASSERT_EQ(file.NumSavedFrames(), frames.size());
+            EXPECT_EQ(fileio::ToBroadcastBuffer(file.GetBroadcastFrame(6)), ExpectedBuffer(frames[6]));
+
+            StreamOptions options;
+            options.allowPacked = true;
+            auto update = file.GetBroadcastUpdate(0, std::numeric_limits<std::size_t>::max(), options);
+            ASSERT_EQ(update.frames.size(), frames.size());
+            for (auto& view : update.frames) {
+                if (view.frameNumber == 6) {
+                    EXPECT_EQ(view.encoding, FrameEncoding::Full);
+                    continue;
+                }
+
+                ASSERT_EQ(view.encoding, FrameEncoding::Packed);
+                EXPECT_EQ(view.size % 4, 0u);
+
+                TrajectoryFrame decoded;
+                ASSERT_TRUE(fileio::packed::Decode(view.data, view.size, decoded));
+                const TrajectoryFrame& expected = frames[view.frameNumber];
+                ASSERT_EQ(decoded.data.size(), expected.data.size());
+                for (std::size_t j = 0; j < expected.data.size(); ++j) {
+                    EXPECT_EQ(decoded.data[j].id, expected.data[j].id);
+                }
+                EXPECT_EQ(fileio::codec::SerializeFrame(decoded), fileio::codec::SerializeFrame(expected));
+            }
+
+            // 36 bytes per agent and 24 bytes of subpoints for every other
+            //  agent, against 44 and 28 bytes for a float chunk
+            EXPECT_EQ(update.frames[0].size, 12 + 20 * 36 + 10 * 24u);
+
+            std::vector<char> chunk;
+            ASSERT_TRUE(fileio::packed::Encode(frames[0], chunk));
+            TrajectoryFrame decoded;
+            EXPECT_FALSE(fileio::packed::Decode(chunk.data(), chunk.size() - 4, decoded));
+            EXPECT_FALSE(fileio::packed::Encode(frames[6], chunk));
+        }
+
+        TEST_F(BinaryFileTests, FiberFrames)
+        {
+            // A helix, a straight fiber that simplifies to its ends,
+            //  and a fiber with malformed subpoints that is stored as-is
+            std::vector<TrajectoryFrame> frames;
+            for (std::size_t i = 0; i < 8; ++i) {
+                TrajectoryFrame frame = MakeFrame(i, 4);
+                for (std::size_t f = 0; f < 3; ++f) {
+                    AgentData fiber;
+                    fiber.vis_type = fileio::fiber::kFiberVisType;
+                    fiber.id = 10 + f;
+                    for (std::size_t p = 0; p < 60 && f < 2; ++p) {
+                        float t = 0.1f * p + 0.05f * i;
+                        fiber.subpoints.push_back(f == 0 ? std::cos(t) : 0.2f * p);
+                        fiber.subpoints.push_back(f == 0 ? std::sin(t) : 0.1f * p);
+                        fiber.subpoints.push_back(0.05f * p + i);
+                    }
+                    if (f == 2) {
+                        fiber.subpoints = { 1.f, 2.f, 3.f, 4.f };
+                    }
+                    frame.data.push_back(fiber);
+                }
+                frames.push_back(frame);
+            }
+
+            std::string rawFilePath = this->m_filePath + ".raw";
+            fileio::fiber::FiberOptions options;
+            options.step = 0.001f;
+            options.tolerance = 0.01f;
+            {
+                fileio::SimulariumBinaryFile file;
+                fileio::SimulariumBinaryFile raw;
+                file.SetKeyframeInterval(4);
+                file.SetFiberCoding(options);
+                file.Create(this->m_filePath, frames.size());
+                raw.SetKeyframeInterval(4);
+                raw.Create(rawFilePath, frames.size());
+                for (auto& f : frames) {
+                    file.WriteFrame(f);
+                    raw.WriteFrame(f);
+                }
+            }
+
+            std::ifstream coded(this->m_filePath, std::ios_base::binary | std::ios_base::ate);
+            std::ifstream uncoded(rawFilePath, std::ios_base::binary | std::ios_base::ate);
+            EXPECT_LT(4 * std::size_t(coded.tellg()), std::size_t(uncoded.tellg()));
+            std::remove(rawFilePath.c_str());
+            std::remove((rawFilePath + fileio::binary::INDEX_FILE_SUFFIX).c_str());
+
+            fileio::SimulariumBinaryFile file;
+            file.Open(this->m_filePath);
+            float error = file.GetQuantizationError().fiber;
+            EXPECT_GT(error, 0.f);
+            EXPECT_LE(error, options.tolerance + options.step);
+
+            StreamOptions streamOptions;
+            streamOptions.allowDeltas = true;
+            auto update = file.GetBroadcastUpdate(0, std::numeric_limits<std::size_t>::max(), streamOptions);
+            ASSERT_EQ(update.frames.size(), frames.size());
+            for (auto& view : update.frames) {
+                EXPECT_EQ(view.encoding, FrameEncoding::Full);
+
+                TrajectoryFrame decoded;
+                ASSERT_TRUE(fileio::codec::ParseFrame(view.data, view.size, decoded));
+                const TrajectoryFrame& expected = frames[view.frameNumber];
+                ASSERT_EQ(decoded.data.size(), expected.data.size());
+                for (std::size_t j = 0; j < 4; ++j) {
+                    EXPECT_EQ(fileio::codec::SerializeFrame({ { decoded.data[j] }, 0, 0 }),
+                        fileio::codec::SerializeFrame({ { expected.data[j] }, 0, 0 }));
+                }
+                EXPECT_EQ(decoded.data[6].subpoints, expected.data[6].subpoints);
+                EXPECT_EQ(decoded.data[5].subpoints.size(), 6u);
+                EXPECT_LT(decoded.data[4].subpoints.size(), expected.data[4].subpoints.size());
+
+                // Every original point lies within the error of the stored polyline
+                for (std::size_t f = 4; f < 6; ++f) {
+                    const std::vector<float>& points = expected.data[f].subpoints;
+                    const std::vector<float>& stored = decoded.data[f].subpoints;
+                    for (std::size_t p = 0; p < points.size(); p += 3) {
+                        float closest = std::numeric_limits<float>::max();
+                        for (std::size_t k = 3; k < stored.size(); k += 3) {
+                            closest = std::min(closest, SegmentDistance(&points[p], &stored[k - 3], &stored[k]));
+                        }
+                        EXPECT_LE(closest, error * 1.001f);
+                    }
+                }
+            }
+        }
+
+        TEST_F(BinaryFileTests, StaticAgents)
+        {
+            // Agent 100 never moves, 101 moves from frame 15 on, 102 stops
+            //  moving at frame 5, and 103 is gone after frame 9
+            std::size_t numFrames = 30;
+            std::vector<TrajectoryFrame> frames;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                TrajectoryFrame frame = MakeFrame(i, 6);
+                for (std::uint32_t id = 100; id < 104; ++id) {
+                    AgentData agent;
+                    agent.id = id;
+                    agent.type = 7;
+                    agent.x = (id == 101 && i >= 15) || (id == 102 && i < 5) ? float(i) : 1.f;
+                    agent.subpoints = { 1.f, 2.f, 3.f };
+                    if (id != 103 || i < 10) {
+                        frame.data.push_back(agent);
+                    }
+                }
+                frames.push_back(frame);
+            }
+
+            {
+                fileio::SimulariumBinaryFile file;
+                file.SetKeyframeInterval(4);
+                file.SetStaticAgents(4);
+                file.Create(this->m_filePath);
+                for (auto& frame : frames) {
+                    file.WriteFrame(frame);
+                }
+            }
+
+            auto byId = [](TrajectoryFrame frame) {
+                std::stable_sort(frame.data.begin(), frame.data.end(),
+                    [](const AgentData& a, const AgentData& b) { return a.id < b.id; });
+                return fileio::codec::SerializeFrame(frame);
+            };
+
+            fileio::SimulariumBinaryFile file;
+            file.Open(this->m_filePath);
+            ASSERT_EQ(file.NumSavedFrames(), numFrames);
+
+            fileio::static_layer::StaticLayer layer;
+            std::vector<char> encoded = file.GetStaticLayer();
+            ASSERT_TRUE(fileio::static_layer::Decode(encoded.data(), encoded.size(), layer));
+            ASSERT_EQ(layer.size(), 4u);
+            std::sort(layer.begin(), layer.end(),
+                [](const fileio::static_layer::StaticAgent& a, const fileio::static_layer::StaticAgent& b) { return a.agent.id < b.agent.id; });
+            EXPECT_EQ(layer[0].first, 0u);
+            EXPECT_EQ(layer[0].end, fileio::static_layer::kOpenEnd);
+            EXPECT_EQ(layer[1].first, 0u);
+            EXPECT_EQ(layer[1].end, 15u);
+            EXPECT_EQ(layer[2].first, 5u);
+            EXPECT_EQ(layer[2].end, fileio::static_layer::kOpenEnd);
+            EXPECT_EQ(layer[3].first, 0u);
+            EXPECT_EQ(layer[3].end, 10u);
+
+            // Clients without the layer get every agent back, and no stored deltas
+            StreamOptions options;
+            options.allowDeltas = true;
+            auto update = file.GetBroadcastUpdate(0, std::numeric_limits<std::size_t>::max(), options);
+            ASSERT_EQ(update.frames.size(), numFrames);
+            for (auto& view : update.frames) {
+                EXPECT_EQ(view.encoding, FrameEncoding::Full);
+
+                TrajectoryFrame decoded;
+                ASSERT_TRUE(fileio::codec::ParseFrame(view.data, view.size, decoded));
+                EXPECT_EQ(byId(decoded), byId(frames[view.frameNumber]));
+
+                fileio::FrameStats stats;
+                ASSERT_TRUE(file.GetFrameStats(view.frameNumber, stats));
+                EXPECT_EQ(stats.numAgents, frames[view.frameNumber].data.size());
+            }
+
+            // Clients with the layer only get the agents that aren't in it
+            options.allowDeltas = false;
+            options.omitStaticAgents = true;
+            update = file.GetBroadcastUpdate(0, std::numeric_limits<std::size_t>::max(), options);
+            ASSERT_EQ(update.frames.size(), numFrames);
+            for (auto& view : update.frames) {
+                TrajectoryFrame decoded;
+                ASSERT_TRUE(fileio::codec::ParseFrame(view.data, view.size, decoded));
+                std::size_t numStatic = std::count_if(layer.begin(), layer.end(),
+                    [&view](const fileio::static_layer::StaticAgent& entry) { return entry.Covers(view.frameNumber); });
+                EXPECT_EQ(decoded.data.size() + numStatic, frames[view.frameNumber].data.size());
+
+                fileio::static_layer::AddStaticAgents(layer, view.frameNumber, decoded);
+                EXPECT_EQ(byId(decoded), byId(frames[view.frameNumber]));
+            }
+        }
+
+        TEST_F(BinaryFileTests, TemporalPyramid)
+        {
+            // Agent 100 never moves, so it goes into the static layer
+            std::size_t numFrames = 21;
+            std::vector<TrajectoryFrame> frames;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                TrajectoryFrame frame = MakeFrame(i, 6);
+                AgentData agent;
+                agent.id = 100;
+                agent.x = 1.f;
+                frame.data.push_back(agent);
+                frames.push_back(frame);
+            }
+
+            {
+                fileio::SimulariumBinaryFile file;
+                file.SetKeyframeInterval(4);
+                file.SetStaticAgents(4);
+                file.SetTemporalPyramid(3);
+                file.Create(this->m_filePath);
+                for (auto& frame : frames) {
+                    file.WriteFrame(frame);
+                }
+            }
+
+            auto byId = [](TrajectoryFrame frame) {
+                std::stable_sort(frame.data.begin(), frame.data.end(),
+                    [](const AgentData& a, const AgentData& b) { return a.id < b.id; });
+                return fileio::codec::SerializeFrame(frame);
+            };
+
+            fileio::SimulariumBinaryFile file;
+            file.Open(this->m_filePath);
+            ASSERT_EQ(file.NumSavedFrames(), numFrames);
+            ASSERT_EQ(file.NumPyramidLevels(), 3u);
+            ASSERT_EQ(file.NumStaticAgents(), 1u);
+
+            // A stride of 4 reads every 4th frame from level 2
+            StreamOptions options;
+            options.frameStride = 4;
+            auto update = file.GetBroadcastUpdate(0, std::numeric_limits<std::size_t>::max(), options);
+            ASSERT_EQ(update.frames.size(), 6u);
+            EXPECT_EQ(update.new_pos, numFrames);
+            for (std::size_t i = 0; i < update.frames.size(); ++i) {
+                const FrameView& view = update.frames[i];
+                ASSERT_EQ(view.frameNumber, 4 * i);
+
+                TrajectoryFrame decoded;
+                ASSERT_TRUE(fileio::codec::ParseFrame(view.data, view.size, decoded));
+                EXPECT_EQ(byId(decoded), byId(frames[view.frameNumber]));
+            }
+
+            // Reads start at the next level frame, and strides
+            //  between levels use the finer level
+            options.frameStride = 3;
+            update = file.GetBroadcastUpdate(5, std::numeric_limits<std::size_t>::max(), options);
+            ASSERT_FALSE(update.frames.empty());
+            EXPECT_EQ(update.frames[0].frameNumber, 6u);
+            EXPECT_EQ(update.frames.back().frameNumber, 20u);
+
+            // Clients with the static layer don't get its agents from the levels either
+            options.frameStride = 100;
+            options.omitStaticAgents = true;
+            update = file.GetBroadcastUpdate(0, std::numeric_limits<std::size_t>::max(), options);
+            ASSERT_EQ(update.frames.size(), 3u);
+            for (auto& view : update.frames) {
+                TrajectoryFrame decoded;
+                ASSERT_TRUE(fileio::codec::ParseFrame(view.data, view.size, decoded));
+                EXPECT_EQ(decoded.data.size() + 1, frames[view.frameNumber].data.size());
+            }
+
+            // Once the level runs out, the remaining frames are read from the file
+            update = file.GetBroadcastUpdate(17, std::numeric_limits<std::size_t>::max(), options);
+            ASSERT_EQ(update.frames.size(), 4u);
+            EXPECT_EQ(update.frames[0].frameNumber, 17u);
+
+            // Single frames snap to the nearest level frame
+            options.frameStride = 4;
+            update = file.GetBroadcastFrame(13, options);
+            ASSERT_EQ(update.frames.size(), 1u);
+            EXPECT_EQ(update.frames[0].frameNumber, 12u);
+            EXPECT_EQ(update.new_pos, 16u);
+
+            options.frameStride = 8;
+            update = file.GetBroadcastFrame(20, options);
+            ASSERT_EQ(update.frames.size(), 1u);
+            EXPECT_EQ(update.frames[0].frameNumber, 16u);
+
+            // A file created without levels doesn't pick up the old ones
+            {
+                fileio::SimulariumBinaryFile overwritten;
+                overwritten.Create(this->m_filePath);
+                overwritten.WriteFrame(frames[0]);
+            }
+            file.Open(this->m_filePath);
+            EXPECT_EQ(file.NumPyramidLevels(), 0u);
+        }
+
+        TEST_F(BinaryFileTests, AttributeTable)
+        {
+            // Agent 3 changes type at frame 7, agent 5 grows at frame 12,
+            //  and agents 10 and 11 appear at frame 15
+            std::size_t numFrames = 20;
+            std::vector<TrajectoryFrame> frames;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                TrajectoryFrame frame = MakeFrame(i, i < 15 ? 10 : 12);
+                frame.data[3].type = i < 7 ? 0.f : 4.f;
+                frame.data[5].collision_radius = i < 12 ? 1.f : 2.5f;
+                frames.push_back(frame);
+            }
+
+            {
+                fileio::SimulariumBinaryFile file;
+                file.SetKeyframeInterval(4);
+                file.SetAttributeTable(true);
+                file.SetWriteBuffer(1 << 20, 6);
+                file.Create(this->m_filePath);
+                for (auto& frame : frames) {
+                    file.WriteFrame(frame);
+                }
+            }
+
+            fileio::SimulariumBinaryFile file;
+            file.Open(this->m_filePath);
+            ASSERT_EQ(file.NumSavedFrames(), numFrames);
+
+            // A record per agent in the first frame, then one per change
+            std::vector<fileio::attributes::AttributeRecord> records;
+            std::vector<char> encoded = file.GetAttributeRecords(0, numFrames);
+            ASSERT_TRUE(fileio::attributes::Decode(encoded.data(), encoded.size(), records));
+            ASSERT_EQ(records.size(), 14u);
+            EXPECT_EQ(records[10].frame, 7u);
+            EXPECT_EQ(records[10].id, 3u);
+            EXPECT_EQ(records[10].type, 4.f);
+            EXPECT_EQ(records[11].frame, 12u);
+            EXPECT_EQ(records[11].collisionRadius, 2.5f);
+            EXPECT_EQ(records[13].frame, 15u);
+            EXPECT_EQ(records[13].id, 11u);
+
+            encoded = file.GetAttributeRecords(10, 12);
+            ASSERT_TRUE(fileio::attributes::Decode(encoded.data(), encoded.size(), records));
+            EXPECT_EQ(records.size(), 2u);
+
+            // Clients without the table get every attribute back
+            auto update = file.GetBroadcastUpdate(0, std::numeric_limits<std::size_t>::max());
+            ASSERT_EQ(update.frames.size(), numFrames);
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                EXPECT_EQ(update.frames[i].encoding, FrameEncoding::Full);
+            }
+            EXPECT_EQ(fileio::ToBroadcastBuffer(update), [&]() {
+                BroadcastDataBuffer expected;
+                for (auto& frame : frames) {
+                    auto buffer = ExpectedBuffer(frame);
+                    expected.insert(expected.end(), buffer.begin(), buffer.end());
+                }
+                return expected;
+            }());
+
+            // Clients with the table rebuild frames from the records sent so far
+            StreamOptions options;
+            options.omitAttributes = true;
+            update = file.GetBroadcastUpdate(0, std::numeric_limits<std::size_t>::max(), options);
+            ASSERT_EQ(update.frames.size(), numFrames);
+
+            fileio::attributes::AttributeTable table;
+            for (auto& view : update.frames) {
+                EXPECT_EQ(view.encoding, FrameEncoding::Transforms);
+
+                encoded = file.GetAttributeRecords(table.Size(), view.frameNumber);
+                ASSERT_TRUE(fileio::attributes::Decode(encoded.data(), encoded.size(), records));
+                for (auto& record : records) {
+                    table.Append(record);
+                }
+
+                TrajectoryFrame decoded;
+                ASSERT_TRUE(fileio::attributes::ParseFrame(view.data, view.size, decoded));
+                ASSERT_TRUE(table.Apply(view.frameNumber, decoded));
+                EXPECT_EQ(fileio::codec::SerializeFrame(decoded), fileio::codec::SerializeFrame(frames[view.frameNumber]));
+                EXPECT_LT(view.size, fileio::codec::SerializeFrame(frames[view.frameNumber]).size() * sizeof(float));
+            }
+        }
+
+        TEST_F(BinaryFileTests, BufferedWrites)
+        {
+            std::size_t numFrames = 100;
+            {
+                fileio::SimulariumBinaryFile writer;
+                writer.SetWriteBuffer(1 << 20, 16);
+                writer.Create(this->m_filePath, 32);
+                for (std::size_t i = 0; i < numFrames; ++i) {
+                    writer.WriteFrame(MakeFrame(i, 10));
+                }
+
+                // Buffered frames can be read through the writer
+                ASSERT_EQ(writer.NumSavedFrames(), numFrames);
+                for (std::size_t i = 0; i < numFrames; ++i) {
+                    EXPECT_EQ(fileio::ToBroadcastBuffer(writer.GetBroadcastFrame(i)), ExpectedBuffer(MakeFrame(i, 10)));
+                }
+
+                // Other readers only see flushed frames, all of which are complete
+                fileio::SimulariumBinaryFile reader;
+                reader.Open(this->m_filePath, false);
+                EXPECT_EQ(reader.NumSavedFrames(), 96u);
+                for (std::size_t i = 0; i < reader.NumSavedFrames(); ++i) {
+                    EXPECT_EQ(fileio::ToBroadcastBuffer(reader.GetBroadcastFrame(i)), ExpectedBuffer(MakeFrame(i, 10)));
+                }
+            }
+
+            // The rest is flushed when the writer goes away
+            fileio::SimulariumBinaryFile file;
+            file.Open(this->m_filePath);
+            ASSERT_EQ(file.NumSavedFrames(), numFrames);
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                EXPECT_EQ(fileio::ToBroadcastBuffer(file.GetBroadcastFrame(i)), ExpectedBuffer(MakeFrame(i, 10)));
+            }
+        }
+
+        TEST_F(BinaryFileTests, ResumeAfterCheckpoint)
+        {
+            // Agent 100 is static until frame 18, past the point of the interruption
+            std::size_t numFrames = 30;
+            std::vector<TrajectoryFrame> frames;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                TrajectoryFrame frame = MakeFrame(i, 6);
+                AgentData agent;
+                agent.id = 100;
+                agent.x = i < 18 ? 1.f : float(i);
+                frame.data.push_back(agent);
+                frames.push_back(frame);
+            }
+
+            auto configure = [](fileio::SimulariumBinaryFile& file) {
+                file.SetKeyframeInterval(4);
+                file.SetStaticAgents(4);
+                file.SetAttributeTable(true);
+                file.SetWriteBuffer(1 << 20, 1024);
+            };
+
+            // The cache as a crashed writer leaves it: checkpointed
+            //  frames on disk, the frames after them lost
+            std::string interrupted = this->m_filePath + ".interrupted";
+            std::size_t numCheckpointed = 0;
+            {
+                fileio::SimulariumBinaryFile writer;
+                configure(writer);
+                writer.Create(this->m_filePath);
+                for (std::size_t i = 0; i < 12; ++i) {
+                    writer.WriteFrame(frames[i]);
+                }
+                numCheckpointed = writer.Checkpoint();
+                for (std::size_t i = 12; i < 16; ++i) {
+                    writer.WriteFrame(frames[i]);
+                }
+
+                std::ifstream src(this->m_filePath, std::ios_base::binary);
+                std::ofstream dst(interrupted, std::ios_base::binary);
+                dst << src.rdbuf();
+            }
+            ASSERT_GT(numCheckpointed, 0u);
+            ASSERT_LE(numCheckpointed, 12u);
+
+            {
+                fileio::SimulariumBinaryFile writer;
+                configure(writer);
+                writer.Open(interrupted);
+                ASSERT_EQ(writer.NumSavedFrames(), numCheckpointed);
+                for (std::size_t i = numCheckpointed; i < numFrames; ++i) {
+                    writer.WriteFrame(frames[i]);
+                }
+            }
+
+            auto byId = [](TrajectoryFrame frame) {
+                std::stable_sort(frame.data.begin(), frame.data.end(),
+                    [](const AgentData& a, const AgentData& b) { return a.id < b.id; });
+                return fileio::codec::SerializeFrame(frame);
+            };
+
+            fileio::SimulariumBinaryFile file;
+            file.Open(interrupted);
+            ASSERT_EQ(file.NumSavedFrames(), numFrames);
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                TrajectoryFrame decoded;
+                auto update = file.GetBroadcastFrame(i);
+                ASSERT_EQ(update.frames.size(), 1u);
+                ASSERT_TRUE(fileio::codec::ParseFrame(update.frames[0].data, update.frames[0].size, decoded));
+                EXPECT_EQ(byId(decoded), byId(frames[i]));
+
+                fileio::FrameStats stats;
+                ASSERT_TRUE(file.GetFrameStats(i, stats));
+                EXPECT_EQ(stats.numAgents, frames[i].data.size());
+            }
+
+            std::remove(interrupted.c_str());
+            std::remove((interrupted + fileio::binary::INDEX_FILE_SUFFIX).c_str());
+        }
+
+        TEST_F(BinaryFileTests, SegmentedFiles)
+        {
+            // Agent 100 is static, so segments have a static layer of their own
+            std::size_t numFrames = 30;
+            std::size_t segmentFrames = 8;
+            std::vector<TrajectoryFrame> frames;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                TrajectoryFrame frame = MakeFrame(i, 6);
+                AgentData agent;
+                agent.id = 100;
+                agent.x = 1.f;
+                frame.data.push_back(agent);
+                frames.push_back(frame);
+            }
+
+            auto configure = [](fileio::SimulariumBinaryFile& file) {
+                file.SetKeyframeInterval(4);
+                file.SetStaticAgents(4);
+                file.SetAttributeTable(true);
+            };
+
+            auto byId = [](TrajectoryFrame frame) {
+                std::stable_sort(frame.data.begin(), frame.data.end(),
+                    [](const AgentData& a, const AgentData& b) { return a.id < b.id; });
+                return fileio::codec::SerializeFrame(frame);
+            };
+
+            {
+                fileio::SegmentedBinaryFile writer;
+                writer.SetSegmentSettings(configure);
+                writer.Create(this->m_filePath, segmentFrames);
+                for (std::size_t i = 0; i < numFrames; ++i) {
+                    writer.WriteFrame(frames[i]);
+                }
+                writer.Flush();
+                EXPECT_EQ(writer.NumSegments(), 4u);
+                EXPECT_EQ(writer.NumSavedFrames(), numFrames);
+            }
+            EXPECT_TRUE(fileio::SegmentedBinaryFile::Exists(this->m_filePath));
+            EXPECT_FALSE(std::ifstream(this->m_filePath).good());
+
+            fileio::SegmentedBinaryFile file;
+            file.SetSegmentSettings(configure);
+            file.Open(this->m_filePath);
+            ASSERT_TRUE(file.IsSegmented());
+            ASSERT_EQ(file.NumSavedFrames(), numFrames);
+            EXPECT_EQ(file.GetFilePaths().size(), 9u);
+            EXPECT_TRUE(file.GetStaticLayer().empty());
+
+            // Manifests of a major version the reader doesn't know are rejected
+            std::string manifestPath = fileio::segments::ManifestPath(this->m_filePath);
+            fileio::segments::Manifest manifest;
+            ASSERT_TRUE(fileio::segments::ReadManifest(manifestPath, manifest));
+            {
+                std::fstream fs(manifestPath, std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+                fs.seekp(13);
+                fs.put(char(2));
+            }
+            EXPECT_FALSE(fileio::segments::ReadManifest(manifestPath, manifest));
+            ASSERT_TRUE(fileio::segments::WriteManifest(manifestPath, manifest));
+
+            // Updates stop at the end of a segment, and clients that hold a
+            //  static layer still get every frame with all of its agents
+            StreamOptions options;
+            options.omitStaticAgents = true;
+            options.omitAttributes = true;
+            std::size_t pos = 0;
+            while (pos < numFrames) {
+                auto update = file.GetBroadcastUpdate(pos, 1 << 20, options);
+                ASSERT_FALSE(update.frames.empty());
+                EXPECT_EQ(update.new_pos, std::min((pos / segmentFrames + 1) * segmentFrames, numFrames));
+                for (auto& view : update.frames) {
+                    TrajectoryFrame decoded;
+                    ASSERT_TRUE(fileio::codec::ParseFrame(view.data, view.size, decoded));
+                    EXPECT_EQ(view.frameNumber, pos);
+                    EXPECT_EQ(byId(decoded), byId(frames[pos]));
+                    pos++;
+                }
+                EXPECT_EQ(update.new_pos, pos);
+            }
+
+            std::size_t frameNumber = 0;
+            ASSERT_TRUE(file.FindFrameForTime(frames[20].time, frameNumber));
+            EXPECT_EQ(frameNumber, 20u);
+            fileio::FrameStats stats;
+            ASSERT_TRUE(file.GetFrameStats(17, stats));
+            EXPECT_FLOAT_EQ(stats.time, frames[17].time);
+
+            // Frames of an evicted segment are not available, until it is back
+            std::string segmentPath = fileio::segments::SegmentPath(this->m_filePath, 1);
+            std::string segmentData;
+            {
+                std::ifstream is(segmentPath, std::ios_base::binary);
+                segmentData.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+            }
+            ASSERT_TRUE(file.EvictSegment(1));
+            EXPECT_FALSE(file.HasSegment(1));
+            EXPECT_EQ(file.NumSavedFrames(), numFrames);
+
+            auto missing = file.GetBroadcastUpdate(9, 1 << 20);
+            EXPECT_TRUE(missing.frames.empty());
+            EXPECT_EQ(missing.new_pos, 9u);
+            EXPECT_TRUE(file.GetBroadcastFrame(9).frames.empty());
+
+            {
+                std::ofstream os(segmentPath, std::ios_base::binary);
+                os << segmentData;
+            }
+            EXPECT_TRUE(file.HasSegment(1));
+            auto restored = file.GetBroadcastFrame(9);
+            ASSERT_EQ(restored.frames.size(), 1u);
+            EXPECT_EQ(restored.new_pos, 10u);
+
+            // Without segments, the cache is a single binary file
+            {
+                fileio::SegmentedBinaryFile writer;
+                writer.SetSegmentSettings(configure);
+                writer.Create(this->m_filePath);
+                for (std::size_t i = 0; i < 10; ++i) {
+                    writer.WriteFrame(frames[i]);
+                }
+            }
+            EXPECT_FALSE(std::ifstream(fileio::segments::ManifestPath(this->m_filePath)).good());
+            EXPECT_FALSE(std::ifstream(segmentPath).good());
+
+            fileio::SegmentedBinaryFile single;
+            single.Open(this->m_filePath);
+            EXPECT_FALSE(single.IsSegmented());
+            EXPECT_EQ(single.NumSavedFrames(), 10u);
+            EXPECT_FALSE(single.GetStaticLayer().empty());
+
+            fileio::SegmentedBinaryFile::Remove(this->m_filePath);
+            EXPECT_FALSE(fileio::SegmentedBinaryFile::Exists(this->m_filePath));
+        }
+
+        TEST_F(BinaryFileTests, SparseFill)
+        {
+            std::size_t segmentFrames = 4;
+            std::vector<TrajectoryFrame> frames;
+            for (std::size_t i = 0; i < 16; ++i) {
+                frames.push_back(MakeFrame(i, 3));
+            }
+
+            auto expectRanges = [](fileio::SegmentedBinaryFile& file, std::vector<std::size_t> bounds) {
+                auto ranges = file.GetAvailableRanges();
+                ASSERT_EQ(ranges.size() * 2, bounds.size());
+                for (std::size_t i = 0; i < ranges.size(); ++i) {
+                    EXPECT_EQ(ranges[i].begin, bounds[2 * i]);
+                    EXPECT_EQ(ranges[i].end, bounds[2 * i + 1]);
+                }
+            };
+
+            {
+                // Frames 8 to 13 first, as if a client were watching them
+                fileio::SegmentedBinaryFile writer;
+                writer.Create(this->m_filePath, segmentFrames);
+                EXPECT_FALSE(writer.SetWritePosition(9));
+                ASSERT_TRUE(writer.SetWritePosition(8));
+                for (std::size_t i = 8; i < 14; ++i) {
+                    ASSERT_TRUE(writer.WriteFrame(frames[i]));
+                }
+                writer.Flush();
+
+                EXPECT_EQ(writer.NumSavedFrames(), 14u);
+                EXPECT_FALSE(writer.HasFrame(0));
+                EXPECT_TRUE(writer.HasFrame(9));
+                expectRanges(writer, { 8, 14 });
+
+                auto missing = writer.GetBroadcastUpdate(2, 1 << 20);
+                EXPECT_TRUE(missing.frames.empty());
+                EXPECT_EQ(missing.new_pos, 2u);
+                EXPECT_TRUE(writer.GetBroadcastFrame(5).frames.empty());
+
+                auto update = writer.GetBroadcastUpdate(8, 1 << 20);
+                ASSERT_EQ(update.frames.size(), 4u);
+                EXPECT_EQ(update.frames.front().frameNumber, 8u);
+                EXPECT_EQ(update.new_pos, 12u);
+
+                // The frames before, up to those that are there
+                EXPECT_FALSE(writer.SetWritePosition(2));
+                EXPECT_FALSE(writer.SetWritePosition(13));
+                EXPECT_EQ(writer.GetFillPosition(13), 14u);
+                ASSERT_TRUE(writer.SetWritePosition(0));
+                for (std::size_t i = 0; i < 8; ++i) {
+                    ASSERT_TRUE(writer.WriteFrame(frames[i]));
+                }
+                EXPECT_FALSE(writer.WriteFrame(frames[8]));
+                writer.Flush();
+                expectRanges(writer, { 0, 14 });
+
+                ASSERT_TRUE(writer.SetWritePosition(writer.GetFillPosition(12)));
+                EXPECT_EQ(writer.GetWritePosition(), 14u);
+                ASSERT_TRUE(writer.WriteFrame(frames[14]));
+            }
+
+            fileio::SegmentedBinaryFile file;
+            file.Open(this->m_filePath);
+            EXPECT_EQ(file.NumSavedFrames(), 15u);
+            expectRanges(file, { 0, 15 });
+            for (std::size_t i = 0; i < 15; ++i) {
+                auto update = file.GetBroadcastFrame(i);
+                ASSERT_EQ(update.frames.size(), 1u);
+                EXPECT_EQ(fileio::ToBroadcastBuffer(update), ExpectedBuffer(frames[i]));
+            }
+
+            std::size_t frameNumber = 0;
+            ASSERT_TRUE(file.FindFrameForTime(frames[6].time, frameNumber));
+            EXPECT_EQ(frameNumber, 6u);
+        }
+
+        TEST_F(BinaryFileTests, PartialCache)
+        {
+            std::size_t numFrames = 60;
+            {
+                fileio::SimulariumBinaryFile file;
+                file.SetKeyframeInterval(8);
+                file.SetAttributeTable(true);
+                file.Create(this->m_filePath, 16);
+                for (std::size_t i = 0; i < numFrames; ++i) {
+                    file.WriteFrame(MakeFrame(i, 50));
+                }
+            }
+
+            // The cache is only read a range at a time, its frame index stays
+            std::string sourcePath = this->m_filePath + ".source";
+            ASSERT_EQ(std::rename(this->m_filePath.c_str(), sourcePath.c_str()), 0);
+            std::ifstream source(sourcePath, std::ios_base::binary | std::ios_base::ate);
+            std::uint64_t sourceSize = source.tellg();
+            std::uint64_t bytesRead = 0;
+            auto read = [&](std::uint64_t offset, std::uint64_t size, std::vector<char>& out) {
+                out.resize(size);
+                bytesRead += size;
+                source.seekg(offset, std::ios_base::beg);
+                return bool(source.read(out.data(), size));
+            };
+
+            // Only the layout is read before the cache is opened
+            ASSERT_TRUE(fileio::SegmentedBinaryFile::CreatePartial(this->m_filePath, read, sourceSize));
+            EXPECT_LT(bytesRead, sourceSize / 4);
+
+            fileio::SegmentedBinaryFile partial;
+            partial.Open(this->m_filePath);
+            EXPECT_TRUE(partial.IsPartial());
+            EXPECT_EQ(partial.NumSavedFrames(), 0u);
+            EXPECT_FALSE(partial.HasFrame(0));
+
+            // Frames are readable as soon as they are there, in playback order
+            std::uint64_t offset = 0;
+            std::uint64_t size = 0;
+            std::size_t endFrame = 0;
+            std::size_t numDownloaded = 0;
+            while (partial.GetMissingRange(16 << 10, offset, size, endFrame)) {
+                ASSERT_GT(endFrame, numDownloaded);
+                std::vector<char> data;
+                ASSERT_TRUE(read(offset, size, data));
+                ASSERT_TRUE(partial.AddDownloadedFrames(offset, data, endFrame));
+                numDownloaded = endFrame;
+
+                EXPECT_EQ(partial.NumSavedFrames(), numDownloaded);
+                EXPECT_EQ(fileio::ToBroadcastBuffer(partial.GetBroadcastFrame(numDownloaded - 1)),
+                    ExpectedBuffer(MakeFrame(numDownloaded - 1, 50)));
+                EXPECT_TRUE(partial.GetBroadcastFrame(numDownloaded).frames.empty());
+
+                // Opened again, the cache picks up where the download left off
+                if (numDownloaded < numFrames) {
+                    fileio::SegmentedBinaryFile reopened;
+                    reopened.Open(this->m_filePath);
+                    EXPECT_TRUE(reopened.IsPartial());
+                    EXPECT_EQ(reopened.NumSavedFrames(), numDownloaded);
+                }
+            }
+            EXPECT_EQ(numDownloaded, numFrames);
+            EXPECT_FALSE(partial.IsPartial());
+            EXPECT_FALSE(std::ifstream(this->m_filePath + fileio::PARTIAL_FILE_SUFFIX));
+
+            fileio::SegmentedBinaryFile reopened;
+            reopened.Open(this->m_filePath);
+            EXPECT_FALSE(reopened.IsPartial());
+            EXPECT_EQ(reopened.NumSavedFrames(), numFrames);
+            BroadcastDataBuffer expected;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                auto frame = ExpectedBuffer(MakeFrame(i, 50));
+                expected.insert(expected.end(), frame.begin(), frame.end());
+            }
+            BroadcastDataBuffer streamed;
+            for (std::size_t pos = 0; pos < numFrames;) {
+                auto update = reopened.GetBroadcastUpdate(pos, 64 << 10);
+                ASSERT_GT(update.new_pos, pos);
+                auto buffer = fileio::ToBroadcastBuffer(update);
+                streamed.insert(streamed.end(), buffer.begin(), buffer.end());
+                pos = update.new_pos;
+            }
+            EXPECT_EQ(streamed, expected);
+
+            source.close();
+            std::remove(sourcePath.c_str());
+        }
+
+        TEST_F(BinaryFileTests, ArrowExport)
+        {
+            std::size_t numFrames = 10;
+            {
+                fileio::SegmentedBinaryFile writer;
+                writer.Create(this->m_filePath, 4);
+                for (std::size_t i = 0; i < numFrames; ++i) {
+                    writer.WriteFrame(MakeFrame(i, 5));
+                }
+            }
+
+            fileio::SegmentedBinaryFile cache;
+            cache.Open(this->m_filePath);
+            std::string arrowPath = this->m_filePath + ".arrow";
+            ASSERT_TRUE(fileio::arrow::ExportCache(cache, arrowPath, 3));
+
+            std::string data;
+            {
+                std::ifstream is(arrowPath, std::ios_base::binary);
+                data.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+            }
+            std::remove(arrowPath.c_str());
+
+            // Magic, padded to 8 bytes, then the schema message
+            const std::size_t magicSize = sizeof(fileio::arrow::kMagic);
+            ASSERT_GT(data.size(), 64u);
+            EXPECT_EQ(data.compare(0, magicSize, fileio::arrow::kMagic, magicSize), 0);
+            EXPECT_EQ(data.compare(data.size() - magicSize, magicSize, fileio::arrow::kMagic, magicSize), 0);
+            std::uint32_t continuation = 0;
+            std::memcpy(&continuation, &data[8], sizeof(continuation));
+            EXPECT_EQ(continuation, 0xFFFFFFFFu);
+
+            // The footer is preceded by the end-of-stream marker
+            std::int32_t footerSize = 0;
+            std::memcpy(&footerSize, &data[data.size() - magicSize - 4], sizeof(footerSize));
+            ASSERT_GT(footerSize, 0);
+            std::size_t footerStart = data.size() - magicSize - 4 - footerSize;
+            ASSERT_LT(footerStart, data.size());
+            std::uint32_t endOfStream[2] = { 0, 1 };
+            std::memcpy(endOfStream, &data[footerStart - 8], sizeof(endOfStream));
+            EXPECT_EQ(endOfStream[0], 0xFFFFFFFFu);
+            EXPECT_EQ(endOfStream[1], 0u);
+        }
+
+        TEST_F(BinaryFileTests, TocMirrorConcurrentReads)
+        {
+            fileio::TocMirror toc;
+            std::size_t numEntries = 200000;
+
+            // Every entry a reader can see has been fully written
+            std::thread reader([&toc, numEntries] {
+                std::size_t size = 0;
+                while (size < numEntries) {
+                    std::size_t next = toc.Size();
+                    ASSERT_GE(next, size);
+                    if (next > 0) {
+                        ASSERT_EQ(toc[next - 1].offset, next - 1);
+                        ASSERT_EQ(toc[next - 1].size, std::uint32_t(next));
+                    }
+                    size = next;
+                }
+            });
+
+            for (std::size_t i = 0; i < numEntries; ++i) {
+                fileio::binary::TocEntry entry;
+                entry.offset = i;
+                entry.size = std::uint32_t(i + 1);
+                toc.Append(entry);
+            }
+            reader.join();
+
+            for (std::size_t i = 0; i < numEntries; ++i) {
+                EXPECT_EQ(toc[i].offset, i);
+            }
+        }
+
+        TEST_F(BinaryFileTests, ConcurrentReadsWhileWriting)
+        {
+            std::size_t numFrames = 300;
+            fileio::SimulariumBinaryFile file;
+            file.SetKeyframeInterval(4);
+            file.SetWriteBuffer(4096, 8);
+            file.Create(this->m_filePath, 64);
+            ASSERT_TRUE(std::ifstream(this->m_filePath).is_open()) << "Failed to create " << this->m_filePath;
+
+            // Readers check the newest visible frame, and stream from the start;
+            //  they give up if the writer stalls, rather than hang the suite
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+            std::vector<std::thread> readers;
+            for (std::size_t r = 0; r < 4; ++r) {
+                readers.emplace_back([this, &file, numFrames, r, deadline] {
+                    std::size_t pos = 0;
+                    while (pos < numFrames) {
+                        if (std::chrono::steady_clock::now() > deadline) {
+                            ADD_FAILURE() << "Reader " << r << " timed out at frame " << pos;
+                            return;
+                        }
+
+                        std::size_t available = file.NumSavedFrames();
+                        if (pos >= available) {
+                            std::this_thread::yield();
+                            continue;
+                        }
+
+                        if (r % 2) {
+                            std::size_t last = available - 1;
+                            EXPECT_EQ(fileio::ToBroadcastBuffer(file.GetBroadcastFrame(last)), ExpectedBuffer(MakeFrame(last, 6)));
+                            pos = available;
+                        } else {
+                            auto update = file.GetBroadcastUpdate(pos, 1);
+                            ASSERT_EQ(update.frames.size(), 1u);
+                            EXPECT_EQ(fileio::ToBroadcastBuffer(update), ExpectedBuffer(MakeFrame(pos, 6)));
+                            pos = update.new_pos;
+                        }
+                    }
+                });
+            }
+
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                file.WriteFrame(MakeFrame(i, 6));
+            }
+            for (auto& reader : readers) {
+                reader.join();
+            }
+        }
+
+        TEST_F(BinaryFileTests, FrameIndex)
+        {
+            // Frame times with a varying time step
+            std::vector<float> times = { 0.f, 1.f, 2.f, 4.f, 8.f, 8.f, 16.f };
+            {
+                fileio::SimulariumBinaryFile file;
+                file.SetKeyframeInterval(3);
+                file.Create(this->m_filePath);
+                for (std::size_t i = 0; i < times.size(); ++i) {
+                    TrajectoryFrame frame = MakeFrame(i, i == 2 ? 0 : 9 + i);
+                    frame.time = times[i];
+                    file.WriteFrame(frame);
+                }
+
+                fileio::FrameStats stats;
+                ASSERT_TRUE(file.GetFrameStats(3, stats));
+                TrajectoryFrame frame = MakeFrame(3, 12);
+                EXPECT_EQ(stats.time, 4.0);
+                EXPECT_EQ(stats.numAgents, 12u);
+                EXPECT_EQ(stats.frameSize, (ExpectedBuffer(frame).size() * sizeof(float)) - fileio::binary::EOF_SIZE);
+                EXPECT_EQ(stats.lo, (std::array<float, 3> { { 3.f, 3.f - 1.5f * 11, 0.f } }));
+                EXPECT_EQ(stats.hi, (std::array<float, 3> { { 3.f + 11, 3.f, 22.f } }));
+
+                ASSERT_TRUE(file.GetFrameStats(2, stats));
+                EXPECT_EQ(stats.numAgents, 0u);
+                EXPECT_GT(stats.lo[0], stats.hi[0]);
+                EXPECT_FALSE(file.GetFrameStats(times.size(), stats));
+            }
+
+            std::string indexPath = this->m_filePath + fileio::binary::INDEX_FILE_SUFFIX;
+            for (int pass = 0; pass < 2; ++pass) {
+                // The index is read back, then rebuilt from the frames once deleted
+                if (pass == 1) {
+                    std::remove(indexPath.c_str());
+                }
+
+                fileio::SimulariumBinaryFile file;
+                file.Open(this->m_filePath);
+
+                std::size_t frameNumber = 0;
+                ASSERT_TRUE(file.FindFrameForTime(-5.0, frameNumber));
+                EXPECT_EQ(frameNumber, 0u);
+                file.FindFrameForTime(2.9, frameNumber);
+                EXPECT_EQ(frameNumber, 2u);
+                file.FindFrameForTime(3.0, frameNumber); // ties go to the later frame
+                EXPECT_EQ(frameNumber, 3u);
+                file.FindFrameForTime(8.0, frameNumber);
+                EXPECT_EQ(frameNumber, 4u);
+                file.FindFrameForTime(11.0, frameNumber);
+                EXPECT_EQ(frameNumber, 5u);
+                file.FindFrameForTime(100.0, frameNumber);
+                EXPECT_EQ(frameNumber, times.size() - 1);
+
+                fileio::FrameStats stats;
+                ASSERT_TRUE(file.GetFrameStats(6, stats));
+                EXPECT_EQ(stats.time, 16.0);
+                EXPECT_EQ(stats.numAgents, 15u);
+            }
+        }
+
+        TEST_F(BinaryFileTests, ReadVersion1)
+        {
+            std::size_t numFrames = 3;
+            {
+                // v1 layout: header, int32 count, int32 offsets, delimited frames
+                std::ofstream os(this->m_filePath, std::ios_base::binary);
+                const char header[16] = { 'S', 'I', 'M', 'U', 'L', 'A', 'R', 'I', 'U', 'M', 'B', 'I', 'N', 1, 0, 0 };
+                os.write(header, sizeof(header));
+
+                std::vector<std::int32_t> toc(numFrames + 1, 0);
+                toc[0] = numFrames;
+                std::int32_t pos = sizeof(header) + toc.size() * sizeof(toc[0]);
+                std::vector<float> chunks;
+                for (std::size_t i = 0; i < numFrames; ++i) {
+                    toc[i + 1] = pos + chunks.size() * sizeof(float);
+                    auto frame = ExpectedBuffer(MakeFrame(i, 4));
+                    chunks.insert(chunks.end(), frame.begin(), frame.end());
+                }
+
+                os.write((char*)&toc[0], toc.size() * sizeof(toc[0]));
+                os.write((char*)&chunks[0], chunks.size() * sizeof(chunks[0]));
+            }
+
+            fileio::SimulariumBinaryFile file;
+            file.Open(this->m_filePath);
+            EXPECT_EQ(file.GetMajorVersion(), 1);
+            ASSERT_EQ(file.NumSavedFrames(), numFrames);
+
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                EXPECT_EQ(fileio::ToBroadcastBuffer(file.GetBroadcastFrame(i)), ExpectedBuffer(MakeFrame(i, 4)));
+            }
+        }
+
+        TEST_F(BinaryFileTests, FrameCache)
+        {
+            fileio::SimulariumBinaryFile file;
+            file.Create(this->m_filePath);
+            std::size_t numFrames = 4;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                file.WriteFrame(MakeFrame(i, 5));
+            }
+            file.Flush();
+
+            // Room for two frames in a single shard
+            std::size_t frameSize = file.GetBroadcastFrame(0).frames[0].size;
+            fileio::FrameCache cache(2 * frameSize + frameSize / 2, 1);
+            std::atomic<int> loads { 0 };
+            auto get = [&](std::size_t frameNumber, StreamOptions options) {
+                return cache.GetOrLoad("test", frameNumber, options, [&]() {
+                    loads++;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                    return file.GetBroadcastFrame(frameNumber, options);
+                });
+            };
+
+            EXPECT_EQ(fileio::ToBroadcastBuffer(get(1, StreamOptions())), ExpectedBuffer(MakeFrame(1, 5)));
+            EXPECT_EQ(fileio::ToBroadcastBuffer(get(1, StreamOptions())), ExpectedBuffer(MakeFrame(1, 5)));
+            EXPECT_EQ(loads, 1);
+
+            // Frames read with other options are kept apart
+            StreamOptions strided;
+            strided.frameStride = 2;
+            get(1, strided);
+            EXPECT_EQ(loads, 2);
+
+            // The least recently used frame is evicted
+            get(1, StreamOptions());
+            get(2, StreamOptions());
+            get(1, StreamOptions());
+            EXPECT_EQ(loads, 3);
+            get(1, strided);
+            EXPECT_EQ(loads, 4);
+
+            auto stats = cache.GetStats();
+            EXPECT_EQ(stats.hits, 3u);
+            EXPECT_EQ(stats.misses, 4u);
+            EXPECT_EQ(stats.entries, 2u);
+            EXPECT_GT(stats.evictions, 0u);
+
+            // Concurrent requests for a frame share one load
+            std::vector<std::thread> clients;
+            std::vector<BroadcastDataBuffer> received(4);
+            for (std::size_t i = 0; i < received.size(); ++i) {
+                clients.emplace_back([&, i]() { received[i] = fileio::ToBroadcastBuffer(get(3, StreamOptions())); });
+            }
+            for (auto& client : clients) {
+                client.join();
+            }
+            EXPECT_EQ(loads, 5);
+            for (auto& buffer : received) {
+                EXPECT_EQ(buffer, ExpectedBuffer(MakeFrame(3, 5)));
+            }
+            stats = cache.GetStats();
+            EXPECT_EQ(stats.hits + stats.shared, 3u + received.size() - 1);
+
+            cache.Invalidate("test");
+            EXPECT_EQ(cache.GetStats().entries, 0u);
+            get(3, StreamOptions());
+            EXPECT_EQ(loads, 6);
+        }
+
+    } // namespace test
+} // namespace simularium
+} // namespace aics
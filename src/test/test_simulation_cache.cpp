@@ -0,0 +1,234 @@
+#include "simularium/simulation_cache.h"
+#include "simularium/config/config.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace aics {
+namespace simularium {
+    namespace test {
+        class SimulationCacheTests : public ::testing::Test {
+        protected:
+            TrajectoryFrame MakeFrame(std::size_t frameNumber, std::size_t numAgents)
+            {
+                TrajectoryFrame frame;
+                frame.frameNumber = frameNumber;
+                frame.time = frameNumber * 0.5f;
+
+                for (std::size_t i = 0; i < numAgents; ++i) {
+                    AgentData ad;
+                    ad.vis_type = 1000;
+                    ad.id = i;
+                    ad.type = i % 3;
+                    ad.x = frameNumber + i;
+                    ad.y = frameNumber - 1.5f * i;
+                    ad.z = 2.f * i;
+                    ad.collision_radius = 1;
+                    frame.data.push_back(ad);
+                }
+
+                return frame;
+            }
+
+            // Settings the tests change, restored to what the process had
+            std::vector<std::string> m_envNames = {
+                "SIMULARIUM_STORAGE",
+                "SIMULARIUM_CACHE_OPEN_FILES",
+                "SIMULARIUM_CACHE_DISK_QUOTA",
+                "SIMULARIUM_CACHE_PERSISTENT",
+                "SIMULARIUM_CACHE_CHECKPOINT_INTERVAL",
+                "SIMULARIUM_CACHE_RANGE_BYTES",
+                "SIMULARIUM_STORAGE_FOLDER",
+            };
+            std::map<std::string, std::string> m_savedEnv;
+            std::vector<std::string> m_identifiers;
+
+            std::string AddIdentifier(std::string identifier)
+            {
+                this->m_identifiers.push_back(identifier);
+                return identifier;
+            }
+
+            void SetUp() override
+            {
+                for (auto& name : this->m_envNames) {
+                    char* value = std::getenv(name.c_str());
+                    if (value) {
+                        this->m_savedEnv[name] = value;
+                    }
+                    unsetenv(name.c_str());
+                }
+                setenv("SIMULARIUM_STORAGE", "local", 1);
+            }
+
+            void TearDown() override
+            {
+                std::string folder = config::GetCacheFolder();
+                for (auto& identifier : this->m_identifiers) {
+                    fileio::SegmentedBinaryFile::Remove(folder + identifier + ".bin");
+                    std::remove((folder + identifier + ".info").c_str());
+                    std::remove((folder + identifier + ".ckpt").c_str());
+                }
+                std::remove((folder + "warm_caches.json").c_str());
+
+                // Caches uploaded to the storage folder of a test
+                char* storageFolder = std::getenv("SIMULARIUM_STORAGE_FOLDER");
+                for (auto& identifier : this->m_identifiers) {
+                    if (storageFolder) {
+                        std::string objectPath = std::string(storageFolder) + config::GetS3CacheLocation() + identifier;
+                        fileio::SegmentedBinaryFile::Remove(objectPath + ".bin");
+                        std::remove((objectPath + ".info").c_str());
+                    }
+                }
+
+                for (auto& name : this->m_envNames) {
+                    auto saved = this->m_savedEnv.find(name);
+                    if (saved != this->m_savedEnv.end()) {
+                        setenv(name.c_str(), saved->second.c_str(), 1);
+                    } else {
+                        unsetenv(name.c_str());
+                    }
+                }
+            }
+        };
+
+        TEST_F(SimulationCacheTests, WritingCacheIsNotEvicted)
+        {
+            // One cache can be open, and none fit on disk
+            setenv("SIMULARIUM_CACHE_OPEN_FILES", "1", 1);
+            setenv("SIMULARIUM_CACHE_DISK_QUOTA", "1", 1);
+            SimulationCache cache;
+
+            std::size_t numFrames = 200;
+            std::string writing = AddIdentifier("writing");
+            std::thread writer([&cache, &writing, numFrames, this] {
+                for (std::size_t i = 0; i < numFrames; ++i) {
+                    cache.AddFrame(writing, MakeFrame(i, 8));
+                }
+            });
+
+            // Other conversions open, and finish, caches while it is written
+            for (std::size_t i = 0; i < 20; ++i) {
+                std::string identifier = AddIdentifier("other" + std::to_string(i));
+                cache.AddFrame(identifier, MakeFrame(0, 8));
+                cache.FinishConversion(identifier);
+            }
+            writer.join();
+
+            EXPECT_EQ(cache.GetNumFrames(writing), numFrames);
+            EXPECT_EQ(cache.GetNextMissingFrame(writing, 0), numFrames);
+
+            // Once finished, it is evicted like any other cache
+            cache.FinishConversion(writing);
+            std::string later = AddIdentifier("later");
+            cache.AddFrame(later, MakeFrame(0, 8));
+            cache.FinishConversion(later);
+            EXPECT_EQ(cache.GetNumFrames(writing), 0u);
+        }
+
+        TEST_F(SimulationCacheTests, ConcurrentOpens)
+        {
+            SimulationCache cache;
+            std::string identifier = AddIdentifier("opened");
+
+            // Threads that open the cache at once all get the same one
+            std::vector<std::thread> openers;
+            for (std::size_t i = 0; i < 8; ++i) {
+                openers.emplace_back([&cache, &identifier] {
+                    EXPECT_EQ(cache.GetWritePosition(identifier), 0u);
+                });
+            }
+            for (auto& opener : openers) {
+                opener.join();
+            }
+
+            std::size_t numFrames = 20;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                cache.AddFrame(identifier, MakeFrame(i, 8));
+            }
+            cache.FinishConversion(identifier);
+            EXPECT_EQ(cache.GetNumFrames(identifier), numFrames);
+            EXPECT_EQ(cache.GetNextMissingFrame(identifier, 0), numFrames);
+        }
+
+        TEST_F(SimulationCacheTests, ConcurrentKeptCaches)
+        {
+            setenv("SIMULARIUM_CACHE_PERSISTENT", "1", 1);
+            std::vector<std::string> identifiers;
+            for (std::size_t i = 0; i < 16; ++i) {
+                identifiers.push_back(AddIdentifier("kept" + std::to_string(i)));
+            }
+
+            // Conversions finish on several threads at once
+            {
+                SimulationCache cache;
+                std::vector<std::thread> converters;
+                for (std::size_t t = 0; t < 4; ++t) {
+                    converters.emplace_back([&cache, &identifiers, t, this] {
+                        for (std::size_t i = t; i < identifiers.size(); i += 4) {
+                            cache.AddFrame(identifiers[i], MakeFrame(0, 8));
+                            cache.FinishConversion(identifiers[i]);
+                        }
+                    });
+                }
+                for (auto& converter : converters) {
+                    converter.join();
+                }
+            }
+
+            SimulationCache restarted;
+            for (auto& identifier : identifiers) {
+                EXPECT_TRUE(restarted.LoadWarmCache(identifier)) << identifier;
+            }
+        }
+
+        TEST_F(SimulationCacheTests, RangedDownload)
+        {
+            setenv("SIMULARIUM_STORAGE_FOLDER", "trajectory/storage/", 1);
+            setenv("SIMULARIUM_CACHE_RANGE_BYTES", "4096", 1);
+            SimulationCache cache;
+            std::string identifier = AddIdentifier("ranged");
+
+            std::size_t numFrames = 100;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                cache.AddFrame(identifier, MakeFrame(i, 20));
+            }
+            cache.FinishConversion(identifier);
+            ASSERT_TRUE(cache.UploadRuntimeCache(identifier));
+
+            // The info file only needs the fields a download checks for
+            {
+                std::ofstream os(std::string(std::getenv("SIMULARIUM_STORAGE_FOLDER")) + config::GetS3CacheLocation() + identifier + ".info");
+                os << "{ \"version\": 3, \"size\": {}, \"typeMapping\": {}, \"fileName\": \"" << identifier
+                   << "\", \"totalSteps\": " << numFrames << ", \"timeStepSize\": 0.5, \"spatialUnitFactorMeters\": 1e-9 }";
+            }
+
+            std::vector<BroadcastDataBuffer> expected;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                expected.push_back(fileio::ToBroadcastBuffer(cache.GetBroadcastFrame(identifier, i)));
+            }
+            cache.ClearCache(identifier);
+
+            // The cache is opened once its first frames are there, and
+            //  the others follow in the background
+            ASSERT_TRUE(cache.DownloadRuntimeCache(identifier));
+            EXPECT_GT(cache.GetNumFrames(identifier), 0u);
+            for (std::size_t i = 0; i < 1000 && cache.GetNumFrames(identifier) < numFrames; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            ASSERT_EQ(cache.GetNumFrames(identifier), numFrames);
+
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                EXPECT_EQ(fileio::ToBroadcastBuffer(cache.GetBroadcastFrame(identifier, i)), expected[i]) << i;
+            }
+        }
+
+    } // namespace test
+} // namespace simularium
+} // namespace aics
@@ -0,0 +1,102 @@
+#include "simularium/storage/storage_backend.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace aics {
+namespace simularium {
+    namespace test {
+        class StorageBackendTests : public ::testing::Test {
+        protected:
+            std::string m_rootFolder = "trajectory/test_storage";
+            std::string m_filePath = "trajectory/test_storage_file.bin";
+
+            void WriteFile(const std::string& filePath, const std::string& contents)
+            {
+                std::ofstream os(filePath, std::ios::binary | std::ios::trunc);
+                os << contents;
+            }
+
+            std::string ReadFile(const std::string& filePath)
+            {
+                std::ifstream is(filePath, std::ios::binary);
+                return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+            }
+
+            void TearDown() override
+            {
+                std::string cmd = "rm -rf " + this->m_rootFolder;
+                int ignore = system(cmd.c_str());
+                std::remove(this->m_filePath.c_str());
+                std::remove((this->m_filePath + ".copy").c_str());
+            }
+        };
+
+        TEST_F(StorageBackendTests, LocalUploadAndDownload)
+        {
+            storage::LocalStorageBackend backend(this->m_rootFolder);
+            WriteFile(this->m_filePath, "frames");
+
+            std::string etag;
+            EXPECT_FALSE(backend.GetETag("trajectory/test.h5.bin", etag));
+            EXPECT_FALSE(backend.Download("trajectory/test.h5.bin", this->m_filePath + ".copy"));
+
+            // Folders of the object are created
+            ASSERT_TRUE(backend.Upload(this->m_filePath, "trajectory/test.h5.bin"));
+            ASSERT_TRUE(backend.GetETag("trajectory/test.h5.bin", etag));
+            ASSERT_TRUE(backend.Download("trajectory/test.h5.bin", this->m_filePath + ".copy"));
+            EXPECT_EQ(ReadFile(this->m_filePath + ".copy"), "frames");
+
+            // The tag changes with the object
+            WriteFile(this->m_filePath, "more frames");
+            ASSERT_TRUE(backend.Upload(this->m_filePath, "trajectory/test.h5.bin"));
+            std::string newEtag;
+            ASSERT_TRUE(backend.GetETag("trajectory/test.h5.bin", newEtag));
+            EXPECT_NE(etag, newEtag);
+
+            // Objects can't be outside of the folder
+            EXPECT_FALSE(backend.Upload(this->m_filePath, "../test.h5.bin"));
+            EXPECT_FALSE(backend.Upload(this->m_filePath, "trajectory/../../test.h5.bin"));
+            EXPECT_FALSE(backend.Download("/etc/hostname", this->m_filePath + ".copy"));
+        }
+
+        TEST_F(StorageBackendTests, LocalTransferAll)
+        {
+            storage::LocalStorageBackend backend(this->m_rootFolder);
+            std::vector<storage::FileTransfer> uploads;
+            for (std::size_t i = 0; i < 4; ++i) {
+                storage::FileTransfer transfer;
+                transfer.fileName = this->m_filePath + std::to_string(i);
+                transfer.objectName = "trajectory/test.h5.bin.seg" + std::to_string(i);
+                WriteFile(transfer.fileName, "segment " + std::to_string(i));
+                uploads.push_back(transfer);
+            }
+            EXPECT_TRUE(backend.UploadAll(uploads));
+
+            std::vector<storage::FileTransfer> downloads = uploads;
+            for (auto& transfer : downloads) {
+                std::remove(transfer.fileName.c_str());
+            }
+            EXPECT_TRUE(backend.DownloadAll(downloads));
+            for (std::size_t i = 0; i < downloads.size(); ++i) {
+                EXPECT_EQ(ReadFile(downloads[i].fileName), "segment " + std::to_string(i));
+            }
+
+            // One missing object fails the batch, the others are still fetched
+            storage::FileTransfer missing;
+            missing.fileName = this->m_filePath + "missing";
+            missing.objectName = "trajectory/missing.bin";
+            downloads.push_back(missing);
+            EXPECT_FALSE(backend.DownloadAll(downloads));
+
+            for (auto& transfer : downloads) {
+                std::remove(transfer.fileName.c_str());
+            }
+        }
+
+    } // namespace test
+} // namespace simularium
+} // namespace aics